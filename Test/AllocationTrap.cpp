@@ -0,0 +1,164 @@
+/*
+ *   Copyright (c) 2025 Robin E. R. Davies
+ *   All rights reserved.
+
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ 
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ 
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ */
+
+#include "AllocationTrap.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+using namespace toob;
+
+// Name of the trapped scope on this thread, or nullptr if allocations are allowed.
+static thread_local const char* trapScope = nullptr;
+
+AllocationTrap::AllocationTrap(const char* scopeName)
+{
+	previousScope = trapScope;
+	trapScope = scopeName;
+}
+
+AllocationTrap::~AllocationTrap()
+{
+	trapScope = previousScope;
+}
+
+#ifdef TOOB_TRAP_RT_ALLOCATIONS
+
+bool AllocationTrap::IsEnabled() { return true; }
+
+extern "C" {
+	extern void* __libc_malloc(size_t size);
+	extern void* __libc_calloc(size_t count, size_t size);
+	extern void* __libc_realloc(void* ptr, size_t size);
+	extern void* __libc_memalign(size_t alignment, size_t size);
+	extern void __libc_free(void* ptr);
+}
+
+static void CheckAllocation(const char* function)
+{
+	const char* scope = trapScope;
+	if (scope != nullptr)
+	{
+		trapScope = nullptr;
+		// no stdio: it allocates.
+		const char* message = "Error: Allocation on the audio thread. (";
+		(void)!write(STDERR_FILENO, message, strlen(message));
+		(void)!write(STDERR_FILENO, function, strlen(function));
+		(void)!write(STDERR_FILENO, " in ", 4);
+		(void)!write(STDERR_FILENO, scope, strlen(scope));
+		(void)!write(STDERR_FILENO, ")\n", 2);
+		abort();
+	}
+}
+
+extern "C" {
+	void* malloc(size_t size)
+	{
+		CheckAllocation("malloc");
+		return __libc_malloc(size);
+	}
+	void* calloc(size_t count, size_t size)
+	{
+		CheckAllocation("calloc");
+		return __libc_calloc(count, size);
+	}
+	void* realloc(void* ptr, size_t size)
+	{
+		CheckAllocation("realloc");
+		return __libc_realloc(ptr, size);
+	}
+	void* aligned_alloc(size_t alignment, size_t size)
+	{
+		CheckAllocation("aligned_alloc");
+		return __libc_memalign(alignment, size);
+	}
+	int posix_memalign(void** result, size_t alignment, size_t size)
+	{
+		CheckAllocation("posix_memalign");
+		void* p = __libc_memalign(alignment, size);
+		if (p == nullptr)
+		{
+			return ENOMEM;
+		}
+		*result = p;
+		return 0;
+	}
+	void free(void* ptr)
+	{
+		__libc_free(ptr);
+	}
+}
+
+static void* NewImpl(size_t size, const char* function)
+{
+	CheckAllocation(function);
+	void* p = __libc_malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+static void* AlignedNewImpl(size_t size, std::align_val_t alignment, const char* function)
+{
+	CheckAllocation(function);
+	void* p = __libc_memalign((size_t)alignment, size == 0 ? 1 : size);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size) { return NewImpl(size, "operator new"); }
+void* operator new[](size_t size) { return NewImpl(size, "operator new[]"); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	CheckAllocation("operator new");
+	return __libc_malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	CheckAllocation("operator new[]");
+	return __libc_malloc(size == 0 ? 1 : size);
+}
+void* operator new(size_t size, std::align_val_t alignment) { return AlignedNewImpl(size, alignment, "operator new"); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AlignedNewImpl(size, alignment, "operator new[]"); }
+
+void operator delete(void* p) noexcept { __libc_free(p); }
+void operator delete[](void* p) noexcept { __libc_free(p); }
+void operator delete(void* p, size_t) noexcept { __libc_free(p); }
+void operator delete[](void* p, size_t) noexcept { __libc_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { __libc_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { __libc_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { __libc_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { __libc_free(p); }
+
+#else
+
+bool AllocationTrap::IsEnabled() { return false; }
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *   Copyright (c) 2025 Robin E. R. Davies
+ *   All rights reserved.
+
+ *   Permission is hereby granted, free of charge, to any person obtaining a copy
+ *   of this software and associated documentation files (the "Software"), to deal
+ *   in the Software without restriction, including without limitation the rights
+ *   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *   copies of the Software, and to permit persons to whom the Software is
+ *   furnished to do so, subject to the following conditions:
+ 
+ *   The above copyright notice and this permission notice shall be included in all
+ *   copies or substantial portions of the Software.
+ 
+ *   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *   SOFTWARE.
+ */
+#pragma once
+
+namespace toob {
+
+	/// <summary>
+	/// Traps memory allocations made on the current thread while an instance is live.
+	/// </summary>
+	/// <remarks>
+	/// Only active when AllocationTrap.cpp is compiled with TOOB_TRAP_RT_ALLOCATIONS defined (as it
+	/// is for the TestHost library and hostTest), in which case the test executable replaces the
+	/// global operator new and the malloc family. An allocation made inside a trapped scope (e.g. a
+	/// plugin's run() call) prints the offending scope and aborts, so that the culprit can be found
+	/// in a debugger or core dump. Otherwise a no-op.
+	/// </remarks>
+	class AllocationTrap {
+	public:
+		AllocationTrap(const char* scopeName);
+		~AllocationTrap();
+
+		AllocationTrap(const AllocationTrap&) = delete;
+		AllocationTrap& operator=(const AllocationTrap&) = delete;
+
+		static bool IsEnabled();
+	private:
+		const char* previousScope;
+	};
+}
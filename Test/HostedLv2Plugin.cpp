@@ -23,6 +23,9 @@
 
 #include "HostedLv2Plugin.h"
 #include "Lv2Exception.h"
+#include "AllocationTrap.h"
+#include "lv2/atom/forge.h"
+#include <cstring>
 
 
 using namespace toob;
@@ -72,6 +75,10 @@ void HostedLv2Plugin::Instantiate(const LV2_Descriptor* descriptor, const char*
 {
 	this->instance = descriptor->instantiate(descriptor, host->GetSampleRate(), resourcePath, host->GetFeatures());
 	this->descriptor = descriptor;
+	if (descriptor->extension_data)
+	{
+		this->workerInterface = (const LV2_Worker_Interface*)descriptor->extension_data(LV2_WORKER__interface);
+	}
 
 	
 }
@@ -158,7 +165,7 @@ void HostedLv2Plugin::SetPortType(int port, PortType portType, uint32_t bufferSi
 		LV2_Atom* pAtom = (LV2_Atom*)(void*)buffer;
 		pAtom->size = bufferSize - 8;
 		pAtom->type = uris.ridAtomSequence;
-		inputAtomStreams.push_back(AtomStreamEntry(port, pAtom, bufferSize));
+		outputAtomStreams.push_back(AtomStreamEntry(port, pAtom, bufferSize));
 		ConnectPort(port, buffer);
 	}
 	break;
@@ -211,9 +218,21 @@ void HostedLv2Plugin::PrepareAtomPorts()
 {
 	for (auto i = inputAtomStreams.begin(); i != inputAtomStreams.end(); ++i)
 	{
-		(*i).buffer->type = uris.ridAtomSequence;
-		(*i).buffer->size = 0;
-
+		LV2_Atom_Sequence* sequence = (LV2_Atom_Sequence*)(*i).buffer;
+		sequence->atom.type = uris.ridAtomSequence;
+		sequence->atom.size = sizeof(LV2_Atom_Sequence_Body);
+		sequence->body.unit = 0;
+		sequence->body.pad = 0;
+		if (!i->pendingEvents.empty())
+		{
+			if (sizeof(LV2_Atom_Sequence) + i->pendingEvents.size() > i->size)
+			{
+				throw Lv2Exception("Input atom buffer too small.");
+			}
+			memcpy(sequence + 1, i->pendingEvents.data(), i->pendingEvents.size());
+			sequence->atom.size += (uint32_t)i->pendingEvents.size();
+			i->pendingEvents.clear();
+		}
 	}
 	for (auto i = outputAtomStreams.begin(); i != outputAtomStreams.end(); ++i)
 	{
@@ -224,6 +243,7 @@ void HostedLv2Plugin::PrepareAtomPorts()
 }
 void HostedLv2Plugin::Run(uint32_t samples)
 {
+	AllocationTrap allocationTrap(this->descriptor->URI);
 	this->descriptor->run(this->instance,samples);
 
 }
@@ -231,3 +251,55 @@ void HostedLv2Plugin::Deactivate()
 {
 	this->descriptor->deactivate(this->instance);
 }
+
+LV2_Worker_Status HostedLv2Plugin::Work(LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+	if (workerInterface == nullptr)
+	{
+		throw Lv2Exception("Work scheduled by a plugin that has no worker interface.");
+	}
+	return workerInterface->work(this->instance, respond, handle, size, data);
+}
+
+LV2_Worker_Status HostedLv2Plugin::WorkResponse(uint32_t size, const void* data)
+{
+	// work_response() is called in the audio thread's context.
+	AllocationTrap allocationTrap(this->descriptor->URI);
+	return workerInterface->work_response(this->instance, size, data);
+}
+
+void HostedLv2Plugin::EndRun()
+{
+	if (workerInterface != nullptr && workerInterface->end_run != nullptr)
+	{
+		AllocationTrap allocationTrap(this->descriptor->URI);
+		workerInterface->end_run(this->instance);
+	}
+}
+
+void HostedLv2Plugin::SetPathProperty(int port, const char* propertyUri, const char* path)
+{
+	for (auto i = inputAtomStreams.begin(); i != inputAtomStreams.end(); ++i)
+	{
+		if (i->port == port)
+		{
+			std::vector<uint8_t> buffer(strlen(path) + 256);
+			LV2_Atom_Forge forge;
+			lv2_atom_forge_init(&forge, host->GetUridMap());
+			lv2_atom_forge_set_buffer(&forge, buffer.data(), buffer.size());
+
+			lv2_atom_forge_frame_time(&forge, 0);
+			LV2_Atom_Forge_Frame objectFrame;
+			lv2_atom_forge_object(&forge, &objectFrame, 0, uris.ridPatchSet);
+			lv2_atom_forge_key(&forge, uris.ridPatchProperty);
+			lv2_atom_forge_urid(&forge, host->MapURI(propertyUri));
+			lv2_atom_forge_key(&forge, uris.ridPatchValue);
+			lv2_atom_forge_path(&forge, path, (uint32_t)strlen(path));
+			lv2_atom_forge_pop(&forge, &objectFrame);
+
+			i->pendingEvents.insert(i->pendingEvents.end(), buffer.begin(), buffer.begin() + forge.offset);
+			return;
+		}
+	}
+	throw Lv2Exception("Not an input atom port.");
+}
@@ -28,7 +28,10 @@
 #include "InputControl.h"
 #include "OutputControl.h"
 #include "lv2/core/lv2.h"
+#include "lv2/patch/patch.h"
+#include "lv2/worker/worker.h"
 #include "Lv2Exception.h"
+#include <cstdint>
 
 
 namespace toob {
@@ -49,6 +52,8 @@ namespace toob {
 			int port;
 			LV2_Atom* buffer;
 			uint32_t size;
+			// events to send on the next cycle.
+			std::vector<uint8_t> pendingEvents;
 		public:
 
 			AtomStreamEntry()
@@ -81,9 +86,15 @@ namespace toob {
 			void Map(Lv2Host* host)
 			{
 				ridAtomSequence = host->MapURI(LV2_ATOM__Sequence);
+				ridPatchSet = host->MapURI(LV2_PATCH__Set);
+				ridPatchProperty = host->MapURI(LV2_PATCH__property);
+				ridPatchValue = host->MapURI(LV2_PATCH__value);
 			}
 
 			LV2_URID ridAtomSequence;
+			LV2_URID ridPatchSet;
+			LV2_URID ridPatchProperty;
+			LV2_URID ridPatchValue;
 		};
 		Uris uris;
 		std::vector <float*> ioBuffers;
@@ -93,6 +104,7 @@ namespace toob {
 		std::vector <AtomStreamEntry> outputAtomStreams;
 		const LV2_Descriptor* descriptor;
 		LV2_Handle instance;
+		const LV2_Worker_Interface* workerInterface = nullptr;
 
 		std::vector<PortType> portTypes;
 		Lv2Host* host;
@@ -119,6 +131,10 @@ namespace toob {
 		void Run(uint32_t samples);
 		void Deactivate();
 
+		LV2_Worker_Status Work(LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle handle, uint32_t size, const void* data);
+		LV2_Worker_Status WorkResponse(uint32_t size, const void* data);
+		void EndRun();
+
 	public:
 		void ConnectPort(int port, void* data);
 
@@ -144,5 +160,15 @@ namespace toob {
 		{
 			inputControls[control]->SetValue(value);
 		}
+
+		float GetControlOutput(int control)
+		{
+			return outputControls[control]->GetValue();
+		}
+
+		/// <summary>
+		/// Send a patch:Set message with an atom:Path value to an input atom port on the next cycle.
+		/// </summary>
+		void SetPathProperty(int port, const char* propertyUri, const char* path);
 	};
 };
\ No newline at end of file
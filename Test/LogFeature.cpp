@@ -58,6 +58,7 @@ int LogFeature::vprintf(LV2_URID type,const char*fmt, va_list va)
 	if (type == uris.ridError)
 	{
 		prefix = "Error";
+		++errorCount;
 	}
 	else if (type == uris.ridWarning)
 	{
@@ -37,6 +37,7 @@
 #include <map>
 #include <string>
 #include <mutex>
+#include <atomic>
 
 
 namespace toob {
@@ -47,6 +48,7 @@ namespace toob {
 		LV2_Feature feature;
 		LV2_Log_Log log;
 		std::mutex logMutex;
+		std::atomic<int> errorCount = 0;
 		struct Uri {
 			void Map(MapFeature* map)
 			{
@@ -73,6 +75,10 @@ namespace toob {
 			return &feature;
 		}
 		LV2_URID GetUrid(const char* uri);
+		int GetErrorCount() const
+		{
+			return errorCount;
+		}
 	private:
 		static int printfFn(LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...);
 
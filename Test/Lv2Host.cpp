@@ -25,6 +25,7 @@
 #include "Lv2Host.h"
 #include "HostedLv2Plugin.h"
 #include "Lv2Api.h"
+#include <cstring>
 #include <filesystem>
 #include <stdexcept>
 
@@ -57,8 +58,11 @@ void Lv2Host::Activate()
 {
 	for (auto plugin : activePlugins)
 	{
+		scheduleFeature.SetCurrentPlugin(plugin);
 		plugin->Activate();
 	}
+	scheduleFeature.SetCurrentPlugin(nullptr);
+	scheduleFeature.RunWork();
 }
 void Lv2Host::Deactivate()
 {
@@ -66,6 +70,7 @@ void Lv2Host::Deactivate()
 	{
 		plugin->Deactivate();
 	}
+	scheduleFeature.Clear();
 }
 void Lv2Host::Run(int samples)
 {
@@ -75,8 +80,17 @@ void Lv2Host::Run(int samples)
 	}
 	for (auto plugin : activePlugins)
 	{
+		scheduleFeature.SetCurrentPlugin(plugin);
 		plugin->Run(samples);
 	}
+	scheduleFeature.SetCurrentPlugin(nullptr);
+
+	// Execute scheduled work inline, as if the worker thread had completed it before the next cycle.
+	scheduleFeature.RunWork();
+	for (auto plugin : activePlugins)
+	{
+		plugin->EndRun();
+	}
 }
 
 
@@ -25,6 +25,7 @@
 
 #include "MapFeature.h"
 #include "LogFeature.h"
+#include "ScheduleFeature.h"
 #include <vector>
 #include "Lv2Exception.h"
 #include "lv2/urid/urid.h"
@@ -42,6 +43,7 @@ namespace toob {
 		int maxBufferSize;
 		MapFeature mapFeature;
 		LogFeature logFeature;
+		ScheduleFeature scheduleFeature;
 
 		std::vector<const LV2_Feature*> features;
 		const LV2_Feature** pFeatures = 0;
@@ -55,6 +57,7 @@ namespace toob {
 			features.push_back(mapFeature.GetFeature());
 			logFeature.Prepare(&mapFeature);
 			features.push_back(logFeature.GetFeature());
+			features.push_back(scheduleFeature.GetFeature());
 		}
 		virtual ~Lv2Host();
 
@@ -62,6 +65,10 @@ namespace toob {
 		{
 			return mapFeature.GetUrid(uri);
 		}
+		LV2_URID_Map* GetUridMap()
+		{
+			return mapFeature.GetMap();
+		}
 	protected:
 		void AddFeature(const LV2_Feature* feature)
 		{
@@ -95,6 +102,10 @@ namespace toob {
 		float GetSampleRate() const {
 			return this->sampleRate;
 		}
+		// The number of messages that plugins have logged with type log:Error.
+		int GetLogErrorCount() const {
+			return logFeature.GetErrorCount();
+		}
 
 		HostedLv2Plugin* CreatePlugin(const char* libName, int instance);
 		HostedLv2Plugin* CreatePlugin(const char* libName, const char*pluginUri);
@@ -57,6 +57,10 @@ namespace toob {
 			return &feature;
 		}
 		LV2_URID GetUrid(const char* uri);
+		LV2_URID_Map* GetMap()
+		{
+			return &map;
+		}
 
 	};
 }
\ No newline at end of file
@@ -22,7 +22,9 @@
  */
 
 #include "ScheduleFeature.h"
-#include <mutex>
+#include "HostedLv2Plugin.h"
+#include <cstring>
+#include <utility>
 
 
 using namespace toob;
@@ -33,14 +35,39 @@ static LV2_Worker_Status scheduleWorkFn(
 	const void* data)
 {
 	ScheduleFeature* feature = (ScheduleFeature*)(void*)handle;
-	feature->ScheduleWork(size, data);
+	return feature->ScheduleWork(size, data);
+}
 
-	return LV2_WORKER_SUCCESS;
+ScheduleFeature::WorkQueue::WorkQueue(size_t capacity)
+	: buffer(capacity)
+{
+}
 
+bool ScheduleFeature::WorkQueue::Write(HostedLv2Plugin* plugin, uint32_t size, const void* data)
+{
+	size_t entrySize = EntrySize(size);
+	if (used + entrySize > buffer.size())
+	{
+		return false;
+	}
+	Header* header = (Header*)(buffer.data() + used);
+	header->plugin = plugin;
+	header->size = size;
+	memcpy(header + 1, data, size);
+	used += entrySize;
+	return true;
+}
 
+void ScheduleFeature::WorkQueue::Swap(WorkQueue& other)
+{
+	buffer.swap(other.buffer);
+	std::swap(used, other.used);
 }
 
-ScheduleFeature::ScheduleFeature()
+ScheduleFeature::ScheduleFeature(size_t queueSize)
+	: workQueue(queueSize),
+	  processingQueue(queueSize),
+	  responseQueue(queueSize)
 {
 	feature.URI = LV2_WORKER__schedule;
 	feature.data = &schedule;
@@ -50,12 +77,58 @@ ScheduleFeature::ScheduleFeature()
 }
 
 
-void ScheduleFeature::ScheduleWork(
+LV2_Worker_Status ScheduleFeature::ScheduleWork(
 	uint32_t     size,
 	const void* data
 )
 {
+	if (currentPlugin == nullptr)
+	{
+		return LV2_WORKER_ERR_UNKNOWN;
+	}
+	if (!workQueue.Write(currentPlugin, size, data))
+	{
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	return LV2_WORKER_SUCCESS;
+}
 
+LV2_Worker_Status ScheduleFeature::RespondFn(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+	ScheduleFeature* this_ = (ScheduleFeature*)(void*)handle;
+	if (!this_->responseQueue.Write(this_->workingPlugin, size, data))
+	{
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	return LV2_WORKER_SUCCESS;
 }
 
+void ScheduleFeature::RunWork()
+{
+	HostedLv2Plugin* savedPlugin = currentPlugin;
+	while (!workQueue.IsEmpty())
+	{
+		processingQueue.Swap(workQueue);
+		processingQueue.ForEach(
+			[this](HostedLv2Plugin* plugin, uint32_t size, const void* data) {
+				workingPlugin = plugin;
+				plugin->Work(RespondFn, (LV2_Worker_Respond_Handle)this, size, data);
+			});
+		workingPlugin = nullptr;
+		processingQueue.Clear();
+
+		responseQueue.ForEach(
+			[this](HostedLv2Plugin* plugin, uint32_t size, const void* data) {
+				currentPlugin = plugin;
+				plugin->WorkResponse(size, data);
+			});
+		responseQueue.Clear();
+	}
+	currentPlugin = savedPlugin;
+}
 
+void ScheduleFeature::Clear()
+{
+	workQueue.Clear();
+	responseQueue.Clear();
+}
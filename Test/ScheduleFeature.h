@@ -35,27 +35,98 @@
 #include "lv2/atom/atom.h"
 #include "lv2/worker/worker.h"
 
-#include <map>
-#include <string>
-#include <mutex>
+#include <cstdint>
+#include <vector>
 
 namespace toob {
+	class HostedLv2Plugin;
+
+	/// <summary>
+	/// LV2 worker feature for test hosts.
+	/// </summary>
+	/// <remarks>
+	/// Work scheduled by a plugin is queued, and executed inline on the host thread by RunWork()
+	/// once the current cycle's run() calls have completed. Responses are then delivered
+	/// through the plugin's work_response(). Queues are preallocated, so neither schedule_work()
+	/// nor respond() allocates memory.
+	/// </remarks>
 	class ScheduleFeature {
 
 	private:
+		class WorkQueue {
+		public:
+			WorkQueue(size_t capacity);
+
+			bool Write(HostedLv2Plugin* plugin, uint32_t size, const void* data);
+			bool IsEmpty() const { return used == 0; }
+			void Clear() { used = 0; }
+			void Swap(WorkQueue& other);
+
+			template <typename FN>
+			void ForEach(FN fn)
+			{
+				size_t position = 0;
+				while (position < used)
+				{
+					const Header* header = (const Header*)(buffer.data() + position);
+					fn(header->plugin, header->size, (const void*)(header + 1));
+					position += EntrySize(header->size);
+				}
+			}
+		private:
+			struct Header {
+				HostedLv2Plugin* plugin;
+				uint32_t size;
+			};
+			static size_t EntrySize(uint32_t size)
+			{
+				return (sizeof(Header) + size + 7) & ~(size_t)7;
+			}
+			std::vector<uint8_t> buffer;
+			size_t used = 0;
+		};
+
 		LV2_Feature feature;
 		LV2_Worker_Schedule schedule;
-		std::mutex mapMutex;
+
+		HostedLv2Plugin* currentPlugin = nullptr;
+		HostedLv2Plugin* workingPlugin = nullptr;
+		WorkQueue workQueue;
+		WorkQueue processingQueue;
+		WorkQueue responseQueue;
+
+		static LV2_Worker_Status RespondFn(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data);
 
 	public:
-		ScheduleFeature();
+		ScheduleFeature(size_t queueSize = 64 * 1024);
 
 		const LV2_Feature* GetFeature()
 		{
 			return &feature;
 		}
 
-		void ScheduleWork(uint32_t     size, const void* data);
+		/// <summary>
+		/// Set the plugin that subsequent calls to schedule_work() are made on behalf of.
+		/// </summary>
+		void SetCurrentPlugin(HostedLv2Plugin* plugin)
+		{
+			currentPlugin = plugin;
+		}
+
+		LV2_Worker_Status ScheduleWork(uint32_t     size, const void* data);
+
+		/// <summary>
+		/// Execute queued work, and deliver the responses.
+		/// </summary>
+		/// <remarks>
+		/// Repeats until no work is pending, since work_response() may schedule more work.
+		/// </remarks>
+		void RunWork();
+
+		/// <summary>
+		/// Discard queued work without executing it.
+		/// </summary>
+		void Clear();
 
 	};
 }
\ No newline at end of file
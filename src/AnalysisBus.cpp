@@ -0,0 +1,543 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "AnalysisBus.hpp"
+#include "LsNumerics/HalfbandOversampler.hpp"
+#include "LsNumerics/StagedFft.hpp"
+#include "LsNumerics/Window.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+using namespace toob;
+
+static constexpr double CAPTURE_SECONDS = 0.5;
+static constexpr size_t MIN_LEVEL_HISTORY = 8192;
+static constexpr size_t DECIMATOR_LENGTH = 47;
+static constexpr double DECIMATOR_STOPBAND_DB = 90;
+static constexpr size_t DECIMATION_CHUNK_SIZE = 512;
+// larger blocks are captured privately.
+static constexpr size_t MAX_SYNCHRONIZED_BLOCK_SIZE = 8192;
+// blocks to wait for a matching block from another instance, before deciding that the input is different.
+static constexpr size_t MAX_SYNCHRONIZE_ATTEMPTS = 4;
+
+static size_t NextPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+namespace toob
+{
+    class AnalysisBus::Tap
+    {
+    public:
+        Tap(double sampleRate)
+            : sampleRate(sampleRate)
+        {
+            captureBuffer.resize(NextPowerOfTwo((size_t)(sampleRate * CAPTURE_SECONDS)));
+            captureMask = captureBuffer.size() - 1;
+            decimatorPrototype = LsNumerics::HalfbandOversampler::DesignLinearPhase(DECIMATOR_LENGTH, DECIMATOR_STOPBAND_DB);
+        }
+
+        double GetSampleRate(size_t level) const { return sampleRate / (1 << level); }
+
+        // Audio thread.
+        uint64_t GetWritePosition() const { return writePosition.load(std::memory_order_acquire); }
+        // Samples more than this far behind the write position may be overwritten at any time.
+        uint64_t GetMaxLag() const { return captureBuffer.size() / 2; }
+        bool Matches(uint64_t position, const float *input, size_t count) const;
+        // Verify the samples that have already been captured, and capture the rest. Returns false if
+        // the input doesn't match what has already been captured.
+        bool Write(uint64_t &position, const float *input, size_t count);
+
+        size_t AddStft(const StftConfig &config);
+        void ReadFrames(
+            size_t stft,
+            uint64_t &nextFrame,
+            const std::function<void(uint64_t frameIndex, const spectrum_t &spectrum)> &onFrame);
+        uint64_t GetFftCount()
+        {
+            std::lock_guard lock{mutex};
+            return fftCount;
+        }
+
+    private:
+        struct Level
+        {
+            LsNumerics::HalfbandStage decimator; // produces the next level's input.
+            std::vector<float> history;          // circular.
+            size_t historyMask = 0;
+            uint64_t count = 0; // samples since the tap was created.
+            bool hasOddSample = false; // the decimator consumes samples in pairs.
+            float oddSample = 0;
+            std::vector<float> decimatorInput;
+            std::vector<float> decimatorOutput;
+        };
+        struct Stft
+        {
+            StftConfig config;
+            LsNumerics::StagedFft fft;
+            std::vector<double> window;
+            spectrum_t buffer;
+            std::vector<spectrum_t> frames; // circular, by frame index.
+            uint64_t nextFrame = 0;         // next frame to compute.
+            uint64_t validFrom = 0;         // oldest retained frame.
+        };
+
+        void Update();
+        void AddLevel();
+        void EnsureHistory(Level &level, size_t size);
+        void AddSamples(size_t levelIndex, const float *samples, size_t count);
+        void SkipSamples(uint64_t count);
+        void ComputeFrame(Stft &stft, uint64_t frameIndex);
+
+        double sampleRate;
+
+        // capture (audio thread).
+        std::vector<float> captureBuffer;
+        size_t captureMask;
+        std::atomic<uint64_t> writePosition{0};
+        std::atomic<bool> writing{false};
+
+        // analysis (worker threads).
+        std::mutex mutex;
+        std::vector<double> decimatorPrototype;
+        uint64_t processedPosition = 0;
+        std::vector<Level> levels;
+        std::vector<std::unique_ptr<Stft>> stfts;
+        uint64_t fftCount = 0;
+    };
+}
+
+bool AnalysisBus::Tap::Matches(uint64_t position, const float *input, size_t count) const
+{
+    while (count != 0)
+    {
+        size_t index = (size_t)(position & captureMask);
+        size_t thisTime = std::min(count, captureBuffer.size() - index);
+        if (std::memcmp(&captureBuffer[index], input, thisTime * sizeof(float)) != 0)
+        {
+            return false;
+        }
+        position += thisTime;
+        input += thisTime;
+        count -= thisTime;
+    }
+    return true;
+}
+
+bool AnalysisBus::Tap::Write(uint64_t &position, const float *input, size_t count)
+{
+    while (count != 0)
+    {
+        uint64_t captured = writePosition.load(std::memory_order_acquire);
+        if (position > captured || captured - position > GetMaxLag())
+        {
+            return false;
+        }
+        if (position < captured)
+        {
+            size_t thisTime = (size_t)std::min((uint64_t)count, captured - position);
+            if (!Matches(position, input, thisTime))
+            {
+                return false;
+            }
+            position += thisTime;
+            input += thisTime;
+            count -= thisTime;
+            continue;
+        }
+        if (writing.exchange(true, std::memory_order_acquire))
+        {
+            // another instance is capturing concurrently (a multi-threaded host).
+            return false;
+        }
+        if (writePosition.load(std::memory_order_relaxed) != position)
+        {
+            writing.store(false, std::memory_order_release);
+            continue;
+        }
+        size_t index = (size_t)(position & captureMask);
+        size_t thisTime = std::min(count, captureBuffer.size() - index);
+        std::copy(input, input + thisTime, &captureBuffer[index]);
+        std::copy(input + thisTime, input + count, &captureBuffer[0]);
+        position += count;
+        writePosition.store(position, std::memory_order_release);
+        writing.store(false, std::memory_order_release);
+        count = 0;
+    }
+    return true;
+}
+
+void AnalysisBus::Tap::EnsureHistory(Level &level, size_t size)
+{
+    size = NextPowerOfTwo(size);
+    if (level.history.size() < size)
+    {
+        level.history.resize(0);
+        level.history.resize(size);
+        level.historyMask = size - 1;
+    }
+}
+
+void AnalysisBus::Tap::AddLevel()
+{
+    levels.emplace_back();
+    Level &level = levels.back();
+    size_t index = levels.size() - 1;
+    level.decimator.SetPrototype(decimatorPrototype);
+    level.decimatorInput.resize(DECIMATION_CHUNK_SIZE + 1);
+    level.decimatorOutput.resize(DECIMATION_CHUNK_SIZE / 2 + 1);
+    // as much time as the capture buffer holds.
+    EnsureHistory(level, std::max(MIN_LEVEL_HISTORY, captureBuffer.size() >> index));
+    if (index != 0)
+    {
+        level.count = levels[index - 1].count / 2;
+    }
+    else
+    {
+        level.count = processedPosition;
+    }
+}
+
+size_t AnalysisBus::Tap::AddStft(const StftConfig &config)
+{
+    if (config.level >= MAX_LEVELS || config.fftSize == 0 || (config.fftSize & (config.fftSize - 1)) != 0 ||
+        config.hopSize == 0 || config.frameHistory == 0)
+    {
+        throw std::invalid_argument("AnalysisBus: invalid analysis.");
+    }
+    std::lock_guard lock{mutex};
+
+    while (levels.size() <= config.level)
+    {
+        AddLevel();
+    }
+    EnsureHistory(levels[config.level], config.fftSize + (config.frameHistory + 1) * config.hopSize + DECIMATION_CHUNK_SIZE);
+
+    for (size_t i = 0; i < stfts.size(); ++i)
+    {
+        Stft &stft = *stfts[i];
+        if (stft.config.level == config.level && stft.config.fftSize == config.fftSize && stft.config.hopSize == config.hopSize)
+        {
+            if (stft.config.frameHistory < config.frameHistory)
+            {
+                stft.config.frameHistory = config.frameHistory;
+                stft.frames.resize(config.frameHistory, spectrum_t(config.fftSize));
+                // frames are indexed modulo the history size.
+                stft.validFrom = stft.nextFrame;
+            }
+            return i;
+        }
+    }
+    auto stft = std::make_unique<Stft>();
+    stft->config = config;
+    stft->fft.SetSize(config.fftSize);
+    stft->window = LsNumerics::Window::Hann<double>((int)config.fftSize);
+    stft->buffer.resize(config.fftSize);
+    stft->frames.resize(config.frameHistory, spectrum_t(config.fftSize));
+    // frames before the analysis was added would include samples that were never decimated at this level.
+    const Level &level = levels[config.level];
+    stft->nextFrame = stft->validFrom = (level.count + config.hopSize - 1) / config.hopSize;
+    stfts.push_back(std::move(stft));
+    return stfts.size() - 1;
+}
+
+void AnalysisBus::Tap::SkipSamples(uint64_t count)
+{
+    // the decimator states no longer follow on from the captured samples.
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        Level &level = levels[i];
+        level.decimator.Reset();
+        level.hasOddSample = false;
+        std::fill(level.history.begin(), level.history.end(), 0.0f);
+        level.count += count >> i;
+    }
+}
+
+void AnalysisBus::Tap::AddSamples(size_t levelIndex, const float *samples, size_t count)
+{
+    Level &level = levels[levelIndex];
+    for (size_t i = 0; i < count; ++i)
+    {
+        level.history[(size_t)(level.count + i) & level.historyMask] = samples[i];
+    }
+    level.count += count;
+
+    if (levelIndex + 1 == levels.size())
+    {
+        return;
+    }
+    float *input = level.decimatorInput.data();
+    size_t inputCount = 0;
+    if (level.hasOddSample)
+    {
+        input[inputCount++] = level.oddSample;
+    }
+    std::copy(samples, samples + count, input + inputCount);
+    inputCount += count;
+
+    level.hasOddSample = (inputCount & 1) != 0;
+    if (level.hasOddSample)
+    {
+        level.oddSample = input[inputCount - 1];
+    }
+    size_t outputCount = inputCount / 2;
+    level.decimator.Downsample(input, level.decimatorOutput.data(), outputCount);
+    AddSamples(levelIndex + 1, level.decimatorOutput.data(), outputCount);
+}
+
+// Decimate everything captured since the last update.
+void AnalysisBus::Tap::Update()
+{
+    uint64_t captured = writePosition.load(std::memory_order_acquire);
+    uint64_t available = captured - processedPosition;
+    uint64_t maxAvailable = captureBuffer.size() / 2; // the rest may be being overwritten.
+    if (available > maxAvailable)
+    {
+        SkipSamples(available - maxAvailable);
+        processedPosition = captured - maxAvailable;
+    }
+    while (processedPosition != captured)
+    {
+        size_t index = (size_t)(processedPosition & captureMask);
+        size_t thisTime = (size_t)std::min(captured - processedPosition, (uint64_t)DECIMATION_CHUNK_SIZE);
+        thisTime = std::min(thisTime, captureBuffer.size() - index);
+        if (!levels.empty())
+        {
+            AddSamples(0, &captureBuffer[index], thisTime);
+        }
+        processedPosition += thisTime;
+    }
+}
+
+void AnalysisBus::Tap::ComputeFrame(Stft &stft, uint64_t frameIndex)
+{
+    const Level &level = levels[stft.config.level];
+    uint64_t start = frameIndex * stft.config.hopSize;
+    size_t fftSize = stft.config.fftSize;
+    for (size_t i = 0; i < fftSize; ++i)
+    {
+        stft.buffer[i] = level.history[(size_t)(start + i) & level.historyMask] * stft.window[i];
+    }
+    stft.fft.Forward(stft.buffer, stft.frames[frameIndex % stft.frames.size()]);
+    ++fftCount;
+}
+
+void AnalysisBus::Tap::ReadFrames(
+    size_t stftId,
+    uint64_t &nextFrame,
+    const std::function<void(uint64_t frameIndex, const spectrum_t &spectrum)> &onFrame)
+{
+    std::lock_guard lock{mutex};
+    Update();
+
+    Stft &stft = *stfts[stftId];
+    const Level &level = levels[stft.config.level];
+    size_t fftSize = stft.config.fftSize;
+    size_t hopSize = stft.config.hopSize;
+    uint64_t frameHistory = stft.frames.size();
+
+    // one past the last complete frame.
+    uint64_t end = level.count >= fftSize ? (level.count - fftSize) / hopSize + 1 : 0;
+    end = std::max(end, stft.nextFrame);
+
+    // only the most recent frames are kept, and only frames whose samples are still in the level history can be computed.
+    uint64_t first = std::max(stft.nextFrame, end > frameHistory ? end - frameHistory : 0);
+    size_t historySize = level.history.size();
+    if (level.count > historySize)
+    {
+        first = std::max(first, (level.count - historySize + hopSize - 1) / hopSize);
+    }
+    if (first > stft.nextFrame)
+    {
+        stft.validFrom = first;
+    }
+    for (uint64_t frame = first; frame < end; ++frame)
+    {
+        ComputeFrame(stft, frame);
+    }
+    stft.nextFrame = end;
+    stft.validFrom = std::max(stft.validFrom, end > frameHistory ? end - frameHistory : 0);
+
+    if (nextFrame > end)
+    {
+        // the subscriber's frame count belongs to a different tap (it was moved to a private capture).
+        nextFrame = 0;
+    }
+    for (uint64_t frame = std::max(nextFrame, stft.validFrom); frame < end; ++frame)
+    {
+        onFrame(frame, stft.frames[frame % frameHistory]);
+    }
+    nextFrame = end;
+}
+
+AnalysisBus::Subscription::Subscription(std::shared_ptr<Tap> sharedTap, std::shared_ptr<Tap> privateTap)
+    : sharedTap(std::move(sharedTap)),
+      privateTap(std::move(privateTap))
+{
+    previousBlock.resize(MAX_SYNCHRONIZED_BLOCK_SIZE);
+}
+
+AnalysisBus::Subscription::~Subscription()
+{
+}
+
+AnalysisBus::Tap &AnalysisBus::Subscription::CurrentTap() const
+{
+    return detached.load(std::memory_order_acquire) ? *privateTap : *sharedTap;
+}
+
+size_t AnalysisBus::Subscription::AddStft(const StftConfig &config)
+{
+    stftIds.push_back({sharedTap->AddStft(config), privateTap->AddStft(config)});
+    return stftIds.size() - 1;
+}
+
+void AnalysisBus::Subscription::Reset()
+{
+    synchronized = false;
+    previousBlockSize = 0;
+    hasObservedPosition = false;
+    synchronizeAttempts = 0;
+    detached.store(false, std::memory_order_release);
+}
+
+void AnalysisBus::Subscription::Detach(const float *input, size_t count)
+{
+    detached.store(true, std::memory_order_release);
+    privateTap->Write(privatePosition, input, count);
+}
+
+// Find this instance's place in the shared capture, after activation, or after the host stopped running it for
+// a while. Other instances watching the same signal either ran before this one in the current cycle (and have
+// captured this block), or run after it (and captured the previous block), or there are none (and the capture
+// position hasn't moved since the previous block).
+void AnalysisBus::Subscription::Synchronize(const float *input, size_t count)
+{
+    uint64_t captured = sharedTap->GetWritePosition();
+    if (captured >= count && sharedTap->Matches(captured - count, input, count))
+    {
+        sharedPosition = captured;
+        synchronized = true;
+        return;
+    }
+    bool capture =
+        captured == 0 ||
+        (previousBlockSize != 0 && captured >= previousBlockSize && sharedTap->Matches(captured - previousBlockSize, previousBlock.data(), previousBlockSize)) ||
+        (hasObservedPosition && captured == observedPosition);
+    if (capture)
+    {
+        sharedPosition = captured;
+        synchronized = true;
+        if (!sharedTap->Write(sharedPosition, input, count))
+        {
+            Detach(input, count);
+        }
+        return;
+    }
+    if (++synchronizeAttempts > MAX_SYNCHRONIZE_ATTEMPTS || count > previousBlock.size())
+    {
+        // another instance is capturing a different signal.
+        Detach(input, count);
+        return;
+    }
+    std::copy(input, input + count, previousBlock.begin());
+    previousBlockSize = count;
+    observedPosition = captured;
+    hasObservedPosition = true;
+}
+
+void AnalysisBus::Subscription::Write(const float *input, size_t count)
+{
+    if (detached.load(std::memory_order_relaxed))
+    {
+        privateTap->Write(privatePosition, input, count);
+        return;
+    }
+    if (synchronized && sharedTap->GetWritePosition() - sharedPosition > sharedTap->GetMaxLag())
+    {
+        synchronized = false;
+        previousBlockSize = 0;
+        hasObservedPosition = false;
+        synchronizeAttempts = 0;
+    }
+    if (!synchronized)
+    {
+        Synchronize(input, count);
+        return;
+    }
+    if (!sharedTap->Write(sharedPosition, input, count))
+    {
+        Detach(input, count);
+    }
+}
+
+void AnalysisBus::Subscription::ReadFrames(
+    size_t stft,
+    uint64_t &nextFrame,
+    const std::function<void(uint64_t frameIndex, const spectrum_t &spectrum)> &onFrame)
+{
+    bool isDetached = detached.load(std::memory_order_acquire);
+    Tap &tap = isDetached ? *privateTap : *sharedTap;
+    tap.ReadFrames(isDetached ? stftIds[stft].second : stftIds[stft].first, nextFrame, onFrame);
+}
+
+double AnalysisBus::Subscription::GetSampleRate(size_t level) const
+{
+    return sharedTap->GetSampleRate(level);
+}
+
+uint64_t AnalysisBus::Subscription::GetFftCount() const
+{
+    return CurrentTap().GetFftCount();
+}
+
+AnalysisBus::Subscription::ptr AnalysisBus::Subscribe(double sampleRate)
+{
+    // one shared capture per sample rate. Instances whose input differs fall back to their private capture.
+    static std::mutex registryMutex;
+    static std::map<double, std::weak_ptr<Tap>> registry;
+
+    std::shared_ptr<Tap> sharedTap;
+    {
+        std::lock_guard lock{registryMutex};
+        sharedTap = registry[sampleRate].lock();
+        if (!sharedTap)
+        {
+            sharedTap = std::make_shared<Tap>(sampleRate);
+            registry[sampleRate] = sharedTap;
+        }
+    }
+    return Subscription::ptr(new Subscription(sharedTap, std::make_shared<Tap>(sampleRate)));
+}
@@ -0,0 +1,130 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace toob
+{
+    // Shares analysis of an input signal between plugin instances in the same process that watch the
+    // same signal (a tuner and a spectrum analyzer on the same input, for example).
+    //
+    // Each instance writes its input to a Subscription on the audio thread. The first instance to write
+    // a block captures it; the others only verify that their block is identical. An instance whose input
+    // turns out to differ is moved to a private capture of its own, so results are always those of the
+    // instance's own input.
+    //
+    // Analysis is done on worker threads, on demand. The capture is decimated by a chain of halfband
+    // filters (level n runs at sampleRate/2^n), and Hann-windowed FFT frames of the decimated signals are
+    // computed at a fixed hop. Each frame is computed once, and read by every subscriber that registered
+    // the same StftConfig.
+    class AnalysisBus
+    {
+    public:
+        using complex_t = std::complex<double>;
+        using spectrum_t = std::vector<complex_t>;
+
+        static constexpr size_t MAX_LEVELS = 12;
+
+        struct StftConfig
+        {
+            size_t level = 0;        // the input is analyzed at sampleRate/2^level.
+            size_t fftSize = 0;      // power of 2.
+            size_t hopSize = 0;
+            size_t frameHistory = 1; // frames retained for subscribers that read less often than once per hop.
+        };
+
+        class Tap;
+
+        class Subscription
+        {
+        public:
+            using ptr = std::unique_ptr<Subscription>;
+
+            Subscription(const Subscription &) = delete;
+            Subscription &operator=(const Subscription &) = delete;
+            ~Subscription();
+
+            // Register an analysis, and return its id. Not realtime-safe.
+            size_t AddStft(const StftConfig &config);
+
+            // Resynchronize with the shared capture. Not realtime-safe; call when the plugin is activated.
+            void Reset();
+
+            // Audio thread.
+            void Write(const float *input, size_t count);
+
+            // Worker thread. Calls onFrame for each retained frame at or after nextFrame, in order, and updates nextFrame.
+            // Frame n covers decimated samples n*hopSize to n*hopSize+fftSize. Spectra have fftSize bins, scaled
+            // by 1/sqrt(fftSize) as StagedFft's are.
+            void ReadFrames(
+                size_t stft,
+                uint64_t &nextFrame,
+                const std::function<void(uint64_t frameIndex, const spectrum_t &spectrum)> &onFrame);
+
+            double GetSampleRate(size_t level) const;
+
+            // False once this instance's input has been found to differ from the shared capture.
+            bool IsShared() const { return !detached.load(std::memory_order_acquire); }
+
+            // Total FFTs computed for the capture that serves this subscription. For tests and profiling.
+            uint64_t GetFftCount() const;
+
+        private:
+            friend class AnalysisBus;
+            Subscription(std::shared_ptr<Tap> sharedTap, std::shared_ptr<Tap> privateTap);
+
+            Tap &CurrentTap() const;
+            void Synchronize(const float *input, size_t count);
+            void Detach(const float *input, size_t count);
+
+            std::shared_ptr<Tap> sharedTap;
+            std::shared_ptr<Tap> privateTap;
+            // ids of each registered analysis in the shared and private taps.
+            std::vector<std::pair<size_t, size_t>> stftIds;
+
+            uint64_t sharedPosition = 0;
+            bool synchronized = false;
+            // synchronization state: the previous block, and the shared capture position when it was written.
+            std::vector<float> previousBlock;
+            size_t previousBlockSize = 0;
+            uint64_t observedPosition = 0;
+            bool hasObservedPosition = false;
+            size_t synchronizeAttempts = 0;
+
+            uint64_t privatePosition = 0;
+            std::atomic<bool> detached{false};
+        };
+
+        // Not realtime-safe.
+        static Subscription::ptr Subscribe(double sampleRate);
+    };
+}
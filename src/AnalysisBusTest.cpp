@@ -0,0 +1,217 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "AnalysisBus.hpp"
+#include "LsNumerics/StagedFft.hpp"
+#include "LsNumerics/Window.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace toob;
+
+static constexpr double SAMPLE_RATE = 48000;
+static constexpr size_t BLOCK_SIZE = 64;
+
+static float Signal(double frequency, uint64_t t)
+{
+    return (float)(0.5 * std::sin(2 * M_PI * frequency * t / SAMPLE_RATE));
+}
+
+static void WriteBlock(AnalysisBus::Subscription &subscription, double frequency, uint64_t t)
+{
+    float block[BLOCK_SIZE];
+    for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    {
+        block[i] = Signal(frequency, t + i);
+    }
+    subscription.Write(block, BLOCK_SIZE);
+}
+
+static size_t PeakBin(const AnalysisBus::spectrum_t &spectrum)
+{
+    size_t peak = 1;
+    for (size_t i = 1; i < spectrum.size() / 2; ++i)
+    {
+        if (std::abs(spectrum[i]) > std::abs(spectrum[peak]))
+        {
+            peak = i;
+        }
+    }
+    return peak;
+}
+
+// Frames are windowed FFTs of the captured signal at the configured hop.
+static void TestFrames()
+{
+    constexpr double FREQUENCY = 1000;
+    AnalysisBus::StftConfig config;
+    config.fftSize = 256;
+    config.hopSize = 128;
+    config.frameHistory = 4;
+
+    auto subscription = AnalysisBus::Subscribe(SAMPLE_RATE);
+    size_t stft = subscription->AddStft(config);
+
+    LsNumerics::StagedFft fft(config.fftSize);
+    std::vector<double> window = LsNumerics::Window::Hann<double>((int)config.fftSize);
+    AnalysisBus::spectrum_t expected(config.fftSize);
+
+    uint64_t t = 0;
+    uint64_t nextFrame = 0;
+    uint64_t framesRead = 0;
+    for (size_t block = 0; block < 100; ++block)
+    {
+        WriteBlock(*subscription, FREQUENCY, t);
+        t += BLOCK_SIZE;
+        // read less often than once per hop.
+        if (block % 7 == 0 || block == 99)
+        {
+            subscription->ReadFrames(stft, nextFrame, [&](uint64_t frameIndex, const AnalysisBus::spectrum_t &spectrum)
+                                     {
+                TEST_ASSERT(frameIndex == framesRead);
+                ++framesRead;
+                for (size_t i = 0; i < config.fftSize; ++i)
+                {
+                    expected[i] = Signal(FREQUENCY, frameIndex * config.hopSize + i) * window[i];
+                }
+                fft.Forward(expected, expected);
+                for (size_t i = 0; i < config.fftSize; ++i)
+                {
+                    TEST_ASSERT(std::abs(spectrum[i] - expected[i]) < 1E-6);
+                } });
+        }
+    }
+    TEST_ASSERT(framesRead == (t - config.fftSize) / config.hopSize + 1);
+    TEST_ASSERT(subscription->IsShared());
+}
+
+// Instances watching the same signal capture it once, and compute each frame once, in either run order.
+static void TestSharing()
+{
+    AnalysisBus::StftConfig config;
+    config.level = 2;
+    config.fftSize = 512;
+    config.hopSize = 128;
+    config.frameHistory = 8;
+
+    auto a = AnalysisBus::Subscribe(SAMPLE_RATE);
+    auto b = AnalysisBus::Subscribe(SAMPLE_RATE);
+    size_t stftA = a->AddStft(config);
+    size_t stftB = b->AddStft(config);
+    a->Reset();
+    b->Reset();
+
+    uint64_t nextFrameA = 0, nextFrameB = 0;
+    std::vector<AnalysisBus::spectrum_t> framesA, framesB;
+    uint64_t t = 0;
+    for (size_t block = 0; block < 2000; ++block)
+    {
+        if (block < 1000)
+        {
+            WriteBlock(*a, 440, t);
+            WriteBlock(*b, 440, t);
+        }
+        else
+        {
+            WriteBlock(*b, 440, t);
+            WriteBlock(*a, 440, t);
+        }
+        t += BLOCK_SIZE;
+        if (block % 10 == 0)
+        {
+            a->ReadFrames(stftA, nextFrameA, [&](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+                          { framesA.push_back(spectrum); });
+            b->ReadFrames(stftB, nextFrameB, [&](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+                          { framesB.push_back(spectrum); });
+        }
+    }
+    TEST_ASSERT(a->IsShared() && b->IsShared());
+    TEST_ASSERT(!framesA.empty());
+    TEST_ASSERT(framesA == framesB);
+    TEST_ASSERT(a->GetFftCount() == framesA.size());
+
+    // 440Hz at 12kHz.
+    double binHz = a->GetSampleRate(config.level) / config.fftSize;
+    TEST_ASSERT(std::abs(PeakBin(framesA.back()) * binHz - 440) < binHz);
+
+    // reactivation resynchronizes with the shared capture.
+    b->Reset();
+    for (size_t block = 0; block < 10; ++block)
+    {
+        WriteBlock(*a, 440, t);
+        WriteBlock(*b, 440, t);
+        t += BLOCK_SIZE;
+    }
+    TEST_ASSERT(b->IsShared());
+}
+
+// An instance watching a different signal gets analysis of its own input.
+static void TestDifferentInputs()
+{
+    AnalysisBus::StftConfig config;
+    config.fftSize = 1024;
+    config.hopSize = 512;
+
+    auto a = AnalysisBus::Subscribe(SAMPLE_RATE);
+    auto c = AnalysisBus::Subscribe(SAMPLE_RATE);
+    size_t stftA = a->AddStft(config);
+    size_t stftC = c->AddStft(config);
+
+    uint64_t nextFrameA = 0, nextFrameC = 0;
+    uint64_t t = 0;
+    for (size_t block = 0; block < 200; ++block)
+    {
+        WriteBlock(*a, 1000, t);
+        WriteBlock(*c, 3000, t);
+        t += BLOCK_SIZE;
+    }
+    TEST_ASSERT(a->IsShared());
+    TEST_ASSERT(!c->IsShared());
+
+    double binHz = SAMPLE_RATE / config.fftSize;
+    size_t frames = 0;
+    a->ReadFrames(stftA, nextFrameA, [&](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+                  { TEST_ASSERT(std::abs(PeakBin(spectrum) * binHz - 1000) < binHz); });
+    c->ReadFrames(stftC, nextFrameC, [&](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+                  { ++frames; TEST_ASSERT(std::abs(PeakBin(spectrum) * binHz - 3000) < binHz); });
+    TEST_ASSERT(frames != 0);
+}
+
+int main(void)
+{
+    try
+    {
+        TestFrames();
+        TestSharing();
+        TestDifferentInputs();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
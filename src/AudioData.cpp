@@ -27,62 +27,95 @@
 #include "LsNumerics/LagrangeInterpolator.hpp"
 #include "Filters/ChebyshevDownsamplingFilter.h"
 #include "LsNumerics/LsMath.hpp"
+#include "LsNumerics/PolyphaseResampler.hpp"
 #include <iostream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 using namespace toob;
 using namespace LsNumerics;
 
 void AudioData::Resample(size_t outputSampleRate, AudioData &output)
 {
-
-    output.setSampleRate(getSampleRate());
-    output.setChannelCount(getChannelCount());
-
-    if (outputSampleRate < getSampleRate())
+    output.setSampleRate(outputSampleRate);
+    output.setChannelMask(getChannelMask());
+    output.data = this->data;
+    ResampleChannels(getSampleRate(), outputSampleRate, output.data);
+    output.size = output.data.size() == 0 ? 0 : output.data[0].size();
+}
+void AudioData::Resample(size_t sampleRate)
+{
+    ResampleChannels(getSampleRate(), sampleRate, this->data);
+    this->sampleRate = sampleRate;
+    if (data.size() == 0)
     {
-        auto downsamplingFilter = DesignFilter(getSampleRate(),outputSampleRate);
-        for (size_t c = 0; c < getChannelCount(); ++c)
-        {
-            std::vector<float> resampledChannel = AudioData::Resample(getSampleRate(), outputSampleRate, getChannel(c),&downsamplingFilter);
-            output.getData()[c] = std::move(resampledChannel);
-        }
-
-    } else {
-        for (size_t c = 0; c < getChannelCount(); ++c)
-        {
-            std::vector<float> resampledChannel = AudioData::Resample(getSampleRate(), outputSampleRate, getChannel(c),nullptr);
-            output.getData()[c] = std::move(resampledChannel);
-        }
+        this->size = 0;
+    }
+    else
+    {
+        this->size = data[0].size();
     }
-    output.size = output.data[0].size();
 }
-void AudioData::Resample(size_t sampleRate)
+
+/*static*/ void AudioData::ResampleChannels(size_t inputSampleRate, size_t outputSampleRate, std::vector<std::vector<float>> &channels)
 {
-    if (sampleRate < getSampleRate())
+    if (inputSampleRate == outputSampleRate || channels.empty())
     {
-        auto downsamplingFilter = DesignFilter(getSampleRate(),sampleRate);
+        return;
+    }
+    std::function<void(std::vector<float> &)> resampleChannel;
+    std::unique_ptr<PolyphaseResampler> polyphaseResampler;
+    if (PolyphaseResampler::CanResample(inputSampleRate, outputSampleRate))
+    {
+        // 20kHz at 44.1kHz, proportionately scaled for other rates.
+        double cutoff = std::min(inputSampleRate, outputSampleRate) * 20000.0 / 44100;
+        polyphaseResampler = std::make_unique<PolyphaseResampler>(inputSampleRate, outputSampleRate, cutoff);
+        resampleChannel = [&polyphaseResampler](std::vector<float> &channel)
+        {
+            channel = polyphaseResampler->Resample(channel);
+        };
+    }
+    else
+    {
+        resampleChannel = [inputSampleRate, outputSampleRate](std::vector<float> &channel)
+        {
+            channel = AudioData::Resample(inputSampleRate, outputSampleRate, channel);
+        };
+    }
 
-        for (size_t c = 0; c < getChannelCount(); ++c)
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(channels.size());
+    auto run = [&](size_t c)
+    {
+        try
         {
-            std::vector<float> resampledChannel = AudioData::Resample(getSampleRate(), sampleRate, getChannel(c),&downsamplingFilter);
-            data[c] = std::move(resampledChannel);
+            resampleChannel(channels[c]);
         }
-
-    } else {
-        for (size_t c = 0; c < getChannelCount(); ++c)
+        catch (...)
         {
-            std::vector<float> resampledChannel = AudioData::Resample(getSampleRate(), sampleRate, getChannel(c),nullptr);
-            data[c] = std::move(resampledChannel);
+            errors[c] = std::current_exception();
         }
+    };
+    for (size_t c = 1; c < channels.size(); ++c)
+    {
+        threads.emplace_back(run, c);
     }
-    this->sampleRate = sampleRate;
-    if (data.size() == 0)
+    run(0);
+    for (auto &thread : threads)
     {
-        this->size = 0;
+        thread.join();
     }
-    else
+    for (auto &error : errors)
     {
-        this->size = data[0].size();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
     }
 }
 
@@ -124,62 +157,49 @@ static float GetMonoChannelDownmix(size_t channel,ChannelMask mask)
     }
     return 0;
 }
-void AudioData::ConvertToMono()
+/*static*/ ChannelMatrix ChannelMatrix::Mono(size_t inputChannelCount, ChannelMask channelMask)
 {
-    if (getChannelCount() > 1)
+    ChannelMatrix result(1, inputChannelCount);
+    if (inputChannelCount == 0)
+    {
+        return result;
+    }
+    if (inputChannelCount > 1)
     {
         // https://www.audiokinetic.com/en/library/edge/?source=Help&id=downmix_tables
-        if (channelMask != ChannelMask::ZERO )
+        if (channelMask != ChannelMask::ZERO)
         {
-            try {
-                std::vector<float> scale;
-                scale.resize(getChannelCount());
-                for (size_t i = 0; i < getChannelCount(); ++i)
-                {
-                    scale[i] = GetMonoChannelDownmix(i,channelMask);
-                }
-                for (size_t i = 0; i < size; ++i)
+            try
+            {
+                for (size_t c = 0; c < inputChannelCount; ++c)
                 {
-                    float sum = 0;
-                    for (size_t c = 0; c < getChannelCount(); ++c)
-                    {
-                        sum += this->data[c][i]*scale[i];
-                    }
-                    this->data[0][i] = sum;
+                    result.Set(0, c, GetMonoChannelDownmix(c, channelMask));
                 }
-                data.resize(1);
-                return;
-            } catch(...)
-            {
-                // presumably, the channel mask doens't match the number of channels. fall through.
+                return result;
             }
-        }
-        if (getChannelCount() == 2)
-        {
-            std::vector<float> mono(getSize());
-
-            size_t channels = getChannelCount();
-            float scale = 1.0f / channels;
-            size_t size = getSize();
-            for (size_t i = 0; i < size; ++i)
+            catch (...)
             {
-                float result = data[0][i];
-
-                for (size_t c = 1; c < channels; ++c)
-                {
-                    result += data[c][i];
-                }
-                mono[i] = result * scale;
+                // presumably, the channel mask doens't match the number of channels. fall through.
             }
-            data[0] = std::move(mono);
-            data.resize(1);
         }
-        else
+        if (inputChannelCount == 2)
         {
-            // just take the first channel.
-            data.resize(1);
+            result.Set(0, 0, 0.5f);
+            result.Set(0, 1, 0.5f);
+            return result;
         }
     }
+    // just take the first channel.
+    result.Set(0, 0, 1.0f);
+    return result;
+}
+
+void AudioData::ConvertToMono()
+{
+    if (getChannelCount() > 1)
+    {
+        Remix(ChannelMatrix::Mono(getChannelCount(), channelMask));
+    }
 }
 
 /*static*/ ChebyshevDownsamplingFilter AudioData::DesignFilter(size_t inputSampleRate, size_t outputSampleRate)
@@ -272,18 +292,22 @@ static double degreesToRadians(double degrees)
 {
     return degrees*LsNumerics::Pi/180.0;
 }
+static void AmbisonicCoefficients(const AmbisonicMicrophone &micParameter, float *w, float *x, float *y)
+{
+    double p = micParameter.getMicP();
+    *w = (float)(p * std::sqrt(2.0));
+    *x = (float)(-(1 - p) * std::cos(degreesToRadians(micParameter.getHorizontalAngle())));
+    *y = (float)(-(1 - p) * std::sin(degreesToRadians(micParameter.getHorizontalAngle())));
+}
+
 std::vector<float> AudioData::AmbisonicDownmixChannel(const AmbisonicMicrophone &micParameter)
 {
     assert(getChannelCount() == 4);
     std::vector<float> result;
     result.resize(size);
 
-    double p = micParameter.getMicP();
-    double w = p*std::sqrt(2.0);
-    double x = -(1-p)*std::cos(degreesToRadians(micParameter.getHorizontalAngle()));
-    double y = -(1-p)*std::sin(degreesToRadians(micParameter.getHorizontalAngle()));
-
-    //std::cout << "a: " << micParameter.getHorizontalAngle() << " w: " << w << " x: " << x << " y: " << y << std::endl;
+    float w, x, y;
+    AmbisonicCoefficients(micParameter, &w, &x, &y);
 
     const std::vector<float>&W = getChannel(0);
     const std::vector<float>&X = getChannel(1);
@@ -296,17 +320,24 @@ std::vector<float> AudioData::AmbisonicDownmixChannel(const AmbisonicMicrophone
     return result;
 }
 
-
-void AudioData::AmbisonicDownmix(const std::vector<AmbisonicMicrophone> &micParameters)
+/*static*/ ChannelMatrix ChannelMatrix::AmbisonicDownmix(const std::vector<AmbisonicMicrophone> &micParameters)
 {
-    assert(getChannelCount() == 4);
-    std::vector<std::vector<float>> outputData;
-    outputData.reserve(micParameters.size());
+    ChannelMatrix result(micParameters.size(), 4);
     for (size_t i = 0; i < micParameters.size(); ++i)
     {
-        outputData.push_back(AmbisonicDownmixChannel(micParameters[i]));
+        float w, x, y;
+        AmbisonicCoefficients(micParameters[i], &w, &x, &y);
+        result.Set(i, 0, w);
+        result.Set(i, 1, x);
+        result.Set(i, 2, y);
     }
-    this->data = std::move(outputData);
+    return result;
+}
+
+void AudioData::AmbisonicDownmix(const std::vector<AmbisonicMicrophone> &micParameters)
+{
+    assert(getChannelCount() == 4);
+    Remix(ChannelMatrix::AmbisonicDownmix(micParameters));
 }
 
 void AudioData::Erase(size_t start, size_t end)
@@ -322,48 +353,182 @@ void AudioData::Erase(size_t start, size_t end)
 
 void AudioData::Scale(float value)
 {
-    for (size_t c = 0; c < getChannelCount(); ++c)
-    {
-        auto &channel = this->data[c];
-        for (size_t i = 0; i < channel.size(); ++i)
-        {
-            channel[i] *= value;
-        }
-    }
+    Remix(ChannelMatrix::Gain(std::vector<float>(getChannelCount(), value)));
 }
 
 
 void AudioData::MonoToStereo()
 {
-    this->data.resize(2);
-    this->data[1] = this->data[0];
+    Remix(ChannelMatrix::MonoToStereo(getChannelCount()));
     this->channelMask = ChannelMask::SPEAKER_FRONT_LEFT | ChannelMask::SPEAKER_FRONT_RIGHT;
 }
 
 void AudioData::SetStereoWidth(float width)
 {
-    this->data.resize(2);
-    float fLL = width*0.5f+0.5f;
-    float fLR = -width*0.5f+0.5f;
-    float fRL = -width*0.5+0.5f;
-    float fRR = width*0.5f+0.5f;
+    Remix(ChannelMatrix::StereoWidth(getChannelCount(), width));
+}
+
+ChannelMatrix::ChannelMatrix(size_t outputChannelCount, size_t inputChannelCount)
+    : outputChannelCount(outputChannelCount),
+      inputChannelCount(inputChannelCount),
+      values(outputChannelCount * inputChannelCount)
+{
+}
 
-    auto & left = data[0];
-    auto & right = data[1];
-    size_t size = data[0].size();
+/*static*/ ChannelMatrix ChannelMatrix::Identity(size_t channelCount)
+{
+    return Gain(std::vector<float>(channelCount, 1.0f));
+}
 
-    for (size_t i = 0; i < size; ++i)
+/*static*/ ChannelMatrix ChannelMatrix::Gain(const std::vector<float> &gains)
+{
+    ChannelMatrix result(gains.size(), gains.size());
+    for (size_t c = 0; c < gains.size(); ++c)
     {
-        float lVal = left[i]*fLL + right[i]*fLR;
-        float rVal = left[i]*fRL + right[i]*fRR;
-        left[i] = lVal;
-        right[i] = rVal;
+        result.Set(c, c, gains[c]);
+    }
+    return result;
+}
 
+/*static*/ ChannelMatrix ChannelMatrix::MonoToStereo(size_t inputChannelCount)
+{
+    ChannelMatrix result(2, inputChannelCount);
+    if (inputChannelCount != 0)
+    {
+        result.Set(0, 0, 1.0f);
+        result.Set(1, 0, 1.0f);
     }
+    return result;
+}
+
+/*static*/ ChannelMatrix ChannelMatrix::StereoWidth(size_t inputChannelCount, float width)
+{
+    if (inputChannelCount < 2)
+    {
+        return MonoToStereo(inputChannelCount);
+    }
+    ChannelMatrix result(2, inputChannelCount);
+    result.Set(0, 0, width * 0.5f + 0.5f);
+    result.Set(0, 1, -width * 0.5f + 0.5f);
+    result.Set(1, 0, -width * 0.5f + 0.5f);
+    result.Set(1, 1, width * 0.5f + 0.5f);
+    return result;
 }
 
+ChannelMatrix ChannelMatrix::Then(const ChannelMatrix &next) const
+{
+    assert(next.inputChannelCount == this->outputChannelCount);
+    ChannelMatrix result(next.outputChannelCount, this->inputChannelCount);
+    for (size_t o = 0; o < next.outputChannelCount; ++o)
+    {
+        for (size_t i = 0; i < this->inputChannelCount; ++i)
+        {
+            double sum = 0;
+            for (size_t k = 0; k < this->outputChannelCount; ++k)
+            {
+                sum += (double)next.Get(o, k) * this->Get(k, i);
+            }
+            result.Set(o, i, (float)sum);
+        }
+    }
+    return result;
+}
+
+double ChannelStatistics::getRms() const
+{
+    return size == 0 ? 0 : std::sqrt(sumOfSquares / size);
+}
 
+// Short enough that a block of every output channel stays in L1 cache.
+static constexpr size_t REMIX_BLOCK_SIZE = 512;
 
+void ChannelStatistics::Add(const float *samples, size_t count)
+{
+    float peak = this->peak;
+    float sumOfSquares = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        peak = std::max(peak, std::abs(samples[i]));
+        sumOfSquares += samples[i] * samples[i];
+    }
+    this->peak = peak;
+    this->sumOfSquares += sumOfSquares;
+    this->size += count;
+
+    double sum = this->sum;
+    double convolutionPeak = this->convolutionPeak;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += samples[i];
+        convolutionPeak = std::max(convolutionPeak, std::abs(sum));
+    }
+    this->sum = sum;
+    this->convolutionPeak = convolutionPeak;
+}
+
+void AudioData::Remix(const ChannelMatrix &matrix, std::vector<ChannelStatistics> *statistics)
+{
+    assert(matrix.getInputChannelCount() == getChannelCount());
+
+    size_t inputChannelCount = matrix.getInputChannelCount();
+    size_t outputChannelCount = matrix.getOutputChannelCount();
+    for (auto &channel : data)
+    {
+        channel.resize(size);
+    }
+    for (size_t c = inputChannelCount; c < outputChannelCount; ++c)
+    {
+        data.emplace_back(size);
+    }
+    if (statistics)
+    {
+        statistics->assign(outputChannelCount, ChannelStatistics());
+    }
+    // Each block of every output channel is completed before any of them is written back, which allows the remix to be done in place.
+    std::vector<float> block(outputChannelCount * REMIX_BLOCK_SIZE);
+    for (size_t start = 0; start < size; start += REMIX_BLOCK_SIZE)
+    {
+        size_t count = std::min(REMIX_BLOCK_SIZE, size - start);
+        for (size_t o = 0; o < outputChannelCount; ++o)
+        {
+            float *output = block.data() + o * REMIX_BLOCK_SIZE;
+            std::fill(output, output + count, 0.0f);
+            for (size_t i = 0; i < inputChannelCount; ++i)
+            {
+                float scale = matrix.Get(o, i);
+                if (scale == 0)
+                {
+                    continue;
+                }
+                const float *input = data[i].data() + start;
+                for (size_t k = 0; k < count; ++k)
+                {
+                    output[k] += scale * input[k];
+                }
+            }
+        }
+        for (size_t o = 0; o < outputChannelCount; ++o)
+        {
+            const float *output = block.data() + o * REMIX_BLOCK_SIZE;
+            std::copy(output, output + count, data[o].data() + start);
+            if (statistics)
+            {
+                (*statistics)[o].Add(output, count);
+            }
+        }
+    }
+    data.resize(outputChannelCount);
+}
+
+std::vector<ChannelStatistics> AudioData::GetStatistics() const
+{
+    std::vector<ChannelStatistics> result(getChannelCount());
+    for (size_t c = 0; c < getChannelCount(); ++c)
+    {
+        result[c].Add(data[c].data(), std::min(size, data[c].size()));
+    }
+    return result;
+}
 
 AudioData& AudioData::operator+=(const AudioData&other) 
 {
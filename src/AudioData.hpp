@@ -68,6 +68,59 @@ namespace toob
         double horizontalAngle, verticalAngle, micP;
     };
 
+    /// @brief A linear remix of audio channels.
+    /// @remarks
+    /// Output channel o is the sum over input channels i of Get(o,i)*input[i]. Successive remixes can be combined
+    /// with Then(), so that AudioData::Remix can apply a whole chain of them in a single pass over the data.
+    class ChannelMatrix
+    {
+    public:
+        ChannelMatrix(size_t outputChannelCount = 0, size_t inputChannelCount = 0);
+
+        static ChannelMatrix Identity(size_t channelCount);
+        /// @brief Scale each channel by the corresponding gain.
+        static ChannelMatrix Gain(const std::vector<float> &gains);
+        /// @brief Copy the first channel into two channels.
+        static ChannelMatrix MonoToStereo(size_t inputChannelCount = 1);
+        /// @brief Set width of the stereo image of the first two channels [0...1], 0 = monophonic. 1 = normal.
+        static ChannelMatrix StereoWidth(size_t inputChannelCount, float width);
+        /// @brief Downmix to a single channel, using standard downmix weights if the channel mask is known.
+        static ChannelMatrix Mono(size_t inputChannelCount, ChannelMask channelMask);
+        /// @brief Ambisonic b-format (WXYZ) to one channel for each virtual microphone.
+        static ChannelMatrix AmbisonicDownmix(const std::vector<AmbisonicMicrophone> &micParameters);
+
+        size_t getOutputChannelCount() const { return outputChannelCount; }
+        size_t getInputChannelCount() const { return inputChannelCount; }
+        float Get(size_t outputChannel, size_t inputChannel) const { return values[outputChannel * inputChannelCount + inputChannel]; }
+        void Set(size_t outputChannel, size_t inputChannel, float value) { values[outputChannel * inputChannelCount + inputChannel] = value; }
+
+        /// @brief The remix that applies this remix, followed by next.
+        ChannelMatrix Then(const ChannelMatrix &next) const;
+
+    private:
+        size_t outputChannelCount;
+        size_t inputChannelCount;
+        std::vector<float> values;
+    };
+
+    /// @brief Level statistics for one channel of audio data.
+    struct ChannelStatistics
+    {
+        size_t size = 0;
+        /// @brief Largest absolute sample value.
+        float peak = 0;
+        double sumOfSquares = 0;
+        /// @brief Largest absolute value of the running sum of the samples.
+        /// @remarks The worst-case output level of a convolution that uses the channel as its impulse response.
+        double convolutionPeak = 0;
+        /// @brief Running sum of the samples.
+        double sum = 0;
+
+        /// @brief Accumulate statistics for the next samples of the channel.
+        void Add(const float *samples, size_t count);
+        double getRms() const;
+    };
+
     class AudioData
     {
     public:
@@ -194,6 +247,16 @@ namespace toob
         void AmbisonicDownmix(const std::vector<AmbisonicMicrophone> &micParameters);
 
 
+        /// @brief Apply a channel remix in a single pass over the data.
+        /// @param matrix The remix. Must have an input for each channel of the current data.
+        /// @param statistics If not null, receives level statistics for each of the remixed channels.
+        /// @remarks
+        /// The remix is done in place, a block at a time.
+        void Remix(const ChannelMatrix &matrix, std::vector<ChannelStatistics> *statistics = nullptr);
+
+        /// @brief Level statistics for each channel.
+        std::vector<ChannelStatistics> GetStatistics() const;
+
         /// @brief Resample the audio data.
         /// @param outputSampleRate The new sample rate.
         /// @param output The AudioData object in which to store the result.
@@ -211,6 +274,8 @@ namespace toob
         void Erase(size_t start, size_t end);
 
     private:
+        // Resamples each channel in place, on a thread per channel.
+        static void ResampleChannels(size_t inputSampleRate, size_t outputSampleRate, std::vector<std::vector<float>> &channels);
         static std::vector<float> Resample(size_t inputSampleRate, size_t outputSampleRate, std::vector<float> &values);
 
         static ChebyshevDownsamplingFilter DesignFilter(size_t inputSampleRate, size_t outputSampleRate);
@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "AudioData.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace toob;
+
+// not a multiple of the remix block size.
+static constexpr size_t TEST_SIZE = 2000;
+
+static AudioData MakeTestData(size_t channelCount)
+{
+    AudioData result(48000, channelCount, TEST_SIZE);
+    for (size_t c = 0; c < channelCount; ++c)
+    {
+        auto &channel = result.getChannel(c);
+        for (size_t i = 0; i < TEST_SIZE; ++i)
+        {
+            channel[i] = (float)(std::sin(i * 0.01 * (c + 1)) * std::exp(-(double)i / TEST_SIZE));
+        }
+    }
+    return result;
+}
+
+static void AssertChannel(const std::vector<float> &actual, const std::vector<float> &expected)
+{
+    TEST_ASSERT(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); ++i)
+    {
+        TEST_ASSERT(std::abs(actual[i] - expected[i]) < 1E-5f);
+    }
+}
+
+static void TestRemix()
+{
+    // stereo width.
+    {
+        AudioData data = MakeTestData(2);
+        const auto left = data.getChannel(0);
+        const auto right = data.getChannel(1);
+        data.SetStereoWidth(0.5f);
+        TEST_ASSERT(data.getChannelCount() == 2);
+        std::vector<float> expectedLeft(TEST_SIZE), expectedRight(TEST_SIZE);
+        for (size_t i = 0; i < TEST_SIZE; ++i)
+        {
+            expectedLeft[i] = left[i] * 0.75f + right[i] * 0.25f;
+            expectedRight[i] = left[i] * 0.25f + right[i] * 0.75f;
+        }
+        AssertChannel(data.getChannel(0), expectedLeft);
+        AssertChannel(data.getChannel(1), expectedRight);
+    }
+    // more outputs than inputs.
+    {
+        AudioData data = MakeTestData(1);
+        const auto mono = data.getChannel(0);
+        data.MonoToStereo();
+        TEST_ASSERT(data.getChannelCount() == 2);
+        AssertChannel(data.getChannel(0), mono);
+        AssertChannel(data.getChannel(1), mono);
+    }
+    // ambisonic.
+    {
+        AudioData data = MakeTestData(4);
+        AudioData copy = data;
+        std::vector<AmbisonicMicrophone> mics{AmbisonicMicrophone(-45, 0), AmbisonicMicrophone(45, 0)};
+        std::vector<float> expectedLeft = copy.AmbisonicDownmixChannel(mics[0]);
+        std::vector<float> expectedRight = copy.AmbisonicDownmixChannel(mics[1]);
+        data.AmbisonicDownmix(mics);
+        TEST_ASSERT(data.getChannelCount() == 2);
+        AssertChannel(data.getChannel(0), expectedLeft);
+        AssertChannel(data.getChannel(1), expectedRight);
+    }
+}
+
+static void TestConvertToMono()
+{
+    AudioData data = MakeTestData(3);
+    const auto left = data.getChannel(0);
+    const auto right = data.getChannel(1);
+    const auto center = data.getChannel(2);
+    data.setChannelMask(ChannelMask::SPEAKER_FRONT_LEFT | ChannelMask::SPEAKER_FRONT_RIGHT | ChannelMask::SPEAKER_FRONT_CENTER);
+    data.ConvertToMono();
+    TEST_ASSERT(data.getChannelCount() == 1);
+    std::vector<float> expected(TEST_SIZE);
+    for (size_t i = 0; i < TEST_SIZE; ++i)
+    {
+        expected[i] = (float)((left[i] + right[i]) / std::sqrt(2.0) + center[i]);
+    }
+    AssertChannel(data.getChannel(0), expected);
+
+    // no channel mask.
+    data = MakeTestData(2);
+    expected = data.getChannel(0);
+    for (size_t i = 0; i < TEST_SIZE; ++i)
+    {
+        expected[i] = (expected[i] + data.getChannel(1)[i]) * 0.5f;
+    }
+    data.ConvertToMono();
+    AssertChannel(data.getChannel(0), expected);
+}
+
+static void TestThen()
+{
+    float angle = 60;
+    ChannelMatrix chain =
+        ChannelMatrix::AmbisonicDownmix({AmbisonicMicrophone(-angle, 0), AmbisonicMicrophone(angle, 0)})
+            .Then(ChannelMatrix::StereoWidth(2, 0.3f))
+            .Then(ChannelMatrix::Gain({0.5f, 2.0f}));
+
+    AudioData fused = MakeTestData(4);
+    AudioData sequential = fused;
+
+    fused.Remix(chain);
+
+    sequential.AmbisonicDownmix({AmbisonicMicrophone(-angle, 0), AmbisonicMicrophone(angle, 0)});
+    sequential.SetStereoWidth(0.3f);
+    sequential.Remix(ChannelMatrix::Gain({0.5f, 2.0f}));
+
+    TEST_ASSERT(fused.getChannelCount() == 2);
+    AssertChannel(fused.getChannel(0), sequential.getChannel(0));
+    AssertChannel(fused.getChannel(1), sequential.getChannel(1));
+}
+
+static void TestStatistics()
+{
+    AudioData data = MakeTestData(2);
+    std::vector<ChannelStatistics> statistics;
+    data.Remix(ChannelMatrix::Gain({2.0f, -1.0f}), &statistics);
+    TEST_ASSERT(statistics.size() == 2);
+
+    std::vector<ChannelStatistics> readStatistics = data.GetStatistics();
+    for (size_t c = 0; c < 2; ++c)
+    {
+        const auto &channel = data.getChannel(c);
+        double peak = 0, sumOfSquares = 0, sum = 0, convolutionPeak = 0;
+        for (size_t i = 0; i < TEST_SIZE; ++i)
+        {
+            peak = std::max(peak, (double)std::abs(channel[i]));
+            sumOfSquares += channel[i] * (double)channel[i];
+            sum += channel[i];
+            convolutionPeak = std::max(convolutionPeak, std::abs(sum));
+        }
+        double rms = std::sqrt(sumOfSquares / TEST_SIZE);
+        for (const auto &s : {statistics[c], readStatistics[c]})
+        {
+            TEST_ASSERT(s.size == TEST_SIZE);
+            TEST_ASSERT(s.peak == (float)peak);
+            TEST_ASSERT(std::abs(s.getRms() - rms) < 1E-5 * rms);
+            TEST_ASSERT(std::abs(s.convolutionPeak - convolutionPeak) < 1E-6 * convolutionPeak);
+        }
+    }
+}
+
+int main(void)
+{
+    try
+    {
+        TestRemix();
+        TestConvertToMono();
+        TestThen();
+        TestStatistics();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "record_plugins/AudioDecoderStream.hpp"
+#include "record_plugins/AudioFileWriter.hpp"
+#include "record_plugins/FfmpegDecoderStream.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+using namespace toob;
+namespace fs = std::filesystem;
+
+static constexpr uint32_t SAMPLE_RATE = 48000;
+static constexpr size_t TEST_FRAMES = 5 * SAMPLE_RATE + 1234;
+
+static fs::path TestDirectory()
+{
+    fs::path path = fs::temp_directory_path() / ("AudioDecoderStreamTest-" + std::to_string(getpid()));
+    fs::remove_all(path);
+    fs::create_directories(path);
+    return path;
+}
+
+static float TestSignal(size_t channel, size_t frame)
+{
+    return (float)(0.5 * std::sin(frame * 0.01 * (channel + 1)));
+}
+
+static void WriteTestFile(const fs::path &path, AudioFileFormat format, int channels)
+{
+    auto writer = AudioFileWriter::Create(path, format, channels, SAMPLE_RATE);
+    constexpr size_t BUFFER_SIZE = 4800;
+    std::vector<std::vector<float>> buffers(channels, std::vector<float>(BUFFER_SIZE));
+    std::vector<const float *> pointers;
+    for (auto &buffer : buffers)
+    {
+        pointers.push_back(buffer.data());
+    }
+    size_t t = 0;
+    while (t < TEST_FRAMES)
+    {
+        size_t thisTime = std::min(TEST_FRAMES - t, BUFFER_SIZE);
+        for (int c = 0; c < channels; ++c)
+        {
+            for (size_t i = 0; i < thisTime; ++i)
+            {
+                buffers[c][i] = TestSignal(c, t + i);
+            }
+        }
+        writer->write(pointers.data(), thisTime);
+        t += thisTime;
+    }
+    writer->close();
+}
+
+static std::vector<std::vector<float>> ReadAll(AudioDecoderStream &stream, int channels)
+{
+    std::vector<std::vector<float>> result(channels, std::vector<float>(TEST_FRAMES + 1000));
+    std::vector<float *> pointers;
+    for (auto &channel : result)
+    {
+        pointers.push_back(channel.data());
+    }
+    size_t position = 0;
+    while (true)
+    {
+        size_t frames = stream.read(pointers.data(), 777);
+        position += frames;
+        for (auto &pointer : pointers)
+        {
+            pointer += frames;
+        }
+        if (frames != 777)
+        {
+            break;
+        }
+    }
+    TEST_ASSERT(position == TEST_FRAMES);
+    TEST_ASSERT(stream.eof());
+    for (auto &channel : result)
+    {
+        channel.resize(position);
+    }
+    return result;
+}
+
+static void TestFormat(const fs::path &path, AudioFileFormat format, float tolerance)
+{
+    constexpr int CHANNELS = 2;
+    WriteTestFile(path, format, CHANNELS);
+
+    auto stream = AudioDecoderStream::Create(path, CHANNELS, SAMPLE_RATE);
+    // must not have fallen back to ffmpeg.
+    TEST_ASSERT(dynamic_cast<FfmpegDecoderStream *>(stream.get()) == nullptr);
+
+    auto decoded = ReadAll(*stream, CHANNELS);
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+        for (size_t i = 0; i < TEST_FRAMES; ++i)
+        {
+            TEST_ASSERT(std::abs(decoded[c][i] - TestSignal(c, i)) <= tolerance);
+        }
+    }
+
+    // seeks land on exactly the requested frame, including seeks after end of file.
+    std::mt19937 random(1234);
+    std::vector<std::vector<float>> buffers(CHANNELS, std::vector<float>(1000));
+    float *pointers[CHANNELS] = {buffers[0].data(), buffers[1].data()};
+    for (size_t n = 0; n < 50; ++n)
+    {
+        size_t frame = n == 0 ? 0 : random() % TEST_FRAMES;
+        stream->seek(frame);
+        TEST_ASSERT(!stream->eof());
+        size_t frames = stream->read(pointers, 1000);
+        TEST_ASSERT(frames == std::min((size_t)1000, TEST_FRAMES - frame));
+        for (size_t c = 0; c < CHANNELS; ++c)
+        {
+            for (size_t i = 0; i < frames; ++i)
+            {
+                TEST_ASSERT(buffers[c][i] == decoded[c][frame + i]);
+            }
+        }
+    }
+    stream->seek(TEST_FRAMES);
+    TEST_ASSERT(stream->read(pointers, 1000) == 0);
+    TEST_ASSERT(stream->eof());
+
+    // stereo files mix to mono.
+    auto monoStream = AudioDecoderStream::Create(path, 1, SAMPLE_RATE);
+    auto mono = ReadAll(*monoStream, 1);
+    for (size_t i = 0; i < TEST_FRAMES; ++i)
+    {
+        TEST_ASSERT(std::abs(mono[0][i] - 0.5f * (decoded[0][i] + decoded[1][i])) < 1E-6f);
+    }
+}
+
+int main(void)
+{
+    try
+    {
+        fs::path directory = TestDirectory();
+        TestFormat(directory / "test16.wav", AudioFileFormat::WavInt16, 1.0f / 32768);
+        TestFormat(directory / "testFloat.wav", AudioFileFormat::WavFloat, 0.0f);
+        TestFormat(directory / "test.flac", AudioFileFormat::Flac, 1.0f / (1 << 23));
+        fs::remove_all(directory);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,398 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "record_plugins/AudioFileWriter.hpp"
+#include "record_plugins/AsyncFile.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace toob;
+namespace fs = std::filesystem;
+
+static constexpr uint32_t SAMPLE_RATE = 48000;
+
+static fs::path TestDirectory()
+{
+    fs::path path = fs::temp_directory_path() / ("AudioFileWriterTest-" + std::to_string(getpid()));
+    fs::remove_all(path);
+    fs::create_directories(path);
+    return path;
+}
+
+static std::vector<uint8_t> ReadFile(const fs::path &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static uint32_t Uint32At(const std::vector<uint8_t> &data, size_t offset)
+{
+    uint32_t result;
+    memcpy(&result, data.data() + offset, sizeof(result));
+    return result;
+}
+
+static uint64_t BigEndianAt(const std::vector<uint8_t> &data, size_t offset, size_t bytes)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        result = (result << 8) | data[offset + i];
+    }
+    return result;
+}
+
+static void WriteTestSignal(AudioFileWriter &writer, int channels, double seconds)
+{
+    constexpr size_t BUFFER_SIZE = SAMPLE_RATE / 10;
+    std::vector<std::vector<float>> buffers(channels, std::vector<float>(BUFFER_SIZE));
+    std::vector<const float *> pointers;
+    for (auto &buffer : buffers)
+    {
+        pointers.push_back(buffer.data());
+    }
+    size_t frames = (size_t)(seconds * SAMPLE_RATE);
+    size_t t = 0;
+    while (t < frames)
+    {
+        size_t thisTime = std::min(frames - t, BUFFER_SIZE);
+        for (size_t i = 0; i < thisTime; ++i)
+        {
+            float v = (float)(0.5 * std::sin((t + i) * 0.01));
+            for (int c = 0; c < channels; ++c)
+            {
+                buffers[c][i] = c == 0 ? v : -v;
+            }
+        }
+        writer.write(pointers.data(), thisTime);
+        t += thisTime;
+    }
+}
+
+// Returns the number of frames in the data chunk, after checking that the RIFF sizes are consistent.
+static size_t CheckWavFile(const fs::path &path, size_t frameSize)
+{
+    std::vector<uint8_t> data = ReadFile(path);
+    TEST_ASSERT(data.size() > 12);
+    TEST_ASSERT(memcmp(data.data(), "RIFF", 4) == 0);
+    TEST_ASSERT(Uint32At(data, 4) == data.size() - 8);
+    TEST_ASSERT(memcmp(data.data() + 8, "WAVE", 4) == 0);
+
+    size_t position = 12;
+    while (position + 8 <= data.size())
+    {
+        uint32_t chunkSize = Uint32At(data, position + 4);
+        if (memcmp(data.data() + position, "data", 4) == 0)
+        {
+            size_t dataStart = position + 8;
+            TEST_ASSERT(dataStart + chunkSize + (chunkSize & 1) == data.size());
+            TEST_ASSERT(chunkSize % frameSize == 0);
+            return chunkSize / frameSize;
+        }
+        position += 8 + chunkSize + (chunkSize & 1);
+    }
+    throw std::logic_error("No data chunk.");
+}
+
+static void TestAsyncFile()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "async.bin";
+
+    std::mt19937 random(1234);
+    std::vector<uint8_t> expected;
+    {
+        AsyncFile file(path, 2);
+        std::vector<uint8_t> chunk;
+        for (int i = 0; i < 400; ++i)
+        {
+            chunk.resize(random() % 20000 + 1);
+            for (auto &b : chunk)
+            {
+                b = (uint8_t)random();
+            }
+            file.Write(expected.size(), chunk.data(), chunk.size());
+            expected.insert(expected.end(), chunk.begin(), chunk.end());
+
+            if (i % 7 == 0)
+            {
+                // rewrite part of the header.
+                uint8_t patch[16];
+                size_t position = random() % std::min(expected.size() - sizeof(patch), AsyncFile::HEADER_SIZE - sizeof(patch));
+                for (auto &b : patch)
+                {
+                    b = (uint8_t)random();
+                }
+                file.Write(position, patch, sizeof(patch));
+                memcpy(expected.data() + position, patch, sizeof(patch));
+            }
+            if (i % 50 == 0)
+            {
+                file.Flush();
+                TEST_ASSERT(ReadFile(path) == expected);
+            }
+            else if (i % 50 == 25)
+            {
+                // Checkpoint() doesn't wait, but the file (without padding) catches up.
+                file.Checkpoint();
+                bool caughtUp = false;
+                for (int retry = 0; retry < 500 && !caughtUp; ++retry)
+                {
+                    caughtUp = ReadFile(path) == expected;
+                    if (!caughtUp)
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    }
+                }
+                TEST_ASSERT(caughtUp);
+            }
+        }
+        TEST_ASSERT(file.Size() == expected.size());
+        TEST_ASSERT(expected.size() > 4 * AsyncFile::BLOCK_SIZE);
+        file.Close();
+    }
+    TEST_ASSERT(ReadFile(path) == expected);
+
+    fs::remove_all(directory);
+}
+
+static void TestWavClose()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.wav";
+
+    auto writer = AudioFileWriter::Create(path, AudioFileFormat::WavInt16, 2, SAMPLE_RATE);
+    TEST_ASSERT(fs::exists(path.string() + ".$$$"));
+    WriteTestSignal(*writer, 2, 7.5);
+    writer->close();
+    writer.reset();
+
+    TEST_ASSERT(!fs::exists(path.string() + ".$$$"));
+    TEST_ASSERT(CheckWavFile(path, 2 * sizeof(int16_t)) == (size_t)(7.5 * SAMPLE_RATE));
+
+    fs::remove_all(directory);
+}
+
+static void TestAbandonedFile()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.mp3";
+
+    {
+        auto writer = AudioFileWriter::Create(path, AudioFileFormat::Mp3, 1, SAMPLE_RATE);
+        WriteTestSignal(*writer, 1, 1.0);
+        // destroyed without close().
+    }
+    TEST_ASSERT(!fs::exists(path));
+    TEST_ASSERT(CheckWavFile(directory / "take.wav", sizeof(float)) == SAMPLE_RATE);
+
+    fs::remove_all(directory);
+}
+
+static void TestCrashRecovery()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.wav";
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // child: exit without closing the file, or flushing anything after the last header update.
+        auto writer = AudioFileWriter::Create(path, AudioFileFormat::WavFloat, 2, SAMPLE_RATE);
+        WriteTestSignal(*writer, 2, AudioFileWriter::HEADER_UPDATE_INTERVAL_SECONDS + 1.05);
+        // header updates are written by the file's writer thread; let it catch up before the "crash".
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        _exit(EXIT_SUCCESS);
+    }
+    TEST_ASSERT(pid > 0);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    TEST_ASSERT(!fs::exists(path));
+    TEST_ASSERT(fs::exists(path.string() + ".$$$"));
+
+    auto recovered = AudioFileWriter::RecoverIncompleteFiles(directory);
+    TEST_ASSERT(recovered.size() == 1);
+    TEST_ASSERT(recovered[0] == path);
+    TEST_ASSERT(!fs::exists(path.string() + ".$$$"));
+
+    size_t frames = CheckWavFile(path, 2 * sizeof(float));
+    TEST_ASSERT(frames >= AudioFileWriter::HEADER_UPDATE_INTERVAL_SECONDS * SAMPLE_RATE);
+
+    fs::remove_all(directory);
+}
+
+static void TestRecordingInProgressIsSkipped()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.wav";
+
+    auto writer = AudioFileWriter::Create(path, AudioFileFormat::WavInt16, 1, SAMPLE_RATE);
+    WriteTestSignal(*writer, 1, 1.0);
+
+    TEST_ASSERT(AudioFileWriter::RecoverIncompleteFiles(directory).empty());
+    TEST_ASSERT(fs::exists(path.string() + ".$$$"));
+
+    writer->close();
+    TEST_ASSERT(fs::exists(path));
+
+    fs::remove_all(directory);
+}
+
+// Returns the sample numbers of the (non-placeholder) seek points in a FLAC file, after checking
+// the metadata block chain and that each seek point lies within the file.
+static std::vector<uint64_t> ReadFlacSeekPoints(const fs::path &path)
+{
+    std::vector<uint8_t> data = ReadFile(path);
+    TEST_ASSERT(data.size() > 8 && memcmp(data.data(), "fLaC", 4) == 0);
+    TEST_ASSERT((data[4] & 0x7F) == 0); // STREAMINFO comes first.
+
+    std::vector<uint64_t> samples;
+    uint64_t lastOffset = 0;
+    bool foundSeekTable = false;
+    size_t position = 4;
+    while (true)
+    {
+        TEST_ASSERT(position + 4 <= data.size());
+        uint8_t blockType = data[position];
+        size_t length = BigEndianAt(data, position + 1, 3);
+        TEST_ASSERT(position + 4 + length <= data.size());
+        if ((blockType & 0x7F) == 3)
+        {
+            foundSeekTable = true;
+            for (size_t i = 0; i < length / 18; ++i)
+            {
+                size_t p = position + 4 + i * 18;
+                uint64_t sample = BigEndianAt(data, p, 8);
+                if (sample == 0xFFFFFFFFFFFFFFFFull)
+                {
+                    continue;
+                }
+                // placeholders only follow the real points.
+                TEST_ASSERT(samples.size() == i);
+                uint64_t offset = BigEndianAt(data, p + 8, 8);
+                TEST_ASSERT(samples.empty() ? (sample == 0 && offset == 0) : (sample > samples.back() && offset > lastOffset));
+                TEST_ASSERT(BigEndianAt(data, p + 16, 2) != 0);
+                samples.push_back(sample);
+                lastOffset = offset;
+            }
+        }
+        position += 4 + length;
+        if (blockType & 0x80)
+        {
+            break;
+        }
+    }
+    TEST_ASSERT(foundSeekTable);
+    // offsets are relative to the first frame.
+    TEST_ASSERT(position + lastOffset < data.size());
+    return samples;
+}
+
+static void TestFlacSeekTable()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.flac";
+
+    auto writer = AudioFileWriter::Create(path, AudioFileFormat::Flac, 1, SAMPLE_RATE);
+    WriteTestSignal(*writer, 1, 25.0);
+    writer->close();
+
+    // points at 0, 10 and 20 seconds: the first frame that starts at or after each.
+    std::vector<uint64_t> seekPoints = ReadFlacSeekPoints(path);
+    TEST_ASSERT(seekPoints.size() == 3);
+    for (size_t i = 0; i < seekPoints.size(); ++i)
+    {
+        TEST_ASSERT(seekPoints[i] >= i * 10 * SAMPLE_RATE);
+        TEST_ASSERT(seekPoints[i] < i * 10 * SAMPLE_RATE + 2 * 4096);
+    }
+
+    fs::remove_all(directory);
+}
+
+static void TestFlacCrashRecovery()
+{
+    fs::path directory = TestDirectory();
+    fs::path path = directory / "take.flac";
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // child: exit without finishing the encoder. The last header update is at 10 seconds.
+        auto writer = AudioFileWriter::Create(path, AudioFileFormat::Flac, 2, SAMPLE_RATE);
+        WriteTestSignal(*writer, 2, 2 * AudioFileWriter::HEADER_UPDATE_INTERVAL_SECONDS + 1.05);
+        // header updates are written by the file's writer thread; let it catch up before the "crash".
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        _exit(EXIT_SUCCESS);
+    }
+    TEST_ASSERT(pid > 0);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    TEST_ASSERT(!fs::exists(path));
+    TEST_ASSERT(fs::exists(path.string() + ".$$$"));
+
+    auto recovered = AudioFileWriter::RecoverIncompleteFiles(directory);
+    TEST_ASSERT(recovered.size() == 1);
+    TEST_ASSERT(recovered[0] == path);
+    TEST_ASSERT(!fs::exists(path.string() + ".$$$"));
+
+    // the seek table is as of the last header update.
+    std::vector<uint64_t> seekPoints = ReadFlacSeekPoints(path);
+    TEST_ASSERT(!seekPoints.empty());
+    TEST_ASSERT(seekPoints.back() < 2 * AudioFileWriter::HEADER_UPDATE_INTERVAL_SECONDS * SAMPLE_RATE);
+
+    fs::remove_all(directory);
+}
+
+int main(void)
+{
+    try
+    {
+        TestAsyncFile();
+        TestWavClose();
+        TestAbandonedFile();
+        TestCrashRecovery();
+        TestRecordingInProgressIsSkipped();
+        TestFlacSeekTable();
+        TestFlacCrashRecovery();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -22,6 +22,9 @@
 #include <iostream>
 #include <thread>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <random>
 using namespace std;
 
 
@@ -29,7 +32,7 @@ using namespace toob;
 
 static void CheckPoolBuffers(AudioFileBufferPool &pool, size_t n) 
 {
-
+    pool.TestPoolCount(n);
 }
 
 void BasicOps() {
@@ -66,6 +69,7 @@ void BasicOps() {
 }
 
 
+// The threads hold more buffers between them than the pool has, so some takes find it empty.
 void MultiThreadedTest() {
 
     AudioFileBufferPool pool(1,1024,6);
@@ -80,7 +84,9 @@ void MultiThreadedTest() {
                 buffers[j] = pool.TakeBuffer();
             }
             for (size_t j = 0; j < buffers.size(); ++j) {
-                pool.PutBuffer(buffers[j]);
+                if (buffers[j]) {
+                    pool.PutBuffer(buffers[j]);
+                }
             }
         }
     });
@@ -94,7 +100,9 @@ void MultiThreadedTest() {
                 buffers[j] = pool.TakeBuffer();
             }
             for (size_t j = 0; j < buffers.size(); ++j) {
-                pool.PutBuffer(buffers[j]);
+                if (buffers[j]) {
+                    pool.PutBuffer(buffers[j]);
+                }
             }
         }
     });
@@ -102,11 +110,161 @@ void MultiThreadedTest() {
     t1.join();
     t2.join();
 
+    CheckPoolBuffers(pool,6);
+    if (pool.AllocationCount() != 6) {
+        throw std::runtime_error("Allocation count mismatch");
+    }
     pool.Trim(0);
     CheckPoolBuffers(pool,0);
 
 }
 
+// TakeBuffer() runs on the audio thread, so an empty pool returns nullptr rather than allocating.
+void EmptyPool() {
+    AudioFileBufferPool pool(1,256,1);
+    size_t callbacks = 0;
+    pool.SetLowWatermark(1,[&callbacks]() { ++callbacks; });
+
+    auto buffer = pool.TakeBuffer();
+    if (buffer == nullptr) {
+        throw std::runtime_error("Expected a pooled buffer.");
+    }
+    if (pool.TakeBuffer() != nullptr) {
+        throw std::runtime_error("An empty pool should return nullptr.");
+    }
+    if (pool.AllocationCount() != 1) {
+        throw std::runtime_error("TakeBuffer() should not allocate.");
+    }
+    if (callbacks != 1) {
+        throw std::runtime_error("Low watermark should be signalled once.");
+    }
+    pool.PutBuffer(buffer);
+    pool.Trim(0);
+}
+
+
+void ReleaseReturnsToPool() {
+    AudioFileBufferPool pool(2,1000,2);
+
+    {
+        AudioFileBuffer::ptr buffer { pool.TakeBuffer()};
+        CheckPoolBuffers(pool,1);
+
+        // channels are planar, and each starts on a cache line.
+        if (((uintptr_t)buffer->GetChannel(0) % 64) != 0 || ((uintptr_t)buffer->GetChannel(1) % 64) != 0) {
+            throw std::runtime_error("Channel data is not aligned.");
+        }
+        if (buffer->GetChannel(1) - buffer->GetChannel(0) < 1000) {
+            throw std::runtime_error("Channels overlap.");
+        }
+    }
+    CheckPoolBuffers(pool,2);
+    if (pool.AllocationCount() != 2) {
+        throw std::runtime_error("Allocation count mismatch");
+    }
+}
+
+void LowWatermark() {
+    AudioFileBufferPool pool(1,256,8);
+    size_t callbacks = 0;
+    pool.SetLowWatermark(4,[&callbacks]() { ++callbacks; });
+
+    std::vector<AudioFileBuffer*> buffers;
+    for (size_t i = 0; i < 4; ++i) {
+        buffers.push_back(pool.TakeBuffer());
+    }
+    if (callbacks != 0) {
+        throw std::runtime_error("Low watermark signalled too early.");
+    }
+    buffers.push_back(pool.TakeBuffer());
+    buffers.push_back(pool.TakeBuffer());
+    if (callbacks != 1) {
+        throw std::runtime_error("Low watermark should be signalled once.");
+    }
+    // refilling re-arms the watermark.
+    pool.Reserve(8);
+    CheckPoolBuffers(pool,8);
+    for (size_t i = 0; i < 5; ++i) {
+        buffers.push_back(pool.TakeBuffer());
+    }
+    if (callbacks != 2) {
+        throw std::runtime_error("Low watermark was not re-armed.");
+    }
+    for (auto buffer: buffers) {
+        pool.PutBuffer(buffer);
+    }
+    pool.Trim(0);
+}
+
+// An audio thread and a background thread take and put buffers as fast as they can, while a third
+// thread keeps the pool topped up. Every buffer carries an ownership flag in its first sample, so
+// a buffer handed out twice (e.g. after an ABA race on the free list) is detected.
+void ConcurrentStress() {
+    constexpr size_t POOL_SIZE = 64;
+    AudioFileBufferPool pool(2,480,POOL_SIZE);
+
+    std::atomic<bool> refill { false};
+    pool.SetLowWatermark(8,[&refill]() { refill = true; });
+
+    {
+        std::vector<AudioFileBuffer*> buffers;
+        for (size_t i = 0; i < POOL_SIZE; ++i) {
+            buffers.push_back(pool.TakeBuffer());
+            *(uint32_t*)buffers.back()->GetChannel(0) = 0;
+        }
+        for (auto buffer: buffers) {
+            pool.PutBuffer(buffer);
+        }
+    }
+    std::atomic<bool> failed { false};
+    std::atomic<size_t> running { 2};
+
+    auto worker = [&](uint32_t seed, size_t maxHeld) {
+        std::minstd_rand random(seed);
+        std::vector<AudioFileBuffer*> held;
+        for (size_t i = 0; i < 200000 && !failed; ++i) {
+            size_t n = 1 + random() % maxHeld;
+            for (size_t j = 0; j < n; ++j) {
+                auto buffer = pool.TakeBuffer();
+                if (std::atomic_ref<uint32_t>(*(uint32_t*)buffer->GetChannel(0)).exchange(1) != 0) {
+                    failed = true;
+                }
+                held.push_back(buffer);
+            }
+            for (auto buffer: held) {
+                if (std::atomic_ref<uint32_t>(*(uint32_t*)buffer->GetChannel(0)).exchange(0) != 1) {
+                    failed = true;
+                }
+                pool.PutBuffer(buffer);
+            }
+            held.clear();
+        }
+        --running;
+    };
+    std::thread refiller([&]() {
+        while (running != 0) {
+            if (refill.exchange(false)) {
+                pool.Reserve(POOL_SIZE);
+            }
+            std::this_thread::yield();
+        }
+    });
+    std::thread t1(worker,1,7);
+    std::thread t2(worker,2,12);
+    t1.join();
+    t2.join();
+    refiller.join();
+
+    if (failed) {
+        throw std::runtime_error("A buffer was handed out twice.");
+    }
+    CheckPoolBuffers(pool,pool.AllocationCount());
+    pool.Trim(0);
+    CheckPoolBuffers(pool,0);
+    if (pool.AllocationCount() != 0) {
+        throw std::runtime_error("Allocation count mismatch");
+    }
+}
 
 int main(void) {
 
@@ -116,9 +274,15 @@ int main(void) {
 
         MultiThreadedTest();
 
+        ReleaseReturnsToPool();
+        EmptyPool();
+        LowWatermark();
+        ConcurrentStress();
+
     } catch (const std::exception&e) 
     {
         std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
 
 
@@ -61,7 +61,11 @@ namespace toob {
         }
 
         void CopyTo(std::vector<float> &buffer) const {
-            size_t count = buffer.size();
+            CopyTo(buffer, buffer.size());
+        }
+        // Copy the most recent count values to the start of buffer, oldest first.
+        void CopyTo(std::vector<float> &buffer, size_t count) const {
+            assert(count <= buffer.size() && count <= this->buffer.size());
             if (head >= count)
             {
                 size_t ix = 0;
@@ -72,7 +76,7 @@ namespace toob {
             } else {
                 size_t ix = 0;
                 size_t start = this->head + this->buffer.size()-count;
-                for (size_t i = start; i < buffer.size(); ++i)
+                for (size_t i = start; i < this->buffer.size(); ++i)
                 {
                     buffer[ix++] = this->buffer[i]; 
                 }
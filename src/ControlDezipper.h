@@ -24,6 +24,7 @@
  */
 
 
+#include <cstddef>
 #include <cstdint>
 
 namespace toob {
@@ -80,6 +81,35 @@ public:
         }
         return x;
     }
+
+    // Number of upcoming samples over which Tick() returns a linear ramp (or a constant,
+    // once the transition is complete).
+    size_t LinearRun() const
+    {
+        return samplesRemaining == 0 ? SIZE_MAX : samplesRemaining;
+    }
+
+    // Equivalent to n calls to Tick(), which return first + i*increment. n must not exceed LinearRun().
+    void TickBlock(size_t n, float &first, float &increment)
+    {
+        if (samplesRemaining == 0)
+        {
+            first = x;
+            increment = 0;
+            return;
+        }
+        first = x + dx;
+        increment = dx;
+        samplesRemaining -= n;
+        if (samplesRemaining == 0)
+        {
+            x = targetX;
+        }
+        else
+        {
+            x += dx * n;
+        }
+    }
 };
 
 }// namespace
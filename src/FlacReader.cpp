@@ -23,6 +23,8 @@
 
 #include "FlacReader.hpp"
 #include <FLAC++/decoder.h>
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include "ss.hpp"
 
@@ -32,162 +34,258 @@ using namespace FLAC::Decoder;
 namespace toob
 {
 
-    class FlacDecoder : public FLAC::Decoder::File
+    class FlacReader::Decoder : public FLAC::Decoder::File
     {
     public:
-        FlacDecoder(AudioData &audioData)
-            : FLAC::Decoder::File(), audioData(audioData)
+        ~Decoder()
         {
+            Close();
         }
-        std::string getErrorMessage() const {
-            return errorMessage;
-        }
-        size_t getLength() const { return this->sampleOffset; }
-    protected:
-
-        virtual ::FLAC__StreamDecoderLengthStatus length_callback(	FLAC__uint64 * 	stream_length	)  override	
-        {
-            return FLAC__StreamDecoderLengthStatus::FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
-        }
-
-        virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 *const buffers[]) override
+        void Open(const std::filesystem::path &path)
         {
-            if (!seenStreamInfo)
+            FLAC__StreamDecoderInitStatus rc = init(path.string());
+            if (rc != FLAC__STREAM_DECODER_INIT_STATUS_OK)
             {
-                errorMessage = "Received data before receiving stream format.";
-                return FLAC__StreamDecoderWriteStatus::FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
-            }
-            size_t i;
-
-            // Update data
-            size_t channels = audioData.getChannelCount();
-
-            if (frame->header.blocksize + sampleOffset > audioData.getSize())
-            {
-                size_t newSize = (audioData.getSize() + frame->header.blocksize)*3/2;
-                if (newSize < 64*1024)
+                if (rc == FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE)
+                {
+                    throw std::logic_error(SS("Can't open file " << path));
+                }
+                else
                 {
-                    newSize = 64*1024;
+                    throw std::logic_error(SS("Invalid file format: " << path));
                 }
-                audioData.setSize(newSize);
             }
+            isOpen = true;
+            if (!process_until_end_of_metadata() || !seenStreamInfo)
+            {
+                throw std::logic_error(SS("Invalid file format: " << path));
+            }
+            if (channels == 0)
+            {
+                throw std::logic_error(SS("Invalid file format: " << path));
+            }
+        }
+        void Close()
+        {
+            if (isOpen)
+            {
+                isOpen = false;
+                finish();
+            }
+        }
 
-            /* write decoded PCM samples */
+        uint32_t Channels() const { return channels; }
+        uint32_t SampleRate() const { return sampleRate; }
+        size_t NumberOfFrames() const { return totalSamples; }
 
-            auto &outputBuffers = audioData.getData();
-            if (this->bitsPerSample == 16)
+        size_t ReadData(float **output, size_t offset, size_t length)
+        {
+            size_t read = 0;
+            while (read < length)
             {
-                static constexpr float SCALE = 1.0f/32768;
-
-                for (size_t c = 0; c < channels; ++c)
+                if (blockIndex == blockLength)
                 {
-                    auto &outputBuffer = outputBuffers[c];
-                    auto buffer = buffers[c];
-                    for (i = 0; i < frame->header.blocksize; i++)
+                    // the next frame is converted straight into the output, with anything that doesn't fit left in block.
+                    target = output;
+                    targetOffset = offset + read;
+                    targetLength = length - read;
+                    targetWritten = 0;
+                    bool more = NextFrame();
+                    target = nullptr;
+                    read += targetWritten;
+                    if (!more)
                     {
-                            outputBuffer[sampleOffset+i] = SCALE*(FLAC__int16)buffer[i];
+                        break;
                     }
+                    continue;
                 }
-                sampleOffset += frame->header.blocksize;
-            } else if (this->bitsPerSample == 24)
-            {
-                static constexpr float SCALE = 1.0f/(32768L*256L);
-
+                size_t thisTime = std::min(length - read, blockLength - blockIndex);
                 for (size_t c = 0; c < channels; ++c)
                 {
-                    auto &outputBuffer = outputBuffers[c];
-                    auto buffer = buffers[c];
-                    for (i = 0; i < frame->header.blocksize; i++)
-                    {
-                            outputBuffer[sampleOffset+i] = SCALE*(FLAC__int32)buffer[i];
-                    }
+                    const float *input = block[c].data() + blockIndex;
+                    std::copy(input, input + thisTime, output[c] + offset + read);
                 }
-                sampleOffset += frame->header.blocksize;
+                blockIndex += thisTime;
+                read += thisTime;
+            }
+            return read;
+        }
 
-            } else if (this->bitsPerSample == 32)
+    protected:
+        virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 *const buffers[]) override
+        {
+            if (!seenStreamInfo)
+            {
+                errorMessage = "Received data before receiving stream format.";
+                return FLAC__StreamDecoderWriteStatus::FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+            }
+            unsigned bitsPerSample = frame->header.bits_per_sample;
+            if (bitsPerSample == 0 || bitsPerSample > 32 || frame->header.channels != channels)
             {
-                static constexpr float SCALE = 1.0f/(32768L*65536L);
+                this->errorMessage = "Invalid bits per sample.";
+                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+            }
+            size_t frames = frame->header.blocksize;
+            float scale = std::ldexp(1.0f, 1 - (int)bitsPerSample);
 
-                for (size_t c = 0; c < channels; ++c)
+            size_t direct = std::min(frames, targetLength);
+            size_t remaining = frames - direct;
+            for (size_t c = 0; c < channels; ++c)
+            {
+                const FLAC__int32 *input = buffers[c];
+                if (direct != 0)
                 {
-                    auto &outputBuffer = outputBuffers[c];
-                    auto buffer = buffers[c];
-                    for (i = 0; i < frame->header.blocksize; i++)
+                    Convert(input, target[c] + targetOffset, direct, scale);
+                }
+                if (remaining != 0)
+                {
+                    if (block[c].size() < remaining)
                     {
-                            outputBuffer[sampleOffset+i] = SCALE*(FLAC__int32)buffer[i];
+                        block[c].resize(remaining);
                     }
+                    Convert(input + direct, block[c].data(), remaining, scale);
                 }
-                sampleOffset += frame->header.blocksize;
-
-            } else {
-                this->errorMessage = "Invalid bits per sample.";
-                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
             }
+            targetWritten = direct;
+            blockIndex = 0;
+            blockLength = remaining;
             return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
         }
 
-        virtual bool eof_callback() override
-        {
-            audioData.setSize(sampleOffset); // trim the buffers to correct size.
-            return true;
-        }
-
         virtual void metadata_callback(const ::FLAC__StreamMetadata *metadata) override
         {
             if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO)
             {
                 seenStreamInfo = true;
 
-                const FLAC__StreamMetadata_StreamInfo &stream_info = metadata->data.stream_info;
-                audioData.setSampleRate((size_t)stream_info.sample_rate);
-                audioData.setChannelCount(stream_info.channels);
-                audioData.setSize(stream_info.total_samples);
-                this->bitsPerSample = stream_info.bits_per_sample;
+                const FLAC__StreamMetadata_StreamInfo &streamInfo = metadata->data.stream_info;
+                sampleRate = streamInfo.sample_rate;
+                channels = streamInfo.channels;
+                totalSamples = (size_t)streamInfo.total_samples;
+                block.resize(channels);
+                for (auto &channel : block)
+                {
+                    channel.reserve(streamInfo.max_blocksize);
+                }
             }
         }
-        virtual void error_callback(::FLAC__StreamDecoderErrorStatus status)  override
+        virtual void error_callback(::FLAC__StreamDecoderErrorStatus status) override
         {
             this->errorMessage = "Invalid file format.";
         }
 
     private:
-        FlacDecoder(const FlacDecoder &) = delete;
-        FlacDecoder &operator=(const FlacDecoder &) = delete;
+        // plain loop over contiguous buffers, so that the compiler vectorizes the conversion.
+        static void Convert(const FLAC__int32 *input, float *output, size_t count, float scale)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                output[i] = scale * (float)input[i];
+            }
+        }
 
+        bool NextFrame()
+        {
+            blockIndex = blockLength = 0;
+            while (targetWritten == 0 && blockLength == 0)
+            {
+                if (get_state() == FLAC__STREAM_DECODER_END_OF_STREAM)
+                {
+                    return false;
+                }
+                if (!process_single())
+                {
+                    if (errorMessage.length() == 0)
+                    {
+                        errorMessage = "Invalid file format.";
+                    }
+                    throw std::logic_error(errorMessage);
+                }
+            }
+            return true;
+        }
+
+        bool isOpen = false;
         bool seenStreamInfo = false;
-        float bitsPerSample = 0;
+        uint32_t channels = 0;
+        uint32_t sampleRate = 0;
+        size_t totalSamples = 0;
         std::string errorMessage;
-        size_t sampleOffset = 0;
 
-        AudioData &audioData;
+        // the decoded frame that didn't fit in the caller's buffer.
+        std::vector<std::vector<float>> block;
+        size_t blockIndex = 0;
+        size_t blockLength = 0;
+
+        float **target = nullptr;
+        size_t targetOffset = 0;
+        size_t targetLength = 0;
+        size_t targetWritten = 0;
     };
 
+    FlacReader::FlacReader()
+    {
+    }
+    FlacReader::~FlacReader()
+    {
+    }
+
+    void FlacReader::Open(const std::filesystem::path &path)
+    {
+        decoder = nullptr;
+        auto newDecoder = std::make_unique<Decoder>();
+        newDecoder->Open(path);
+        decoder = std::move(newDecoder);
+    }
+    void FlacReader::Close()
+    {
+        decoder = nullptr;
+    }
+
+    uint32_t FlacReader::Channels() const { return decoder ? decoder->Channels() : 0; }
+    uint32_t FlacReader::SampleRate() const { return decoder ? decoder->SampleRate() : 0; }
+    size_t FlacReader::NumberOfFrames() const { return decoder ? decoder->NumberOfFrames() : 0; }
+
+    size_t FlacReader::ReadData(float **channels, size_t offset, size_t length)
+    {
+        if (!decoder)
+        {
+            throw std::logic_error("File not open.");
+        }
+        return decoder->ReadData(channels, offset, length);
+    }
+
     /*static*/ AudioData FlacReader::Load(const std::filesystem::path &path)
     {
+        FlacReader reader;
+        reader.Open(path);
+
         AudioData result;
-        FlacDecoder decoder{result};
-        FLAC__StreamDecoderInitStatus rc = decoder.init(path);
-        if (rc != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+        result.setSampleRate(reader.SampleRate());
+        result.setChannelCount(reader.Channels());
+
+        size_t frames = 0;
+        std::vector<float *> channels(reader.Channels());
+        while (true)
         {
-            if (rc == FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE)
+            // streams that don't record their length grow the buffers as they go.
+            size_t capacity = reader.NumberOfFrames();
+            if (capacity <= frames)
             {
-                throw std::logic_error(SS("Can't open file " << path));
+                capacity = frames + std::max((size_t)64 * 1024, frames / 2);
             }
-            else {
-                throw std::logic_error(SS("Invalid file format: " << path));
+            result.setSize(capacity);
+            for (size_t c = 0; c < channels.size(); ++c)
+            {
+                channels[c] = result.getChannel(c).data();
             }
-        }
-        if (!decoder.process_until_end_of_stream())
-        {
-            std::string message = decoder.getErrorMessage();
-            if (message == "" )
+            frames += reader.ReadData(channels.data(), frames, capacity - frames);
+            if (frames < capacity || frames == reader.NumberOfFrames())
             {
-                message = SS("Invalid file format: " << path);
-                throw std::logic_error(message);
+                break;
             }
         }
-        result.setSize(decoder.getLength());
+        result.setSize(frames);
         return result;
-        
     }
 }
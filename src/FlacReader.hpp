@@ -24,12 +24,37 @@
 #pragma once
 
 #include "AudioData.hpp"
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 
 namespace toob {
 
+    // Decodes .flac files a frame at a time, so a file can be streamed (ReadData) without decoding
+    // the parts that haven't been asked for yet.
     class FlacReader {
     public:
+        FlacReader();
+        FlacReader(const FlacReader &) = delete;
+        FlacReader &operator=(const FlacReader &) = delete;
+        ~FlacReader();
+
         static AudioData Load(const std::filesystem::path &path);
+
+        void Open(const std::filesystem::path &path);
+
+        uint32_t Channels() const;
+        uint32_t SampleRate() const;
+        // Zero if the encoder didn't record the length of the stream.
+        size_t NumberOfFrames() const;
+
+        // Decode up to length frames into channels[c][offset...offset+length). Returns the number of
+        // frames decoded, which is less than length only at the end of the stream.
+        size_t ReadData(float **channels, size_t offset, size_t length);
+        void Close();
+
+    private:
+        class Decoder;
+        std::unique_ptr<Decoder> decoder;
     };
-}
\ No newline at end of file
+}
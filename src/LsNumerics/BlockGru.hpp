@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+
+namespace LsNumerics
+{
+    /// @brief GRU layer that is evaluated a block of samples at a time.
+    ///
+    /// Interface-compatible with BlockLstmLayer. The input-weight product for the whole block is computed 
+    /// before the recurrent loop. GRUs have three gates rather than four, so they are roughly 25% 
+    /// cheaper than an LSTM with the same hidden size.
+    ///
+    /// @tparam N_INPUTS Number of inputs.
+    /// @tparam HIDDEN_SIZE Number of hidden units.
+    /// @tparam MAX_BLOCK_SIZE Maximum number of samples per call to Process.
+    template <int N_INPUTS, int HIDDEN_SIZE, int MAX_BLOCK_SIZE = 64>
+    class BlockGruLayer
+    {
+    public:
+        static constexpr int MAX_BLOCK = MAX_BLOCK_SIZE;
+        static constexpr int N_GATES = 3 * HIDDEN_SIZE;
+
+        using InputBlock = Eigen::Matrix<float, N_INPUTS, MAX_BLOCK_SIZE>;
+        using OutputBlock = Eigen::Matrix<float, HIDDEN_SIZE, MAX_BLOCK_SIZE>;
+
+        using FloatMatrix = std::vector<std::vector<float>>;
+
+        BlockGruLayer()
+        {
+            wIh.setZero();
+            wHh.setZero();
+            bias.setZero();
+            biasHn.setZero();
+            Reset();
+        }
+
+        /// @brief Set weights from PyTorch (weight_ih_l0, weight_hh_l0, bias_ih_l0, bias_hh_l0) tensors.
+        ///
+        /// PyTorch gate order is (r, z, n).
+        void SetWeights(
+            const FloatMatrix &weight_ih,
+            const FloatMatrix &weight_hh,
+            const std::vector<float> &bias_ih,
+            const std::vector<float> &bias_hh)
+        {
+            if (weight_ih.size() != N_GATES || weight_hh.size() != N_GATES || bias_ih.size() != N_GATES || bias_hh.size() != N_GATES)
+            {
+                throw std::invalid_argument("Invalid GRU weights.");
+            }
+            for (int row = 0; row < N_GATES; ++row)
+            {
+                if (weight_ih[row].size() != N_INPUTS || weight_hh[row].size() != HIDDEN_SIZE)
+                {
+                    throw std::invalid_argument("Invalid GRU weights.");
+                }
+                for (int c = 0; c < N_INPUTS; ++c)
+                {
+                    wIh(row, c) = weight_ih[row][c];
+                }
+                for (int c = 0; c < HIDDEN_SIZE; ++c)
+                {
+                    wHh(row, c) = weight_hh[row][c];
+                }
+                if (row < 2 * HIDDEN_SIZE)
+                {
+                    // r and z hidden biases fold into the input bias.
+                    bias(row) = bias_ih[row] + bias_hh[row];
+                }
+                else
+                {
+                    // the n hidden bias is scaled by r, so it must be kept separate.
+                    bias(row) = bias_ih[row];
+                    biasHn(row - 2 * HIDDEN_SIZE) = bias_hh[row];
+                }
+            }
+        }
+
+        void Reset()
+        {
+            h.setZero();
+        }
+
+        /// @brief Process a block of samples.
+        /// @param numSamples Number of samples (columns of input) to process. Must not exceed MAX_BLOCK.
+        /// @param input Inputs, one column per sample.
+        /// @param output Receives the hidden state after each sample, one column per sample.
+        void Process(int numSamples, const InputBlock &input, OutputBlock &output)
+        {
+            inputGates.leftCols(numSamples).noalias() = wIh * input.leftCols(numSamples);
+            inputGates.leftCols(numSamples).colwise() += bias;
+
+            for (int t = 0; t < numSamples; ++t)
+            {
+                hiddenGates.noalias() = wHh * h;
+
+                auto inputCol = inputGates.col(t);
+
+                // sigmoid(x) = 0.5*tanh(0.5*x)+0.5, which vectorizes.
+                rz = ((inputCol.template head<2 * HIDDEN_SIZE>() + hiddenGates.template head<2 * HIDDEN_SIZE>()).array() * 0.5f).tanh() * 0.5f + 0.5f;
+                auto r = rz.template head<HIDDEN_SIZE>();
+                auto z = rz.template tail<HIDDEN_SIZE>();
+
+                n = (inputCol.template tail<HIDDEN_SIZE>().array() +
+                     r * (hiddenGates.template tail<HIDDEN_SIZE>() + biasHn).array())
+                        .tanh();
+
+                h.array() = n + z * (h.array() - n);
+                output.col(t) = h;
+            }
+        }
+
+    private:
+        Eigen::Matrix<float, N_GATES, N_INPUTS> wIh;
+        Eigen::Matrix<float, N_GATES, HIDDEN_SIZE> wHh;
+        Eigen::Matrix<float, N_GATES, 1> bias;
+        Eigen::Matrix<float, HIDDEN_SIZE, 1> biasHn;
+
+        Eigen::Matrix<float, N_GATES, MAX_BLOCK_SIZE> inputGates;
+        Eigen::Matrix<float, N_GATES, 1> hiddenGates;
+        Eigen::Array<float, 2 * HIDDEN_SIZE, 1> rz;
+        Eigen::Array<float, HIDDEN_SIZE, 1> n;
+        Eigen::Matrix<float, HIDDEN_SIZE, 1> h;
+    };
+}
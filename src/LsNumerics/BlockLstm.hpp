@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+
+namespace LsNumerics
+{
+    /// @brief LSTM layer that is evaluated a block of samples at a time.
+    ///
+    /// The input-weight product (W_ih·x) for the whole block is computed as a single matrix product 
+    /// before the recurrent loop, leaving only the W_hh·h product and the gate nonlinearities on the 
+    /// sample-by-sample path. Gate rows are stored in (i, f, o, g) order so that the three sigmoid 
+    /// gates are evaluated as one vectorized operation across all hidden units.
+    ///
+    /// @tparam N_INPUTS Number of inputs.
+    /// @tparam HIDDEN_SIZE Number of hidden units.
+    /// @tparam MAX_BLOCK_SIZE Maximum number of samples per call to Process.
+    template <int N_INPUTS, int HIDDEN_SIZE, int MAX_BLOCK_SIZE = 64>
+    class BlockLstmLayer
+    {
+    public:
+        static constexpr int MAX_BLOCK = MAX_BLOCK_SIZE;
+        static constexpr int N_GATES = 4 * HIDDEN_SIZE;
+
+        using InputBlock = Eigen::Matrix<float, N_INPUTS, MAX_BLOCK_SIZE>;
+        using OutputBlock = Eigen::Matrix<float, HIDDEN_SIZE, MAX_BLOCK_SIZE>;
+
+        using FloatMatrix = std::vector<std::vector<float>>;
+
+        BlockLstmLayer()
+        {
+            wIh.setZero();
+            wHh.setZero();
+            bias.setZero();
+            Reset();
+        }
+
+        /// @brief Set weights from PyTorch (weight_ih_l0, weight_hh_l0, bias_ih_l0, bias_hh_l0) tensors.
+        ///
+        /// PyTorch gate order is (i, f, g, o).
+        void SetWeights(
+            const FloatMatrix &weight_ih,
+            const FloatMatrix &weight_hh,
+            const std::vector<float> &bias_ih,
+            const std::vector<float> &bias_hh)
+        {
+            if (weight_ih.size() != N_GATES || weight_hh.size() != N_GATES || bias_ih.size() != N_GATES || bias_hh.size() != N_GATES)
+            {
+                throw std::invalid_argument("Invalid LSTM weights.");
+            }
+            for (int row = 0; row < N_GATES; ++row)
+            {
+                int dstRow = GateRow(row);
+                if (weight_ih[row].size() != N_INPUTS || weight_hh[row].size() != HIDDEN_SIZE)
+                {
+                    throw std::invalid_argument("Invalid LSTM weights.");
+                }
+                for (int c = 0; c < N_INPUTS; ++c)
+                {
+                    wIh(dstRow, c) = weight_ih[row][c];
+                }
+                for (int c = 0; c < HIDDEN_SIZE; ++c)
+                {
+                    wHh(dstRow, c) = weight_hh[row][c];
+                }
+                bias(dstRow) = bias_ih[row] + bias_hh[row];
+            }
+        }
+
+        void Reset()
+        {
+            h.setZero();
+            c.setZero();
+        }
+
+        /// @brief Process a block of samples.
+        /// @param numSamples Number of samples (columns of input) to process. Must not exceed MAX_BLOCK.
+        /// @param input Inputs, one column per sample.
+        /// @param output Receives the hidden state after each sample, one column per sample.
+        void Process(int numSamples, const InputBlock &input, OutputBlock &output)
+        {
+            // Input contribution to the gates for the entire block.
+            inputGates.leftCols(numSamples).noalias() = wIh * input.leftCols(numSamples);
+            inputGates.leftCols(numSamples).colwise() += bias;
+
+            for (int t = 0; t < numSamples; ++t)
+            {
+                gates.noalias() = wHh * h;
+                gates += inputGates.col(t);
+
+                // sigmoid(x) = 0.5*tanh(0.5*x)+0.5, which vectorizes.
+                auto sigmoidGates = gates.template head<3 * HIDDEN_SIZE>().array();
+                sigmoidGates = (sigmoidGates * 0.5f).tanh() * 0.5f + 0.5f;
+                auto g = gates.template tail<HIDDEN_SIZE>().array();
+                g = g.tanh();
+
+                auto i = gates.template segment<HIDDEN_SIZE>(0).array();
+                auto f = gates.template segment<HIDDEN_SIZE>(HIDDEN_SIZE).array();
+                auto o = gates.template segment<HIDDEN_SIZE>(2 * HIDDEN_SIZE).array();
+
+                c.array() = f * c.array() + i * g;
+                h.array() = o * c.array().tanh();
+                output.col(t) = h;
+            }
+        }
+
+    private:
+        // map PyTorch (i, f, g, o) row to (i, f, o, g) row.
+        static int GateRow(int row)
+        {
+            int gate = row / HIDDEN_SIZE;
+            int unit = row % HIDDEN_SIZE;
+            static constexpr int gateMap[4] = {0, 1, 3, 2};
+            return gateMap[gate] * HIDDEN_SIZE + unit;
+        }
+
+        Eigen::Matrix<float, N_GATES, N_INPUTS> wIh;
+        Eigen::Matrix<float, N_GATES, HIDDEN_SIZE> wHh;
+        Eigen::Matrix<float, N_GATES, 1> bias;
+
+        Eigen::Matrix<float, N_GATES, MAX_BLOCK_SIZE> inputGates;
+        Eigen::Matrix<float, N_GATES, 1> gates;
+        Eigen::Matrix<float, HIDDEN_SIZE, 1> h;
+        Eigen::Matrix<float, HIDDEN_SIZE, 1> c;
+    };
+}
@@ -0,0 +1,163 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "BlockLstm.hpp"
+#include <cmath>
+#include <random>
+#include <iostream>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+using FloatMatrix = std::vector<std::vector<float>>;
+
+// Straightforward per-sample LSTM, using PyTorch conventions.
+class ReferenceLstm
+{
+public:
+    ReferenceLstm(const FloatMatrix &wIh, const FloatMatrix &wHh, const std::vector<float> &bIh, const std::vector<float> &bHh)
+        : wIh(wIh), wHh(wHh), bIh(bIh), bHh(bHh)
+    {
+        hiddenSize = bIh.size() / 4;
+        h.resize(hiddenSize);
+        c.resize(hiddenSize);
+    }
+
+    const std::vector<float> &Tick(const std::vector<float> &x)
+    {
+        std::vector<double> gates(4 * hiddenSize);
+        for (size_t row = 0; row < gates.size(); ++row)
+        {
+            double sum = bIh[row] + bHh[row];
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                sum += wIh[row][i] * x[i];
+            }
+            for (size_t i = 0; i < hiddenSize; ++i)
+            {
+                sum += wHh[row][i] * h[i];
+            }
+            gates[row] = sum;
+        }
+        for (size_t u = 0; u < hiddenSize; ++u)
+        {
+            double i = Sigmoid(gates[u]);
+            double f = Sigmoid(gates[hiddenSize + u]);
+            double g = std::tanh(gates[2 * hiddenSize + u]);
+            double o = Sigmoid(gates[3 * hiddenSize + u]);
+            c[u] = (float)(f * c[u] + i * g);
+            h[u] = (float)(o * std::tanh(c[u]));
+        }
+        return h;
+    }
+
+private:
+    static double Sigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+
+    FloatMatrix wIh, wHh;
+    std::vector<float> bIh, bHh;
+    size_t hiddenSize;
+    std::vector<float> h, c;
+};
+
+static FloatMatrix RandomMatrix(std::mt19937 &rng, size_t rows, size_t columns)
+{
+    std::uniform_real_distribution<float> dist(-0.4f, 0.4f);
+    FloatMatrix result(rows);
+    for (auto &row : result)
+    {
+        row.resize(columns);
+        for (auto &v : row)
+        {
+            v = dist(rng);
+        }
+    }
+    return result;
+}
+
+template <int N_INPUTS, int HIDDEN_SIZE>
+static void TestLstm()
+{
+    cout << "BlockLstmLayer<" << N_INPUTS << "," << HIDDEN_SIZE << ">" << endl;
+    std::mt19937 rng(N_INPUTS * 1000 + HIDDEN_SIZE);
+
+    FloatMatrix wIh = RandomMatrix(rng, 4 * HIDDEN_SIZE, N_INPUTS);
+    FloatMatrix wHh = RandomMatrix(rng, 4 * HIDDEN_SIZE, HIDDEN_SIZE);
+    std::vector<float> bIh = RandomMatrix(rng, 1, 4 * HIDDEN_SIZE)[0];
+    std::vector<float> bHh = RandomMatrix(rng, 1, 4 * HIDDEN_SIZE)[0];
+
+    ReferenceLstm reference(wIh, wHh, bIh, bHh);
+
+    using Layer = BlockLstmLayer<N_INPUTS, HIDDEN_SIZE>;
+    Layer *layer = new Layer(); // too large for the stack.
+    layer->SetWeights(wIh, wHh, bIh, bHh);
+
+    typename Layer::InputBlock input;
+    typename Layer::OutputBlock output;
+
+    std::uniform_real_distribution<float> inputDist(-1.0f, 1.0f);
+
+    // odd block sizes to check partial blocks.
+    const int blockSizes[] = {1, 64, 17, 3, 64, 40};
+    for (int blockSize : blockSizes)
+    {
+        std::vector<std::vector<float>> inputs(blockSize);
+        for (int t = 0; t < blockSize; ++t)
+        {
+            inputs[t].resize(N_INPUTS);
+            for (int i = 0; i < N_INPUTS; ++i)
+            {
+                inputs[t][i] = inputDist(rng);
+                input(i, t) = inputs[t][i];
+            }
+        }
+        layer->Process(blockSize, input, output);
+        for (int t = 0; t < blockSize; ++t)
+        {
+            const std::vector<float> &expected = reference.Tick(inputs[t]);
+            for (int u = 0; u < HIDDEN_SIZE; ++u)
+            {
+                TEST_ASSERT(std::abs(expected[u] - output(u, t)) < 1E-4);
+            }
+        }
+    }
+    delete layer;
+}
+
+int main(int, char **)
+{
+    try
+    {
+        TestLstm<1, 8>();
+        TestLstm<2, 20>();
+        TestLstm<3, 40>();
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include <cstddef>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+
+namespace LsNumerics
+{
+    /// @brief A stack of recurrent layers followed by a single-output dense layer, evaluated a block at a time.
+    ///
+    /// @tparam LAYER Recurrent layer template (BlockLstmLayer or BlockGruLayer).
+    /// @tparam N_INPUTS Number of model inputs.
+    /// @tparam HIDDEN_SIZE Hidden size of every recurrent layer.
+    /// @tparam MAX_BLOCK_SIZE Maximum number of samples per call to Process.
+    template <template <int, int, int> class LAYER, int N_INPUTS, int HIDDEN_SIZE, int MAX_BLOCK_SIZE = 64>
+    class BlockRnnModel
+    {
+    public:
+        using InputLayer = LAYER<N_INPUTS, HIDDEN_SIZE, MAX_BLOCK_SIZE>;
+        using StackedLayer = LAYER<HIDDEN_SIZE, HIDDEN_SIZE, MAX_BLOCK_SIZE>;
+
+        static constexpr int MAX_BLOCK = MAX_BLOCK_SIZE;
+
+        using InputBlock = typename InputLayer::InputBlock;
+        using FloatMatrix = std::vector<std::vector<float>>;
+
+        BlockRnnModel(size_t numLayers)
+        {
+            if (numLayers < 1)
+            {
+                throw std::invalid_argument("Invalid number of layers.");
+            }
+            stackedLayers.resize(numLayers - 1);
+            denseWeights.setZero();
+        }
+
+        size_t NumLayers() const { return stackedLayers.size() + 1; }
+
+        void SetLayerWeights(
+            size_t layer,
+            const FloatMatrix &weight_ih,
+            const FloatMatrix &weight_hh,
+            const std::vector<float> &bias_ih,
+            const std::vector<float> &bias_hh)
+        {
+            if (layer == 0)
+            {
+                inputLayer.SetWeights(weight_ih, weight_hh, bias_ih, bias_hh);
+            }
+            else
+            {
+                stackedLayers.at(layer - 1).SetWeights(weight_ih, weight_hh, bias_ih, bias_hh);
+            }
+        }
+
+        void SetDenseWeights(const FloatMatrix &weight, const std::vector<float> &bias)
+        {
+            if (weight.size() != 1 || weight[0].size() != HIDDEN_SIZE || bias.size() != 1)
+            {
+                throw std::invalid_argument("Invalid dense layer weights.");
+            }
+            for (int i = 0; i < HIDDEN_SIZE; ++i)
+            {
+                denseWeights(0, i) = weight[0][i];
+            }
+            denseBias = bias[0];
+        }
+
+        void Reset()
+        {
+            inputLayer.Reset();
+            for (auto &layer : stackedLayers)
+            {
+                layer.Reset();
+            }
+        }
+
+        /// @brief Process a block of samples.
+        /// @param numSamples Number of samples (columns of input) to process. Must not exceed MAX_BLOCK.
+        /// @param input Inputs, one column per sample.
+        /// @param output Receives one output sample per input column.
+        void Process(int numSamples, const InputBlock &input, float *output)
+        {
+            inputLayer.Process(numSamples, input, hidden[0]);
+            int current = 0;
+            for (auto &layer : stackedLayers)
+            {
+                layer.Process(numSamples, hidden[current], hidden[current ^ 1]);
+                current ^= 1;
+            }
+            Eigen::Map<Eigen::Matrix<float, 1, Eigen::Dynamic>> outputMap(output, numSamples);
+            outputMap.noalias() = denseWeights * hidden[current].leftCols(numSamples);
+            outputMap.array() += denseBias;
+        }
+
+    private:
+        InputLayer inputLayer;
+        std::vector<StackedLayer> stackedLayers;
+        typename InputLayer::OutputBlock hidden[2];
+        Eigen::Matrix<float, 1, HIDDEN_SIZE> denseWeights;
+        float denseBias = 0;
+    };
+}
@@ -0,0 +1,244 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "BlockGru.hpp"
+#include "BlockLstm.hpp"
+#include "BlockRnnModel.hpp"
+#include <cmath>
+#include <random>
+#include <iostream>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+using FloatMatrix = std::vector<std::vector<float>>;
+
+// Straightforward per-sample GRU, using PyTorch conventions.
+class ReferenceGru
+{
+public:
+    ReferenceGru(const FloatMatrix &wIh, const FloatMatrix &wHh, const std::vector<float> &bIh, const std::vector<float> &bHh)
+        : wIh(wIh), wHh(wHh), bIh(bIh), bHh(bHh)
+    {
+        hiddenSize = bIh.size() / 3;
+        h.resize(hiddenSize);
+    }
+
+    const std::vector<float> &Tick(const std::vector<float> &x)
+    {
+        std::vector<double> inputGates(3 * hiddenSize);
+        std::vector<double> hiddenGates(3 * hiddenSize);
+        for (size_t row = 0; row < inputGates.size(); ++row)
+        {
+            double sum = bIh[row];
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                sum += wIh[row][i] * x[i];
+            }
+            inputGates[row] = sum;
+            sum = bHh[row];
+            for (size_t i = 0; i < hiddenSize; ++i)
+            {
+                sum += wHh[row][i] * h[i];
+            }
+            hiddenGates[row] = sum;
+        }
+        for (size_t u = 0; u < hiddenSize; ++u)
+        {
+            double r = Sigmoid(inputGates[u] + hiddenGates[u]);
+            double z = Sigmoid(inputGates[hiddenSize + u] + hiddenGates[hiddenSize + u]);
+            double n = std::tanh(inputGates[2 * hiddenSize + u] + r * hiddenGates[2 * hiddenSize + u]);
+            h[u] = (float)((1 - z) * n + z * h[u]);
+        }
+        return h;
+    }
+
+private:
+    static double Sigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+
+    FloatMatrix wIh, wHh;
+    std::vector<float> bIh, bHh;
+    size_t hiddenSize;
+    std::vector<float> h;
+};
+
+static FloatMatrix RandomMatrix(std::mt19937 &rng, size_t rows, size_t columns)
+{
+    std::uniform_real_distribution<float> dist(-0.4f, 0.4f);
+    FloatMatrix result(rows);
+    for (auto &row : result)
+    {
+        row.resize(columns);
+        for (auto &v : row)
+        {
+            v = dist(rng);
+        }
+    }
+    return result;
+}
+
+// odd block sizes to check partial blocks.
+static const int blockSizes[] = {1, 64, 17, 3, 64, 40};
+
+template <int N_INPUTS, int HIDDEN_SIZE>
+static void TestGru()
+{
+    cout << "BlockGruLayer<" << N_INPUTS << "," << HIDDEN_SIZE << ">" << endl;
+    std::mt19937 rng(N_INPUTS * 1000 + HIDDEN_SIZE);
+
+    FloatMatrix wIh = RandomMatrix(rng, 3 * HIDDEN_SIZE, N_INPUTS);
+    FloatMatrix wHh = RandomMatrix(rng, 3 * HIDDEN_SIZE, HIDDEN_SIZE);
+    std::vector<float> bIh = RandomMatrix(rng, 1, 3 * HIDDEN_SIZE)[0];
+    std::vector<float> bHh = RandomMatrix(rng, 1, 3 * HIDDEN_SIZE)[0];
+
+    ReferenceGru reference(wIh, wHh, bIh, bHh);
+
+    using Layer = BlockGruLayer<N_INPUTS, HIDDEN_SIZE>;
+    Layer *layer = new Layer(); // too large for the stack.
+    layer->SetWeights(wIh, wHh, bIh, bHh);
+
+    typename Layer::InputBlock input;
+    typename Layer::OutputBlock output;
+
+    std::uniform_real_distribution<float> inputDist(-1.0f, 1.0f);
+
+    for (int blockSize : blockSizes)
+    {
+        std::vector<std::vector<float>> inputs(blockSize);
+        for (int t = 0; t < blockSize; ++t)
+        {
+            inputs[t].resize(N_INPUTS);
+            for (int i = 0; i < N_INPUTS; ++i)
+            {
+                inputs[t][i] = inputDist(rng);
+                input(i, t) = inputs[t][i];
+            }
+        }
+        layer->Process(blockSize, input, output);
+        for (int t = 0; t < blockSize; ++t)
+        {
+            const std::vector<float> &expected = reference.Tick(inputs[t]);
+            for (int u = 0; u < HIDDEN_SIZE; ++u)
+            {
+                TEST_ASSERT(std::abs(expected[u] - output(u, t)) < 1E-4);
+            }
+        }
+    }
+    delete layer;
+}
+
+// A stacked model must produce the same result as the individual layers chained by hand.
+template <template <int, int, int> class LAYER, int N_INPUTS, int HIDDEN_SIZE, int N_GATES>
+static void TestStackedModel(size_t numLayers)
+{
+    cout << "BlockRnnModel<" << N_INPUTS << "," << HIDDEN_SIZE << "> layers=" << numLayers << endl;
+    std::mt19937 rng(N_INPUTS * 1000 + HIDDEN_SIZE + numLayers);
+
+    using Model = BlockRnnModel<LAYER, N_INPUTS, HIDDEN_SIZE>;
+    using InputLayer = typename Model::InputLayer;
+    using StackedLayer = typename Model::StackedLayer;
+
+    Model *model = new Model(numLayers);
+    InputLayer *inputLayer = new InputLayer();
+    std::vector<StackedLayer> stackedLayers(numLayers - 1);
+
+    for (size_t i = 0; i < numLayers; ++i)
+    {
+        FloatMatrix wIh = RandomMatrix(rng, N_GATES * HIDDEN_SIZE, i == 0 ? N_INPUTS : HIDDEN_SIZE);
+        FloatMatrix wHh = RandomMatrix(rng, N_GATES * HIDDEN_SIZE, HIDDEN_SIZE);
+        std::vector<float> bIh = RandomMatrix(rng, 1, N_GATES * HIDDEN_SIZE)[0];
+        std::vector<float> bHh = RandomMatrix(rng, 1, N_GATES * HIDDEN_SIZE)[0];
+        model->SetLayerWeights(i, wIh, wHh, bIh, bHh);
+        if (i == 0)
+        {
+            inputLayer->SetWeights(wIh, wHh, bIh, bHh);
+        }
+        else
+        {
+            stackedLayers[i - 1].SetWeights(wIh, wHh, bIh, bHh);
+        }
+    }
+    FloatMatrix denseWeights = RandomMatrix(rng, 1, HIDDEN_SIZE);
+    std::vector<float> denseBias = RandomMatrix(rng, 1, 1)[0];
+    model->SetDenseWeights(denseWeights, denseBias);
+
+    typename Model::InputBlock input;
+    typename InputLayer::OutputBlock hidden[2];
+    float output[Model::MAX_BLOCK];
+
+    std::uniform_real_distribution<float> inputDist(-1.0f, 1.0f);
+
+    for (int blockSize : blockSizes)
+    {
+        for (int t = 0; t < blockSize; ++t)
+        {
+            for (int i = 0; i < N_INPUTS; ++i)
+            {
+                input(i, t) = inputDist(rng);
+            }
+        }
+        model->Process(blockSize, input, output);
+
+        inputLayer->Process(blockSize, input, hidden[0]);
+        int current = 0;
+        for (auto &layer : stackedLayers)
+        {
+            layer.Process(blockSize, hidden[current], hidden[current ^ 1]);
+            current ^= 1;
+        }
+        for (int t = 0; t < blockSize; ++t)
+        {
+            double expected = denseBias[0];
+            for (int u = 0; u < HIDDEN_SIZE; ++u)
+            {
+                expected += denseWeights[0][u] * hidden[current](u, t);
+            }
+            TEST_ASSERT(std::abs(expected - output[t]) < 1E-4);
+        }
+    }
+    delete inputLayer;
+    delete model;
+}
+
+int main(int, char **)
+{
+    try
+    {
+        TestGru<1, 8>();
+        TestGru<2, 12>();
+        TestGru<3, 40>();
+
+        TestStackedModel<BlockGruLayer, 1, 16, 3>(1);
+        TestStackedModel<BlockGruLayer, 2, 12, 3>(3);
+        TestStackedModel<BlockLstmLayer, 1, 8, 4>(2);
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -944,13 +944,20 @@ using namespace LsNumerics::Implementation;
 static size_t convolutionSampleRate = (size_t)-1;
 static size_t convolutionMaxAudioBufferSize = (size_t)-1;
 
-BalancedConvolution::BalancedConvolution(SchedulerPolicy schedulerPolicy, size_t size, const std::vector<float> &impulseResponse, size_t sampleRate, size_t maxAudioBufferSize)
-    : schedulerPolicy(schedulerPolicy), isStereo(false), assemblyQueue(false)
+BalancedConvolution::BalancedConvolution(
+    SchedulerPolicy schedulerPolicy, size_t size, const std::vector<float> &impulseResponse, size_t sampleRate, size_t maxAudioBufferSize,
+    SectionActivation sectionActivation)
+    : schedulerPolicy(schedulerPolicy), isStereo(false), assemblyQueue(false), sectionActivation(sectionActivation)
 {
     this->assemblyInputBuffer.resize(1024);
     this->assemblyOutputBuffer.resize(1024);
     PrepareSections(size, impulseResponse, nullptr, sampleRate, maxAudioBufferSize);
     PrepareThreads();
+    if (pendingSectionCount != 0)
+    {
+        // The builder works on its own copy, since the caller's impulse may not outlive the constructor.
+        StartSectionBuilder(IncrementalImpulse{nullptr, impulseResponse});
+    }
 }
 
 BalancedConvolution::BalancedConvolution(
@@ -958,8 +965,9 @@ BalancedConvolution::BalancedConvolution(
     size_t size,
     const std::vector<float> &impulseResponseLeft, const std::vector<float> &impulseResponseRight,
     size_t sampleRate,
-    size_t maxAudioBufferSize)
-    : schedulerPolicy(schedulerPolicy), isStereo(true), assemblyQueue(true)
+    size_t maxAudioBufferSize,
+    SectionActivation sectionActivation)
+    : schedulerPolicy(schedulerPolicy), isStereo(true), assemblyQueue(true), sectionActivation(sectionActivation)
 {
 
     this->assemblyInputBuffer.resize(1024);
@@ -968,6 +976,185 @@ BalancedConvolution::BalancedConvolution(
     this->assemblyOutputBufferRight.resize(1024);
     PrepareSections(size, impulseResponseLeft, &impulseResponseRight, sampleRate, maxAudioBufferSize);
     PrepareThreads();
+    if (pendingSectionCount != 0)
+    {
+        StartSectionBuilder(IncrementalImpulse{nullptr, impulseResponseLeft, impulseResponseRight});
+    }
+}
+
+void BalancedConvolution::IncrementalImpulse::Require(size_t end)
+{
+    end = std::min(end, left.size());
+    while (available < end)
+    {
+        size_t read = source->Read(
+            left.data() + available,
+            right.empty() ? nullptr : right.data() + available,
+            end - available);
+        if (read == 0)
+        {
+            // short source: the rest of the impulse is silent.
+            available = end;
+            break;
+        }
+        for (size_t i = available; i < available + read; ++i)
+        {
+            left[i] *= gain;
+        }
+        if (!right.empty())
+        {
+            for (size_t i = available; i < available + read; ++i)
+            {
+                right[i] *= gainRight;
+            }
+        }
+        available += read;
+    }
+}
+
+void BalancedConvolution::IncrementalImpulse::SetGain(float gain, float gainRight)
+{
+    // applied to what has been read so far, and by Require() from now on.
+    for (size_t i = 0; i < available; ++i)
+    {
+        left[i] *= gain;
+    }
+    for (size_t i = 0; i < std::min(available, right.size()); ++i)
+    {
+        right[i] *= gainRight;
+    }
+    this->gain = gain;
+    this->gainRight = gainRight;
+}
+
+void BalancedConvolution::StartSectionBuilder(IncrementalImpulse &&impulse)
+{
+    if (pendingSectionCount == 0)
+    {
+        return;
+    }
+    this->sectionBuilderThread = std::make_unique<std::thread>(
+        &BalancedConvolution::SectionBuilderThreadProc, this,
+        std::move(impulse));
+}
+
+void BalancedConvolution::PublishSourceFeedback(ImpulseSource &source)
+{
+    sourceFeedback.store(source.GetFeedback(), std::memory_order_relaxed);
+    sourceFeedbackReady.store(true, std::memory_order_release);
+}
+
+void BalancedConvolution::SectionBuilderThreadProc(IncrementalImpulse impulse)
+{
+    toob::SetThreadName("cr_sections");
+    try
+    {
+        // threadedDirectSections are in order of increasing sample offset, so the reverb tail fills in from the front,
+        // each section as soon as the source has delivered its samples.
+        for (auto &threadedSection : threadedDirectSections)
+        {
+            if (threadedSection->IsActive())
+            {
+                continue;
+            }
+            auto &directSection = threadedSection->GetDirectSection()->directSection;
+            if (impulse.source)
+            {
+                constexpr size_t READ_SIZE = 64 * 1024; // so that a close doesn't wait for a large section.
+                // (the last section can extend past the end of the impulse.)
+                size_t end = std::min(directSection.SampleOffset() + directSection.Size(), impulse.left.size());
+                while (impulse.available < end && !closingSectionBuilder)
+                {
+                    impulse.Require(std::min(end, impulse.available + READ_SIZE));
+                }
+            }
+            if (closingSectionBuilder)
+            {
+                return;
+            }
+            directSection.SetImpulse(
+                impulse.left,
+                isStereo ? &impulse.right : nullptr);
+            threadedSection->SetActive();
+            --pendingSectionCount;
+        }
+        if (impulse.source)
+        {
+            PublishSourceFeedback(*impulse.source);
+        }
+    }
+    catch (const std::exception &)
+    {
+        // (out of memory, or a read error). Sections that haven't been built remain silent.
+    }
+}
+
+BalancedConvolution::BalancedConvolution(
+    SchedulerPolicy schedulerPolicy,
+    size_t size, std::shared_ptr<ImpulseSource> impulseSource, bool isStereo,
+    size_t sampleRate,
+    size_t maxAudioBufferSize,
+    SectionActivation sectionActivation)
+    : schedulerPolicy(schedulerPolicy), isStereo(isStereo), assemblyQueue(isStereo), sectionActivation(sectionActivation)
+{
+    this->assemblyInputBuffer.resize(1024);
+    this->assemblyOutputBuffer.resize(1024);
+    if (isStereo)
+    {
+        this->assemblyInputBufferRight.resize(1024);
+        this->assemblyOutputBufferRight.resize(1024);
+    }
+
+    // Sections are built in order of increasing sample offset, so each one only needs the samples
+    // up to its end, which are read from the source as they are required. Deferred sections don't
+    // read anything, so with SectionActivation::Progressive only the head is read here.
+    IncrementalImpulse impulse{std::move(impulseSource), std::vector<float>(size), std::vector<float>(isStereo ? size : 0)};
+    PrepareSections(
+        size, impulse.left, isStereo ? &impulse.right : nullptr, sampleRate, maxAudioBufferSize,
+        [&impulse](size_t end)
+        {
+            impulse.Require(end);
+        });
+    if (pendingSectionCount == 0)
+    {
+        impulse.Require(size);
+    }
+    float gain = impulse.source->GetGain(0);
+    float gainRight = isStereo ? impulse.source->GetGain(1) : 1.0f;
+    ScaleImpulse(gain, gainRight);
+    PrepareThreads();
+    if (pendingSectionCount != 0)
+    {
+        impulse.SetGain(gain, gainRight);
+        StartSectionBuilder(std::move(impulse));
+    }
+    else
+    {
+        PublishSourceFeedback(*impulse.source);
+    }
+}
+
+void BalancedConvolution::ScaleImpulse(float scale, float scaleRight)
+{
+    if (scale == 1 && scaleRight == 1)
+    {
+        return;
+    }
+    for (auto &value : directImpulse)
+    {
+        value *= scale;
+    }
+    for (auto &value : directImpulseRight)
+    {
+        value *= scaleRight;
+    }
+    for (auto &section : directSections)
+    {
+        if (!section.deferred)
+        {
+            section.directSection.ScaleImpulse(scale, scaleRight);
+        }
+    }
 }
 
 BalancedConvolution::DirectSectionThread *BalancedConvolution::GetDirectSectionThread(int threadNumber)
@@ -1020,10 +1207,16 @@ void BalancedConvolution::PrepareThreads()
         this->WaitForAssemblyThreadStartup();
     }
 }
-void BalancedConvolution::PrepareSections(size_t size, const std::vector<float> &impulseResponse, const std::vector<float> *impulseResponseRight, size_t sampleRate, size_t maxAudioBufferSize)
+void BalancedConvolution::PrepareSections(
+    size_t size, const std::vector<float> &impulseResponse, const std::vector<float> *impulseResponseRight,
+    size_t sampleRate, size_t maxAudioBufferSize,
+    const std::function<void(size_t)> &requireImpulse)
 {
     constexpr size_t INITIAL_SECTION_SIZE = 128;
     constexpr size_t INITIAL_DIRECT_SECTION_SIZE = 128;
+    // Largest section whose spectrum is calculated in the constructor with SectionActivation::Progressive.
+    constexpr size_t MAX_IMMEDIATE_SECTION_SIZE = 16384;
+    static const std::vector<float> deferredImpulse;
 
     // nb: global data, but constructor is always protected by the cache mutex.
     {
@@ -1037,11 +1230,35 @@ void BalancedConvolution::PrepareSections(size_t size, const std::vector<float>
     }
     int stereoScaling = isStereo ? 2 : 1;
 
+    // Separate the portion of the impulse that's calculated directly (without FFT) on the audio thread.
+    // Note that the order of samples is reversed here, to simplify realtime calculations.
+    auto prepareDirectImpulse = [&]()
+    {
+        if (requireImpulse)
+        {
+            requireImpulse(directConvolutionLength);
+        }
+        directImpulse.resize(directConvolutionLength);
+        for (size_t i = 0; i < directConvolutionLength; ++i)
+        {
+            directImpulse[directConvolutionLength - 1 - i] = i < impulseResponse.size() ? impulseResponse[i] : 0;
+        }
+        if (isStereo)
+        {
+            directImpulseRight.resize(directConvolutionLength);
+            for (size_t i = 0; i < directConvolutionLength; ++i)
+            {
+                directImpulseRight[directConvolutionLength - 1 - i] = i < (*impulseResponseRight).size() ? ((*impulseResponseRight)[i]) : 0;
+            }
+        }
+    };
+
     size_t delaySize = -1;
     if (size < INITIAL_SECTION_SIZE)
     {
         directConvolutionLength = size;
         delaySize = directConvolutionLength;
+        prepareDirectImpulse();
     }
     else
     {
@@ -1055,6 +1272,7 @@ void BalancedConvolution::PrepareSections(size_t size, const std::vector<float>
             directConvolutionLength = size;
         }
         delaySize = directConvolutionLength;
+        prepareDirectImpulse();
 
         size_t sampleOffset = directConvolutionLength;
 
@@ -1140,38 +1358,33 @@ void BalancedConvolution::PrepareSections(size_t size, const std::vector<float>
                     threadNumber = t;
                 }
 
+                bool deferred = sectionActivation == SectionActivation::Progressive && directSectionSize > MAX_IMMEDIATE_SECTION_SIZE;
+                if (requireImpulse && !deferred)
+                {
+                    requireImpulse(sampleOffset + directSectionSize);
+                }
                 directSections.emplace_back(
                     DirectSection{
                         inputDelay,
                         DirectConvolutionSection(
                             directSectionSize,
                             sampleOffset,
-                            impulseResponse,
-                            impulseResponseRight,
+                            deferred ? deferredImpulse : impulseResponse,
+                            impulseResponseRight == nullptr ? nullptr : deferred ? &deferredImpulse : impulseResponseRight,
                             directSectionDelay,
                             inputDelay,
-                            threadNumber)});
+                            threadNumber),
+                        deferred});
+                if (deferred)
+                {
+                    ++pendingSectionCount;
+                }
                 sampleOffset += directSectionSize;
                 executionOffsetInSamples += this->GetDirectSectionExecutionTimeInSamples(directSectionSize);
             }
         }
     }
 
-    // Separate the portion of the impulse that's calculated directly (without FFT) on the audio thread.
-    // Note that the order of samples is reversed here, to simplify realtime calculations.
-    directImpulse.resize(directConvolutionLength);
-    for (size_t i = 0; i < directConvolutionLength; ++i)
-    {
-        directImpulse[directConvolutionLength - 1 - i] = i < impulseResponse.size() ? impulseResponse[i] : 0;
-    }
-    if (isStereo)
-    {
-        directImpulseRight.resize(directConvolutionLength);
-        for (size_t i = 0; i < directConvolutionLength; ++i)
-        {
-            directImpulseRight[directConvolutionLength - 1 - i] = i < (*impulseResponseRight).size() ? ((*impulseResponseRight)[i]) : 0;
-        }
-    }
     audioThreadToBackgroundQueue.SetSize(delaySize + 1, 256, this->schedulerPolicy, isStereo);
 }
 static int NextPowerOf2(size_t value)
@@ -1218,6 +1431,18 @@ Implementation::DirectConvolutionSection::DirectConvolutionSection(
     buffer.resize(size * 2);
     inputBuffer.resize(size * 2);
     impulseFft.resize(size * 2);
+    bufferIndex = 0;
+    if (impulseDataRightOpt != nullptr)
+    {
+        bufferRight.resize(size * 2);
+        inputBufferRight.resize(size * 2);
+        impulseFftRight.resize(size * 2);
+    }
+    SetImpulse(impulseData, impulseDataRightOpt);
+}
+
+void Implementation::DirectConvolutionSection::SetImpulse(const std::vector<float> &impulseData, const std::vector<float> *impulseDataRightOpt)
+{
     size_t len = size;
 
     const float norm = (float)(std::sqrt(2 * size));
@@ -1230,18 +1455,19 @@ Implementation::DirectConvolutionSection::DirectConvolutionSection(
     {
         len = impulseData.size() - sampleOffset;
     }
+    if (len == 0)
+    {
+        // the spectrum of silence is silence.
+        return;
+    }
 
     for (size_t i = 0; i < len; ++i)
     {
         impulseFft[i + size] = norm * impulseData[i + sampleOffset];
     }
     fftPlan.Compute(impulseFft, impulseFft, Fft::Direction::Forward);
-    bufferIndex = 0;
     if (impulseDataRightOpt != nullptr)
     {
-        bufferRight.resize(size * 2);
-        inputBufferRight.resize(size * 2);
-        impulseFftRight.resize(size * 2);
         for (size_t i = 0; i < len; ++i)
         {
             impulseFftRight[i + size] = norm * (*impulseDataRightOpt)[i + sampleOffset];
@@ -1250,6 +1476,18 @@ Implementation::DirectConvolutionSection::DirectConvolutionSection(
     }
 }
 
+void Implementation::DirectConvolutionSection::ScaleImpulse(float scale, float scaleRight)
+{
+    for (auto &value : impulseFft)
+    {
+        value *= scale;
+    }
+    for (auto &value : impulseFftRight)
+    {
+        value *= scaleRight;
+    }
+}
+
 void Implementation::DirectConvolutionSection::UpdateBuffer()
 {
     fftPlan.Compute(inputBuffer, buffer, Fft::Direction::Forward);
@@ -1280,6 +1518,12 @@ BalancedConvolution::~BalancedConvolution()
 
 void BalancedConvolution::Close()
 {
+    closingSectionBuilder = true;
+    if (sectionBuilderThread)
+    {
+        sectionBuilderThread->join();
+        sectionBuilderThread = nullptr;
+    }
     this->audioThreadToBackgroundQueue.Close();
 
     // shut down Direct Convolution Threads in an orderly manner.
@@ -1304,7 +1548,7 @@ bool BalancedConvolution::ThreadedDirectSection::Execute(AudioThreadToBackground
     {
         if (outputDelayLine.CanWrite(size))
         {
-            section->directSection.Execute(delayLine, currentSample, outputDelayLine);
+            section->directSection.Execute(delayLine, currentSample, outputDelayLine, IsActive());
 
             currentSample += size;
             processed = true;
@@ -1317,7 +1561,7 @@ bool BalancedConvolution::ThreadedDirectSection::Execute(AudioThreadToBackground
     return processed;
 }
 
-void DirectConvolutionSection::Execute(AudioThreadToBackgroundQueue &input, size_t time, LocklessQueue &output)
+void DirectConvolutionSection::Execute(AudioThreadToBackgroundQueue &input, size_t time, LocklessQueue &output, bool active)
 {
 
 #if EXECUTION_TRACE
@@ -1339,7 +1583,10 @@ void DirectConvolutionSection::Execute(AudioThreadToBackgroundQueue &input, size
                 inputBufferRight[i] = inputBufferRight[i + size];
             }
             input.ReadRange(time, size, size, inputBuffer, inputBufferRight);
-            UpdateBuffer();
+            if (active)
+            {
+                UpdateBuffer();
+            } // else buffer is still silent.
 
             output.Write(size, 0, this->buffer, this->bufferRight);
         }
@@ -1351,7 +1598,10 @@ void DirectConvolutionSection::Execute(AudioThreadToBackgroundQueue &input, size
                 inputBuffer[i] = inputBuffer[i + size];
             }
             input.ReadRange(time, size, size, inputBuffer);
-            UpdateBuffer();
+            if (active)
+            {
+                UpdateBuffer();
+            } // else buffer is still silent.
 
             output.Write(size, 0, this->buffer);
         }
@@ -1369,7 +1619,7 @@ void DirectConvolutionSection::Execute(AudioThreadToBackgroundQueue &input, size
 }
 
 BalancedConvolution::ThreadedDirectSection::ThreadedDirectSection(DirectSection &section)
-    : section(&section)
+    : section(&section), active(!section.deferred)
 {
     auto &directSection = section.directSection;
     size_t size = directSection.Size();
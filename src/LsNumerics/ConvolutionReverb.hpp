@@ -42,6 +42,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 #include "../ControlDezipper.h"
 
 #ifndef RESTRICT
@@ -416,7 +417,15 @@ namespace LsNumerics
                 return result;
             }
 
-            void Execute(AudioThreadToBackgroundQueue &input, size_t time, LocklessQueue &output);
+            /// @brief Process the next block of input.
+            /// @param active False if the section's impulse hasn't been set yet. Input is consumed, but the section outputs silence.
+            void Execute(AudioThreadToBackgroundQueue &input, size_t time, LocklessQueue &output, bool active = true);
+
+            /// @brief Calculate the section's impulse spectrum.
+            /// @remarks An empty impulse leaves the section silent without performing an FFT.
+            void SetImpulse(const std::vector<float> &impulseData, const std::vector<float> *impulseDataRightOpt);
+
+            void ScaleImpulse(float scale, float scaleRight);
 
             bool IsL1Optimized() const
             {
@@ -465,6 +474,51 @@ namespace LsNumerics
         };
     }
 
+    /// @brief Supplies impulse response samples incrementally.
+    ///
+    /// Allows BalancedConvolution to build each convolution section as soon as the samples it covers
+    /// have been read, instead of waiting for the entire impulse response (e.g. while a long impulse
+    /// file is still being decoded).
+    ///
+    /// With SectionActivation::Progressive, only the head of the impulse is read by the constructor. The
+    /// convolution keeps the source alive, and reads the rest on its section builder thread.
+    class ImpulseSource
+    {
+    public:
+        virtual ~ImpulseSource() {}
+
+        /// @brief Read the next frames of the impulse response.
+        /// @param left Receives the next frames of the (left) impulse response.
+        /// @param right Receives the next frames of the right impulse response. Null if the convolution is mono.
+        /// @param frames Number of frames to read.
+        /// @return Number of frames read, which is less than frames only at the end of the impulse response.
+        virtual size_t Read(float *left, float *right, size_t frames) = 0;
+
+        /// @brief Gain applied to the impulse response.
+        /// @remarks
+        /// Called once the frames needed by the sections that the constructor builds have been read (all
+        /// of them, with SectionActivation::Immediate), and before any section goes live. Sources that
+        /// normalize the impulse response must do so from the frames read so far.
+        virtual float GetGain(size_t channel) { return 1.0f; }
+
+        /// @brief Recirculation gain for the tail of the impulse response (see ConvolutionReverb::SetFeedback).
+        /// @remarks
+        /// Called after the last frame has been read. With SectionActivation::Progressive, that happens on
+        /// the section builder thread, and the feedback takes effect once the tail is complete.
+        virtual float GetFeedback() { return 0.0f; }
+    };
+
+    /// @brief When BalancedConvolution sections start producing output.
+    enum class SectionActivation
+    {
+        /// All sections are built before the constructor returns.
+        Immediate,
+        /// The head of the impulse is built before the constructor returns. Spectra of large
+        /// tail sections are calculated on a background thread, and each section is activated
+        /// (outputs silence until then) as soon as its spectrum is ready.
+        Progressive
+    };
+
     /// @brief Convolution using a roughly fixed execution time per cycle.
     ///
     /// A convolution section is performed on the audio thread using non-FFT convolution just long enough
@@ -511,20 +565,41 @@ namespace LsNumerics
         /// current implementation runs reasonable efficiently with buffer sizes less that 256 frames, and may well
         /// behave badly with buffer sizes of 1024.
         ///
+        /// The sectionActivation parameter controls whether the constructor waits until spectra for all convolution
+        /// sections have been calculated. With SectionActivation::Progressive, the head of the impulse response is 
+        /// audible immediately, and the tail fills in as the spectra of the large sections are calculated in the background.
+        ///
         BalancedConvolution(
             SchedulerPolicy schedulerPolicy,
             size_t size, const std::vector<float> &impulseResponse,
             size_t sampleRate,
-            size_t maxAudioBufferSize);
+            size_t maxAudioBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate);
 
         BalancedConvolution(
             SchedulerPolicy schedulerPolicy,
             size_t size, 
             const std::vector<float> &impulseResponseLeft, const std::vector<float> &impulseResponseRight,
             size_t sampleRate,
-            size_t maxAudioBufferSize);
+            size_t maxAudioBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate);
 
 
+        /// @brief Convolution with an impulse response that is read incrementally.
+        /// @param size Number of samples of the impulse response to use.
+        /// @param impulseSource Source of the impulse response. Samples are read as each section is built.
+        /// @param isStereo True for separate left and right impulse responses.
+        /// @remarks
+        /// With SectionActivation::Immediate, the whole impulse response is read before the constructor returns.
+        /// With SectionActivation::Progressive, the constructor reads and builds only the head, so it is audible
+        /// while the section builder thread reads the rest of the source and builds the tail.
+        BalancedConvolution(
+            SchedulerPolicy schedulerPolicy,
+            size_t size, std::shared_ptr<ImpulseSource> impulseSource, bool isStereo,
+            size_t sampleRate,
+            size_t maxAudioBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate);
+
         BalancedConvolution(
             SchedulerPolicy schedulerPolicy,
             const std::vector<float> &impulseResponse,
@@ -555,6 +630,9 @@ namespace LsNumerics
 
         size_t GetUnderrunCount() const { return (size_t)underrunCount; }
 
+        /// @brief Number of sections still waiting for their impulse spectrum (SectionActivation::Progressive only).
+        size_t GetPendingSectionCount() const { return pendingSectionCount.load(std::memory_order_acquire); }
+
     private:
         void WaitForAssemblyThreadStartup();
         void SetAssemblyThreadStartupFailed(const std::string & e);
@@ -652,8 +730,40 @@ namespace LsNumerics
         virtual void OnSynchronizedSingleReaderDelayLineReady();
         virtual void OnSynchronizedSingleReaderDelayLineUnderrun();
 
-        void PrepareSections(size_t size, const std::vector<float> &impulseResponse, const std::vector<float> *impulseResponseRight, size_t sampleRate, size_t maxAudioBufferSize);
+        // requireImpulse(n): called before samples [0..n) of the impulse response are used.
+        void PrepareSections(
+            size_t size, const std::vector<float> &impulseResponse, const std::vector<float> *impulseResponseRight,
+            size_t sampleRate, size_t maxAudioBufferSize,
+            const std::function<void(size_t)> &requireImpulse = nullptr);
+        void ScaleImpulse(float scale, float scaleRight);
         void PrepareThreads();
+
+        // The impulse response, as far as it has been read from source (all of it, if there's no source).
+        struct IncrementalImpulse
+        {
+            std::shared_ptr<ImpulseSource> source;
+            std::vector<float> left;
+            std::vector<float> right;
+            size_t available = 0;
+            float gain = 1;
+            float gainRight = 1;
+
+            // Read samples [available..end), with the gain applied.
+            void Require(size_t end);
+            void SetGain(float gain, float gainRight);
+        };
+
+        SectionActivation sectionActivation = SectionActivation::Immediate;
+        std::atomic<size_t> pendingSectionCount { 0 };
+        std::atomic<bool> closingSectionBuilder { false };
+        std::unique_ptr<std::thread> sectionBuilderThread;
+        void StartSectionBuilder(IncrementalImpulse &&impulse);
+        void SectionBuilderThreadProc(IncrementalImpulse impulse);
+        void PublishSourceFeedback(ImpulseSource &source);
+
+        // ImpulseSource::GetFeedback(), handed to ConvolutionReverb::Tick() once the source has been read.
+        std::atomic<float> sourceFeedback { 0 };
+        std::atomic<bool> sourceFeedbackReady { false };
         class DirectSectionThread;
         DirectSectionThread *GetDirectSectionThread(int threadNumber);
 
@@ -663,6 +773,7 @@ namespace LsNumerics
         {
             size_t sampleDelay;
             Implementation::DirectConvolutionSection directSection;
+            bool deferred = false; // impulse spectrum is calculated by the section builder thread.
         };
 
         class ThreadedDirectSection
@@ -694,6 +805,9 @@ namespace LsNumerics
             DirectSection *GetDirectSection() { return this->section; }
             const DirectSection *GetDirectSection() const { return this->section; }
 
+            bool IsActive() const { return active.load(std::memory_order_acquire); }
+            void SetActive() { active.store(true, std::memory_order_release); }
+
 #if EXECUTION_TRACE
         public:
             void SetTraceInfo(SectionExecutionTrace *pTrace, size_t threadNumber)
@@ -713,6 +827,7 @@ namespace LsNumerics
             size_t currentSample = 0;
             LocklessQueue outputDelayLine;
             DirectSection *section;
+            std::atomic<bool> active { true };
         };
         std::vector<std::unique_ptr<ThreadedDirectSection>> threadedDirectSections;
 
@@ -787,8 +902,10 @@ namespace LsNumerics
     class ConvolutionReverb
     {
     public:
-        ConvolutionReverb(SchedulerPolicy schedulerPolicy, size_t size, const std::vector<float> &impulse, size_t sampleRate, size_t maxBufferSize)
-            : convolution(schedulerPolicy, size == 0 ? 0 : size - 1, impulse, sampleRate, maxBufferSize), // the last value is recirculated.
+        ConvolutionReverb(
+            SchedulerPolicy schedulerPolicy, size_t size, const std::vector<float> &impulse, size_t sampleRate, size_t maxBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate)
+            : convolution(schedulerPolicy, size == 0 ? 0 : size - 1, impulse, sampleRate, maxBufferSize, sectionActivation), // the last value is recirculated.
               isStereo(false)
         {
             directMixDezipper.To(0, 0);
@@ -813,8 +930,9 @@ namespace LsNumerics
         ConvolutionReverb(
             SchedulerPolicy schedulerPolicy, 
             size_t size, const std::vector<float> &impulseLeft,const std::vector<float> &impulseRight,
-            size_t sampleRate, size_t maxBufferSize)
-            : convolution(schedulerPolicy, size == 0 ? 0 : size - 1, impulseLeft, impulseRight, sampleRate, maxBufferSize), // the last value is recirculated.
+            size_t sampleRate, size_t maxBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate)
+            : convolution(schedulerPolicy, size == 0 ? 0 : size - 1, impulseLeft, impulseRight, sampleRate, maxBufferSize, sectionActivation), // the last value is recirculated.
                 isStereo(true)
         {
             directMixDezipper.To(0, 0);
@@ -838,9 +956,35 @@ namespace LsNumerics
                 feedbackScale = 0;
             }
         }
+        /// @brief Convolution reverb with an impulse response that is read incrementally.
+        /// @param size Number of samples of the impulse response to use.
+        /// @remarks The impulse response is used as-is. The tail is recirculated from the end of the impulse,
+        /// with the source's GetFeedback() gain, once the source has been read to the end.
+        ConvolutionReverb(
+            SchedulerPolicy schedulerPolicy,
+            size_t size, std::shared_ptr<ImpulseSource> impulseSource, bool isStereo,
+            size_t sampleRate, size_t maxBufferSize,
+            SectionActivation sectionActivation = SectionActivation::Immediate)
+            : isStereo(isStereo),
+              convolution(schedulerPolicy, size, std::move(impulseSource), isStereo, sampleRate, maxBufferSize, sectionActivation)
+        {
+            directMixDezipper.To(0, 0);
+            reverbMixDezipper.To(1.0, 0);
+            feedbackDelay.SetSize(size == 0 ? 1 : size);
+            if (isStereo)
+            {
+                feedbackDelayRight.SetSize(size == 0 ? 1 : size);
+            }
+            feedbackScale = 0;
+            // already known with SectionActivation::Immediate.
+            UpdateSourceFeedback();
+        }
         ~ConvolutionReverb() {
             
         }
+        /// @brief Number of tail sections still being built (SectionActivation::Progressive only).
+        size_t GetPendingSectionCount() const { return convolution.GetPendingSectionCount(); }
+
         void SetFeedback(float feedback, size_t tapPosition)
         {
 
@@ -855,6 +999,17 @@ namespace LsNumerics
         }
 
     protected:
+        // Picks up the feedback of an impulse source once it has been read to the end.
+        void UpdateSourceFeedback()
+        {
+            if (convolution.sourceFeedbackReady.load(std::memory_order_acquire))
+            {
+                convolution.sourceFeedbackReady.store(false, std::memory_order_relaxed);
+                feedbackScale = convolution.sourceFeedback.load(std::memory_order_relaxed);
+                hasFeedback = feedbackScale != 0;
+            }
+        }
+
         // float TickUnsynchronizedWithFeedback(float value)
         // {
         //     float recirculationValue = feedbackDelay.Value() * feedbackScale;
@@ -919,6 +1074,7 @@ namespace LsNumerics
             const float  * RESTRICT inputL, const float  * RESTRICT inputR, 
             float * RESTRICT outputL,float * RESTRICT outputR)
         {
+            UpdateSourceFeedback();
             // TODO: there has to be a way to refactor this sensibly. :-/
             if (hasFeedback)
             {
@@ -1065,6 +1221,7 @@ namespace LsNumerics
 
         void Tick(size_t count, const float  * RESTRICT input, float * RESTRICT output)
         {
+            UpdateSourceFeedback();
             // TODO: there has to be a way to refactor this sensibly. :-/
             if (hasFeedback)
             {
@@ -38,6 +38,8 @@
 #include "../AudioData.hpp"
 #include "../WavReader.hpp"
 #include "../WavWriter.hpp"
+#include <mutex>
+#include <condition_variable>
 
 #include <time.h> // for clock_nanosleep
 
@@ -312,6 +314,262 @@ static void TestBalancedConvolution()
     }
 }
 
+// Delivers an impulse a chunk at a time, the way a streaming file decoder would.
+// The right channel's gain is half the left channel's. Reads past Hold()'s position wait for Release(),
+// the way they would for a slow decoder.
+class ChunkedImpulseSource : public ImpulseSource
+{
+public:
+    ChunkedImpulseSource(const std::vector<float> &impulse, size_t chunkSize, float gain, float feedback = 0)
+        : ChunkedImpulseSource(impulse, nullptr, chunkSize, gain, feedback)
+    {
+    }
+    ChunkedImpulseSource(const std::vector<float> &impulse, const std::vector<float> *impulseRight, size_t chunkSize, float gain, float feedback = 0)
+        : impulse(impulse), impulseRight(impulseRight), chunkSize(chunkSize), gain(gain), feedback(feedback)
+    {
+    }
+    virtual size_t Read(float *left, float *right, size_t frames) override
+    {
+        TEST_ASSERT((right == nullptr) == (impulseRight == nullptr));
+        std::unique_lock lock{mutex};
+        if (!cv.wait_for(lock, std::chrono::seconds(30), [this]() { return position < holdPosition; }))
+        {
+            throw logic_error("Impulse source was not released.");
+        }
+        size_t thisTime = std::min(std::min(std::min(frames, chunkSize), impulse.size() - position), holdPosition - position);
+        std::copy(impulse.begin() + position, impulse.begin() + position + thisTime, left);
+        if (right)
+        {
+            std::copy(impulseRight->begin() + position, impulseRight->begin() + position + thisTime, right);
+        }
+        position += thisTime;
+        ++readCount;
+        return thisTime;
+    }
+    virtual float GetGain(size_t channel) override
+    {
+        return channel == 0 ? gain : gain * 0.5f;
+    }
+    virtual float GetFeedback() override
+    {
+        return feedback;
+    }
+    void Hold(size_t position)
+    {
+        std::lock_guard lock{mutex};
+        holdPosition = position;
+    }
+    void Release()
+    {
+        {
+            std::lock_guard lock{mutex};
+            holdPosition = std::numeric_limits<size_t>::max();
+        }
+        cv.notify_all();
+    }
+    size_t Position()
+    {
+        std::lock_guard lock{mutex};
+        return position;
+    }
+    size_t ReadCount()
+    {
+        std::lock_guard lock{mutex};
+        return readCount;
+    }
+
+private:
+    const std::vector<float> &impulse;
+    const std::vector<float> *impulseRight;
+    size_t chunkSize;
+    float gain;
+    float feedback;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t holdPosition = std::numeric_limits<size_t>::max();
+    size_t position = 0;
+    size_t readCount = 0;
+};
+
+static void TestImpulseSource()
+{
+    for (size_t n : {10, 128 + 10, 1024 + 10, 4096 + 17, 16384 + 512})
+    {
+        std::cout << "=== TestImpulseSource(" << n << ") ===" << std::endl;
+
+        std::vector<float> impulse(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            impulse[i] = (float)(std::sin(i * 0.37) * std::exp(-3.0 * i / n));
+        }
+        constexpr float GAIN = 0.5f;
+        std::vector<float> scaledImpulse = impulse;
+        for (auto &value : scaledImpulse)
+        {
+            value *= GAIN;
+        }
+
+        auto source = std::make_shared<ChunkedImpulseSource>(impulse, 1000, GAIN);
+        BalancedConvolution streamed{SchedulerPolicy::UnitTest, n, source, false, 44100, 256};
+        BalancedConvolution expected{SchedulerPolicy::UnitTest, n, scaledImpulse, 44100, 256};
+        TEST_ASSERT(source->ReadCount() >= (n + 999) / 1000);
+
+        for (size_t i = 0; i < n * 3; ++i)
+        {
+            float input = (float)std::cos(i * 0.011) + ((i % 97) == 0 ? 1.0f : 0.0f);
+            float expectedValue = expected.Tick(input);
+            float actualValue = streamed.Tick(input);
+            if (std::abs(expectedValue - actualValue) > 1E-4f * std::max(1.0f, std::abs(expectedValue)))
+            {
+                throw logic_error(SS("TestImpulseSource failed. n: " << n << " i: " << i));
+            }
+        }
+    }
+
+    // The source's feedback recirculates the end of the impulse, as SetFeedback() does.
+    {
+        std::cout << "=== TestImpulseSource(feedback) ===" << std::endl;
+        constexpr size_t n = 4096 + 17;
+        constexpr float FEEDBACK = 0.05f;
+        std::vector<float> impulse(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            impulse[i] = (float)(std::sin(i * 0.37) * std::exp(-3.0 * i / n));
+        }
+
+        auto source = std::make_shared<ChunkedImpulseSource>(impulse, 1000, 1.0f, FEEDBACK);
+        ConvolutionReverb streamed{SchedulerPolicy::UnitTest, n, source, false, 44100, 256};
+        auto expectedSource = std::make_shared<ChunkedImpulseSource>(impulse, 1000, 1.0f);
+        ConvolutionReverb expected{SchedulerPolicy::UnitTest, n, expectedSource, false, 44100, 256};
+        expected.SetFeedback(FEEDBACK, n);
+
+        constexpr size_t BLOCK_SIZE = 64;
+        std::vector<float> input(BLOCK_SIZE), expectedOutput(BLOCK_SIZE), actualOutput(BLOCK_SIZE);
+        for (size_t t = 0; t < n * 4; t += BLOCK_SIZE)
+        {
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                input[i] = (float)std::cos((t + i) * 0.011) + (((t + i) % 997) == 0 ? 1.0f : 0.0f);
+            }
+            expected.Tick(BLOCK_SIZE, input.data(), expectedOutput.data());
+            streamed.Tick(BLOCK_SIZE, input.data(), actualOutput.data());
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                if (std::abs(expectedOutput[i] - actualOutput[i]) > 1E-4f * std::max(1.0f, std::abs(expectedOutput[i])))
+                {
+                    throw logic_error(SS("TestImpulseSource failed (feedback). i: " << (t + i)));
+                }
+            }
+        }
+    }
+}
+
+static void TestProgressiveActivation(bool stereo, bool streamed)
+{
+    std::cout << "=== TestProgressiveActivation(" << (stereo ? "stereo" : "mono") << (streamed ? ", impulse source" : "") << ") ===" << std::endl;
+
+    // (not a whole number of sections, as in ToobConvolutionReverb.)
+    size_t n = 200000 - 1;
+    std::vector<float> impulse(n);
+    std::vector<float> impulseRight(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        impulse[i] = (float)(std::sin(i * 0.37) * std::exp(-3.0 * i / n));
+        impulseRight[i] = (float)(std::cos(i * 0.23) * std::exp(-3.0 * i / n));
+    }
+    std::unique_ptr<ConvolutionReverb> progressive;
+    std::unique_ptr<ConvolutionReverb> expected;
+    // The constructor only reads the head of a streamed impulse. The rest is held back until RELEASE_TIME,
+    // during which the head must already be audible.
+    constexpr size_t HOLD_POSITION = 100000;
+    constexpr size_t RELEASE_TIME = 65536;
+    std::shared_ptr<ChunkedImpulseSource> source;
+    if (streamed)
+    {
+        constexpr float GAIN = 0.5f;
+        source = std::make_shared<ChunkedImpulseSource>(impulse, stereo ? &impulseRight : nullptr, 10000, GAIN);
+        source->Hold(HOLD_POSITION);
+        progressive = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, source, stereo, 44100, 256, SectionActivation::Progressive);
+        TEST_ASSERT(source->Position() <= HOLD_POSITION);
+        auto expectedSource = std::make_shared<ChunkedImpulseSource>(impulse, stereo ? &impulseRight : nullptr, 10000, GAIN);
+        expected = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, expectedSource, stereo, 44100, 256);
+    }
+    else if (stereo)
+    {
+        progressive = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, impulse, impulseRight, 44100, 256, SectionActivation::Progressive);
+        expected = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, impulse, impulseRight, 44100, 256);
+    }
+    else
+    {
+        progressive = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, impulse, 44100, 256, SectionActivation::Progressive);
+        expected = std::make_unique<ConvolutionReverb>(SchedulerPolicy::UnitTest, n, impulse, 44100, 256);
+    }
+    TEST_ASSERT(expected->GetPendingSectionCount() == 0);
+
+    constexpr size_t BLOCK_SIZE = 64;
+    std::vector<float> input(BLOCK_SIZE), inputRight(BLOCK_SIZE);
+    std::vector<float> expectedOutput(BLOCK_SIZE), expectedOutputRight(BLOCK_SIZE);
+    std::vector<float> actualOutput(BLOCK_SIZE), actualOutputRight(BLOCK_SIZE);
+
+    // The head is audible while the tail is being built; the whole impulse is once the last
+    // section is active, and its (formerly silent) output has flushed through.
+    size_t headLength = 16384;
+    size_t completeTime = std::numeric_limits<size_t>::max();
+    size_t t = 0;
+    while (t < completeTime + 2 * n)
+    {
+        if (source && t >= RELEASE_TIME)
+        {
+            TEST_ASSERT(progressive->GetPendingSectionCount() != 0);
+            source->Release();
+            source = nullptr;
+        }
+        if (completeTime == std::numeric_limits<size_t>::max() && progressive->GetPendingSectionCount() == 0)
+        {
+            completeTime = t + n + 1024;
+        }
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            input[i] = (float)std::cos((t + i) * 0.011) + (((t + i) % 997) == 0 ? 1.0f : 0.0f);
+            inputRight[i] = (float)std::sin((t + i) * 0.007);
+        }
+        if (stereo)
+        {
+            expected->Tick(BLOCK_SIZE, input.data(), inputRight.data(), expectedOutput.data(), expectedOutputRight.data());
+            progressive->Tick(BLOCK_SIZE, input.data(), inputRight.data(), actualOutput.data(), actualOutputRight.data());
+        }
+        else
+        {
+            expected->Tick(BLOCK_SIZE, input.data(), expectedOutput.data());
+            progressive->Tick(BLOCK_SIZE, input.data(), actualOutput.data());
+        }
+        if (t + BLOCK_SIZE <= headLength || t >= completeTime)
+        {
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                float tolerance = 1E-4f * std::max(1.0f, std::abs(expectedOutput[i]));
+                if (std::abs(expectedOutput[i] - actualOutput[i]) > tolerance ||
+                    (stereo && std::abs(expectedOutputRight[i] - actualOutputRight[i]) > tolerance))
+                {
+                    throw logic_error(SS("TestProgressiveActivation failed. t: " << (t + i)));
+                }
+            }
+        }
+        t += BLOCK_SIZE;
+    }
+}
+
+static void TestProgressiveActivation()
+{
+    for (bool stereo : {false, true})
+    {
+        for (bool streamed : {false, true})
+        {
+            TestProgressiveActivation(stereo, streamed);
+        }
+    }
+}
+
 class StreamCapturer
 {
 public:
@@ -1272,6 +1530,10 @@ static void PrintHelp()
          << "       Run audio thread simulation, checking for read stalls." << endl
          << "  realtime_convolution:" << endl
          << "       Simulate running on an audio thread." << endl
+         << "  impulse_source:" << endl
+         << "       Build convolution sections from an incrementally-read impulse." << endl
+         << "  progressive_activation:" << endl
+         << "       Activate tail sections as they are built in the background." << endl
          << "  file_test:" << endl
          << "       Run on an actual audio file." << endl
          << endl
@@ -1361,6 +1623,14 @@ int main(int argc, const char **argv)
         {
             BenchmarkBalancedConvolution();
         }
+        else if (testName == "impulse_source")
+        {
+            TestImpulseSource();
+        }
+        else if (testName == "progressive_activation")
+        {
+            TestProgressiveActivation();
+        }
         else if (testName == "section_allocations")
         {
             TestDirectConvolutionSectionAllocations();
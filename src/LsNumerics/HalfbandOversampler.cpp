@@ -0,0 +1,382 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "HalfbandOversampler.hpp"
+#include "LsMath.hpp"
+#include "Fft.hpp"
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+using namespace LsNumerics;
+
+// First stage: passband to 0.4 x base rate, stopband from 0.6 x base rate.
+static constexpr size_t STAGE1_LENGTH = 67;
+// Second stage runs at 2x, so the transition band is three times as wide.
+static constexpr size_t STAGE2_LENGTH = 23;
+static constexpr double STOPBAND_DB = 100;
+
+static double BesselI0(double x)
+{
+    double sum = 1;
+    double term = 1;
+    double halfX = x * 0.5;
+    for (int k = 1; k < 50; ++k)
+    {
+        term *= halfX / k;
+        double t2 = term * term;
+        sum += t2;
+        if (t2 < sum * 1E-17)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+std::vector<double> HalfbandOversampler::DesignLinearPhase(size_t length, double stopbandDb)
+{
+    if (length % 4 != 3)
+    {
+        throw std::invalid_argument("Halfband filter length must be 4k+3.");
+    }
+    double beta;
+    if (stopbandDb > 50)
+    {
+        beta = 0.1102 * (stopbandDb - 8.7);
+    }
+    else if (stopbandDb > 21)
+    {
+        beta = 0.5842 * std::pow(stopbandDb - 21, 0.4) + 0.07886 * (stopbandDb - 21);
+    }
+    else
+    {
+        beta = 0;
+    }
+    std::vector<double> result(length);
+    int center = (int)(length / 2);
+    double i0Beta = BesselI0(beta);
+    for (int n = 0; n < (int)length; ++n)
+    {
+        int k = n - center;
+        double sinc;
+        if (k == 0)
+        {
+            sinc = 0.5;
+        }
+        else if (k % 2 == 0)
+        {
+            sinc = 0; // exact zeros of a halfband filter.
+        }
+        else
+        {
+            sinc = std::sin(Pi * k * 0.5) / (Pi * k);
+        }
+        double r = (double)k / center;
+        double window = BesselI0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / i0Beta;
+        result[n] = sinc * window;
+    }
+    // Normalize so that both polyphase branches have a DC gain of exactly 0.5. Otherwise the 
+    // branches are mismatched, which leaks an image at the base-rate Nyquist frequency.
+    double sum = 0;
+    for (int n = 0; n < (int)length; ++n)
+    {
+        if (n != center)
+        {
+            sum += result[n];
+        }
+    }
+    for (int n = 0; n < (int)length; ++n)
+    {
+        if (n != center)
+        {
+            result[n] *= 0.5 / sum;
+        }
+    }
+    return result;
+}
+
+std::vector<double> HalfbandOversampler::MinimumPhase(const std::vector<double> &prototype)
+{
+    size_t fftSize = NextPowerOfTwo((uint32_t)(prototype.size() * 64));
+    Fft fft(fftSize);
+    // Fft is unitary (1/sqrt(N) scaling in both directions).
+    double scale = std::sqrt((double)fftSize);
+
+    std::vector<std::complex<double>> buffer(fftSize);
+    std::vector<std::complex<double>> spectrum(fftSize);
+    for (size_t i = 0; i < prototype.size(); ++i)
+    {
+        buffer[i] = prototype[i];
+    }
+    fft.Forward(buffer, spectrum);
+
+    // log magnitude. Floor well below the stopband to keep zeros on the unit circle finite.
+    constexpr double MAGNITUDE_FLOOR = 1E-9;
+    for (size_t i = 0; i < fftSize; ++i)
+    {
+        double magnitude = std::abs(spectrum[i]) * scale;
+        buffer[i] = std::log(std::max(magnitude, MAGNITUDE_FLOOR));
+    }
+    std::vector<std::complex<double>> cepstrum(fftSize);
+    fft.Backward(buffer, cepstrum);
+
+    // fold the real cepstrum onto positive quefrencies.
+    for (size_t i = 0; i < fftSize; ++i)
+    {
+        double c = cepstrum[i].real() / scale;
+        if (i == 0 || i == fftSize / 2)
+        {
+            buffer[i] = c;
+        }
+        else if (i < fftSize / 2)
+        {
+            buffer[i] = 2 * c;
+        }
+        else
+        {
+            buffer[i] = 0;
+        }
+    }
+    fft.Forward(buffer, spectrum);
+    for (size_t i = 0; i < fftSize; ++i)
+    {
+        buffer[i] = std::exp(spectrum[i] * scale);
+    }
+    fft.Backward(buffer, spectrum);
+
+    std::vector<double> result(prototype.size());
+    double sum = 0;
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        result[i] = spectrum[i].real() / scale;
+        sum += result[i];
+    }
+    for (auto &v : result)
+    {
+        v /= sum;
+    }
+    return result;
+}
+
+void HalfbandStage::Branch::SetTaps(std::vector<float> &&taps)
+{
+    this->taps = std::move(taps);
+    this->length = this->taps.size();
+    this->history.resize(this->length * 2);
+
+    // Detect a branch with a single non-zero tap (the odd branch of a linear-phase halfband filter).
+    delayTap = -1;
+    int nonZero = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (this->taps[i] != 0)
+        {
+            ++nonZero;
+            delayTap = (int)i;
+        }
+    }
+    if (nonZero != 1)
+    {
+        delayTap = -1;
+    }
+    else
+    {
+        delayGain = this->taps[delayTap];
+    }
+    Reset();
+}
+void HalfbandStage::Branch::Reset()
+{
+    for (auto &v : history)
+    {
+        v = 0;
+    }
+    pos = 0;
+}
+
+void HalfbandStage::SetPrototype(const std::vector<double> &coefficients)
+{
+    size_t evenLength = (coefficients.size() + 1) / 2;
+    size_t oddLength = coefficients.size() / 2;
+    std::vector<float> even(evenLength);
+    std::vector<float> odd(oddLength);
+    double delaySum = 0;
+    double sum = 0;
+    for (size_t i = 0; i < coefficients.size(); ++i)
+    {
+        if (i % 2 == 0)
+        {
+            even[i / 2] = (float)coefficients[i];
+        }
+        else
+        {
+            odd[i / 2] = (float)coefficients[i];
+        }
+        delaySum += i * coefficients[i];
+        sum += coefficients[i];
+    }
+    groupDelay = delaySum / sum;
+
+    // Upsampling: zero-stuffing loses half the energy; branches get a gain of 2.
+    std::vector<float> evenUp = even;
+    std::vector<float> oddUp = odd;
+    for (auto &v : evenUp)
+    {
+        v *= 2;
+    }
+    for (auto &v : oddUp)
+    {
+        v *= 2;
+    }
+    upEven.SetTaps(std::move(evenUp));
+    upOdd.SetTaps(std::move(oddUp));
+    downEven.SetTaps(std::move(even));
+    downOdd.SetTaps(std::move(odd));
+    Reset();
+}
+
+void HalfbandStage::Reset()
+{
+    upEven.Reset();
+    upOdd.Reset();
+    downEven.Reset();
+    downOdd.Reset();
+    downPreviousOdd = 0;
+}
+
+void HalfbandStage::Upsample(const float *input, float *output, size_t numFrames)
+{
+    for (size_t i = 0; i < numFrames; ++i)
+    {
+        float x = input[i];
+        output[2 * i] = upEven.Tick(x);
+        output[2 * i + 1] = upOdd.Tick(x);
+    }
+}
+
+void HalfbandStage::Downsample(const float *input, float *output, size_t numFrames)
+{
+    for (size_t i = 0; i < numFrames; ++i)
+    {
+        output[i] = downEven.Tick(input[2 * i]) + downOdd.Tick(downPreviousOdd);
+        downPreviousOdd = input[2 * i + 1];
+    }
+}
+
+HalfbandOversampler::HalfbandOversampler(size_t maxBlockSize)
+{
+    std::vector<double> stage1 = DesignLinearPhase(STAGE1_LENGTH, STOPBAND_DB);
+    std::vector<double> stage2 = DesignLinearPhase(STAGE2_LENGTH, STOPBAND_DB);
+    stages[0].SetPrototype(stage1);
+    stages[1].SetPrototype(stage2);
+    stages[2].SetPrototype(MinimumPhase(stage1));
+    stages[3].SetPrototype(MinimumPhase(stage2));
+    SetMaxBlockSize(maxBlockSize);
+}
+
+void HalfbandOversampler::SetMaxBlockSize(size_t maxBlockSize)
+{
+    this->maxBlockSize = maxBlockSize;
+    upBuffer2x.resize(maxBlockSize * 2);
+    upBuffer4x.resize(maxBlockSize * 4);
+    downBuffer2x.resize(maxBlockSize * 2);
+}
+
+void HalfbandOversampler::SetOversampling(int factor, FilterPhase phase)
+{
+    if (factor != 1 && factor != 2 && factor != 4)
+    {
+        throw std::invalid_argument("Oversampling factor must be 1, 2 or 4.");
+    }
+    this->factor = factor;
+    this->phase = phase;
+    Reset();
+}
+
+double HalfbandOversampler::GetLatency() const
+{
+    switch (factor)
+    {
+    case 1:
+    default:
+        return 0;
+    case 2:
+        // up + down, at 2x.
+        return 2 * Stage(0)->GetGroupDelay() / 2;
+    case 4:
+        return 2 * Stage(0)->GetGroupDelay() / 2 + 2 * Stage(1)->GetGroupDelay() / 4;
+    }
+}
+
+void HalfbandOversampler::Reset()
+{
+    for (auto &stage : stages)
+    {
+        stage.Reset();
+    }
+}
+
+float *HalfbandOversampler::Upsample(const float *input, size_t numFrames)
+{
+    switch (factor)
+    {
+    case 1:
+    default:
+        for (size_t i = 0; i < numFrames; ++i)
+        {
+            upBuffer2x[i] = input[i];
+        }
+        return upBuffer2x.data();
+    case 2:
+        Stage(0)->Upsample(input, upBuffer2x.data(), numFrames);
+        return upBuffer2x.data();
+    case 4:
+        Stage(0)->Upsample(input, upBuffer2x.data(), numFrames);
+        Stage(1)->Upsample(upBuffer2x.data(), upBuffer4x.data(), numFrames * 2);
+        return upBuffer4x.data();
+    }
+}
+
+void HalfbandOversampler::Downsample(const float *input, float *output, size_t numFrames)
+{
+    switch (factor)
+    {
+    case 1:
+    default:
+        for (size_t i = 0; i < numFrames; ++i)
+        {
+            output[i] = input[i];
+        }
+        break;
+    case 2:
+        Stage(0)->Downsample(input, output, numFrames);
+        break;
+    case 4:
+        Stage(1)->Downsample(input, downBuffer2x.data(), numFrames * 2);
+        Stage(0)->Downsample(downBuffer2x.data(), output, numFrames);
+        break;
+    }
+}
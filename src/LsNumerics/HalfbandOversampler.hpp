@@ -0,0 +1,167 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace LsNumerics
+{
+    /// @brief One 2x stage of a polyphase oversampler.
+    ///
+    /// The prototype lowpass filter is split into even and odd polyphase branches, so that 
+    /// each branch runs at the low sample rate. When the prototype is a linear-phase halfband filter, every second 
+    /// tap of the odd branch is zero except the center tap, and the odd branch degenerates into a pure delay.
+    class HalfbandStage
+    {
+    public:
+        /// @brief Set the prototype lowpass filter (cutoff at 1/4 of the high sample rate, unity DC gain).
+        void SetPrototype(const std::vector<double> &coefficients);
+
+        void Reset();
+
+        /// @brief Upsample numFrames input samples to 2*numFrames output samples.
+        void Upsample(const float *input, float *output, size_t numFrames);
+        /// @brief Downsample 2*numFrames input samples to numFrames output samples.
+        void Downsample(const float *input, float *output, size_t numFrames);
+
+        /// @brief Group delay at DC in samples at the high sample rate.
+        double GetGroupDelay() const { return groupDelay; }
+
+    private:
+        class Branch
+        {
+        public:
+            void SetTaps(std::vector<float> &&taps);
+            void Reset();
+            float Tick(float value)
+            {
+                if (pos == 0)
+                {
+                    pos = length;
+                }
+                --pos;
+                history[pos] = value;
+                history[pos + length] = value;
+                const float *x = history.data() + pos;
+
+                if (delayTap >= 0)
+                {
+                    return delayGain * x[delayTap];
+                }
+                const float *h = taps.data();
+                float sum = 0;
+                for (size_t i = 0; i < length; ++i)
+                {
+                    sum += h[i] * x[i];
+                }
+                return sum;
+            }
+
+        private:
+            std::vector<float> taps;
+            std::vector<float> history; // doubled, so the window for the dot product is always contiguous.
+            size_t length = 0;
+            size_t pos = 0;
+            int delayTap = -1;
+            float delayGain = 0;
+        };
+
+        Branch upEven, upOdd;
+        Branch downEven, downOdd;
+        float downPreviousOdd = 0;
+        double groupDelay = 0;
+    };
+
+    /// @brief 2x or 4x polyphase halfband oversampler.
+    ///
+    /// Linear-phase and minimum-phase filters are designed at construction, 
+    /// and buffers are allocated by SetMaxBlockSize(), so SetOversampling() may be called on 
+    /// the audio thread.
+    class HalfbandOversampler
+    {
+    public:
+        enum class FilterPhase
+        {
+            Linear,
+            Minimum
+        };
+
+        HalfbandOversampler(size_t maxBlockSize = 0);
+
+        /// @brief Allocate buffers. Not realtime-safe.
+        void SetMaxBlockSize(size_t maxBlockSize);
+        size_t GetMaxBlockSize() const { return maxBlockSize; }
+
+        /// @brief Select the oversampling factor (1, 2 or 4) and filter phase. Resets filter state.
+        void SetOversampling(int factor, FilterPhase phase);
+        int GetFactor() const { return factor; }
+        FilterPhase GetPhase() const { return phase; }
+
+        /// @brief Combined latency of the upsampler and downsampler, in samples at the base sample rate.
+        ///
+        /// For minimum-phase filters, this is the group delay at DC; group delay increases towards the cutoff.
+        double GetLatency() const;
+
+        void Reset();
+
+        /// @brief Upsample a block.
+        /// @param input numFrames samples at the base rate.
+        /// @param numFrames Must not exceed the maximum block size.
+        /// @returns A buffer containing numFrames*GetFactor() samples at the oversampled rate. 
+        /// The buffer remains valid until the next call to Upsample.
+        float *Upsample(const float *input, size_t numFrames);
+
+        /// @brief Downsample a block.
+        /// @param input numFrames*GetFactor() samples at the oversampled rate.
+        /// @param output Receives numFrames samples at the base rate.
+        /// @param numFrames Must not exceed the maximum block size.
+        void Downsample(const float *input, float *output, size_t numFrames);
+
+        /// @brief Linear-phase halfband prototype: Kaiser-windowed sinc.
+        /// @param length Filter length. Must be of the form 4k+3.
+        /// @param stopbandDb Stop-band attenuation in dB (positive).
+        static std::vector<double> DesignLinearPhase(size_t length, double stopbandDb);
+
+        /// @brief Minimum-phase filter with the same magnitude response as the prototype (homomorphic method).
+        static std::vector<double> MinimumPhase(const std::vector<double> &prototype);
+
+    private:
+        HalfbandStage *Stage(size_t index) { return &stages[phase == FilterPhase::Linear ? index : index + 2]; }
+        const HalfbandStage *Stage(size_t index) const { return &stages[phase == FilterPhase::Linear ? index : index + 2]; }
+
+        // [linear 2x, linear 4x, minimum 2x, minimum 4x]
+        HalfbandStage stages[4];
+        int factor = 1;
+        FilterPhase phase = FilterPhase::Linear;
+        size_t maxBlockSize = 0;
+
+        std::vector<float> upBuffer2x;
+        std::vector<float> upBuffer4x;
+        std::vector<float> downBuffer2x;
+    };
+}
@@ -0,0 +1,251 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "HalfbandOversampler.hpp"
+#include "LsMath.hpp"
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+using FilterPhase = HalfbandOversampler::FilterPhase;
+
+static constexpr double SAMPLE_RATE = 48000;
+static constexpr size_t BLOCK_SIZE = 64;
+static constexpr size_t SETTLE_FRAMES = 4096;
+static constexpr size_t MEASURE_FRAMES = 8192;
+
+// Exactly 176 cycles in the measurement window, so that the test frequency falls in the center of a DFT bin.
+static constexpr double TEST_FREQUENCY = SAMPLE_RATE * 176 / MEASURE_FRAMES;
+
+static const char *PhaseName(FilterPhase phase)
+{
+    return phase == FilterPhase::Linear ? "linear" : "minimum";
+}
+
+static double Db(double value)
+{
+    return 20 * std::log10(std::max(value, 1E-12));
+}
+
+// Amplitude of the frequency component at f (normalized to the sample rate) using a Hann-windowed DFT bin.
+static double Amplitude(const std::vector<float> &signal, double f)
+{
+    double re = 0, im = 0, windowSum = 0;
+    size_t n = signal.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        double w = 0.5 - 0.5 * std::cos(2 * Pi * i / n);
+        re += w * signal[i] * std::cos(2 * Pi * f * i);
+        im += w * signal[i] * std::sin(2 * Pi * f * i);
+        windowSum += w;
+    }
+    return 2 * std::sqrt(re * re + im * im) / windowSum;
+}
+
+static std::vector<float> RunUpsampler(HalfbandOversampler &oversampler, double frequency)
+{
+    int factor = oversampler.GetFactor();
+    std::vector<float> result;
+    float input[BLOCK_SIZE];
+    size_t t = 0;
+    for (size_t frame = 0; frame < SETTLE_FRAMES + MEASURE_FRAMES; frame += BLOCK_SIZE)
+    {
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            input[i] = (float)std::sin(2 * Pi * frequency / SAMPLE_RATE * (t++));
+        }
+        float *output = oversampler.Upsample(input, BLOCK_SIZE);
+        if (frame >= SETTLE_FRAMES)
+        {
+            result.insert(result.end(), output, output + BLOCK_SIZE * factor);
+        }
+    }
+    return result;
+}
+
+static std::vector<float> RunDownsampler(HalfbandOversampler &oversampler, double frequency)
+{
+    int factor = oversampler.GetFactor();
+    double oversampledRate = SAMPLE_RATE * factor;
+    std::vector<float> result;
+    std::vector<float> input(BLOCK_SIZE * factor);
+    float output[BLOCK_SIZE];
+    size_t t = 0;
+    for (size_t frame = 0; frame < SETTLE_FRAMES + MEASURE_FRAMES; frame += BLOCK_SIZE)
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            input[i] = (float)std::sin(2 * Pi * frequency / oversampledRate * (t++));
+        }
+        oversampler.Downsample(input.data(), output, BLOCK_SIZE);
+        if (frame >= SETTLE_FRAMES)
+        {
+            result.insert(result.end(), output, output + BLOCK_SIZE);
+        }
+    }
+    return result;
+}
+
+static void TestRoundTrip(int factor, FilterPhase phase)
+{
+    HalfbandOversampler oversampler(BLOCK_SIZE);
+    oversampler.SetOversampling(factor, phase);
+
+    double latency = oversampler.GetLatency();
+    double w = 2 * Pi * TEST_FREQUENCY / SAMPLE_RATE;
+
+    float input[BLOCK_SIZE];
+    float output[BLOCK_SIZE];
+    size_t t = 0;
+    double maxError = 0;
+    std::vector<float> result;
+    for (size_t frame = 0; frame < SETTLE_FRAMES + MEASURE_FRAMES; frame += BLOCK_SIZE)
+    {
+        size_t t0 = t;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            input[i] = (float)std::sin(w * (t++));
+        }
+        float *oversampled = oversampler.Upsample(input, BLOCK_SIZE);
+        oversampler.Downsample(oversampled, output, BLOCK_SIZE);
+        if (frame >= SETTLE_FRAMES)
+        {
+            result.insert(result.end(), output, output + BLOCK_SIZE);
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                if (phase == FilterPhase::Linear)
+                {
+                    double expected = std::sin(w * (t0 + i - latency));
+                    maxError = std::max(maxError, std::abs(expected - output[i]));
+                }
+            }
+        }
+    }
+    // passband gain.
+    TEST_ASSERT(std::abs(Amplitude(result, TEST_FREQUENCY / SAMPLE_RATE) - 1) < 1E-3);
+    if (phase == FilterPhase::Linear)
+    {
+        // linear phase: exactly a delay.
+        TEST_ASSERT(maxError < 1E-3);
+    }
+}
+
+static void TestImageRejection(int factor, FilterPhase phase, double minRejectionDb)
+{
+    HalfbandOversampler oversampler(BLOCK_SIZE);
+    oversampler.SetOversampling(factor, phase);
+
+    const double frequency = TEST_FREQUENCY;
+    std::vector<float> upsampled = RunUpsampler(oversampler, frequency);
+    double oversampledRate = SAMPLE_RATE * factor;
+
+    double signal = Amplitude(upsampled, frequency / oversampledRate);
+    TEST_ASSERT(std::abs(signal - 1) < 1E-3);
+
+    double worstImage = 0;
+    for (int k = 1; k < factor; ++k)
+    {
+        double imageLow = (k * SAMPLE_RATE - frequency) / oversampledRate;
+        double imageHigh = (k * SAMPLE_RATE + frequency) / oversampledRate;
+        worstImage = std::max(worstImage, Amplitude(upsampled, imageLow));
+        worstImage = std::max(worstImage, Amplitude(upsampled, imageHigh));
+    }
+    double rejection = Db(signal) - Db(worstImage);
+    cout << "    image rejection: " << std::fixed << std::setprecision(1) << rejection << " dB" << endl;
+    TEST_ASSERT(rejection > minRejectionDb);
+}
+
+static void TestAliasRejection(int factor, FilterPhase phase, double minRejectionDb)
+{
+    HalfbandOversampler oversampler(BLOCK_SIZE);
+    oversampler.SetOversampling(factor, phase);
+
+    // in the stop band of the first stage; would alias to 0.35 x SAMPLE_RATE.
+    const double frequency = SAMPLE_RATE * 0.65;
+    std::vector<float> output = RunDownsampler(oversampler, frequency);
+    double alias = Amplitude(output, 0.35);
+    double rejection = -Db(alias);
+    cout << "    alias rejection: " << std::fixed << std::setprecision(1) << rejection << " dB" << endl;
+    TEST_ASSERT(rejection > minRejectionDb);
+}
+
+static void ReportCost(int factor, FilterPhase phase)
+{
+    HalfbandOversampler oversampler(BLOCK_SIZE);
+    oversampler.SetOversampling(factor, phase);
+
+    constexpr size_t PROFILE_FRAMES = (size_t)(SAMPLE_RATE * 10);
+    float input[BLOCK_SIZE];
+    float output[BLOCK_SIZE];
+    for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    {
+        input[i] = (float)std::sin(i * 0.1);
+    }
+    float sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t frame = 0; frame < PROFILE_FRAMES; frame += BLOCK_SIZE)
+    {
+        float *oversampled = oversampler.Upsample(input, BLOCK_SIZE);
+        oversampler.Downsample(oversampled, output, BLOCK_SIZE);
+        sum += output[0];
+    }
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    double nsPerSample = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double)PROFILE_FRAMES;
+
+    cout << "    latency: " << std::fixed << std::setprecision(2) << oversampler.GetLatency() << " samples"
+         << "  cost: " << std::setprecision(1) << nsPerSample << " ns/sample"
+         << " (" << std::setprecision(3) << nsPerSample * 1E-9 * SAMPLE_RATE * 100 << "% CPU at 48kHz)"
+         << (std::isfinite(sum) ? "" : " !")
+         << endl;
+}
+
+int main(int, char **)
+{
+    try
+    {
+        for (FilterPhase phase : {FilterPhase::Linear, FilterPhase::Minimum})
+        {
+            for (int factor : {2, 4})
+            {
+                cout << factor << "x " << PhaseName(phase) << " phase" << endl;
+                TestRoundTrip(factor, phase);
+                TestImageRejection(factor, phase, 90);
+                TestAliasRejection(factor, phase, 90);
+                ReportCost(factor, phase);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -23,40 +23,65 @@
  */
 
 #include "IfPitchDetector.hpp"
-
+#include "LsMath.hpp"
 
 
 using namespace LsNumerics;
 
-void IfPitchDetector::prime(std::vector<float> p, size_t index)
+void IfPitchDetector::analyze(const float *input, size_t hopSize)
 {
+    swapBuffers();
+    this->hopSize = hopSize;
     for (size_t i = 0; i < fftSize; ++i)
     {
-        windowBuffer[i] = p[i+index]*window[i];
+        windowBuffer[i] = input[i]*window[i];
     }
-    fftPlan.Forward(windowBuffer,*fftBuffer);    
+    fftPlan.Forward(windowBuffer,*fftBuffer);
+}
+
+void IfPitchDetector::setFrame(const buffer_t &spectrum, size_t hopSize)
+{
+    swapBuffers();
+    this->hopSize = hopSize;
+    std::copy(spectrum.begin(),spectrum.begin()+fftSize,fftBuffer->begin());
+}
+
+double IfPitchDetector::getInstantaneousFrequency(size_t bin) const
+{
+    // phase advance over the hop, less the advance of the bin center frequency, wrapped to (-pi,pi].
+    // (Fft's forward transform uses exp(+i...) kernels, so phases run backwards.)
+    double expectedAdvance = 2*Pi*bin*hopSize/fftSize;
+    double advance = std::arg((*lastBuffer)[bin]*std::conj((*fftBuffer)[bin]));
+    double deviation = advance - expectedAdvance;
+    deviation -= 2*Pi*std::round(deviation/(2*Pi));
+
+    double binOffset = deviation*fftSize/(2*Pi*hopSize);
+    return (bin + binOffset)*sampleRate/fftSize;
+}
+
+void IfPitchDetector::prime(std::vector<float> p, size_t index)
+{
+    analyze(p.data()+index,0);
 }
 
 double IfPitchDetector::detectPitch(std::vector<float> p, size_t index,size_t sampleStride)
 {
+    analyze(p.data()+index,sampleStride);
 
-    for (size_t i = 0; i < fftSize; ++i)
+    size_t peakBin = 1;
+    double peakValue = 0;
+    for (size_t i = 1; i < getBinCount(); ++i)
     {
-        windowBuffer[i] = p[i+index]*window[i];
+        double value = std::norm((*fftBuffer)[i]);
+        if (value > peakValue)
+        {
+            peakValue = value;
+            peakBin = i;
+        }
     }
-
-    fftPlan.Forward(windowBuffer,*fftBuffer);
-
-    for (size_t i = 0; i < phase.size(); ++i)
+    if (peakValue == 0)
     {
-        auto d = (*fftBuffer)[i]/(*lastBuffer)[i];
-        phase[0] = std::atan2(d.imag(),d.real());
+        return 0;
     }
-
-
-
-
-    swapBuffers();
-    return 0;
+    return getInstantaneousFrequency(peakBin);
 }
-
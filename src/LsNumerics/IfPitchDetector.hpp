@@ -31,6 +31,11 @@
 namespace LsNumerics {
     using namespace std;
 
+    /// @brief Phase-vocoder (instantaneous frequency) analysis.
+    ///
+    /// Each analyzed frame is compared with the frame before it. The phase advance of a bin between
+    /// the two frames gives the frequency of the sinusoid that dominates the bin to a small fraction of a bin,
+    /// provided the sinusoid lies within fftSize/(2*hop) bins of the bin center.
     class IfPitchDetector {
     public:
         using complex_t = complex<double>;
@@ -38,31 +43,55 @@ namespace LsNumerics {
 
         IfPitchDetector(double sampleRate, size_t fftSize)
         :fftPlan(fftSize),
+         sampleRate(sampleRate),
          fftSize(fftSize)
         {
             buffer0.resize(fftSize);
             buffer1.resize(fftSize);
-            phase.resize(fftSize/2);
+            windowBuffer.resize(fftSize);
 
             window = Window::Hann<double>(fftSize);
-            
+            double windowSum = 0;
+            for (auto w : window)
+            {
+                windowSum += w;
+            }
+            // Fft scales by 1/sqrt(N). A sinusoid centered in a bin reads as its amplitude.
+            magnitudeScale = 2 * std::sqrt((double)fftSize) / windowSum;
         }
 
         void prime(std::vector<float> p, size_t index);
         double detectPitch(std::vector<float> p, size_t index,size_t sampleStride);
         size_t getFftSize() const { return fftSize;}
 
+        /// @brief Analyze fftSize samples starting at input, taken hopSize samples after the previous frame.
+        void analyze(const float *input, size_t hopSize);
+        /// @brief Use a precomputed frame: the Fft of fftSize Hann-windowed samples, taken hopSize samples after the previous frame.
+        void setFrame(const buffer_t &spectrum, size_t hopSize);
 
+        size_t getBinCount() const { return fftSize/2; }
+        double getBinFrequency(size_t bin) const { return bin*sampleRate/fftSize; }
+        size_t frequencyToBin(double frequency) const { return (size_t)std::round(frequency*fftSize/sampleRate); }
+
+        /// @brief Amplitude of the current frame at a bin.
+        double getMagnitude(size_t bin) const { return std::abs((*fftBuffer)[bin])*magnitudeScale; }
+        /// @brief The current frame's value at a bin (unscaled Fft output).
+        const complex_t &getBin(size_t bin) const { return (*fftBuffer)[bin]; }
+        /// @brief Converts the absolute value of a bin to an amplitude.
+        double getMagnitudeScale() const { return magnitudeScale; }
+        /// @brief The instantaneous frequency at a bin, in Hz.
+        double getInstantaneousFrequency(size_t bin) const;
 
     private:
         Fft fftPlan;
+        double sampleRate;
         size_t fftSize;
+        size_t hopSize = 0;
+        double magnitudeScale;
 
         std::vector<double> window;
         buffer_t windowBuffer;
 
-        std::vector<double> phase;
-
         buffer_t buffer0;
         buffer_t buffer1;
 
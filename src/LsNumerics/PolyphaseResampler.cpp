@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "PolyphaseResampler.hpp"
+#include "MotorolaResampler.hpp"
+#include "LsMath.hpp"
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+using namespace LsNumerics;
+
+static double BesselI0(double x)
+{
+    double sum = 1;
+    double term = 1;
+    double halfX = x * 0.5;
+    for (int k = 1; k < 50; ++k)
+    {
+        term *= halfX / k;
+        double t2 = term * term;
+        sum += t2;
+        if (t2 < sum * 1E-17)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+bool PolyphaseResampler::CanResample(size_t inputRate, size_t outputRate)
+{
+    if (inputRate == 0 || outputRate == 0)
+    {
+        return false;
+    }
+    size_t gcd = std::gcd(inputRate, outputRate);
+    return outputRate / gcd <= MAX_PHASES && inputRate / gcd <= MAX_PHASES;
+}
+
+PolyphaseResampler::PolyphaseResampler(size_t inputRate, size_t outputRate, double cutoffFrequency, double stopbandDb)
+{
+    if (!CanResample(inputRate, outputRate))
+    {
+        throw std::invalid_argument("PolyphaseResampler: unsupported rate ratio.");
+    }
+    size_t gcd = std::gcd(inputRate, outputRate);
+    upRate = outputRate / gcd;
+    downRate = inputRate / gcd;
+
+    // Content above the cutoff may alias or image, as long as it lands above the cutoff too.
+    double lowerRate = (double)std::min(inputRate, outputRate);
+    if (cutoffFrequency <= 0 || cutoffFrequency >= lowerRate / 2)
+    {
+        throw std::invalid_argument("PolyphaseResampler: invalid cutoff frequency.");
+    }
+    double stopbandFrequency = lowerRate - cutoffFrequency;
+
+    // Kaiser window design.
+    double prototypeRate = (double)inputRate * upRate;
+    double transitionWidth = 2 * Pi * (stopbandFrequency - cutoffFrequency) / prototypeRate;
+    double beta = stopbandDb > 50 ? 0.1102 * (stopbandDb - 8.7)
+                                  : 0.5842 * std::pow(std::max(0.0, stopbandDb - 21), 0.4) + 0.07886 * std::max(0.0, stopbandDb - 21);
+    size_t minLength = (size_t)std::ceil((stopbandDb - 8) / (2.285 * transitionWidth)) + 1;
+
+    // a delay of a whole number of output samples (each of which is downRate prototype samples).
+    outputDelay = (minLength / 2 + downRate - 1) / downRate;
+    size_t center = outputDelay * downRate;
+    size_t length = 2 * center + 1;
+
+    filter.resize(length);
+    double fc = (cutoffFrequency + stopbandFrequency) / 2 / prototypeRate; // cycles per prototype sample.
+    double i0Beta = BesselI0(beta);
+    for (size_t i = 0; i < length; ++i)
+    {
+        double n = (double)i - (double)center;
+        double sinc = n == 0 ? 2 * fc : std::sin(2 * Pi * fc * n) / (Pi * n);
+        double r = n / center;
+        double window = BesselI0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / i0Beta;
+        // x upRate: zero-stuffing divides the gain by upRate.
+        filter[i] = (float)(sinc * window * upRate);
+    }
+}
+
+std::vector<float> PolyphaseResampler::Resample(const std::vector<float> &input) const
+{
+    size_t outputLength = (input.size() * upRate + downRate - 1) / downRate;
+    if (input.empty())
+    {
+        return std::vector<float>();
+    }
+    // zero-padded, so that the filter's tail (and the delayed samples) are flushed out.
+    size_t requiredOutput = outputLength + outputDelay;
+    size_t paddedLength = (requiredOutput * downRate + upRate - 1) / upRate + GetTapsPerPhase();
+    std::vector<float> paddedInput(std::max(paddedLength, input.size()));
+    std::copy(input.begin(), input.end(), paddedInput.begin());
+
+    Resampler<float, float, float> resampler((int)upRate, (int)downRate, const_cast<float *>(filter.data()), (int)filter.size());
+    std::vector<float> output(resampler.neededOutCount((int)paddedInput.size()));
+    resampler.apply(paddedInput.data(), (int)paddedInput.size(), output.data(), (int)output.size());
+
+    output.erase(output.begin(), output.begin() + outputDelay);
+    output.resize(outputLength);
+    return output;
+}
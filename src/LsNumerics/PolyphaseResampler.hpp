@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace LsNumerics
+{
+    /// @brief Windowed-sinc polyphase resampling between two sample rates whose ratio is rational.
+    ///
+    /// The rates are reduced to upRate/downRate. The prototype lowpass (a Kaiser-windowed sinc, at inputRate*upRate)
+    /// is designed once, and each output sample uses only the taps of one phase, via MotorolaResampler's
+    /// polyphase filter. The delay of the filter is removed, so output sample n is aligned with input time
+    /// n*inputRate/outputRate.
+    class PolyphaseResampler
+    {
+    public:
+        // more phases than this (e.g. 44100 to 44101) make the prototype filter too long.
+        static constexpr size_t MAX_PHASES = 1024;
+
+        static bool CanResample(size_t inputRate, size_t outputRate);
+
+        /// @param cutoffFrequency Top of the passband, in Hz. Less than half of the lower rate.
+        /// @param stopbandDb Attenuation of everything that would alias or image into the passband.
+        PolyphaseResampler(size_t inputRate, size_t outputRate, double cutoffFrequency, double stopbandDb = 90);
+
+        /// @brief Resample a complete signal. The result has ceil(input.size()*outputRate/inputRate) samples.
+        /// @remarks Thread-safe, so that channels can be resampled in parallel.
+        std::vector<float> Resample(const std::vector<float> &input) const;
+
+        size_t GetTapsPerPhase() const { return (filter.size() + upRate - 1) / upRate; }
+
+    private:
+        size_t upRate;
+        size_t downRate;
+        std::vector<float> filter;
+        size_t outputDelay; // filter delay, in output samples.
+    };
+}
@@ -0,0 +1,184 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "PolyphaseResampler.hpp"
+#include "LsMath.hpp"
+#include <cmath>
+#include <iostream>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+static constexpr double AMPLITUDE = 0.5;
+
+struct RateConversion
+{
+    size_t inputRate;
+    size_t outputRate;
+    // an input tone, and the frequency in the output's passband that its alias or image would fold to.
+    double aliasedTone;
+    double aliasFrequency;
+};
+
+// 44.1k->48k: the image at 44100-15000 lands at 48000-29100.
+// 48k->44.1k: the image at 48000-10000 lands at 44100-38000.
+// 96k->48k: 47000 folds to 48000-47000.
+static const RateConversion RATE_CONVERSIONS[] = {
+    {44100, 48000, 15000, 18900},
+    {48000, 44100, 10000, 6100},
+    {96000, 48000, 47000, 1000},
+};
+
+// The cutoff that AudioData uses.
+static double Cutoff(const RateConversion &conversion)
+{
+    return std::min(conversion.inputRate, conversion.outputRate) * 20000.0 / 44100;
+}
+
+static double Db(double value)
+{
+    return 20 * std::log10(std::max(value, 1E-12));
+}
+
+static std::vector<float> Tone(double frequency, double sampleRate, size_t length)
+{
+    std::vector<float> result(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        result[i] = (float)(AMPLITUDE * std::sin(2 * Pi * frequency * i / sampleRate));
+    }
+    return result;
+}
+
+// Amplitude of the frequency component at f (normalized to the sample rate) using a Hann-windowed DFT bin.
+static double Amplitude(const std::vector<float> &signal, double f)
+{
+    double re = 0, im = 0, windowSum = 0;
+    size_t n = signal.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        double w = 0.5 - 0.5 * std::cos(2 * Pi * i / n);
+        re += w * signal[i] * std::cos(2 * Pi * f * i);
+        im += w * signal[i] * std::sin(2 * Pi * f * i);
+        windowSum += w;
+    }
+    return 2 * std::sqrt(re * re + im * im) / windowSum;
+}
+
+static void TestOutputLength(const RateConversion &conversion, const PolyphaseResampler &resampler)
+{
+    for (size_t length : {0, 1, 2, 3, 7, 160, 1001, 44101})
+    {
+        size_t expected = (length * conversion.outputRate + conversion.inputRate - 1) / conversion.inputRate;
+        TEST_ASSERT(resampler.Resample(std::vector<float>(length)).size() == expected);
+    }
+}
+
+// Passband tones must come out with the same amplitude and phase, sampled at the output rate: output sample n
+// is aligned with input time n*inputRate/outputRate.
+static void TestPassband(const RateConversion &conversion, const PolyphaseResampler &resampler)
+{
+    double cutoff = Cutoff(conversion);
+    size_t length = conversion.inputRate / 2;
+    // skip the ends, where the filter sees the zero padding.
+    size_t margin = resampler.GetTapsPerPhase() * 2;
+
+    double maxError = 0;
+    for (double frequency : {100.0, 1000.0, 5000.0, 10000.0, 15000.0, cutoff * 0.98})
+    {
+        std::vector<float> output = resampler.Resample(Tone(frequency, (double)conversion.inputRate, length));
+        std::vector<float> expected = Tone(frequency, (double)conversion.outputRate, output.size());
+        for (size_t i = margin; i < output.size() - margin; ++i)
+        {
+            maxError = std::max(maxError, (double)std::abs(output[i] - expected[i]));
+        }
+    }
+    double errorDb = Db(maxError / AMPLITUDE);
+    cout << "    passband error: " << errorDb << "dB" << endl;
+    TEST_ASSERT(errorDb < -80);
+}
+
+static void TestAliasRejection(const RateConversion &conversion, const PolyphaseResampler &resampler)
+{
+    TEST_ASSERT(conversion.aliasFrequency < Cutoff(conversion));
+
+    size_t length = conversion.inputRate;
+    std::vector<float> output = resampler.Resample(Tone(conversion.aliasedTone, (double)conversion.inputRate, length));
+    double aliasDb = Db(Amplitude(output, conversion.aliasFrequency / conversion.outputRate) / AMPLITUDE);
+    cout << "    " << conversion.aliasedTone << "Hz alias at " << conversion.aliasFrequency << "Hz: " << aliasDb << "dB" << endl;
+    TEST_ASSERT(aliasDb < -85);
+}
+
+// A band-limited pulse keeps its position in time, including right at the start of the signal.
+static void TestAlignment(const RateConversion &conversion, const PolyphaseResampler &resampler)
+{
+    constexpr double SIGMA = 20; // input samples; band-limited to well below the cutoff.
+    size_t length = conversion.inputRate / 10;
+    for (double center : {8 * SIGMA, length / 2.0 + 0.37})
+    {
+        std::vector<float> input(length);
+        for (size_t i = 0; i < length; ++i)
+        {
+            double x = (i - center) / SIGMA;
+            input[i] = (float)std::exp(-0.5 * x * x);
+        }
+        std::vector<float> output = resampler.Resample(input);
+
+        double sum = 0, moment = 0;
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            sum += output[i];
+            moment += i * (double)output[i];
+        }
+        double expectedCenter = center * conversion.outputRate / conversion.inputRate;
+        double error = moment / sum - expectedCenter;
+        TEST_ASSERT(std::abs(error) < 1E-3);
+    }
+}
+
+int main(int, char **)
+{
+    try
+    {
+        for (const RateConversion &conversion : RATE_CONVERSIONS)
+        {
+            cout << conversion.inputRate << " -> " << conversion.outputRate << endl;
+            TEST_ASSERT(PolyphaseResampler::CanResample(conversion.inputRate, conversion.outputRate));
+            PolyphaseResampler resampler(conversion.inputRate, conversion.outputRate, Cutoff(conversion));
+
+            TestOutputLength(conversion, resampler);
+            TestPassband(conversion, resampler);
+            TestAliasRejection(conversion, resampler);
+            TestAlignment(conversion, resampler);
+        }
+        TEST_ASSERT(!PolyphaseResampler::CanResample(44100, 44101));
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,706 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "StrumPitchDetector.hpp"
+#include "LsMath.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace LsNumerics;
+
+// half-width of the main lobe of a Hann window, in bins.
+static constexpr double MAIN_LOBE_BINS = 2;
+
+void StrumPitchDetector::Initialize(double sampleRate, size_t fftSize, size_t hopSize, double maxFrequency)
+{
+    if (hopSize == 0 || hopSize > fftSize / 4)
+    {
+        // the instantaneous frequency of a bin is only unambiguous within fftSize/(2*hopSize) bins.
+        throw std::invalid_argument("StrumPitchDetector: invalid hop size.");
+    }
+    this->sampleRate = sampleRate;
+    this->fftSize = fftSize;
+    this->hopSize = hopSize;
+    this->maxFrequency = std::min(maxFrequency, sampleRate / 2);
+    this->ifPitchDetector = std::make_unique<IfPitchDetector>(sampleRate, fftSize);
+    history.resize(fftSize * 2);
+    SetStringFrequencies(std::vector<double>());
+    Reset();
+}
+
+void StrumPitchDetector::Reset()
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyIndex = 0;
+    samplesSinceFrame = 0;
+    framesAnalyzed = 0;
+    for (auto &string : strings)
+    {
+        string.pitch = 0;
+        string.recentFits.resize(0);
+    }
+}
+
+bool StrumPitchDetector::CollidesWithOtherStrings(size_t string, double frequency) const
+{
+    // another string's partial close enough to be picked up by this partial's search, or to leak into its peak bin.
+    double binWidth = sampleRate / fftSize;
+    double tolerance = frequency * (std::exp2(MAX_DEVIATION_CENTS / 1200) - 1) + MAIN_LOBE_BINS * binWidth;
+    for (size_t i = 0; i < strings.size(); ++i)
+    {
+        if (i == string)
+        {
+            continue;
+        }
+        // every partial of the other string that can be in the input, not just its template partials.
+        for (size_t harmonic = 1; strings[i].frequency * harmonic < maxFrequency + tolerance; ++harmonic)
+        {
+            if (std::abs(strings[i].frequency * harmonic - frequency) < tolerance)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void StrumPitchDetector::SetStringFrequencies(const std::vector<double> &frequencies)
+{
+    strings.resize(frequencies.size());
+    for (size_t i = 0; i < frequencies.size(); ++i)
+    {
+        strings[i].frequency = frequencies[i];
+        strings[i].pitch = 0;
+    }
+    double minRatio = std::exp2(-MAX_DEVIATION_CENTS / 1200);
+    double maxRatio = std::exp2(MAX_DEVIATION_CENTS / 1200);
+    size_t lastBin = ifPitchDetector->getBinCount() - 2;
+    for (size_t i = 0; i < strings.size(); ++i)
+    {
+        StringInfo &string = strings[i];
+        string.partials.resize(0);
+        for (size_t harmonic = 1; harmonic <= MAX_TEMPLATE_HARMONIC; ++harmonic)
+        {
+            double frequency = string.frequency * harmonic;
+            if (frequency * maxRatio > maxFrequency)
+            {
+                break;
+            }
+            // If every partial is shared (the high E string of a guitar is the 4th harmonic of the low E), use the fundamental anyway.
+            if (harmonic != 1 && CollidesWithOtherStrings(i, frequency))
+            {
+                continue;
+            }
+            Partial partial;
+            partial.harmonic = harmonic;
+            partial.minBin = std::max((size_t)1, (size_t)std::floor(frequency * minRatio * fftSize / sampleRate));
+            partial.maxBin = std::min(lastBin, (size_t)std::ceil(frequency * maxRatio * fftSize / sampleRate));
+            string.partials.push_back(partial);
+        }
+        if (string.partials.size() > 1 && CollidesWithOtherStrings(i, string.frequency))
+        {
+            string.partials.erase(string.partials.begin());
+        }
+        string.sharedFundamental =
+            string.partials.size() == 1 && string.partials[0].harmonic == 1 && CollidesWithOtherStrings(i, string.frequency);
+    }
+}
+
+bool StrumPitchDetector::AddSamples(const float *samples, size_t count)
+{
+    bool analyzed = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float value = samples[i];
+        history[historyIndex] = value;
+        history[historyIndex + fftSize] = value;
+        if (++historyIndex == fftSize)
+        {
+            historyIndex = 0;
+        }
+        if (++samplesSinceFrame == hopSize)
+        {
+            samplesSinceFrame = 0;
+            AnalyzeFrame();
+            analyzed = true;
+        }
+    }
+    return analyzed;
+}
+
+void StrumPitchDetector::AddSpectrum(const IfPitchDetector::buffer_t &spectrum)
+{
+    ifPitchDetector->setFrame(spectrum, hopSize);
+    ++framesAnalyzed;
+    AnalyzeSpectrum(framesAnalyzed > 1);
+}
+
+void StrumPitchDetector::AnalyzeFrame()
+{
+    ifPitchDetector->analyze(history.data() + historyIndex, hopSize);
+    ++framesAnalyzed;
+    // the first frames include the silence before the history filled, and have no previous frame.
+    AnalyzeSpectrum(framesAnalyzed * hopSize > fftSize);
+}
+
+void StrumPitchDetector::AnalyzeSpectrum(bool hasPreviousFrame)
+{
+    const IfPitchDetector &spectrum = *ifPitchDetector;
+
+    // instantaneous frequencies are phase differences against the previous frame.
+    bool valid = hasPreviousFrame;
+    double floor = 0;
+    if (valid)
+    {
+        double maxMagnitude = 0;
+        for (const auto &string : strings)
+        {
+            for (const auto &partial : string.partials)
+            {
+                for (size_t bin = partial.minBin; bin <= partial.maxBin; ++bin)
+                {
+                    maxMagnitude = std::max(maxMagnitude, spectrum.getMagnitude(bin));
+                }
+            }
+        }
+        valid = maxMagnitude > threshold;
+        floor = maxMagnitude * std::pow(10.0, RELATIVE_FLOOR_DB / 20);
+    }
+
+    for (auto &string : strings)
+    {
+        string.pitch = 0;
+        if (!valid)
+        {
+            string.recentFits.resize(0);
+        }
+    }
+    if (!valid)
+    {
+        return;
+    }
+    // shared fundamentals are fitted against the pitches of the other strings, so they go last.
+    for (auto &string : strings)
+    {
+        if (!string.partials.empty() && !string.sharedFundamental)
+        {
+            string.pitch = AnalyzeString(string, floor);
+        }
+    }
+    for (auto &string : strings)
+    {
+        if (!string.partials.empty() && string.sharedFundamental)
+        {
+            // the fit is sensitive to noise, so it is averaged over the last few frames.
+            double pitch = FitSharedFundamental(string, floor);
+            if (pitch == 0)
+            {
+                string.recentFits.resize(0);
+                continue;
+            }
+            if (string.recentFits.size() == SHARED_AVERAGE_FRAMES)
+            {
+                string.recentFits.erase(string.recentFits.begin());
+            }
+            string.recentFits.push_back(pitch);
+            double sum = 0;
+            for (double fit : string.recentFits)
+            {
+                sum += fit;
+            }
+            string.pitch = sum / string.recentFits.size();
+        }
+    }
+}
+
+double StrumPitchDetector::AnalyzeString(const StringInfo &string, double floor) const
+{
+    const IfPitchDetector &spectrum = *ifPitchDetector;
+    double minRatio = std::exp2(-MAX_DEVIATION_CENTS / 1200);
+    double maxRatio = std::exp2(MAX_DEVIATION_CENTS / 1200);
+
+    double weightedSum = 0;
+    double totalWeight = 0;
+    for (size_t i = 0; i < string.partials.size(); ++i)
+    {
+        const Partial &partial = string.partials[i];
+        size_t peakBin = partial.minBin;
+        double peakMagnitude = 0;
+        for (size_t bin = partial.minBin; bin <= partial.maxBin; ++bin)
+        {
+            double magnitude = spectrum.getMagnitude(bin);
+            if (magnitude > peakMagnitude)
+            {
+                peakMagnitude = magnitude;
+                peakBin = bin;
+            }
+        }
+        // must be a real peak, not the skirt of a peak outside the search range.
+        if (peakMagnitude <= floor ||
+            spectrum.getMagnitude(peakBin - 1) > peakMagnitude ||
+            spectrum.getMagnitude(peakBin + 1) > peakMagnitude)
+        {
+            if (i == 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+        double frequency = spectrum.getInstantaneousFrequency(peakBin) / partial.harmonic;
+        if (frequency < string.frequency * minRatio || frequency > string.frequency * maxRatio)
+        {
+            if (i == 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+        double weight = peakMagnitude * peakMagnitude;
+        weightedSum += weight * frequency;
+        totalWeight += weight;
+    }
+    if (totalWeight == 0)
+    {
+        return 0;
+    }
+    return weightedSum / totalWeight;
+}
+
+// Fft of a Window::Hann-windowed complex sinusoid, offset bins away from the sinusoid.
+static IfPitchDetector::complex_t HannKernel(double offset, size_t fftSize)
+{
+    auto geometricSum = [fftSize](double x)
+    {
+        double denominator = std::sin(x / 2);
+        if (std::abs(denominator) < 1E-12)
+        {
+            return IfPitchDetector::complex_t((double)fftSize);
+        }
+        // (the ratio can be negative, which std::polar doesn't allow.)
+        return std::sin(fftSize * x / 2) / denominator * std::polar(1.0, x * (fftSize - 1) / 2);
+    };
+    double x = 2 * Pi * offset / fftSize;
+    double windowStep = 2 * Pi / (fftSize - 1);
+    return 0.5 * geometricSum(x) - 0.25 * geometricSum(x + windowStep) - 0.25 * geometricSum(x - windowStep);
+}
+
+// HannKernel(firstOffset + k, fftSize) for k = 0..count-1. The angles advance by a fixed amount per bin, so they are
+// rotated rather than recomputed.
+static void HannKernels(double firstOffset, size_t count, size_t fftSize, IfPitchDetector::complex_t *kernels)
+{
+    using complex_t = IfPitchDetector::complex_t;
+    double n = (double)fftSize;
+    double windowStep = n / (n - 1); // in bins.
+    const double offsets[3] = {firstOffset, firstOffset + windowStep, firstOffset - windowStep};
+    const double weights[3] = {0.5, -0.25, -0.25};
+    std::fill(kernels, kernels + count, 0.0);
+    complex_t denominatorStep = std::polar(1.0, Pi / n);
+    complex_t phaseStep = std::polar(1.0, Pi * (n - 1) / n);
+    for (size_t term = 0; term < 3; ++term)
+    {
+        // sin(N x/2) / sin(x/2) * exp(i x (N-1)/2), with x = 2 pi offset / N.
+        double numerator = weights[term] * std::sin(Pi * offsets[term]);
+        complex_t denominator = std::polar(1.0, Pi * offsets[term] / n);
+        complex_t phase = std::polar(1.0, Pi * offsets[term] * (n - 1) / n);
+        for (size_t k = 0; k < count; ++k)
+        {
+            double sinHalfX = denominator.imag();
+            if (std::abs(sinHalfX) < 1E-12)
+            {
+                kernels[k] += weights[term] * n;
+            }
+            else
+            {
+                kernels[k] += phase * (numerator / sinHalfX);
+            }
+            numerator = -numerator;
+            denominator *= denominatorStep;
+            phase *= phaseStep;
+        }
+    }
+}
+
+double StrumPitchDetector::FitResidual(size_t firstBin, double position, size_t excluded, IfPitchDetector::complex_t *amplitude) const
+{
+    // Least squares by modified Gram-Schmidt, which stays accurate when the fundamental is a small fraction of a
+    // bin from one of the other partials.
+    size_t n = fitPositions.size();
+    size_t binCount = fitResidual.size();
+    HannKernels((double)firstBin - position, binCount, fftSize, &fitColumns[0]);
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        fitResidual[k] = ifPitchDetector->getBin(firstBin + k);
+    }
+    std::fill(fitR.begin(), fitR.end(), 0.0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        IfPitchDetector::complex_t *column = &fitColumns[i * binCount];
+        double originalNorm = 0;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            originalNorm += std::norm(column[k]);
+        }
+        for (size_t j = 0; j < i; ++j)
+        {
+            const IfPitchDetector::complex_t *q = &fitQ[j * binCount];
+            IfPitchDetector::complex_t dot = 0;
+            for (size_t k = 0; k < binCount; ++k)
+            {
+                dot += std::conj(q[k]) * column[k];
+            }
+            fitR[j * n + i] = dot;
+            for (size_t k = 0; k < binCount; ++k)
+            {
+                fitQ[i * binCount + k] = column[k] - dot * q[k];
+            }
+            column = &fitQ[i * binCount];
+        }
+        IfPitchDetector::complex_t *q = &fitQ[i * binCount];
+        if (column != q)
+        {
+            std::copy(column, column + binCount, q);
+        }
+        double norm = 0;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            norm += std::norm(q[k]);
+        }
+        // a column that duplicates earlier ones (the fundamental exactly on another partial) adds nothing.
+        if (i == excluded || norm <= originalNorm * 1E-20)
+        {
+            std::fill(q, q + binCount, 0.0);
+            continue;
+        }
+        double scale = 1 / std::sqrt(norm);
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            q[k] *= scale;
+        }
+        fitR[i * n + i] = std::sqrt(norm);
+        IfPitchDetector::complex_t dot = 0;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            dot += std::conj(q[k]) * fitResidual[k];
+        }
+        fitCoefficients[i] = dot;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            fitResidual[k] -= dot * q[k];
+        }
+    }
+    if (amplitude)
+    {
+        // back-substitute for the coefficient of each sinusoid.
+        for (size_t i = n; i-- > 0;)
+        {
+            IfPitchDetector::complex_t value = fitR[i * n + i] == 0.0 ? 0.0 : fitCoefficients[i];
+            for (size_t j = i + 1; j < n; ++j)
+            {
+                value -= fitR[i * n + j] * fitCoefficients[j];
+            }
+            fitCoefficients[i] = fitR[i * n + i] == 0.0 ? 0.0 : value / fitR[i * n + i];
+        }
+        *amplitude = fitCoefficients[0];
+    }
+    double result = 0;
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        result += std::norm(fitResidual[k]);
+    }
+    return result;
+}
+
+void StrumPitchDetector::PrepareSearch(size_t firstBin, size_t excluded) const
+{
+    // The other partials don't move during a search, so they are orthonormalized once (into fitQ), and the bins are
+    // reduced to what they leave unexplained (fitSearchResidual). Each position then only projects the fundamental.
+    size_t n = fitPositions.size();
+    size_t binCount = fitResidual.size();
+    fitSearchResidual.resize(binCount);
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        fitSearchResidual[k] = ifPitchDetector->getBin(firstBin + k);
+    }
+    fitSearchBasisSize = 0;
+    for (size_t i = 1; i < n; ++i)
+    {
+        if (i == excluded)
+        {
+            continue;
+        }
+        const IfPitchDetector::complex_t *column = &fitColumns[i * binCount];
+        IfPitchDetector::complex_t *q = &fitQ[fitSearchBasisSize * binCount];
+        std::copy(column, column + binCount, q);
+        double originalNorm = 0;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            originalNorm += std::norm(q[k]);
+        }
+        for (size_t j = 0; j < fitSearchBasisSize; ++j)
+        {
+            ProjectOut(&fitQ[j * binCount], q, binCount);
+        }
+        double norm = 0;
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            norm += std::norm(q[k]);
+        }
+        if (norm <= originalNorm * 1E-20)
+        {
+            continue;
+        }
+        double scale = 1 / std::sqrt(norm);
+        for (size_t k = 0; k < binCount; ++k)
+        {
+            q[k] *= scale;
+        }
+        ProjectOut(q, fitSearchResidual.data(), binCount);
+        ++fitSearchBasisSize;
+    }
+}
+
+// Subtract the component along the unit vector q.
+void StrumPitchDetector::ProjectOut(const IfPitchDetector::complex_t *q, IfPitchDetector::complex_t *vector, size_t size)
+{
+    IfPitchDetector::complex_t dot = 0;
+    for (size_t k = 0; k < size; ++k)
+    {
+        dot += std::conj(q[k]) * vector[k];
+    }
+    for (size_t k = 0; k < size; ++k)
+    {
+        vector[k] -= dot * q[k];
+    }
+}
+
+double StrumPitchDetector::SearchResidual(size_t firstBin, double position) const
+{
+    // The same residual as FitResidual(), given the basis from PrepareSearch().
+    size_t binCount = fitSearchResidual.size();
+    IfPitchDetector::complex_t *column = fitSearchColumn.data();
+    HannKernels((double)firstBin - position, binCount, fftSize, column);
+    double originalNorm = 0;
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        originalNorm += std::norm(column[k]);
+    }
+    for (size_t j = 0; j < fitSearchBasisSize; ++j)
+    {
+        ProjectOut(&fitQ[j * binCount], column, binCount);
+    }
+    double norm = 0;
+    IfPitchDetector::complex_t dot = 0;
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        norm += std::norm(column[k]);
+        dot += std::conj(column[k]) * fitSearchResidual[k];
+    }
+    double result = 0;
+    for (size_t k = 0; k < binCount; ++k)
+    {
+        result += std::norm(fitSearchResidual[k]);
+    }
+    // a fundamental that duplicates the other partials adds nothing.
+    if (norm > originalNorm * 1E-20)
+    {
+        result -= std::norm(dot) / norm;
+    }
+    return std::max(result, 0.0);
+}
+
+double StrumPitchDetector::SearchFundamental(
+    size_t firstBin, double minPosition, double maxPosition, double step, size_t excluded, double *residual) const
+{
+    PrepareSearch(firstBin, excluded);
+    // a grid search over the whole range, then golden-section refinement.
+    double bestPosition = minPosition;
+    double bestResidual = SearchResidual(firstBin, minPosition);
+    for (double position = minPosition + step; position <= maxPosition; position += step)
+    {
+        double value = SearchResidual(firstBin, position);
+        if (value < bestResidual)
+        {
+            bestResidual = value;
+            bestPosition = position;
+        }
+    }
+    // the minimum is outside the range.
+    if (bestPosition - step < minPosition || bestPosition + step > maxPosition)
+    {
+        return 0;
+    }
+    const double GOLDEN = (std::sqrt(5.0) - 1) / 2;
+    double a = bestPosition - step;
+    double b = bestPosition + step;
+    double c = b - GOLDEN * (b - a);
+    double d = a + GOLDEN * (b - a);
+    double residualC = SearchResidual(firstBin, c);
+    double residualD = SearchResidual(firstBin, d);
+    while (b - a > SEARCH_TOLERANCE_BINS)
+    {
+        if (residualC < residualD)
+        {
+            b = d;
+            d = c;
+            residualD = residualC;
+            c = b - GOLDEN * (b - a);
+            residualC = SearchResidual(firstBin, c);
+        }
+        else
+        {
+            a = c;
+            c = d;
+            residualC = residualD;
+            d = a + GOLDEN * (b - a);
+            residualD = SearchResidual(firstBin, d);
+        }
+    }
+    *residual = std::min(residualC, residualD);
+    return (a + b) / 2;
+}
+
+double StrumPitchDetector::FitSharedFundamental(const StringInfo &string, double floor) const
+{
+    // Fit Hann-windowed sinusoids to the bins around the fundamental: the fundamental, at a frequency found by
+    // search, and the partials of the other sounding strings, at the frequencies those strings were measured at.
+    // Partials of other strings can sit within a small fraction of a bin of the fundamental, which is too close
+    // for the instantaneous frequency of a single bin to separate them.
+    const Partial &partial = string.partials[0];
+    double binsPerHz = fftSize / sampleRate;
+    size_t firstBin = partial.minBin > FIT_MARGIN_BINS ? partial.minBin - FIT_MARGIN_BINS : 1;
+    size_t lastBin = std::min(partial.maxBin + FIT_MARGIN_BINS, ifPitchDetector->getBinCount() - 2);
+    size_t binCount = lastBin - firstBin + 1;
+
+    // partials well outside the fitted bins still leak into them through the window's side lobes.
+    constexpr double LEAKAGE_BINS = 16;
+    fitPositions.resize(0);
+    fitPositions.push_back(0); // the fundamental.
+    for (const auto &other : strings)
+    {
+        if (&other == &string || other.pitch == 0)
+        {
+            continue;
+        }
+        for (size_t harmonic = 1; other.pitch * harmonic * binsPerHz < lastBin + LEAKAGE_BINS; ++harmonic)
+        {
+            double position = other.pitch * harmonic * binsPerHz;
+            if (position > firstBin - LEAKAGE_BINS)
+            {
+                fitPositions.push_back(position);
+            }
+        }
+    }
+    size_t n = fitPositions.size();
+    if (n > binCount)
+    {
+        return 0;
+    }
+    fitColumns.resize(n * binCount);
+    fitQ.resize(n * binCount);
+    fitR.resize(n * n);
+    fitCoefficients.resize(n);
+    fitResidual.resize(binCount);
+    fitSearchColumn.resize(binCount);
+    for (size_t i = 1; i < n; ++i)
+    {
+        HannKernels((double)firstBin - fitPositions[i], binCount, fftSize, &fitColumns[i * binCount]);
+    }
+
+    double minPosition = string.frequency * std::exp2(-MAX_DEVIATION_CENTS / 1200) * binsPerHz;
+    double maxPosition = string.frequency * std::exp2(MAX_DEVIATION_CENTS / 1200) * binsPerHz;
+    double residual;
+    // A sounding string moves little from one frame to the next, so the search follows the last fit. A fundamental
+    // that has moved further is found in the next frame, since a failed fit clears recentFits.
+    double searchMin = minPosition;
+    double searchMax = maxPosition;
+    if (!string.recentFits.empty())
+    {
+        double lastPosition = string.recentFits.back() * binsPerHz;
+        searchMin = std::max(minPosition, lastPosition - TRACKING_RANGE_BINS);
+        searchMax = std::min(maxPosition, lastPosition + TRACKING_RANGE_BINS);
+    }
+    double position = SearchFundamental(firstBin, searchMin, searchMax, GRID_STEP, n, &residual);
+    // A fundamental that is practically on another partial fits the bins about as well anywhere close by (or, if
+    // the other partial explains the bins on its own, anywhere at all): small errors in the other strings' pitches
+    // are better fitted by a second sinusoid with a large amplitude than by the fundamental in its place. If a
+    // single sinusoid in place of both fits about as well, or a separate fundamental can't be found, read that
+    // instead; it reads between the two. When that could be any of several partials, the fundamental is taken to be
+    // the strongest.
+    size_t excluded = n;
+    double freePosition = position;
+    IfPitchDetector::complex_t amplitude = 0;
+    if (position != 0)
+    {
+        FitResidual(firstBin, position, n, &amplitude);
+    }
+    double freeMagnitude = std::abs(amplitude * HannKernel(0, fftSize)) * ifPitchDetector->getMagnitudeScale();
+    bool freeFound = freeMagnitude > floor;
+    double maxAmplitude = 0;
+    for (size_t i = 1; i < n; ++i)
+    {
+        if (fitPositions[i] < minPosition || fitPositions[i] > maxPosition)
+        {
+            continue;
+        }
+        double mergedResidual;
+        double mergedPosition = SearchFundamental(
+            firstBin, fitPositions[i] - MERGE_SEARCH_BINS, fitPositions[i] + MERGE_SEARCH_BINS, GRID_STEP, i, &mergedResidual);
+        if (mergedPosition == 0 ||
+            (freeFound && std::abs(fitPositions[i] - freePosition) >= MERGE_RANGE_BINS &&
+             mergedResidual >= residual * MERGE_RESIDUAL_RATIO))
+        {
+            continue;
+        }
+        IfPitchDetector::complex_t mergedAmplitude;
+        FitResidual(firstBin, mergedPosition, i, &mergedAmplitude);
+        if (std::abs(mergedAmplitude) > maxAmplitude)
+        {
+            maxAmplitude = std::abs(mergedAmplitude);
+            position = mergedPosition;
+            excluded = i;
+        }
+    }
+    if (position == 0)
+    {
+        return 0;
+    }
+    FitResidual(firstBin, position, excluded, &amplitude);
+
+    // The fundamental itself must be present, not just the partials that collide with it. Sinusoids less than half
+    // a bin apart can't be told apart reliably, though, so those count together.
+    for (size_t i = 1; i < n; ++i)
+    {
+        if (i != excluded && std::abs(fitPositions[i] - position) < 0.5)
+        {
+            amplitude += fitCoefficients[i];
+        }
+    }
+    double magnitude = std::abs(amplitude * HannKernel(0, fftSize)) * ifPitchDetector->getMagnitudeScale();
+    if (magnitude <= floor)
+    {
+        return 0;
+    }
+    return position / binsPerHz;
+}
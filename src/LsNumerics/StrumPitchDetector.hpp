@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "IfPitchDetector.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace LsNumerics
+{
+    /// @brief Estimates the pitches of several strings sounding at once (a strum), from one FFT per hop.
+    ///
+    /// Each string has a harmonic template: the partials (up to MAX_TEMPLATE_HARMONIC) of its expected frequency
+    /// that don't collide with partials (below maxFrequency) of the other strings. For each template partial, the strongest bin
+    /// within MAX_DEVIATION_CENTS of the expected frequency is refined with IfPitchDetector's instantaneous
+    /// frequency, and the string's pitch is the power-weighted mean of partial frequency / harmonic number.
+    /// A string is only reported if the lowest partial of its template is present, since
+    /// higher partials may be higher harmonics of lower strings; otherwise its pitch is zero.
+    ///
+    /// If every partial of a string is shared (on a guitar, B and high E, whose fundamentals are the 3rd and 4th
+    /// harmonics of low E), its template is just the fundamental. The fundamental is found by a least-squares fit of
+    /// Hann-windowed sinusoids to the bins around it, with the nearby partials of the other strings at the frequencies
+    /// measured from those strings' own templates, and averaged over SHARED_AVERAGE_FRAMES frames. A fundamental within
+    /// a few hundredths of a bin of another partial can't be separated from it, and reads between the two.
+    ///
+    /// Strings must be within MAX_DEVIATION_CENTS of their expected pitch to be detected, so this is for
+    /// fine-tuning an instrument that is roughly in tune.
+    ///
+    /// NOT suitable for use on a realtime thread.
+    class StrumPitchDetector
+    {
+    public:
+        static constexpr size_t MAX_TEMPLATE_HARMONIC = 4;
+        static constexpr double MAX_DEVIATION_CENTS = 50;
+        // partials more than this far below the strongest template partial are ignored.
+        static constexpr double RELATIVE_FLOOR_DB = -30;
+
+        /// @brief Allocate buffers.
+        /// @param sampleRate Sample rate of the input.
+        /// @param fftSize Analysis window size. Must be a power of 2.
+        /// @param hopSize Samples between analyses. At most fftSize/4.
+        /// @param maxFrequency Partials above this frequency (e.g. the cutoff of an anti-aliasing filter) are not used.
+        void Initialize(double sampleRate, size_t fftSize, size_t hopSize, double maxFrequency);
+
+        /// @brief Set the expected frequencies of the strings, and rebuild the harmonic templates.
+        void SetStringFrequencies(const std::vector<double> &frequencies);
+        size_t GetStringCount() const { return strings.size(); }
+
+        /// @brief Minimum amplitude of the strongest template partial for which pitches are reported.
+        void SetThreshold(float threshold) { this->threshold = threshold; }
+
+        /// @brief Clear the sample history.
+        void Reset();
+
+        /// @brief Append input samples, analyzing every hopSize samples.
+        /// @returns true if at least one frame was analyzed.
+        bool AddSamples(const float *samples, size_t count);
+
+        /// @brief Analyze a precomputed frame (see IfPitchDetector::setFrame) taken hopSize samples after the
+        /// previous one, instead of adding samples. Call Reset() first if it doesn't follow on from the previous frame.
+        void AddSpectrum(const IfPitchDetector::buffer_t &spectrum);
+
+        size_t GetFftSize() const { return fftSize; }
+        size_t GetHopSize() const { return hopSize; }
+
+        /// @brief The pitch of a string, in Hz, as of the last analyzed frame; zero if it isn't sounding.
+        double GetStringPitch(size_t string) const { return strings[string].pitch; }
+
+    private:
+        struct Partial
+        {
+            size_t harmonic;
+            size_t minBin;
+            size_t maxBin;
+        };
+        struct StringInfo
+        {
+            double frequency = 0;
+            std::vector<Partial> partials;
+            bool sharedFundamental = false;
+            std::vector<double> recentFits; // of a shared fundamental.
+            double pitch = 0;
+        };
+
+        double sampleRate = 0;
+        size_t fftSize = 0;
+        size_t hopSize = 0;
+        double maxFrequency = 0;
+        float threshold = 0;
+
+        std::unique_ptr<IfPitchDetector> ifPitchDetector;
+
+        // doubled, so that the analysis frame is always contiguous.
+        std::vector<float> history;
+        size_t historyIndex = 0;
+        size_t samplesSinceFrame = 0;
+        size_t framesAnalyzed = 0;
+
+        std::vector<StringInfo> strings;
+
+        void AnalyzeFrame();
+        void AnalyzeSpectrum(bool hasPreviousFrame);
+        double AnalyzeString(const StringInfo &string, double floor) const;
+        double FitSharedFundamental(const StringInfo &string, double floor) const;
+        double SearchFundamental(
+            size_t firstBin, double minPosition, double maxPosition, double step, size_t excluded, double *residual) const;
+        double FitResidual(size_t firstBin, double position, size_t excluded, IfPitchDetector::complex_t *amplitude) const;
+        void PrepareSearch(size_t firstBin, size_t excluded) const;
+        double SearchResidual(size_t firstBin, double position) const;
+        static void ProjectOut(const IfPitchDetector::complex_t *q, IfPitchDetector::complex_t *vector, size_t size);
+        bool CollidesWithOtherStrings(size_t string, double frequency) const;
+
+        // Shared fundamentals (all in bins): the bins fitted on either side of the search range, and the search step.
+        static constexpr size_t FIT_MARGIN_BINS = 8;
+        static constexpr double GRID_STEP = 0.05;
+        // about 0.02 cents for B, which is well inside what noise allows.
+        static constexpr double SEARCH_TOLERANCE_BINS = 1E-3;
+        // While a string has recent fits, the search covers this far either side of the last one.
+        static constexpr double TRACKING_RANGE_BINS = 0.5;
+        // A shared fundamental found closer than MERGE_RANGE_BINS to another partial, or that fits the bins less
+        // than MERGE_RESIDUAL_RATIO better than a single sinusoid within MERGE_SEARCH_BINS of the other partial,
+        // is read from the single sinusoid.
+        static constexpr double MERGE_RANGE_BINS = 0.05;
+        static constexpr double MERGE_SEARCH_BINS = 0.2;
+        static constexpr double MERGE_RESIDUAL_RATIO = 1.5;
+        static constexpr size_t SHARED_AVERAGE_FRAMES = 4;
+        // FitSharedFundamental's sinusoid positions (in bins; the fundamental first) and work buffers.
+        mutable std::vector<double> fitPositions;
+        mutable std::vector<IfPitchDetector::complex_t> fitColumns;
+        mutable std::vector<IfPitchDetector::complex_t> fitQ;
+        mutable std::vector<IfPitchDetector::complex_t> fitR;
+        mutable std::vector<IfPitchDetector::complex_t> fitCoefficients;
+        mutable std::vector<IfPitchDetector::complex_t> fitResidual;
+        // SearchFundamental's: the bins less the fixed partials, and the fundamental's column.
+        mutable std::vector<IfPitchDetector::complex_t> fitSearchResidual;
+        mutable std::vector<IfPitchDetector::complex_t> fitSearchColumn;
+        mutable size_t fitSearchBasisSize = 0;
+    };
+}
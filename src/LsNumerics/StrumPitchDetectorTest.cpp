@@ -0,0 +1,316 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "StrumPitchDetector.hpp"
+#include "Fft.hpp"
+#include "Window.hpp"
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+// ToobTuner's strum-mode analysis settings.
+static constexpr size_t FFT_SIZE = 4096;
+static constexpr size_t HOP_SIZE = FFT_SIZE / 4;
+static constexpr double MAX_FREQUENCY = 1200;
+
+static const std::vector<double> STANDARD_TUNING{82.41, 110.0, 146.83, 196.0, 246.94, 329.63};
+// Every partial of B and high E is shared with a harmonic of a lower string (within a few cents, when in tune). Their
+// fundamentals are separated from those harmonics by fitting, which noise limits when they are within a few cents.
+static constexpr size_t FIRST_SHARED_STRING = 4;
+
+static double Cents(double frequency, double expected)
+{
+    return 1200 * std::log2(frequency / expected);
+}
+
+// Strummed strings: 1/n harmonics for each sounding string, with a little noise. Like ToobTuner's input, there
+// is nothing above 1200Hz.
+class StrumTone
+{
+public:
+    StrumTone(double sampleRate, const std::vector<double> &frequencies, double noiseLevel)
+        : sampleRate(sampleRate), frequencies(frequencies), phases(frequencies.size()), noiseLevel(noiseLevel),
+          noise(0, noiseLevel > 0 ? noiseLevel : 1) // (a standard deviation of zero is invalid.)
+    {
+    }
+    float Next()
+    {
+        double value = 0;
+        for (size_t i = 0; i < frequencies.size(); ++i)
+        {
+            double frequency = frequencies[i];
+            if (frequency == 0)
+            {
+                continue;
+            }
+            for (int harmonic = 1; harmonic <= 8 && harmonic * frequency < 1200; ++harmonic)
+            {
+                value += std::sin(phases[i] * harmonic + harmonic + i) / harmonic;
+            }
+            phases[i] += 2 * M_PI * frequency / sampleRate;
+        }
+        return (float)(0.05 * value + (noiseLevel > 0 ? noise(random) : 0.0));
+    }
+    void Feed(StrumPitchDetector &detector, size_t samples)
+    {
+        std::vector<float> buffer(samples);
+        for (auto &value : buffer)
+        {
+            value = Next();
+        }
+        detector.AddSamples(buffer.data(), buffer.size());
+    }
+
+private:
+    double sampleRate;
+    std::vector<double> frequencies;
+    std::vector<double> phases;
+    double noiseLevel;
+    std::mt19937 random{1234};
+    std::normal_distribution<double> noise;
+};
+
+static void TestAccuracy(double sampleRate, double noiseLevel, double maxDetuneCents, double maxCents, double maxSharedCents)
+{
+    StrumPitchDetector detector;
+    detector.Initialize(sampleRate, FFT_SIZE, HOP_SIZE, MAX_FREQUENCY);
+    detector.SetStringFrequencies(STANDARD_TUNING);
+
+    std::mt19937 random(5678);
+    std::uniform_real_distribution<double> detune(-maxDetuneCents, maxDetuneCents);
+
+    double worstCents = 0;
+    double worstSharedCents = 0;
+    for (int strum = 0; strum < 50; ++strum)
+    {
+        std::vector<double> frequencies;
+        for (double frequency : STANDARD_TUNING)
+        {
+            frequencies.push_back(frequency * std::exp2(detune(random) / 1200));
+        }
+        StrumTone tone(sampleRate, frequencies, noiseLevel);
+        detector.Reset();
+        tone.Feed(detector, FFT_SIZE + HOP_SIZE);
+        for (int i = 0; i < 10; ++i)
+        {
+            tone.Feed(detector, HOP_SIZE);
+            for (size_t string = 0; string < frequencies.size(); ++string)
+            {
+                double pitch = detector.GetStringPitch(string);
+                if (pitch == 0) cout << "FAIL " << string << " " << frequencies[string] << " " << frequencies[0] << " " << frequencies[1] << endl;
+                TEST_ASSERT(pitch != 0);
+                double cents = std::abs(Cents(pitch, frequencies[string]));
+                if (string >= FIRST_SHARED_STRING)
+                {
+                    worstSharedCents = std::max(worstSharedCents, cents);
+                }
+                else
+                {
+                    worstCents = std::max(worstCents, cents);
+                }
+            }
+        }
+    }
+    cout << "    " << (int)sampleRate << "Hz, noise " << std::fixed << std::setprecision(3) << noiseLevel
+         << ", detune +/-" << std::setprecision(0) << maxDetuneCents << " cents: worst error " << std::setprecision(3) << worstCents
+         << " cents (B and high E: " << worstSharedCents << " cents)" << endl;
+    TEST_ASSERT(worstCents < maxCents);
+    TEST_ASSERT(worstSharedCents < maxSharedCents);
+}
+
+static void TestMutedStrings(double sampleRate)
+{
+    StrumPitchDetector detector;
+    detector.Initialize(sampleRate, FFT_SIZE, HOP_SIZE, MAX_FREQUENCY);
+    detector.SetStringFrequencies(STANDARD_TUNING);
+
+    // silence.
+    TEST_ASSERT(detector.GetStringPitch(0) == 0);
+
+    // D and G muted.
+    std::vector<double> frequencies = STANDARD_TUNING;
+    frequencies[2] = 0;
+    frequencies[3] = 0;
+    StrumTone tone(sampleRate, frequencies, 0.001);
+    tone.Feed(detector, FFT_SIZE * 4);
+    for (size_t string = 0; string < frequencies.size(); ++string)
+    {
+        double pitch = detector.GetStringPitch(string);
+        if (frequencies[string] == 0)
+        {
+            TEST_ASSERT(pitch == 0);
+        }
+        else
+        {
+            TEST_ASSERT(std::abs(Cents(pitch, frequencies[string])) < 2);
+        }
+    }
+
+    // below the threshold.
+    detector.SetThreshold(0.5f);
+    tone.Feed(detector, FFT_SIZE);
+    for (size_t string = 0; string < frequencies.size(); ++string)
+    {
+        TEST_ASSERT(detector.GetStringPitch(string) == 0);
+    }
+}
+
+// Precomputed frames (ToobTuner gets them from the analysis bus) give the same results as samples.
+static void TestSpectra(double sampleRate)
+{
+    StrumPitchDetector sampleDetector, spectrumDetector;
+    for (StrumPitchDetector *detector : {&sampleDetector, &spectrumDetector})
+    {
+        detector->Initialize(sampleRate, FFT_SIZE, HOP_SIZE, MAX_FREQUENCY);
+        detector->SetStringFrequencies(STANDARD_TUNING);
+    }
+    StrumTone tone(sampleRate, STANDARD_TUNING, 0.001);
+    std::vector<float> buffer(FFT_SIZE * 4);
+    for (auto &value : buffer)
+    {
+        value = tone.Next();
+    }
+    sampleDetector.AddSamples(buffer.data(), FFT_SIZE - HOP_SIZE);
+
+    Fft fft(FFT_SIZE);
+    std::vector<double> window = Window::Hann<double>(FFT_SIZE);
+    IfPitchDetector::buffer_t frame(FFT_SIZE);
+    for (size_t start = 0; start + FFT_SIZE <= buffer.size(); start += HOP_SIZE)
+    {
+        sampleDetector.AddSamples(buffer.data() + start + FFT_SIZE - HOP_SIZE, HOP_SIZE);
+        for (size_t i = 0; i < FFT_SIZE; ++i)
+        {
+            frame[i] = buffer[start + i] * window[i];
+        }
+        fft.Forward(frame, frame);
+        spectrumDetector.AddSpectrum(frame);
+        if (start != 0)
+        {
+            for (size_t string = 0; string < STANDARD_TUNING.size(); ++string)
+            {
+                double pitch = spectrumDetector.GetStringPitch(string);
+                TEST_ASSERT(pitch != 0);
+                TEST_ASSERT(std::abs(pitch - sampleDetector.GetStringPitch(string)) < 1E-6);
+            }
+        }
+    }
+}
+
+// The shared fundamentals track their last fit, so a string that jumps further than that between frames must be
+// picked up again once the fit has failed.
+static void TestPitchChange(double sampleRate)
+{
+    StrumPitchDetector detector;
+    detector.Initialize(sampleRate, FFT_SIZE, HOP_SIZE, MAX_FREQUENCY);
+    detector.SetStringFrequencies(STANDARD_TUNING);
+
+    StrumTone tone(sampleRate, STANDARD_TUNING, 0.0);
+    tone.Feed(detector, FFT_SIZE * 3);
+    std::vector<double> frequencies = STANDARD_TUNING;
+    for (size_t string = FIRST_SHARED_STRING; string < frequencies.size(); ++string)
+    {
+        frequencies[string] *= std::exp2(25.0 / 1200);
+    }
+    StrumTone retuned(sampleRate, frequencies, 0.0);
+    // a full frame of the new pitches, and then enough frames to fill the average.
+    retuned.Feed(detector, FFT_SIZE + HOP_SIZE * 8);
+    for (size_t string = 0; string < frequencies.size(); ++string)
+    {
+        double pitch = detector.GetStringPitch(string);
+        TEST_ASSERT(pitch != 0);
+        TEST_ASSERT(std::abs(Cents(pitch, frequencies[string])) < 1.0);
+    }
+}
+
+// ToobTuner's worker thread budget for strum mode.
+static constexpr double MAX_COST_PERCENT = 0.7;
+
+static void TestCost(double sampleRate)
+{
+    StrumPitchDetector detector;
+    detector.Initialize(sampleRate, FFT_SIZE, HOP_SIZE, MAX_FREQUENCY);
+    detector.SetStringFrequencies(STANDARD_TUNING);
+    StrumTone tone(sampleRate, STANDARD_TUNING, 0.001);
+
+    constexpr int ITERATIONS = 500;
+    std::vector<float> buffer(HOP_SIZE * ITERATIONS);
+    for (auto &value : buffer)
+    {
+        value = tone.Next();
+    }
+    // the best of a few runs, so that a busy machine doesn't fail the test.
+    double seconds = std::numeric_limits<double>::max();
+    double sum = 0;
+    for (int run = 0; run < 3; ++run)
+    {
+        detector.Reset();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i)
+        {
+            detector.AddSamples(buffer.data() + i * HOP_SIZE, HOP_SIZE);
+            sum += detector.GetStringPitch(FIRST_SHARED_STRING);
+        }
+        seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    double percent = seconds / (ITERATIONS * HOP_SIZE / sampleRate) * 100;
+    cout << "    " << std::fixed << std::setprecision(1) << seconds / ITERATIONS * 1E6 << " us per hop ("
+         << percent << "% of one core)" << endl;
+    TEST_ASSERT(sum != 0);
+#ifdef NDEBUG
+    // (debug builds are unoptimized.)
+    TEST_ASSERT(percent < MAX_COST_PERCENT);
+#endif
+}
+
+int main(int, char **)
+{
+    try
+    {
+        for (double sampleRate : {11025.0, 12000.0})
+        {
+            cout << "Accuracy" << endl;
+            TestAccuracy(sampleRate, 0.0, 5, 1.0, 0.6);
+            TestAccuracy(sampleRate, 0.0, 30, 1.0, 0.6);
+            TestAccuracy(sampleRate, 0.01, 30, 1.0, 2.0);
+            TestMutedStrings(sampleRate);
+            TestSpectra(sampleRate);
+            TestPitchChange(sampleRate);
+            cout << "Cost" << endl;
+            TestCost(sampleRate);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "YinPitchTracker.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace LsNumerics;
+
+void YinPitchTracker::Initialize(double sampleRate, double minFrequency, double maxFrequency, double windowSeconds)
+{
+    if (minFrequency <= 0 || maxFrequency <= minFrequency || maxFrequency >= sampleRate / 4)
+    {
+        throw std::invalid_argument("YinPitchTracker: invalid frequency range.");
+    }
+    this->sampleRate = sampleRate;
+    this->minLag = std::max((size_t)2, (size_t)std::floor(sampleRate / maxFrequency));
+    this->maxLag = (size_t)std::ceil(sampleRate / minFrequency);
+    this->windowSize = std::max((size_t)1, (size_t)std::round(windowSeconds * sampleRate));
+
+    // one extra lag for interpolation.
+    this->historySize = std::max(windowSize, LagWindowSize(maxLag + 1)) + maxLag + 1;
+    history.resize(historySize * 2);
+    difference.resize(maxLag + 2);
+    Reset();
+}
+
+void YinPitchTracker::Reset()
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyIndex = 0;
+    confidence = 0;
+}
+
+void YinPitchTracker::AddSamples(const float *samples, size_t count)
+{
+    if (count > historySize)
+    {
+        samples += count - historySize;
+        count = historySize;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        float value = samples[i];
+        history[historyIndex] = value;
+        history[historyIndex + historySize] = value;
+        if (++historyIndex == historySize)
+        {
+            historyIndex = 0;
+        }
+    }
+}
+
+float YinPitchTracker::GetPeakLevel() const
+{
+    const float *x = history.data() + historyIndex;
+    float peak = 0;
+    for (size_t i = 0; i < historySize; ++i)
+    {
+        peak = std::max(peak, std::abs(x[i]));
+    }
+    return peak;
+}
+
+// Long lags are compared over at least 1.25 periods. Windows shorter than that allow spurious
+// dips below the threshold at lags just short of the period of low notes that are rich in harmonics.
+size_t YinPitchTracker::LagWindowSize(size_t lag) const
+{
+    return std::max(windowSize, lag + lag / 4);
+}
+
+// Mean squared difference between the most recent samples and the samples one lag earlier.
+double YinPitchTracker::Difference(size_t lag) const
+{
+    size_t windowSize = LagWindowSize(lag);
+    const float *y = history.data() + historyIndex + historySize - windowSize;
+    const float *x = y - lag;
+
+    // four partial sums so that the loop vectorizes.
+    float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= windowSize; i += 4)
+    {
+        float d0 = x[i] - y[i];
+        float d1 = x[i + 1] - y[i + 1];
+        float d2 = x[i + 2] - y[i + 2];
+        float d3 = x[i + 3] - y[i + 3];
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; i < windowSize; ++i)
+    {
+        float d = x[i] - y[i];
+        sum0 += d * d;
+    }
+    return ((double)sum0 + sum1 + sum2 + sum3) / windowSize;
+}
+
+double YinPitchTracker::DetectPitch()
+{
+    difference[0] = 0;
+    double runningSum = 0;
+    double minNormalized = 1;
+    size_t candidate = 0;
+    double candidateNormalized = 1;
+
+    for (size_t lag = 1; lag <= maxLag + 1; ++lag)
+    {
+        double d = Difference(lag);
+        difference[lag] = d;
+        runningSum += d;
+        double normalized = runningSum > 0 ? d * lag / runningSum : 1;
+
+        if (candidate != 0)
+        {
+            if (normalized >= candidateNormalized || lag > maxLag)
+            {
+                break; // past the bottom of the first dip: we have the neighbours we need.
+            }
+            candidate = lag;
+            candidateNormalized = normalized;
+        }
+        else if (lag >= minLag && lag <= maxLag)
+        {
+            if (normalized < threshold)
+            {
+                candidate = lag;
+                candidateNormalized = normalized;
+            }
+            minNormalized = std::min(minNormalized, normalized);
+        }
+    }
+
+    if (candidate == 0)
+    {
+        confidence = 1 - minNormalized;
+        return 0;
+    }
+    confidence = 1 - candidateNormalized;
+
+    // parabolic interpolation on the raw difference function, which is quadratic near the minimum.
+    double d0 = difference[candidate - 1];
+    double d1 = difference[candidate];
+    double d2 = difference[candidate + 1];
+    double period = (double)candidate;
+    double denominator = d0 - 2 * d1 + d2;
+    if (denominator > 0)
+    {
+        period += std::clamp(0.5 * (d0 - d2) / denominator, -1.0, 1.0);
+    }
+    return sampleRate / period;
+}
@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace LsNumerics
+{
+    /// @brief Streaming pitch tracker for monophonic input, using the YIN difference function.
+    ///
+    /// Audio is pushed in arbitrary-sized hops with AddSamples(). DetectPitch() compares the most recent
+    /// samples with the samples one candidate period earlier, so calling it after every hop gives overlapped
+    /// analysis without re-copying old audio, and a pitch is available max(window, 1.25 * period) + period after a note starts.
+    ///
+    /// The cumulative-mean-normalized difference function is evaluated from the shortest lag upwards,
+    /// and evaluation stops at the first dip below the confidence threshold, so high notes
+    /// cost a fraction of low ones. Long lags are compared over more than one period, regardless of the window size.
+    ///
+    /// Works best at sample rates around 11-12kHz for guitar; the input must be lowpass filtered
+    /// below Nyquist.
+    ///
+    /// NOT suitable for use on a realtime thread.
+    class YinPitchTracker
+    {
+    public:
+        /// @brief Allocate buffers.
+        /// @param sampleRate Sample rate of the input.
+        /// @param minFrequency Lowest detectable frequency.
+        /// @param maxFrequency Highest detectable frequency.
+        /// @param windowSeconds Length of the integration window. Shorter windows respond faster, but are less
+        /// noise-tolerant.
+        void Initialize(double sampleRate, double minFrequency, double maxFrequency, double windowSeconds);
+
+        /// @brief Clear the sample history.
+        void Reset();
+
+        /// @brief Maximum value of the normalized difference function that is accepted as a pitch (default 0.15).
+        void SetThreshold(double threshold) { this->threshold = threshold; }
+        double GetThreshold() const { return threshold; }
+
+        /// @brief Append input samples.
+        void AddSamples(const float *samples, size_t count);
+
+        /// @brief Number of samples that DetectPitch() analyzes.
+        size_t GetHistorySize() const { return historySize; }
+
+        /// @brief Peak absolute sample value over the analyzed history.
+        float GetPeakLevel() const;
+
+        /// @brief Detect the pitch of the most recent GetHistorySize() samples.
+        /// @returns The frequency in Hz, or zero if there is no confident pitch.
+        double DetectPitch();
+
+        /// @brief 1 - the normalized difference at the detected period, of the last DetectPitch() call.
+        ///
+        /// Close to 1 for clean periodic signals.
+        double GetConfidence() const { return confidence; }
+
+    private:
+        double sampleRate = 0;
+        size_t windowSize = 0;
+        size_t minLag = 0;
+        size_t maxLag = 0;
+        size_t historySize = 0;
+        double threshold = 0.15;
+        double confidence = 0;
+
+        // doubled, so that the analysis window is always contiguous.
+        std::vector<float> history;
+        size_t historyIndex = 0;
+
+        std::vector<double> difference;
+
+        size_t LagWindowSize(size_t lag) const;
+        double Difference(size_t lag) const;
+    };
+}
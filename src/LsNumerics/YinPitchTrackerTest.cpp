@@ -0,0 +1,214 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "YinPitchTracker.hpp"
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include "../TestAssert.hpp"
+
+using namespace LsNumerics;
+using namespace std;
+
+// ToobTuner's analysis settings.
+static constexpr double MIN_FREQUENCY = 40;
+static constexpr double MAX_FREQUENCY = 1200;
+static constexpr double WINDOW_SECONDS = 0.012;
+static constexpr double HOP_SECONDS = 0.004;
+
+// Plucked-string-like test tone: 1/n harmonics, with a little noise. Like ToobTuner's input, there
+// is nothing above 1200Hz.
+class TestTone
+{
+public:
+    TestTone(double sampleRate, double frequency, double noiseLevel)
+        : sampleRate(sampleRate), frequency(frequency), noise(0, noiseLevel)
+    {
+    }
+    float Next()
+    {
+        double value = 0;
+        for (int harmonic = 1; harmonic <= 8 && harmonic * frequency < 1200; ++harmonic)
+        {
+            value += std::sin(phase * harmonic + harmonic) / harmonic;
+        }
+        phase += 2 * M_PI * frequency / sampleRate;
+        return (float)(0.25 * value + noise(random));
+    }
+
+private:
+    double sampleRate;
+    double frequency;
+    double phase = 0;
+    std::mt19937 random{1234};
+    std::normal_distribution<double> noise;
+};
+
+static double Cents(double frequency, double expected)
+{
+    return 1200 * std::log2(frequency / expected);
+}
+
+static void Feed(YinPitchTracker &tracker, TestTone &tone, size_t samples)
+{
+    std::vector<float> buffer(samples);
+    for (auto &value : buffer)
+    {
+        value = tone.Next();
+    }
+    tracker.AddSamples(buffer.data(), buffer.size());
+}
+
+static void TestAccuracy(double sampleRate, double noiseLevel, double maxCents)
+{
+    YinPitchTracker tracker;
+    tracker.Initialize(sampleRate, MIN_FREQUENCY, MAX_FREQUENCY, WINDOW_SECONDS);
+    size_t hop = (size_t)(sampleRate * HOP_SECONDS);
+
+    double worstCents = 0;
+    for (double midiNote = 28; midiNote <= 81; midiNote += 0.37) // low E (drop-D) to high E, 17th fret.
+    {
+        double frequency = 440 * std::pow(2.0, (midiNote - 69) / 12);
+        TestTone tone(sampleRate, frequency, noiseLevel);
+        tracker.Reset();
+        Feed(tracker, tone, tracker.GetHistorySize());
+        for (int i = 0; i < 20; ++i)
+        {
+            Feed(tracker, tone, hop);
+            double pitch = tracker.DetectPitch();
+            TEST_ASSERT(pitch != 0);
+            worstCents = std::max(worstCents, std::abs(Cents(pitch, frequency)));
+        }
+    }
+    cout << "    " << (int)sampleRate << "Hz, noise " << std::fixed << std::setprecision(3) << noiseLevel
+         << ": worst error " << worstCents << " cents" << endl;
+    TEST_ASSERT(worstCents < maxCents);
+}
+
+// Time from the start of a note to the first reading within 2 cents, with analysis every hop.
+static void TestLatency(double sampleRate)
+{
+    YinPitchTracker tracker;
+    tracker.Initialize(sampleRate, MIN_FREQUENCY, MAX_FREQUENCY, WINDOW_SECONDS);
+    size_t hop = (size_t)(sampleRate * HOP_SECONDS);
+
+    for (double frequency : {82.41, 110.0, 146.83, 196.0, 246.94, 329.63})
+    {
+        TestTone tone(sampleRate, frequency, 0.001);
+        tracker.Reset();
+        size_t samples = 0;
+        while (true)
+        {
+            Feed(tracker, tone, hop);
+            samples += hop;
+            double pitch = tracker.DetectPitch();
+            if (pitch != 0 && std::abs(Cents(pitch, frequency)) < 2)
+            {
+                break;
+            }
+            TEST_ASSERT(samples < sampleRate);
+        }
+        double latencyMs = samples * 1000 / sampleRate;
+        cout << "    " << std::fixed << std::setprecision(2) << frequency << "Hz: " << std::setprecision(1) << latencyMs << " ms" << endl;
+        TEST_ASSERT(latencyMs < 30);
+    }
+}
+
+static void TestNoPitch(double sampleRate)
+{
+    YinPitchTracker tracker;
+    tracker.Initialize(sampleRate, MIN_FREQUENCY, MAX_FREQUENCY, WINDOW_SECONDS);
+
+    // silence.
+    TEST_ASSERT(tracker.DetectPitch() == 0);
+    TEST_ASSERT(tracker.GetPeakLevel() == 0);
+
+    // white noise.
+    std::mt19937 random{5678};
+    std::normal_distribution<float> noise(0, 0.1f);
+    std::vector<float> buffer(tracker.GetHistorySize());
+    size_t detections = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        for (auto &value : buffer)
+        {
+            value = noise(random);
+        }
+        tracker.AddSamples(buffer.data(), buffer.size());
+        if (tracker.DetectPitch() != 0)
+        {
+            ++detections;
+        }
+    }
+    TEST_ASSERT(detections < 5);
+}
+
+static void ReportCost(double sampleRate)
+{
+    YinPitchTracker tracker;
+    tracker.Initialize(sampleRate, MIN_FREQUENCY, MAX_FREQUENCY, WINDOW_SECONDS);
+    size_t hop = (size_t)(sampleRate * HOP_SECONDS);
+    TestTone tone(sampleRate, 82.41, 0.001);
+    Feed(tracker, tone, tracker.GetHistorySize());
+
+    constexpr int ITERATIONS = 2000;
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        Feed(tracker, tone, hop);
+        sum += tracker.DetectPitch();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cout << "    low E: " << std::fixed << std::setprecision(1) << seconds / ITERATIONS * 1E6 << " us per hop ("
+         << seconds / (ITERATIONS * HOP_SECONDS) * 100 << "% of one core)" << endl;
+    TEST_ASSERT(sum != 0);
+}
+
+int main(int, char **)
+{
+    try
+    {
+        for (double sampleRate : {11025.0, 12000.0})
+        {
+            cout << "Accuracy" << endl;
+            TestAccuracy(sampleRate, 0.0, 1.5);
+            TestAccuracy(sampleRate, 0.01, 4.0);
+            cout << "Latency" << endl;
+            TestLatency(sampleRate);
+            TestNoPitch(sampleRate);
+            cout << "Cost" << endl;
+            ReportCost(sampleRate);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -60,6 +60,7 @@ SOFTWARE.
 
 #include "Eigen/Eigen"
 #include "NeuralAmpModelerCore/NAM/activations.h"
+#include "NeuralAmpModelerCore/NAM/lstm.h"
 #include "nam_architecture.hpp"
 
 #include "namFixes/dsp_ex.h"
@@ -131,8 +132,9 @@ private:
 class NamLoadMessage : public NamMessage
 {
 protected:
-    NamLoadMessage(NamMessageType messageType, const char *modelFileName)
-        : NamMessage(messageType)
+    NamLoadMessage(NamMessageType messageType, size_t modelIndex, const char *modelFileName)
+        : NamMessage(messageType),
+          modelIndex(modelIndex)
     {
         SetFileName(modelFileName);
     }
@@ -148,11 +150,13 @@ protected:
     }
 
 public:
-    NamLoadMessage(const char *modelFileName)
-        : NamMessage(NamMessageType::Load)
+    NamLoadMessage(size_t modelIndex, const char *modelFileName)
+        : NamMessage(NamMessageType::Load),
+          modelIndex(modelIndex)
     {
         SetFileName(modelFileName);
     }
+    size_t ModelIndex() const { return modelIndex; }
     bool HasModel() const { return hasModel; }
     const char *ModelFileName() const
     {
@@ -160,6 +164,7 @@ public:
     }
 
 private:
+    size_t modelIndex;
     bool hasModel;
     char modelFileName[MAX_NAM_FILENAME + 1];
 };
@@ -168,9 +173,10 @@ class NamLoadResponseMessage : public NamLoadMessage
 {
 public:
     NamLoadResponseMessage(
+        size_t modelIndex,
         const char *modelFileName,
         DSP *modelObject)
-        : NamLoadMessage(NamMessageType::LoadResponse, modelFileName),
+        : NamLoadMessage(NamMessageType::LoadResponse, modelIndex, modelFileName),
           modelObject(modelObject)
     {
     }
@@ -191,6 +197,7 @@ NeuralAmpModeler::NeuralAmpModeler(
 {
 
     mNAMPath.reserve(MAX_NAM_FILENAME + 1);
+    mNAMPath2.reserve(MAX_NAM_FILENAME + 1);
 
     urids.Initialize(*this);
 
@@ -211,12 +218,35 @@ NeuralAmpModeler::NeuralAmpModeler(
     // INPUT sample rate
     const int32_t INPUT_UPDATES_PER_SEC = 15;
     vuMaxSampleCount = uint32_t(rate / INPUT_UPDATES_PER_SEC);
+
+    // Size all buffers now, so that Run() never has to allocate.
+    if (this->GetBuffSizeOptions().maxBlockLength != BufSizeOptions::INVALID_VALUE)
+    {
+        this->maxBlockLength = this->GetBuffSizeOptions().maxBlockLength;
+    }
+    if (this->GetBuffSizeOptions().nominalBlockLength != BufSizeOptions::INVALID_VALUE)
+    {
+        this->nominalBlockLength = this->GetBuffSizeOptions().nominalBlockLength;
+    }
+    this->_PrepareIOPointers(1);
+    this->mInputArray.resize(1);
+    this->mOutputArray.resize(1);
+    this->_PrepareBuffers(maxBlockLength);
+    this->mOutputArrayB.resize(maxBlockLength);
+    this->mOutputPointerB = this->mOutputArrayB.data();
+    this->oversampler.SetMaxBlockSize(maxBlockLength);
+    this->mOversampledOutputA.resize(maxBlockLength * 4);
+    this->mOversampledOutputB.resize(maxBlockLength * 4);
+
+    this->mNoiseGateTrigger.PrepareBuffers(1, maxBlockLength);
+    this->mNoiseGateGain.PrepareBuffers(1, maxBlockLength);
 }
 void NeuralAmpModeler::Urids::Initialize(NeuralAmpModeler &this_)
 {
     atom__Path = this_.MapURI(LV2_ATOM__Path);
     atom__String = this_.MapURI(LV2_ATOM__String);
     nam__ModelFileName = this_.MapURI("http://two-play.com/plugins/toob-nam#modelFile");
+    nam__ModelFileName2 = this_.MapURI("http://two-play.com/plugins/toob-nam#modelFile2");
     nam__FrequencyResponse = this_.MapURI("http://two-play.com/plugins/toob-nam#FrequencyResponse");
     patch = this_.MapURI(LV2_PATCH_URI);
     patch__Get = this_.MapURI(LV2_PATCH__Get);
@@ -304,34 +334,45 @@ NeuralAmpModeler::OnSaveLv2State(
     uint32_t flags,
     const LV2_Feature *const *features)
 {
-    if (this->mNAMPath.length() == 0)
+    for (size_t i = 0; i < MAX_MODELS; ++i)
     {
-        return LV2_State_Status::LV2_STATE_SUCCESS; // not-set => "". Avoids assuming that hosts can handle a "" path.
+        const std::string &path = ModelPath(i);
+        if (path.length() == 0)
+        {
+            continue; // not-set => "". Avoids assuming that hosts can handle a "" path.
+        }
+        std::string abstractPath = this->UnmapFilename(features, path.c_str());
+        store(handle, ModelFileNameUrid(i), abstractPath.c_str(), abstractPath.length() + 1, urids.atom__Path, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
     }
-    std::string abstractPath = this->UnmapFilename(features, this->mNAMPath.c_str());
-    store(handle, this->urids.nam__ModelFileName, abstractPath.c_str(), abstractPath.length() + 1, urids.atom__Path, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
     return LV2_State_Status::LV2_STATE_SUCCESS;
 }
 
-bool NeuralAmpModeler::LoadModel(const std::string &modelFileName)
+uint32_t NeuralAmpModeler::ModelFileNameUrid(size_t modelIndex) const
 {
+    return modelIndex == 0 ? urids.nam__ModelFileName : urids.nam__ModelFileName2;
+}
+
+bool NeuralAmpModeler::LoadModel(const std::string &modelFileName, size_t modelIndex)
+{
+    std::unique_ptr<DSP> &model = ModelSlot(modelIndex);
     try
     {
-        this->mNAMPath = modelFileName;
+        ModelPath(modelIndex) = modelFileName;
         std::unique_ptr<DSP> dspResult;
         if (modelFileName.length() != 0)
         {
             dspResult = _GetNAM(modelFileName);
         }
-        this->mNAM = std::move(dspResult);
+        model = std::move(dspResult);
+        modelsChanged = true;
 
-        if (mNAM)
+        if (model)
         {
-            PrepareModel(this->mNAM.get());
+            PrepareModel(model.get());
         }
         else
         {
-            if (!mNAMPath.empty())
+            if (!modelFileName.empty())
             {
                 std::string fileNameOnly = std::filesystem::path(modelFileName).filename().replace_extension();
 
@@ -345,7 +386,7 @@ bool NeuralAmpModeler::LoadModel(const std::string &modelFileName)
     {
         std::string fileNameOnly = std::filesystem::path(modelFileName).filename().replace_extension();
         LogError("%s\n", SS("can't load model " << fileNameOnly).c_str());
-        mNAM = nullptr;
+        model = nullptr;
         return false;
     }
 }
@@ -377,13 +418,13 @@ NeuralAmpModeler::OnRestoreLv2State(
     uint32_t flags,
     const LV2_Feature *const *features)
 {
-    std::string modelFileName;
-
+    for (size_t i = 0; i < MAX_MODELS; ++i)
     {
+        std::string modelFileName;
         size_t size;
         uint32_t type;
         uint32_t flags;
-        const void *data = (*retrieve)(handle, urids.nam__ModelFileName, &size, &type, &flags);
+        const void *data = (*retrieve)(handle, ModelFileNameUrid(i), &size, &type, &flags);
         if (data)
         {
             if (type != this->urids.atom__Path && type != this->urids.atom__String)
@@ -391,7 +432,11 @@ NeuralAmpModeler::OnRestoreLv2State(
                 return LV2_State_Status::LV2_STATE_ERR_BAD_TYPE;
             }
             modelFileName = MapFilename(features, (const char *)data, nullptr);
-            RequestLoad(modelFileName.c_str());
+        }
+        // A missing Model B means a single-model preset, so clear it.
+        if (data || i != 0)
+        {
+            RequestLoad(modelFileName.c_str(), i);
         }
     }
 
@@ -442,6 +487,7 @@ LV2_Worker_Status NeuralAmpModeler::OnWork(
             }
         }
         NamLoadResponseMessage reply{
+            pLoadMessage->ModelIndex(),
             dspFilename.c_str(),
             dspResult.release()};
         respond(handle, sizeof(reply), &reply);
@@ -467,10 +513,12 @@ LV2_Worker_Status NeuralAmpModeler::OnWorkResponse(uint32_t size, const void *da
     case NamMessageType::LoadResponse:
     {
         NamLoadResponseMessage *loadResponse = (NamLoadResponseMessage *)response;
+        std::unique_ptr<DSP> &model = ModelSlot(loadResponse->ModelIndex());
         DSP *oldModel = nullptr;
-        oldModel = this->mNAM.release();
+        oldModel = model.release();
 
-        this->mNAM = std::unique_ptr<DSP>(loadResponse->modelObject);
+        model = std::unique_ptr<DSP>(loadResponse->modelObject);
+        modelsChanged = true;
 
         if (oldModel != nullptr)
         {
@@ -519,6 +567,15 @@ void NeuralAmpModeler::ConnectPort(uint32_t port, void *data)
     case EParams::kStackType:
         cToneStackType.SetData(data);
         break;
+    case EParams::kBlend:
+        cBlend.SetData(data);
+        break;
+    case EParams::kOversample:
+        cOversample.SetData(data);
+        break;
+    case EParams::kLatency:
+        cLatency.SetData(data);
+        break;
     // case EParams::kOutNorm:
     //     cOutNorm.SetData(data);
     //     break;
@@ -546,18 +603,6 @@ void NeuralAmpModeler::Activate()
     this->toneStackFilter.Reset();
     this->baxandallToneStack.Reset();
 
-    size_t maxBufferSize = this->GetBuffSizeOptions().maxBlockLength;
-    this->nominalBlockLength = this->GetBuffSizeOptions().nominalBlockLength;
-    if (maxBufferSize == BufSizeOptions::INVALID_VALUE)
-    {
-        maxBufferSize = 2048;
-    }
-
-    this->_PrepareIOPointers(1);
-    this->mInputArray.resize(1);
-    this->mOutputArray.resize(1);
-    this->_PrepareBuffers(maxBufferSize);
-
     const double time = 0.01;
     const double threshold = cNoiseGateThreshold.GetDb();
     const double ratio = 0.1; // Quadratic...
@@ -569,10 +614,13 @@ void NeuralAmpModeler::Activate()
     this->mNoiseGateTrigger.SetSampleRate(rate);
     this->noiseGateActive = cNoiseGateThreshold.GetDb() != -100;
 
-    this->mNoiseGateTrigger.PrepareBuffers(1, maxBufferSize);
-    this->mNoiseGateGain.PrepareBuffers(1, maxBufferSize);
+    this->blendTarget = this->blendValue = cBlend.GetValue();
 
-    LoadModel(this->mNAMPath);
+    for (size_t i = 0; i < MAX_MODELS; ++i)
+    {
+        LoadModel(ModelPath(i), i);
+    }
+    UpdateOversampling();
 }
 void NeuralAmpModeler::Run(uint32_t n_samples)
 {
@@ -584,6 +632,7 @@ void NeuralAmpModeler::Run(uint32_t n_samples)
     {
         requestFileUpdate = false;
         this->PutPatchPropertyPath(0, urids.nam__ModelFileName, mNAMPath.c_str());
+        this->PutPatchPropertyPath(0, urids.nam__ModelFileName2, mNAMPath2.c_str());
     }
 }
 void NeuralAmpModeler::Deactivate()
@@ -641,7 +690,6 @@ void NeuralAmpModeler::UpdateToneStack()
 void NeuralAmpModeler::ProcessBlock(int nFrames)
 {
 
-    constexpr size_t numChannelsInternal = 1;
     const size_t numFrames = (size_t)nFrames;
     const double sampleRate = this->rate;
 
@@ -649,8 +697,6 @@ void NeuralAmpModeler::ProcessBlock(int nFrames)
 
     fp_state_t fp_state = LsNumerics::disable_denorms();
 
-    this->_PrepareBuffers(numFrames);
-
     if (cBass.HasChanged() || cMid.HasChanged() || cTreble.HasChanged() || cToneStackType.HasChanged())
     {
         UpdateToneStack();
@@ -661,11 +707,6 @@ void NeuralAmpModeler::ProcessBlock(int nFrames)
         }
     }
 
-    // Input is collapsed to mono in preparation for the NAM.
-    this->_ProcessInput(&this->audioIn, numFrames, 1, 1);
-
-    // Noise gate trigger
-    nam_float_t **triggerOutput = mInputPointers;
     if (cNoiseGateThreshold.HasChanged())
     {
         this->noiseGateActive = cNoiseGateThreshold.GetDb() != -100;
@@ -683,6 +724,71 @@ void NeuralAmpModeler::ProcessBlock(int nFrames)
         }
 
     }
+    if (cBlend.HasChanged())
+    {
+        this->blendTarget = cBlend.GetValue();
+    }
+    if (cOversample.HasChanged() || modelsChanged)
+    {
+        UpdateOversampling();
+    }
+    float noiseGateOut = 1;
+
+    // Hosts may deliver blocks larger than maxBlockLength. Process in chunks 
+    // rather than growing buffers on the audio thread.
+    const size_t maxChunk = _GetBufferNumFrames();
+    for (size_t offset = 0; offset < numFrames; /**/)
+    {
+        size_t chunkFrames = std::min(numFrames - offset, maxChunk);
+        noiseGateOut = ProcessChunk(this->audioIn + offset, this->audioOut + offset, chunkFrames);
+        offset += chunkFrames;
+    }
+
+    this->gateOutputUpdateCount += numFrames;
+    if (this->gateOutputUpdateCount >= this->gateOutputUpdateRate)
+    {
+        this->gateOutputUpdateCount = 0;
+        this->cGateOutput.SetValue(1 - noiseGateOut);
+    }
+
+    if (responseDelaySamples != 0)
+    {
+        responseDelaySamples -= nFrames;
+        if (responseDelaySamples <= 0 || nFrames == 0)
+        {
+            responseGet = true;
+            responseDelaySamples = 0;
+        }
+    }
+    if (responseGet)
+    {
+        responseGet = false;
+        responseDelaySamples = 0;
+        WriteFrequencyResponse();
+    }
+    if (sendFileName)
+    {
+        sendFileName = false;
+        this->PutPatchPropertyPath(0, urids.nam__ModelFileName, mNAMPath.c_str());
+    }
+    if (sendFileName2)
+    {
+        sendFileName2 = false;
+        this->PutPatchPropertyPath(0, urids.nam__ModelFileName2, mNAMPath2.c_str());
+    }
+    // restore previous floating point state
+    LsNumerics::restore_denorms(fp_state);
+}
+
+float NeuralAmpModeler::ProcessChunk(const float *input, float *output, size_t numFrames)
+{
+    constexpr size_t numChannelsInternal = 1;
+
+    // Input is collapsed to mono in preparation for the NAM.
+    this->_ProcessInput(&input, numFrames, 1, 1);
+
+    // Noise gate trigger
+    nam_float_t **triggerOutput = mInputPointers;
     float noiseGateOut = 1;
     if (noiseGateActive)
     {
@@ -696,27 +802,49 @@ void NeuralAmpModeler::ProcessBlock(int nFrames)
     {
     case ToneStackType::Bassman:
     case ToneStackType::Jcm8000:
-        toneStackFilter.Process(nFrames, triggerOutput[0], mToneStackPointer);
+        toneStackFilter.Process((int)numFrames, triggerOutput[0], mToneStackPointer);
         toneStackOutput = &this->mToneStackPointer;
         break;
     case ToneStackType::Baxandall:
-        baxandallToneStack.Process(nFrames, triggerOutput[0], mToneStackPointer);
+        baxandallToneStack.Process((int)numFrames, triggerOutput[0], mToneStackPointer);
         toneStackOutput = &this->mToneStackPointer;
         break;
     case ToneStackType::Bypass:
         break;
     }
 
-    if (mNAM != nullptr)
+    // When oversampling, the models (and the blend) run at the oversampled rate.
+    nam_float_t *modelInput = toneStackOutput[0];
+    nam_float_t *modelOutputA = this->mOutputPointers[0];
+    nam_float_t *modelOutputB = this->mOutputPointerB;
+    size_t modelFrames = numFrames;
+    if (oversampler.GetFactor() != 1)
     {
-        // mNAM->SetNormalize(cOutNorm.GetValue());
-        // TODO remove input / output gains from here.
-        // normalize input.
-        mNAM->process(toneStackOutput[0], this->mOutputPointers[0], nFrames);
+        modelInput = oversampler.Upsample(toneStackOutput[0], numFrames);
+        modelOutputA = this->mOversampledOutputA.data();
+        modelOutputB = this->mOversampledOutputB.data();
+        modelFrames = numFrames * oversampler.GetFactor();
+    }
+
+    // Dual-model mode: both models read the same (gated, tone-stacked) input buffer.
+    // A model that is fully blended out is not evaluated.
+    bool dualModel = mNAM2 != nullptr && (blendValue != 0 || blendTarget != 0);
+    if (!dualModel || blendValue != 1 || blendTarget != 1)
+    {
+        _ProcessModel(mNAM.get(), modelInput, modelOutputA, modelFrames);
+    }
+    if (dualModel)
+    {
+        _ProcessModel(mNAM2.get(), modelInput, modelOutputB, modelFrames);
+        _BlendOutputs(modelOutputA, modelOutputB, modelFrames);
     }
     else
     {
-        this->_FallbackDSP(toneStackOutput, this->mOutputPointers, 1, numFrames);
+        blendValue = blendTarget;
+    }
+    if (oversampler.GetFactor() != 1)
+    {
+        oversampler.Downsample(modelOutputA, this->mOutputPointers[0], numFrames);
     }
     // Apply the noise gate
     nam_float_t **gateGainOutput = noiseGateActive
@@ -725,39 +853,104 @@ void NeuralAmpModeler::ProcessBlock(int nFrames)
 
     // Let's get outta here
     // This is where we exit mono for whatever the output requires.
-    this->_ProcessOutput(gateGainOutput, &(this->audioOut), numFrames, 1, 1);
+    this->_ProcessOutput(gateGainOutput, &output, numFrames, 1, 1);
     // * Output of input leveling (inputs -> mInputPointers),
     // * Output of output leveling (mOutputPointers -> outputs)
+    return noiseGateOut;
+}
 
-    this->gateOutputUpdateCount += numFrames;
-    if (this->gateOutputUpdateCount >= this->gateOutputUpdateRate)
+void NeuralAmpModeler::_ProcessModel(DSP *model, nam_float_t *input, nam_float_t *output, size_t numFrames)
+{
+    if (model != nullptr)
     {
-        this->gateOutputUpdateCount = 0;
-        this->cGateOutput.SetValue(1 - noiseGateOut);
+        // mNAM->SetNormalize(cOutNorm.GetValue());
+        // TODO remove input / output gains from here.
+        // normalize input.
+
+        // Models were prepared for at most maxBlockLength frames. Oversampled chunks are larger.
+        for (size_t offset = 0; offset < numFrames; offset += maxBlockLength)
+        {
+            size_t n = std::min(maxBlockLength, numFrames - offset);
+            model->process(input + offset, output + offset, (int)n);
+        }
+    }
+    else
+    {
+        this->_FallbackDSP(&input, &output, 1, numFrames);
     }
+}
 
-    if (responseDelaySamples != 0)
+static bool IsRecurrent(const DSP *model)
+{
+    return dynamic_cast<const lstm::LSTM *>(model) != nullptr;
+}
+
+void NeuralAmpModeler::UpdateOversampling()
+{
+    using FilterPhase = LsNumerics::HalfbandOversampler::FilterPhase;
+    OversampleMode mode = (OversampleMode)cOversample.GetValue();
+    // An LSTM's state advances once per sample, so its response depends on the sample rate it was
+    // trained at. Recurrent models always run at the host rate.
+    if (IsRecurrent(mNAM.get()) || IsRecurrent(mNAM2.get()))
     {
-        responseDelaySamples -= nFrames;
-        if (responseDelaySamples <= 0 || nFrames == 0)
+        mode = OversampleMode::Off;
+    }
+    switch (mode)
+    {
+    case OversampleMode::Off:
+    default:
+        oversampler.SetOversampling(1, FilterPhase::Linear);
+        break;
+    case OversampleMode::X2:
+        oversampler.SetOversampling(2, FilterPhase::Linear);
+        break;
+    case OversampleMode::X4:
+        oversampler.SetOversampling(4, FilterPhase::Linear);
+        break;
+    case OversampleMode::X2LowLatency:
+        oversampler.SetOversampling(2, FilterPhase::Minimum);
+        break;
+    case OversampleMode::X4LowLatency:
+        oversampler.SetOversampling(4, FilterPhase::Minimum);
+        break;
+    }
+    cLatency.SetValue((float)std::round(oversampler.GetLatency()));
+    modelsChanged = false;
+}
+
+void NeuralAmpModeler::_BlendOutputs(nam_float_t *outputA, const nam_float_t *outputB, size_t numFrames)
+{
+    float blend = this->blendValue;
+    if (blend == this->blendTarget)
+    {
+        if (blend == 1)
         {
-            responseGet = true;
-            responseDelaySamples = 0;
+            // Model A was not evaluated.
+            for (size_t i = 0; i < numFrames; ++i)
+            {
+                outputA[i] = outputB[i];
+            }
         }
+        else
+        {
+            for (size_t i = 0; i < numFrames; ++i)
+            {
+                outputA[i] += blend * (outputB[i] - outputA[i]);
+            }
+        }
+        return;
     }
-    if (responseGet)
+    if (numFrames == 0)
     {
-        responseGet = false;
-        responseDelaySamples = 0;
-        WriteFrequencyResponse();
+        return;
     }
-    if (sendFileName)
+    float dBlend = (this->blendTarget - blend) / numFrames;
+    for (size_t i = 0; i < numFrames; ++i)
     {
-        sendFileName = false;
-        this->PutPatchPropertyPath(0, urids.nam__ModelFileName, mNAMPath.c_str());
+        blend += dBlend;
+        outputA[i] += blend * (outputB[i] - outputA[i]);
     }
-    // restore previous floating point state
-    LsNumerics::restore_denorms(fp_state);
+    this->blendValue = this->blendTarget;
 }
 
 void NeuralAmpModeler::OnReset()
@@ -846,7 +1039,7 @@ std::unique_ptr<DSP> NeuralAmpModeler::_GetNAM(const std::string &modelPath)
     std::unique_ptr<DSP> nam = get_dsp_ex(dspPath,
         (uint32_t)getRate(),
         (int)(this->GetBuffSizeOptions().minBlockLength),
-        (int)(this->GetBuffSizeOptions().maxBlockLength));
+        (int)(this->maxBlockLength));
     return nam;
 }
 
@@ -865,10 +1058,6 @@ size_t NeuralAmpModeler::_GetBufferNumFrames() const
 
 void NeuralAmpModeler::_PrepareBuffers(const size_t numFrames)
 {
-    if (mInputArray.size() == 0 || mInputArray[0].size() >= numFrames)
-    {
-        return;
-    }
     {
         mToneStackArray.resize(numFrames);
         mToneStackPointer = &(mToneStackArray[0]);
@@ -983,10 +1172,11 @@ void NeuralAmpModeler::_ProcessOutput(nam_float_t **inputs, float_t **outputs, c
 void NeuralAmpModeler::OnPatchSet(LV2_URID propertyUrid, const LV2_Atom *value)
 {
 
-    if (propertyUrid == urids.nam__ModelFileName && (value->type == urids.atom__Path || value->type == urids.atom__String))
+    if ((propertyUrid == urids.nam__ModelFileName || propertyUrid == urids.nam__ModelFileName2) 
+        && (value->type == urids.atom__Path || value->type == urids.atom__String))
     {
         const char *modelFileName = ((const char *)value) + sizeof(LV2_Atom);
-        RequestLoad(modelFileName);
+        RequestLoad(modelFileName, propertyUrid == urids.nam__ModelFileName ? 0 : 1);
     }
 }
 void NeuralAmpModeler::OnPatchGet(LV2_URID propertyUrid)
@@ -995,6 +1185,10 @@ void NeuralAmpModeler::OnPatchGet(LV2_URID propertyUrid)
     {
         this->sendFileName = true;
     }
+    else if (propertyUrid == this->urids.nam__ModelFileName2)
+    {
+        this->sendFileName2 = true;
+    }
     else if (propertyUrid == this->urids.nam__FrequencyResponse)
     {
         this->responseGet = true;
@@ -1060,25 +1254,21 @@ void NeuralAmpModeler::WriteFrequencyResponse()
     lv2_atom_forge_pop(&outputForge, &objectFrame);
 }
 
-void NeuralAmpModeler::RequestLoad(const char *fileName)
+void NeuralAmpModeler::RequestLoad(const char *fileName, size_t modelIndex)
 {
-    this->mNAMPath = fileName;
-    this->sendFileName = true;
+    bool &sendFlag = modelIndex == 0 ? this->sendFileName : this->sendFileName2;
+    ModelPath(modelIndex) = fileName;
+    sendFlag = true;
     if (!this->isActivated)
     {
         // will be picked up in Activate.
-        this->mNAMPath = fileName;
-        this->sendFileName = fileName;
         return;
     }
 
     const LV2_Worker_Schedule *schedule = GetLv2WorkerSchedule();
     if (schedule)
     {
-        this->mNAMPath = fileName;
-        this->sendFileName = true;
-
-        NamLoadMessage loadMessage(fileName);
+        NamLoadMessage loadMessage(modelIndex, fileName);
 
         schedule->schedule_work(
             schedule->handle,
@@ -1086,7 +1276,7 @@ void NeuralAmpModeler::RequestLoad(const char *fileName)
     }
     else
     {
-        LoadModel(fileName); // do it on the foreground.
+        LoadModel(fileName, modelIndex); // do it on the foreground.
     }
 }
 //----------------------------------------------
@@ -37,6 +37,7 @@ SOFTWARE.
 #include "NeuralAmpModelerCore/NAM/dsp.h"
 #include "LsNumerics/BaxandallToneStack.hpp"
 #include "LsNumerics/ToneStackFilter.h"
+#include "LsNumerics/HalfbandOversampler.hpp"
 
 #include "FilterResponse.h"
 
@@ -98,15 +99,23 @@ namespace toob
             kAudioIn,
             kAudioOut,
             kControlIn,
-            kControlOut
+            kControlOut,
+            kBlend,
+            kOversample,
+            kLatency
         };
-        bool LoadModel(const std::string&filename); // (for tests)
+        // Number of models that can be loaded. The second model (Model B) shares the input, 
+        // noise gate and tone stack stages with the first, and is blended into the output.
+        static constexpr size_t MAX_MODELS = 2;
+
+        bool LoadModel(const std::string&filename, size_t modelIndex = 0); // (for tests)
 
     private:
         struct Urids
         {
             void Initialize(NeuralAmpModeler &this_);
             uint32_t nam__ModelFileName;
+            uint32_t nam__ModelFileName2;
             uint32_t nam__FrequencyResponse;
             uint32_t atom__Path;
             uint32_t atom__String;
@@ -151,6 +160,8 @@ namespace toob
         void OnPatchGet(LV2_URID propertyUrid) override;
 
         void ProcessBlock(int nFrames);
+        // Process at most _GetBufferNumFrames() frames. Returns the noise gate gain.
+        float ProcessChunk(const float *input, float *output, size_t nFrames);
         void OnReset();
         void OnIdle();
 
@@ -172,6 +183,8 @@ namespace toob
 
     private:
         size_t nominalBlockLength = 64;
+        // Size of all internal buffers. Larger host blocks are processed in chunks of this size.
+        size_t maxBlockLength = 2048;
         double rate = 44100;
         std::string bundle_path;
 
@@ -185,6 +198,11 @@ namespace toob
         RangedInputPort cMid{ 0,10};
         RangedInputPort cTreble{ 0,10};
         EnumeratedInputPort cToneStackType { 4};
+        RangedInputPort cBlend{0,1};
+        EnumeratedInputPort cOversample{5};
+        OutputPort cLatency;
+        // Set when a model is loaded, since the oversampling depends on the model type.
+        bool modelsChanged = false;
 
         enum ToneStackType {
             Bassman = 0, // matches enum values in .ttl file.
@@ -193,6 +211,15 @@ namespace toob
             Bypass = 3,
         };
         ToneStackType toneStackType = ToneStackType::Bypass;
+
+        enum OversampleMode {
+            Off = 0, // matches enum values in .ttl file.
+            X2 = 1,
+            X4 = 2,
+            X2LowLatency = 3,
+            X4LowLatency = 4,
+        };
+        LsNumerics::HalfbandOversampler oversampler;
 		ToneStackFilter toneStackFilter;
 		BaxandallToneStack baxandallToneStack;
 
@@ -217,11 +244,17 @@ namespace toob
 
         bool responseGet = false;
         bool sendFileName = false;
+        bool sendFileName2 = false;
         int64_t responseDelaySamplesMax = 0;
         int64_t responseDelaySamples = 0;
 
+        // Model A/B blend. Ramped across each chunk to avoid zipper noise.
+        float blendValue = 0;
+        float blendTarget = 0;
+
     private:
-        void RequestLoad(const char *fileName);
+        void RequestLoad(const char *fileName, size_t modelIndex = 0);
+        uint32_t ModelFileNameUrid(size_t modelIndex) const;
         // Update tone stack filter designs.
         void UpdateToneStack();
         // Write frequency response for UI.
@@ -242,7 +275,13 @@ namespace toob
         std::unique_ptr<DSP> _GetNAM(const std::string &dspFile);
 
         bool _HaveModel() const { return this->mNAM != nullptr; };
-        // Prepare the input & output buffers
+        // Run a model (or the fallback) from input to output.
+        void _ProcessModel(DSP *model, nam_float_t *input, nam_float_t *output, size_t numFrames);
+        // Apply the oversample control for the loaded models, and report the filter latency.
+        void UpdateOversampling();
+        // Blend Model B output into Model A output.
+        void _BlendOutputs(nam_float_t *outputA, const nam_float_t *outputB, size_t numFrames);
+        // Prepare the input & output buffers. Not realtime-safe; called at instantiate time only.
         void _PrepareBuffers(const size_t numFrames);
         // Manage pointers
         void _PrepareIOPointers(const size_t nChans);
@@ -273,15 +312,28 @@ namespace toob
         std::vector<nam_float_t> mToneStackArray;
         nam_float_t *mToneStackPointer = nullptr;
 
+        // Output from Model B.
+        std::vector<nam_float_t> mOutputArrayB;
+        nam_float_t *mOutputPointerB = nullptr;
+        // Model outputs at the oversampled rate.
+        std::vector<nam_float_t> mOversampledOutputA;
+        std::vector<nam_float_t> mOversampledOutputB;
+
         // Noise gates
         dsp::noise_gate::Trigger mNoiseGateTrigger;
         dsp::noise_gate::Gain mNoiseGateGain;
 
         // The Neural Amp Model (NAM) actually being used:
         std::unique_ptr<DSP> mNAM;
+        // Model B, blended with mNAM in dual-model mode.
+        std::unique_ptr<DSP> mNAM2;
+
+        std::unique_ptr<DSP> &ModelSlot(size_t modelIndex) { return modelIndex == 0 ? mNAM : mNAM2; }
+        std::string &ModelPath(size_t modelIndex) { return modelIndex == 0 ? mNAMPath : mNAMPath2; }
 
         // Path to model's config.json or model.nam
         std::string mNAMPath;
+        std::string mNAMPath2;
 
         std::unordered_map<std::string, double> mNAMParams = {{"Input", 0.0}, {"Output", 0.0}};
     };
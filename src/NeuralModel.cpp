@@ -45,6 +45,52 @@ void NeuralModel::Load(const std::string&fileName)
 }
 
 
+const std::vector<std::vector<float> > &StateDict::rec__weight_ih(size_t layer) const
+{
+    switch (layer)
+    {
+    case 0: return rec__weight_ih_l0_;
+    case 1: return rec__weight_ih_l1_;
+    case 2: return rec__weight_ih_l2_;
+    case 3: return rec__weight_ih_l3_;
+    default: throw std::out_of_range("Invalid layer.");
+    }
+}
+const std::vector<std::vector<float> > &StateDict::rec__weight_hh(size_t layer) const
+{
+    switch (layer)
+    {
+    case 0: return rec__weight_hh_l0_;
+    case 1: return rec__weight_hh_l1_;
+    case 2: return rec__weight_hh_l2_;
+    case 3: return rec__weight_hh_l3_;
+    default: throw std::out_of_range("Invalid layer.");
+    }
+}
+const std::vector<float> &StateDict::rec__bias_ih(size_t layer) const
+{
+    switch (layer)
+    {
+    case 0: return rec__bias_ih_l0_;
+    case 1: return rec__bias_ih_l1_;
+    case 2: return rec__bias_ih_l2_;
+    case 3: return rec__bias_ih_l3_;
+    default: throw std::out_of_range("Invalid layer.");
+    }
+}
+const std::vector<float> &StateDict::rec__bias_hh(size_t layer) const
+{
+    switch (layer)
+    {
+    case 0: return rec__bias_hh_l0_;
+    case 1: return rec__bias_hh_l1_;
+    case 2: return rec__bias_hh_l2_;
+    case 3: return rec__bias_hh_l3_;
+    default: throw std::out_of_range("Invalid layer.");
+    }
+}
+
+
 JSON_MAP_BEGIN(ModelData)
     JSON_MAP_REFERENCE(ModelData,model)
     JSON_MAP_REFERENCE(ModelData,input_size)
@@ -61,6 +107,18 @@ JSON_MAP_BEGIN(StateDict)
     JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_hh_l0",rec__weight_hh_l0)
     JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_ih_l0",rec__bias_ih_l0)
     JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_hh_l0",rec__bias_hh_l0)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_ih_l1",rec__weight_ih_l1)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_hh_l1",rec__weight_hh_l1)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_ih_l1",rec__bias_ih_l1)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_hh_l1",rec__bias_hh_l1)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_ih_l2",rec__weight_ih_l2)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_hh_l2",rec__weight_hh_l2)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_ih_l2",rec__bias_ih_l2)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_hh_l2",rec__bias_hh_l2)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_ih_l3",rec__weight_ih_l3)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.weight_hh_l3",rec__weight_hh_l3)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_ih_l3",rec__bias_ih_l3)
+    JSON_MAP_DICTIONARY_REFERENCE(StateDict,"rec.bias_hh_l3",rec__bias_hh_l3)
     JSON_MAP_DICTIONARY_REFERENCE(StateDict,"lin.weight",lin__weight)
     JSON_MAP_DICTIONARY_REFERENCE(StateDict,"lin.bias",lin__bias)
 JSON_MAP_END()
@@ -64,14 +64,34 @@ public:
 };
 
 class StateDict {
+public:
+    static constexpr size_t MAX_LAYERS = 4;
 private:
     std::vector<std::vector<float> > rec__weight_ih_l0_;
     std::vector<std::vector<float> > rec__weight_hh_l0_;
     std::vector<float> rec__bias_ih_l0_;
     std::vector<float> rec__bias_hh_l0_;
+    std::vector<std::vector<float> > rec__weight_ih_l1_;
+    std::vector<std::vector<float> > rec__weight_hh_l1_;
+    std::vector<float> rec__bias_ih_l1_;
+    std::vector<float> rec__bias_hh_l1_;
+    std::vector<std::vector<float> > rec__weight_ih_l2_;
+    std::vector<std::vector<float> > rec__weight_hh_l2_;
+    std::vector<float> rec__bias_ih_l2_;
+    std::vector<float> rec__bias_hh_l2_;
+    std::vector<std::vector<float> > rec__weight_ih_l3_;
+    std::vector<std::vector<float> > rec__weight_hh_l3_;
+    std::vector<float> rec__bias_ih_l3_;
+    std::vector<float> rec__bias_hh_l3_;
     std::vector<std::vector<float> > lin__weight_;
     std::vector<float> lin__bias_;
 public:
+    // Weights for recurrent layer 0..MAX_LAYERS-1.
+    const std::vector<std::vector<float> > &rec__weight_ih(size_t layer) const;
+    const std::vector<std::vector<float> > &rec__weight_hh(size_t layer) const;
+    const std::vector<float> &rec__bias_ih(size_t layer) const;
+    const std::vector<float> &rec__bias_hh(size_t layer) const;
+
     const std::vector<std::vector<float> > &rec__weight_ih_l0() const {return rec__weight_ih_l0_; }
     const std::vector<std::vector<float> > &rec__weight_hh_l0() const {return rec__weight_hh_l0_; };
     const std::vector<float> &rec__bias_ih_l0() const { return rec__bias_ih_l0_; }
@@ -0,0 +1,710 @@
+// Copyright (c) 2025 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+    Runs each Toob plugin through a sweep of block sizes and control values with
+    AllocationTrap enabled. Any allocation made inside a plugin's run() aborts
+    the test, naming the plugin.
+
+    Worker jobs run inline in the host between cycles, so the model-based plugins
+    are also run with a model loaded: ToobNeuralAmpModeler with a generated LSTM
+    .nam file, and ToobML with one of the bundled tone models.
+
+    usage: PluginAllocationTest <path to ToobAmp.so> <path to ToobAmp.lv2/models/tones>
+*/
+
+#include "Lv2Host.h"
+#include "HostedLv2Plugin.h"
+#include "AllocationTrap.h"
+#include "Lv2Exception.h"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numbers>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace toob;
+
+static constexpr double SAMPLE_RATE = 48000;
+
+// The test host provides no options feature, so plugins fall back to their default
+// maxBlockLength. Run blocks both smaller and larger than that.
+static constexpr int HOST_BUFFER_SIZE = 4096;
+
+static const int blockSizes[] = {0, 16, 64, 1, 2048, 2049, 3000, HOST_BUFFER_SIZE, 128};
+
+// Large enough for the frequency response and waveform vectors that plugins send.
+static constexpr uint32_t ATOM_BUFFER_SIZE = 32768;
+
+struct PortSpec
+{
+    int index;
+    PortType type;
+    float defaultValue = 0;
+    float minValue = 0;
+    float maxValue = 0;
+};
+
+struct PluginSpec
+{
+    const char *uri;
+    std::vector<PortSpec> ports;
+};
+
+// A model file to load with a patch:Set message before running the sweep.
+struct ModelLoad
+{
+    int controlPort;
+    const char *propertyUri;
+    std::filesystem::path path;
+    // Asserts that the model is running.
+    void (*checkLoaded)(Lv2Host &host, HostedLv2Plugin *plugin);
+};
+
+// Port layouts as declared in ToobAmp.lv2/ttl.in.
+static const std::vector<PluginSpec> pluginSpecs = {
+    {"http://two-play.com/plugins/toob-input_stage",
+     {
+         {0, PortType::InputControl, 0, -60, 30},        // trim
+         {1, PortType::OutputControl},                   // trimOut
+         {2, PortType::InputControl, -80, -80, -20},     // gate_t
+         {3, PortType::OutputControl},                   // gate_out
+         {4, PortType::InputControl, 60, 30, 300},       // locut
+         {5, PortType::InputControl, 0, 0, 25},          // bright
+         {6, PortType::InputControl, 1300, 1000, 5000},  // brightf
+         {7, PortType::InputControl, 13000, 2000, 13000}, // hicut
+         {8, PortType::InputAudio},
+         {9, PortType::OutputAudio},
+         {10, PortType::InputAtomStream},
+         {11, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-tone-stack",
+     {
+         {0, PortType::InputControl, 0.5f, 0, 1}, // bass
+         {1, PortType::InputControl, 0.5f, 0, 1}, // mid
+         {2, PortType::InputControl, 0.5f, 0, 1}, // treble
+         {3, PortType::InputControl, 0, 0, 2},    // ampmodel
+         {4, PortType::InputAudio},
+         {5, PortType::OutputAudio},
+         {6, PortType::InputAtomStream},
+         {7, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-cab-sim",
+     {
+         {0, PortType::InputControl, 83, 30, 300},       // locut
+         {1, PortType::InputControl, 0, 0, 20},          // bright
+         {2, PortType::InputControl, 1300, 1000, 5000},  // brightf
+         {3, PortType::InputControl, 6000, 2000, 13000}, // hicut
+         {4, PortType::InputControl, 0.32f, 0, 1},       // comb
+         {5, PortType::InputControl, 8000, 1000, 10000}, // combf
+         {6, PortType::InputControl, 1.5f, -30, 30},     // trim
+         {7, PortType::InputAudio},
+         {8, PortType::OutputAudio},
+         {9, PortType::InputAtomStream},
+         {10, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-power-stage-2",
+     {
+         {0, PortType::InputControl, 0, -20, 20},        // trim1
+         {1, PortType::InputControl, 30, 30, 300},       // locut1
+         {2, PortType::InputControl, 19000, 1000, 19000}, // hicut1
+         {3, PortType::InputControl, 0, 0, 1},           // shape1
+         {4, PortType::InputControl, 0, 0, 1},           // gain1
+         {5, PortType::InputControl, 0, -2, 2},          // bias1
+         {6, PortType::InputControl, 0, -20, 20},        // trim2
+         {7, PortType::InputControl, 30, 30, 300},       // locut2
+         {8, PortType::InputControl, 19000, 1000, 19000}, // hicut2
+         {9, PortType::InputControl, 0, 0, 1},           // shape2
+         {10, PortType::InputControl, 0, 0, 1},          // gain2
+         {11, PortType::InputControl, 0, -2, 2},         // bias2
+         {12, PortType::InputControl, 1, 0, 1},          // gain2_enable
+         {13, PortType::InputControl, 0, -20, 20},       // trim3
+         {14, PortType::InputControl, 30, 30, 300},      // locut3
+         {15, PortType::InputControl, 19000, 1000, 19000}, // hicut3
+         {16, PortType::InputControl, 0, 0, 1},          // shape3
+         {17, PortType::InputControl, 0, 0, 1},          // gain3
+         {18, PortType::InputControl, 0, -2, 2},         // bias3
+         {19, PortType::InputControl, 1, 0, 1},          // gain3_enable
+         {20, PortType::InputControl, 0, 0, 1},          // sag
+         {21, PortType::InputControl, 0, 0, 1},          // sagd
+         {22, PortType::InputControl, 0, -60, 30},       // master
+         {23, PortType::InputAudio},
+         {24, PortType::OutputAudio},
+         {25, PortType::InputAtomStream},
+         {26, PortType::OutputAtomStream},
+         {27, PortType::InputControl, 13, 5, 25}, // sagf
+     }},
+    {"http://two-play.com/plugins/toob-nam",
+     {
+         {0, PortType::InputControl, 0, -40, 40},     // inputGain
+         {1, PortType::OutputControl},                // inputGainOut
+         {2, PortType::InputControl, 0, -40, 40},     // outputGain
+         {3, PortType::InputControl, -100, -100, 0},  // gate
+         {4, PortType::OutputControl},                // gateOut
+         {5, PortType::InputControl, 3, 0, 3},        // toneStack
+         {6, PortType::InputControl, 5, 0, 10},       // bass
+         {7, PortType::InputControl, 5, 0, 10},       // mid
+         {8, PortType::InputControl, 5, 0, 10},       // treble
+         {9, PortType::InputAudio},
+         {10, PortType::OutputAudio},
+         {11, PortType::InputAtomStream},
+         {12, PortType::OutputAtomStream},
+         {13, PortType::InputControl, 0, 0, 1}, // blend
+         {14, PortType::InputControl, 0, 0, 4}, // oversample
+         {15, PortType::OutputControl},         // latency
+     }},
+    {"http://two-play.com/plugins/toob-convolution-reverb",
+     {
+         {0, PortType::InputControl, 1.5f, 0.1f, 10}, // time
+         {1, PortType::InputControl, -40, -40, 20},   // direct_mix
+         {2, PortType::InputControl, -10, -40, 20},   // reverb_mix
+         {3, PortType::InputControl, 1, 0, 1},        // predelay
+         {4, PortType::OutputControl},                // loading_state
+         {5, PortType::InputAudio},
+         {6, PortType::OutputAudio},
+         {7, PortType::InputAtomStream},
+         {8, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-tuner",
+     {
+         {0, PortType::OutputControl},               // FREQ
+         {1, PortType::InputControl, 0, 0, 1},       // MUTE
+         {2, PortType::InputControl, 440, 425, 455}, // REFFREQ
+         {3, PortType::InputControl, -37, -60, 0},   // THRESHOLD
+         {4, PortType::InputAudio},
+         {5, PortType::OutputAudio},
+         {6, PortType::InputAtomStream},
+         {7, PortType::OutputAtomStream},
+         {8, PortType::InputControl, 0, 0, 1}, // STRUM
+         {9, PortType::OutputControl},         // STRING1
+         {10, PortType::OutputControl},
+         {11, PortType::OutputControl},
+         {12, PortType::OutputControl},
+         {13, PortType::OutputControl},
+         {14, PortType::OutputControl}, // STRING6
+     }},
+    {"http://two-play.com/plugins/toob-delay",
+     {
+         {0, PortType::InputControl, 340, 5, 1200}, // delay
+         {1, PortType::InputControl, 27, 0, 100},   // level
+         {2, PortType::InputControl, 39, 0, 100},   // feedback
+         {3, PortType::InputAudio},
+         {4, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-chorus",
+     {
+         {0, PortType::InputControl, 0.5f, 0, 1}, // rate
+         {1, PortType::InputControl, 0.5f, 0, 1}, // depth
+         {2, PortType::InputAudio},
+         {3, PortType::OutputAudio},
+         {4, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-flanger",
+     {
+         {0, PortType::InputControl, 0.5f, 0, 1}, // manual
+         {1, PortType::InputControl, 0.5f, 0, 1}, // depth
+         {2, PortType::InputControl, 0.5f, 0, 1}, // rate
+         {3, PortType::OutputControl},            // lfo
+         {4, PortType::InputControl, 0.5f, 0, 1}, // res
+         {5, PortType::InputAudio},
+         {6, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-flanger-stereo",
+     {
+         {0, PortType::InputControl, 0.5f, 0, 1}, // manual
+         {1, PortType::InputControl, 0.5f, 0, 1}, // depth
+         {2, PortType::InputControl, 0.5f, 0, 1}, // rate
+         {3, PortType::OutputControl},            // lfo
+         {4, PortType::InputControl, 0.5f, 0, 1}, // res
+         {5, PortType::InputAudio},
+         {6, PortType::OutputAudio},
+         {7, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-freeverb",
+     {
+         {0, PortType::InputControl, 0.75f, 0, 1}, // dryWet
+         {1, PortType::InputControl, 0.5f, 0, 1},  // roomSize
+         {2, PortType::InputControl, 0, 0, 1},     // damping
+         {3, PortType::InputAudio},
+         {4, PortType::InputAudio},
+         {5, PortType::OutputAudio},
+         {6, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-mix",
+     {
+         {0, PortType::InputControl, 0, -60, 30}, // trimL
+         {1, PortType::InputControl, -1, -1, 1},  // panL
+         {2, PortType::InputControl, 0, -60, 30}, // trimR
+         {3, PortType::InputControl, 1, -1, 1},   // panR
+         {4, PortType::InputAudio},
+         {5, PortType::InputAudio},
+         {6, PortType::OutputAudio},
+         {7, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-volume",
+     {
+         {0, PortType::InputControl, 0, -60, 30}, // vol
+         {1, PortType::InputAudio},
+         {2, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-noise-gate",
+     {
+         {0, PortType::InputControl, -30, -60, 0},    // threshold
+         {1, PortType::InputControl, -6, -30, 0},     // hysteresis
+         {2, PortType::OutputControl},                // trigger_led
+         {3, PortType::InputControl, -60, -60, -6},   // reduction
+         {4, PortType::InputControl, 1, 1, 500},      // attack
+         {5, PortType::InputControl, 100, 10, 1000},  // hold
+         {6, PortType::InputControl, 330, 10, 5000},  // release
+         {7, PortType::OutputControl},                // gate_level
+         {8, PortType::InputAudio},
+         {9, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-ml",
+     {
+         {0, PortType::InputControl, 0, -30, 30},   // trim
+         {1, PortType::OutputControl},              // trimOut
+         {2, PortType::InputControl, -1, -1, 32},   // model
+         {3, PortType::InputControl, 3, 0, 10},     // gain
+         {4, PortType::InputControl, 0, -30, 30},   // master
+         {5, PortType::InputControl, 0.5f, 0, 1},   // bass
+         {6, PortType::InputControl, 0.5f, 0, 1},   // mid
+         {7, PortType::InputControl, 0.5f, 0, 1},   // treble
+         {8, PortType::InputControl, 0, 0, 1},      // sag
+         {9, PortType::InputControl, 0, 0, 1},      // sagd
+         {10, PortType::InputControl, 13, 5, 25},   // sagf
+         {11, PortType::OutputControl},             // gainEnable
+         {12, PortType::InputAudio},
+         {13, PortType::OutputAudio},
+         {14, PortType::InputAtomStream},
+         {15, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-spectrum",
+     {
+         {0, PortType::InputAudio},
+         {1, PortType::OutputAudio},
+         {2, PortType::InputAtomStream},
+         {3, PortType::OutputAtomStream},
+         {4, PortType::InputControl, 60, 10, 400},        // minF
+         {5, PortType::InputControl, 22000, 1000, 22000}, // maxF
+         {6, PortType::InputControl, 0, -30, 30},         // level
+     }},
+    {"http://two-play.com/plugins/toob-cab-ir",
+     {
+         {0, PortType::InputControl, -10, -40, 20},   // reverb_mix
+         {1, PortType::InputControl, -10, -40, 20},   // reverb_mix2
+         {2, PortType::InputControl, -10, -40, 20},   // reverb_mix3
+         {3, PortType::InputControl, 1.5f, 0.1f, 10}, // time
+         {4, PortType::InputControl, -40, -40, 20},   // direct_mix
+         {5, PortType::InputControl, 0, 0, 1},        // predelay
+         {6, PortType::OutputControl},                // loading_state
+         {7, PortType::InputAudio},
+         {8, PortType::OutputAudio},
+         {9, PortType::InputAtomStream},
+         {10, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-convolution-reverb-stereo",
+     {
+         {0, PortType::InputControl, 1.5f, 0.1f, 10}, // time
+         {1, PortType::InputControl, -40, -40, 20},   // direct_mix
+         {2, PortType::InputControl, -10, -40, 20},   // reverb_mix
+         {3, PortType::InputControl, 1, 0, 1},        // width
+         {4, PortType::InputControl, 0, -1, 1},       // pan
+         {5, PortType::InputControl, 1, 0, 1},        // predelay
+         {6, PortType::OutputControl},                // loading_state
+         {7, PortType::InputAudio},
+         {8, PortType::InputAudio},
+         {9, PortType::OutputAudio},
+         {10, PortType::OutputAudio},
+         {11, PortType::InputAtomStream},
+         {12, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-looper-one",
+     {
+         {0, PortType::InputControl, 0, 0, 1},      // control
+         {1, PortType::OutputControl},              // record_led
+         {2, PortType::OutputControl},              // play_led
+         {3, PortType::OutputControl},              // position
+         {4, PortType::OutputControl},              // loop_level
+         {5, PortType::OutputControl},              // bar_led
+         {6, PortType::OutputControl},              // beat_led
+         {7, PortType::InputControl, 120, 40, 240}, // tempo
+         {8, PortType::InputControl, 2, 0, 5},      // timesig
+         {9, PortType::InputControl, 1, 0, 2},      // rec_count_in
+         {10, PortType::InputControl, -25, -60, 0}, // trigger_level
+         {11, PortType::OutputControl},             // trigger_led
+         {12, PortType::InputControl, 0, 0, 32},    // bars
+         {13, PortType::InputControl, 0, 0, 1},     // rec_sync_option
+         {14, PortType::InputControl, 1, 1, 2},     // loop_end_option
+         {15, PortType::InputControl, 0, -60, 30},  // level
+         {16, PortType::InputAudio},
+         {17, PortType::OutputAudio},
+         {18, PortType::InputAtomStream},
+         {19, PortType::OutputAtomStream},
+         {20, PortType::InputAudio},
+         {21, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-looper-four",
+     {
+         {0, PortType::InputControl, 0, 0, 1},      // control1
+         {1, PortType::InputControl, 0, 0, 1},      // stop1
+         {2, PortType::InputControl, 0, 0, 1},      // record1
+         {3, PortType::OutputControl},              // record_led1
+         {4, PortType::InputControl, 0, 0, 1},      // play1
+         {5, PortType::OutputControl},              // play_led1
+         {6, PortType::OutputControl},              // position1
+         {7, PortType::InputControl, 0, 0, 1},      // control2
+         {8, PortType::InputControl, 0, 0, 1},      // stop2
+         {9, PortType::InputControl, 0, 0, 1},      // record2
+         {10, PortType::OutputControl},             // record_led2
+         {11, PortType::InputControl, 0, 0, 1},     // play2
+         {12, PortType::OutputControl},             // play_led2
+         {13, PortType::OutputControl},             // position2
+         {14, PortType::InputControl, 0, 0, 1},     // control3
+         {15, PortType::InputControl, 0, 0, 1},     // stop3
+         {16, PortType::InputControl, 0, 0, 1},     // record3
+         {17, PortType::OutputControl},             // record_led3
+         {18, PortType::InputControl, 0, 0, 1},     // play3
+         {19, PortType::OutputControl},             // play_led3
+         {20, PortType::OutputControl},             // position3
+         {21, PortType::InputControl, 0, 0, 1},     // control4
+         {22, PortType::InputControl, 0, 0, 1},     // stop4
+         {23, PortType::InputControl, 0, 0, 1},     // record4
+         {24, PortType::OutputControl},             // record_led4
+         {25, PortType::InputControl, 0, 0, 1},     // play4
+         {26, PortType::OutputControl},             // play_led4
+         {27, PortType::OutputControl},             // position4
+         {28, PortType::OutputControl},             // bar_led
+         {29, PortType::OutputControl},             // beat_led
+         {30, PortType::InputControl, 120, 40, 240}, // tempo
+         {31, PortType::InputControl, 2, 0, 5},      // timesig
+         {32, PortType::InputControl, 1, 0, 2},      // rec_count_in
+         {33, PortType::InputControl, -25, -60, 0},  // trigger_level
+         {34, PortType::OutputControl},              // trigger_led
+         {35, PortType::InputControl, 0, 0, 32},     // bars
+         {36, PortType::InputControl, 0, 0, 1},      // rec_sync_option
+         {37, PortType::InputControl, 1, 1, 2},      // loop_end_option
+         {38, PortType::InputControl, 0, -60, 30},   // level
+         {39, PortType::InputAudio},
+         {40, PortType::OutputAudio},
+         {41, PortType::InputAtomStream},
+         {42, PortType::OutputAtomStream},
+         {43, PortType::InputAudio},
+         {44, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-record-mono",
+     {
+         {0, PortType::InputControl, 0, 0, 1},     // stop
+         {1, PortType::InputControl, 0, 0, 1},     // record
+         {2, PortType::OutputControl},             // record_led
+         {3, PortType::InputControl, 0, 0, 1},     // play
+         {4, PortType::OutputControl},             // play_led
+         {5, PortType::OutputControl},             // record_time
+         {6, PortType::InputControl, 0, 0, 3},     // fformat
+         {7, PortType::InputControl, 0, -60, 30},  // level
+         {8, PortType::OutputControl},             // level_vu
+         {9, PortType::InputAudio},
+         {10, PortType::OutputAudio},
+         {11, PortType::InputAtomStream},
+         {12, PortType::OutputAtomStream},
+     }},
+    {"http://two-play.com/plugins/toob-record-stereo",
+     {
+         {0, PortType::InputControl, 0, 0, 1},     // stop
+         {1, PortType::InputControl, 0, 0, 1},     // record
+         {2, PortType::OutputControl},             // record_led
+         {3, PortType::InputControl, 0, 0, 1},     // play
+         {4, PortType::OutputControl},             // play_led
+         {5, PortType::OutputControl},             // record_time
+         {6, PortType::InputControl, 0, 0, 3},     // fformat
+         {7, PortType::InputControl, 0, -60, 30},  // level
+         {8, PortType::OutputControl},             // level_vu
+         {9, PortType::InputAudio},
+         {10, PortType::OutputAudio},
+         {11, PortType::InputAtomStream},
+         {12, PortType::OutputAtomStream},
+         {13, PortType::InputAudio},
+         {14, PortType::OutputAudio},
+     }},
+    {"http://two-play.com/plugins/toob-record-multitrack",
+     {
+         {0, PortType::InputControl, 0, 0, 1},     // stop
+         {1, PortType::InputControl, 0, 0, 1},     // record
+         {2, PortType::OutputControl},             // record_led
+         {3, PortType::InputControl, 0, 0, 1},     // play
+         {4, PortType::OutputControl},             // play_led
+         {5, PortType::OutputControl},             // record_time
+         {6, PortType::InputControl, 0, 0, 2},     // fformat
+         {7, PortType::InputControl, 0, -60, 30},  // level
+         {8, PortType::OutputControl},             // level_vu
+         {9, PortType::InputAudio},
+         {10, PortType::OutputAudio},
+         {11, PortType::InputAtomStream},
+         {12, PortType::OutputAtomStream},
+         {13, PortType::InputAudio},
+         {14, PortType::OutputAudio},
+         {15, PortType::InputControl, 3, 1, 8},    // tracks
+         {16, PortType::InputAudio},
+         {17, PortType::InputAudio},
+         {18, PortType::InputAudio},
+         {19, PortType::InputAudio},
+         {20, PortType::InputAudio},
+         {21, PortType::InputAudio},
+         {22, PortType::OutputAudio},
+         {23, PortType::OutputAudio},
+         {24, PortType::OutputAudio},
+         {25, PortType::OutputAudio},
+         {26, PortType::OutputAudio},
+         {27, PortType::OutputAudio},
+     }},
+};
+
+static const PluginSpec &FindPluginSpec(const char *uri)
+{
+    for (const PluginSpec &spec : pluginSpecs)
+    {
+        if (std::string(spec.uri) == uri)
+        {
+            return spec;
+        }
+    }
+    throw std::logic_error("Plugin spec not found.");
+}
+
+// Writes a small single-layer LSTM model in .nam format. The head weights are zero,
+// so the model's output is silent, which distinguishes it from the pass-through
+// that NeuralAmpModeler runs when no model is loaded.
+static void WriteNamModel(const std::filesystem::path &path)
+{
+    constexpr int HIDDEN_SIZE = 8;
+    constexpr int INPUT_SIZE = 1;
+
+    std::ofstream f(path);
+    f << "{\"version\": \"0.5.4\", \"architecture\": \"LSTM\", "
+      << "\"config\": {\"input_size\": " << INPUT_SIZE << ", \"hidden_size\": " << HIDDEN_SIZE << ", \"num_layers\": 1}, "
+      << "\"sample_rate\": " << SAMPLE_RATE << ", \"weights\": [";
+
+    // weights (4H x (I+H)), bias (4H), initial hidden state (H), initial cell state (H).
+    int layerWeights = 4 * HIDDEN_SIZE * (INPUT_SIZE + HIDDEN_SIZE) + 4 * HIDDEN_SIZE + 2 * HIDDEN_SIZE;
+    for (int i = 0; i < layerWeights; ++i)
+    {
+        f << 0.05 * ((i % 7) - 3) << ", ";
+    }
+    // head weights (H), head bias.
+    for (int i = 0; i < HIDDEN_SIZE; ++i)
+    {
+        f << "0, ";
+    }
+    f << "0]}" << std::endl;
+    if (!f)
+    {
+        throw std::runtime_error("Can't write model file.");
+    }
+}
+
+static void CheckNamModelLoaded(Lv2Host &host, HostedLv2Plugin *plugin)
+{
+    const float *out = plugin->GetOutputAudio(10);
+    for (int i = 0; i < HOST_BUFFER_SIZE; ++i)
+    {
+        TEST_ASSERT(std::abs(out[i]) < 1E-6f);
+    }
+    TEST_ASSERT(plugin->GetControlOutput(15) == 0.0f);
+
+    // LSTM models run at the host rate whatever the oversample setting, so no filter latency is reported.
+    plugin->SetControl(14, 1); // 2x
+    host.Run(HOST_BUFFER_SIZE);
+    TEST_ASSERT(plugin->GetControlOutput(15) == 0.0f);
+    plugin->SetControl(14, 0);
+    host.Run(HOST_BUFFER_SIZE);
+}
+
+static void CheckMlModelLoaded(Lv2Host &, HostedLv2Plugin *plugin)
+{
+    // gainEnable is set when a model with a gain input has been loaded.
+    TEST_ASSERT(plugin->GetControlOutput(11) == 1.0f);
+}
+
+static void RunBlocks(Lv2Host &host)
+{
+    for (int blockSize : blockSizes)
+    {
+        host.Run(blockSize);
+    }
+}
+
+static void CheckOutputs(HostedLv2Plugin *plugin, const PluginSpec &spec, int samples)
+{
+    for (const PortSpec &port : spec.ports)
+    {
+        if (port.type == PortType::OutputAudio)
+        {
+            const float *out = plugin->GetOutputAudio(port.index);
+            for (int i = 0; i < samples; ++i)
+            {
+                TEST_ASSERT(std::isfinite(out[i]));
+            }
+        }
+    }
+}
+
+static void TestPlugin(const std::string &libraryPath, const PluginSpec &spec, const ModelLoad *modelLoad = nullptr)
+{
+    std::cout << "    " << spec.uri;
+    if (modelLoad)
+    {
+        std::cout << " (" << modelLoad->path.filename().string() << ")";
+    }
+    std::cout << std::endl;
+
+    Lv2Host host((float)SAMPLE_RATE, HOST_BUFFER_SIZE);
+
+    HostedLv2Plugin *plugin = host.CreatePlugin(libraryPath.c_str(), spec.uri);
+    TEST_ASSERT(plugin != nullptr);
+
+    for (const PortSpec &port : spec.ports)
+    {
+        switch (port.type)
+        {
+        case PortType::InputControl:
+            plugin->SetPortType(port.index, port.type, port.defaultValue, port.minValue, port.maxValue);
+            break;
+        case PortType::InputAtomStream:
+        case PortType::OutputAtomStream:
+            plugin->SetPortType(port.index, port.type, ATOM_BUFFER_SIZE);
+            break;
+        default:
+            plugin->SetPortType(port.index, port.type);
+            break;
+        }
+    }
+    for (const PortSpec &port : spec.ports)
+    {
+        if (port.type == PortType::InputAudio)
+        {
+            // A decaying 110Hz tone, loud enough to open gates and excite the tuner.
+            float *input = plugin->GetInputAudio(port.index);
+            for (int i = 0; i < HOST_BUFFER_SIZE; ++i)
+            {
+                double t = i / SAMPLE_RATE;
+                input[i] = (float)(0.5 * std::exp(-t * 4) * std::sin(2 * std::numbers::pi * 110 * t));
+            }
+        }
+    }
+
+    host.Activate();
+
+    if (modelLoad)
+    {
+        int errorCount = host.GetLogErrorCount();
+        plugin->SetPathProperty(modelLoad->controlPort, modelLoad->propertyUri, modelLoad->path.c_str());
+
+        // The load completes in the first cycle; allow time for the new model to fade in.
+        for (int i = 0; i < (int)(SAMPLE_RATE * 2 / HOST_BUFFER_SIZE); ++i)
+        {
+            host.Run(HOST_BUFFER_SIZE);
+        }
+        TEST_ASSERT(host.GetLogErrorCount() == errorCount);
+        modelLoad->checkLoaded(host, plugin);
+    }
+
+    RunBlocks(host);
+    CheckOutputs(plugin, spec, blockSizes[std::size(blockSizes) - 1]);
+
+    // Control changes typically redesign filters or resize delay lines. Those must
+    // not allocate either.
+    for (const PortSpec &port : spec.ports)
+    {
+        if (port.type == PortType::InputControl)
+        {
+            for (float value : {port.minValue, (port.minValue + port.maxValue) * 0.5f, port.maxValue})
+            {
+                plugin->SetControl(port.index, value);
+                RunBlocks(host);
+            }
+            plugin->SetControl(port.index, port.defaultValue);
+        }
+    }
+    host.Run(HOST_BUFFER_SIZE);
+    CheckOutputs(plugin, spec, HOST_BUFFER_SIZE);
+
+    host.Deactivate();
+    host.DeletePlugin(plugin);
+}
+
+int main(int argc, char **argv)
+{
+    std::string libraryPath = "build/src/ToobAmp.so";
+    std::filesystem::path tonesDirectory = "src/ToobAmp.lv2/models/tones";
+    if (argc >= 2)
+    {
+        libraryPath = argv[1];
+    }
+    if (argc >= 3)
+    {
+        tonesDirectory = argv[2];
+    }
+
+    // The recorders and loopers write recordings, sessions and page files under HOME and TMPDIR.
+    std::filesystem::path workingDirectory =
+        std::filesystem::temp_directory_path() / ("PluginAllocationTest-" + std::to_string(getpid()));
+    std::filesystem::create_directories(workingDirectory);
+    setenv("HOME", workingDirectory.c_str(), 1);
+    setenv("TMPDIR", workingDirectory.c_str(), 1);
+
+    int result = EXIT_SUCCESS;
+    try
+    {
+        TEST_ASSERT(AllocationTrap::IsEnabled());
+
+        std::cout << "PluginAllocationTest" << std::endl;
+        for (const PluginSpec &spec : pluginSpecs)
+        {
+            TestPlugin(libraryPath, spec);
+        }
+
+        std::filesystem::path namModel = workingDirectory / "lstm.nam";
+        WriteNamModel(namModel);
+        ModelLoad namLoad{11, "http://two-play.com/plugins/toob-nam#modelFile", namModel, CheckNamModelLoaded};
+        TestPlugin(libraryPath, FindPluginSpec("http://two-play.com/plugins/toob-nam"), &namLoad);
+
+        ModelLoad mlLoad{14, "http://two-play.com/plugins/toob-ml#modelFile", tonesDirectory / "BluesJR.json", CheckMlModelLoaded};
+        TEST_ASSERT(std::filesystem::exists(mlLoad.path));
+        TestPlugin(libraryPath, FindPluginSpec("http://two-play.com/plugins/toob-ml"), &mlLoad);
+    }
+    catch (Lv2Exception &e)
+    {
+        std::cout << "Error: " << e.GetMessage() << std::endl;
+        result = EXIT_FAILURE;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        result = EXIT_FAILURE;
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(workingDirectory, ec);
+    return result;
+}
@@ -0,0 +1,136 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+    Measures CPU use per sample for each of the recurrent model architectures that ToobML supports.
+
+    Weights are random; only the architecture affects timing.
+*/
+
+#include "LsNumerics/BlockLstm.hpp"
+#include "LsNumerics/BlockGru.hpp"
+#include "LsNumerics/BlockRnnModel.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <memory>
+#include <cmath>
+
+using namespace LsNumerics;
+using namespace std;
+
+using FloatMatrix = std::vector<std::vector<float>>;
+
+static constexpr double SAMPLE_RATE = 48000;
+static constexpr size_t PROFILE_SAMPLES = (size_t)(SAMPLE_RATE * 10);
+
+static FloatMatrix RandomMatrix(std::mt19937 &rng, size_t rows, size_t columns)
+{
+    std::uniform_real_distribution<float> dist(-0.2f, 0.2f);
+    FloatMatrix result(rows);
+    for (auto &row : result)
+    {
+        row.resize(columns);
+        for (auto &v : row)
+        {
+            v = dist(rng);
+        }
+    }
+    return result;
+}
+
+template <template <int, int, int> class LAYER, int HIDDEN_SIZE, int N_GATES>
+static void Profile(const char *unitType, size_t numLayers)
+{
+    constexpr int N_INPUTS = 2;
+    using Model = BlockRnnModel<LAYER, N_INPUTS, HIDDEN_SIZE>;
+
+    std::mt19937 rng(HIDDEN_SIZE);
+    std::unique_ptr<Model> model = std::make_unique<Model>(numLayers);
+    for (size_t i = 0; i < numLayers; ++i)
+    {
+        model->SetLayerWeights(
+            i,
+            RandomMatrix(rng, N_GATES * HIDDEN_SIZE, i == 0 ? N_INPUTS : HIDDEN_SIZE),
+            RandomMatrix(rng, N_GATES * HIDDEN_SIZE, HIDDEN_SIZE),
+            RandomMatrix(rng, 1, N_GATES * HIDDEN_SIZE)[0],
+            RandomMatrix(rng, 1, N_GATES * HIDDEN_SIZE)[0]);
+    }
+    model->SetDenseWeights(RandomMatrix(rng, 1, HIDDEN_SIZE), RandomMatrix(rng, 1, 1)[0]);
+
+    std::unique_ptr<typename Model::InputBlock> input = std::make_unique<typename Model::InputBlock>();
+    for (int i = 0; i < Model::MAX_BLOCK; ++i)
+    {
+        (*input)(0, i) = (float)(0.5 * std::sin(i * 0.1));
+        (*input)(1, i) = 0.5f;
+    }
+    float output[Model::MAX_BLOCK];
+    float sum = 0; // keep the optimizer honest.
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < PROFILE_SAMPLES; i += Model::MAX_BLOCK)
+    {
+        model->Process(Model::MAX_BLOCK, *input, output);
+        sum += output[0];
+    }
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    double nsPerSample = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double)PROFILE_SAMPLES;
+    double cpuPercent = nsPerSample * 1E-9 * SAMPLE_RATE * 100;
+
+    cout << setw(5) << unitType
+         << setw(8) << HIDDEN_SIZE
+         << setw(8) << numLayers
+         << setw(14) << fixed << setprecision(1) << nsPerSample
+         << setw(12) << setprecision(2) << cpuPercent
+         << (std::isfinite(sum) ? "" : " (overflow)")
+         << endl;
+}
+
+template <template <int, int, int> class LAYER, int N_GATES>
+static void ProfileUnitType(const char *unitType)
+{
+    for (size_t numLayers = 1; numLayers <= 2; ++numLayers)
+    {
+        Profile<LAYER, 8, N_GATES>(unitType, numLayers);
+        Profile<LAYER, 12, N_GATES>(unitType, numLayers);
+        Profile<LAYER, 16, N_GATES>(unitType, numLayers);
+        Profile<LAYER, 20, N_GATES>(unitType, numLayers);
+        Profile<LAYER, 32, N_GATES>(unitType, numLayers);
+        Profile<LAYER, 40, N_GATES>(unitType, numLayers);
+    }
+}
+
+int main(int, char **)
+{
+    cout << "ProfileToobMlModels" << endl;
+    cout << endl;
+    cout << " Unit  Hidden  Layers   ns/sample  CPU@48kHz%" << endl;
+
+    ProfileUnitType<BlockGruLayer, 3>("GRU");
+    ProfileUnitType<BlockLstmLayer, 4>("LSTM");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#define NO_MLOCK
+#include "record_plugins/ToobRingBuffer.hpp"
+#include "TestAssert.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace toob;
+using namespace std;
+
+using clock_type = std::chrono::steady_clock;
+
+static void TestTimeoutAndClose()
+{
+    ToobRingBuffer<false, true> ringBuffer(1024);
+
+    auto status = ringBuffer.readWait_for(std::chrono::milliseconds(20));
+    TEST_ASSERT(status == RingBufferStatus::TimedOut);
+
+    uint32_t value = 0x12345678;
+    TEST_ASSERT(ringBuffer.write_packet(sizeof(value), &value));
+    TEST_ASSERT(ringBuffer.readWait_for(std::chrono::milliseconds(20)) == RingBufferStatus::Ready);
+    TEST_ASSERT(ringBuffer.peekSize() == sizeof(value));
+    uint32_t result = 0;
+    TEST_ASSERT(ringBuffer.read_packet(sizeof(result), &result) == sizeof(result));
+    TEST_ASSERT(result == value);
+
+    std::jthread closer([&ringBuffer]()
+                        {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ringBuffer.close(); });
+    TEST_ASSERT(!ringBuffer.readWait());
+}
+
+static void TestFullBuffer()
+{
+    ToobRingBuffer<false, false> ringBuffer(256);
+    uint8_t data[64];
+    std::memset(data, 0xA5, sizeof(data));
+
+    // each packet takes 64 bytes of data plus a size_t header.
+    size_t written = 0;
+    while (ringBuffer.write_packet(sizeof(data), data))
+    {
+        ++written;
+    }
+    TEST_ASSERT(written == 256 / (sizeof(data) + sizeof(size_t)));
+
+    size_t read = 0;
+    while (ringBuffer.peekSize() != 0)
+    {
+        uint8_t result[64];
+        TEST_ASSERT(ringBuffer.read_packet(sizeof(result), result) == sizeof(result));
+        TEST_ASSERT(std::memcmp(result, data, sizeof(data)) == 0);
+        ++read;
+    }
+    TEST_ASSERT(read == written);
+    TEST_ASSERT(ringBuffer.writeSpace() == 256);
+}
+
+// One writer thread, paced roughly like an audio thread, and one reader that sleeps in readWait().
+// Every packet must arrive, in order, intact. Reports write_packet latency.
+static void StressTest()
+{
+    constexpr size_t MESSAGES = 2000000;
+    constexpr size_t MAX_PAYLOAD = 64;
+
+    ToobRingBuffer<false, true> ringBuffer(4096);
+
+    std::vector<clock_type::duration> latencies;
+    latencies.reserve(MESSAGES);
+    size_t retries = 0;
+
+    std::jthread writer([&]()
+                        {
+        uint64_t message[MAX_PAYLOAD / sizeof(uint64_t) + 1];
+        for (uint64_t i = 0; i < MESSAGES; ++i)
+        {
+            size_t words = 1 + (i % (MAX_PAYLOAD / sizeof(uint64_t)));
+            for (size_t w = 0; w < words; ++w)
+            {
+                message[w] = i * 31 + w;
+            }
+            while (true)
+            {
+                auto start = clock_type::now();
+                bool written = ringBuffer.write_packet(words * sizeof(uint64_t), message);
+                auto elapsed = clock_type::now() - start;
+                if (written)
+                {
+                    latencies.push_back(elapsed);
+                    break;
+                }
+                ++retries;
+                std::this_thread::yield();
+            }
+            if (i % 1024 == 0)
+            {
+                // Let the reader go to sleep once in a while, so that the wake path is exercised.
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        } });
+
+    uint64_t message[MAX_PAYLOAD / sizeof(uint64_t) + 1];
+    for (uint64_t i = 0; i < MESSAGES; ++i)
+    {
+        TEST_ASSERT(ringBuffer.readWait());
+        size_t size = ringBuffer.read_packet(sizeof(message), message);
+        size_t words = 1 + (i % (MAX_PAYLOAD / sizeof(uint64_t)));
+        TEST_ASSERT(size == words * sizeof(uint64_t));
+        for (size_t w = 0; w < words; ++w)
+        {
+            TEST_ASSERT(message[w] == i * 31 + w);
+        }
+    }
+    writer.join();
+    TEST_ASSERT(ringBuffer.peekSize() == 0);
+
+    std::sort(latencies.begin(), latencies.end());
+    auto ns = [](clock_type::duration d)
+    { return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(); };
+    cout << "write_packet latency (ns): "
+         << " median " << ns(latencies[latencies.size() / 2])
+         << " p99 " << ns(latencies[latencies.size() * 99 / 100])
+         << " p99.99 " << ns(latencies[latencies.size() * 9999 / 10000])
+         << " max " << ns(latencies.back())
+         << " (" << retries << " retries on a full buffer)" << endl;
+}
+
+int main(void)
+{
+    try
+    {
+        TestTimeoutAndClose();
+        TestFullBuffer();
+        StressTest();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
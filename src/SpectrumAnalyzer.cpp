@@ -40,12 +40,17 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <string.h>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
 #include "LsNumerics/LsMath.hpp"
 #include "LsNumerics/Window.hpp"
+#include "SpectrumFrame.hpp"
+#include "SpectrumBands.hpp"
 
 using namespace std;
 using namespace toob;
 using namespace LsNumerics;
+using namespace toob::spectrum_bands;
 
 #ifndef _MSC_VER
 #include <unistd.h>
@@ -56,7 +61,6 @@ using namespace LsNumerics;
 
 
 
-constexpr size_t MAX_BLOCKSIZE = 32*1024;
 const char *SpectrumAnalyzer::URI = SPECTRUM_ANALZER_URI;
 
 uint64_t timeMs();
@@ -111,7 +115,7 @@ void SpectrumAnalyzer::ConnectPort(uint32_t port, void *data)
 
 void SpectrumAnalyzer::Activate()
 {
-	fftWorker.Initialize(getSampleRate(),FFT_SIZE,minF.GetValue(),maxF.GetValue(),level.GetValue());
+	fftWorker.Initialize(getSampleRate(),minF.GetValue(),maxF.GetValue(),level.GetValue());
 }
 void SpectrumAnalyzer::Deactivate()
 {
@@ -149,9 +153,9 @@ void SpectrumAnalyzer::Run(uint32_t n_samples)
 	fftWorker.Capture(n_samples,inputL);
 
 
-	if (this->svgPathReady)
+	if (this->spectrumReady)
 	{
-		this->svgPathReady = false;
+		this->spectrumReady = false;
 		WriteSpectrum();
 		fftWorker.OnWriteComplete();
 	}
@@ -162,33 +166,52 @@ void SpectrumAnalyzer::Run(uint32_t n_samples)
 
 void SpectrumAnalyzer::WriteSpectrum()
 {
-	if (!enabled)
-		return;
-	lv2_atom_forge_frame_time(&forge, 0);
+	if (this->pSvgPath && enabledCount != 0)
+	{
+		lv2_atom_forge_frame_time(&forge, 0);
 
-	LV2_Atom_Forge_Frame objectFrame;
+		LV2_Atom_Forge_Frame objectFrame;
 
-	lv2_atom_forge_object(&forge, &objectFrame, 0, urids.patch__Set);
-	lv2_atom_forge_key(&forge, urids.patch__property);
-	lv2_atom_forge_urid(&forge, urids.patchProperty__spectrumResponse);
+		lv2_atom_forge_object(&forge, &objectFrame, 0, urids.patch__Set);
+		lv2_atom_forge_key(&forge, urids.patch__property);
+		lv2_atom_forge_urid(&forge, urids.patchProperty__spectrumResponse);
 
-	lv2_atom_forge_key(&forge, urids.patch__value);
-	LV2_Atom_Forge_Frame tupleFrame;
-	lv2_atom_forge_tuple(&forge,&tupleFrame);
-	{
-		lv2_atom_forge_string(&forge, this->pSvgPath->c_str(), (uint32_t)(this->pSvgPath->length()));
-		lv2_atom_forge_string(&forge, this->pSvgHoldPath->c_str(), (uint32_t)(this->pSvgHoldPath->length()));
+		lv2_atom_forge_key(&forge, urids.patch__value);
+		LV2_Atom_Forge_Frame tupleFrame;
+		lv2_atom_forge_tuple(&forge,&tupleFrame);
+		{
+			lv2_atom_forge_string(&forge, this->pSvgPath->c_str(), (uint32_t)(this->pSvgPath->length()));
+			lv2_atom_forge_string(&forge, this->pSvgHoldPath->c_str(), (uint32_t)(this->pSvgHoldPath->length()));
+		}
+		lv2_atom_forge_pop(&forge,&tupleFrame);
+
+		lv2_atom_forge_pop(&forge, &objectFrame);
 	}
-	lv2_atom_forge_pop(&forge,&tupleFrame);
+	if (this->pSpectrumFrame && frameEnabledCount != 0)
+	{
+		lv2_atom_forge_frame_time(&forge, 0);
+
+		LV2_Atom_Forge_Frame objectFrame;
+
+		lv2_atom_forge_object(&forge, &objectFrame, 0, urids.patch__Set);
+		lv2_atom_forge_key(&forge, urids.patch__property);
+		lv2_atom_forge_urid(&forge, urids.patchProperty__spectrumFrame);
+
+		lv2_atom_forge_key(&forge, urids.patch__value);
+		lv2_atom_forge_vector(
+			&forge, sizeof(float), urids.atom__float,
+			(uint32_t)this->pSpectrumFrame->size(), this->pSpectrumFrame->data());
 
-	lv2_atom_forge_pop(&forge, &objectFrame);
+		lv2_atom_forge_pop(&forge, &objectFrame);
+	}
 }
 
-void SpectrumAnalyzer::OnSvgPathReady(const std::string &svgPath,const std::string&svgHoldPath)
+void SpectrumAnalyzer::OnSpectrumReady(const std::string *svgPath, const std::string *svgHoldPath, const std::vector<float> *frame)
 {
-	this->svgPathReady = true;
-	this->pSvgPath = &svgPath;
-	this->pSvgHoldPath = &svgHoldPath;
+	this->spectrumReady = true;
+	this->pSvgPath = svgPath;
+	this->pSvgHoldPath = svgHoldPath;
+	this->pSpectrumFrame = frame;
 }
 
 void SpectrumAnalyzer::HandleEvent(LV2_Atom_Event *event)
@@ -241,22 +264,18 @@ void SpectrumAnalyzer::HandleEvent(LV2_Atom_Event *event)
 
 void SpectrumAnalyzer::OnPatchSet(LV2_URID propertyUrid, const LV2_Atom*value) 
 {
-	if (propertyUrid == urids.patchProperty__spectrumEnable)
+	if (propertyUrid == urids.patchProperty__spectrumEnable || propertyUrid == urids.patchProperty__spectrumFrameEnable)
 	{
 		LV2_Atom_Bool *pVal = (LV2_Atom_Bool*)value;
 		bool enabledVal = pVal->body != 0;
+		int64_t &count = propertyUrid == urids.patchProperty__spectrumEnable ? enabledCount : frameEnabledCount;
 		if (enabledVal)
 		{
-			++enabledCount;
+			++count;
 		} else {
-			--enabledCount;
-		}
-		bool enabled = enabledCount != 0;
-		if (enabled != this->enabled)
-		{
-			this->enabled = enabled;
-			fftWorker.SetEnabled(enabled);
+			--count;
 		}
+		fftWorker.SetEnabled(enabledCount != 0, frameEnabledCount != 0);
 	}
 }
 
@@ -266,7 +285,6 @@ void SpectrumAnalyzer::OnPatchGet(LV2_URID propertyUrid)
 {
 }
 
-const int SPECTRUM_POINTS = 200;
 
 void SpectrumAnalyzer::FftWorker::Reset()
 {
@@ -293,8 +311,12 @@ void SpectrumAnalyzer::FftWorker::Reinitialize(float minFrequency,float maxFrequ
 	sampleCount = 0;
 }
 
-void SpectrumAnalyzer::FftWorker::SetEnabled(bool enabled)
+void SpectrumAnalyzer::FftWorker::SetEnabled(bool svgEnabled, bool frameEnabled)
 {
+	this->svgEnabled = svgEnabled;
+	this->frameEnabled = frameEnabled;
+
+	bool enabled = svgEnabled || frameEnabled;
 	if (this->enabled != enabled)
 	{
 		this->enabled = enabled;
@@ -315,50 +337,73 @@ void SpectrumAnalyzer::FftWorker::BackgroundTask::Initialize(FftWorker*fftWorker
 {
 
 	this->samplesPerUpdate = fftWorker->samplesPerUpdate;
-	blockSize = fftWorker->blockSize;
 	this->sampleRate = fftWorker->sampleRate;
 
-	fft.SetSize(blockSize);
-	fftResult.resize(blockSize);
+	bandCount = BandCount(sampleRate);
 
+	bool newSubscription = !fftWorker->analysisBus;
+	if (newSubscription)
+	{
+		fftWorker->analysisBus = AnalysisBus::Subscribe(sampleRate);
+	}
+	else
+	{
+		fftWorker->analysisBus->Reset();
+	}
+	this->analysisBus = fftWorker->analysisBus.get();
 
-	this->norm = 2/std::sqrt(blockSize);
+	bands.resize(bandCount);
+	for (size_t i = 0; i < bandCount; ++i)
+	{
+		Band &band = bands[i];
+		AnalysisBus::StftConfig config = BandStftConfig(sampleRate,i);
+		if (newSubscription)
+		{
+			band.stft = analysisBus->AddStft(config);
+		}
+		band.nextFrame = 0;
+		band.fftSize = config.fftSize;
 
+		std::vector<double> fftWindow = LsNumerics::Window::Hann<double>((int)band.fftSize);
+		double windowSum = 0;
+		for (double w : fftWindow)
+		{
+			windowSum += w;
+		}
+		// StagedFft scales by 1/sqrt(N). A full-scale sine reads 0dB.
+		band.norm = 2*std::sqrt((double)band.fftSize)/windowSum;
 
-	fftValues.resize(blockSize/2);
-	fftHoldValues.resize(blockSize/2);
-	fftHoldTimes.resize(0);
-	fftHoldTimes.resize(blockSize/2);
+		band.power.resize(band.fftSize/2);
+		band.fftValues.resize(0);
+		band.fftValues.resize(band.fftSize/2,spectrum_frame::MIN_DB);
+		band.binsPerHz = band.fftSize/BandSampleRate(sampleRate,i);
+	}
+
+	holdValues.resize(spectrum_frame::BIN_COUNT);
+	holdTimes.resize(0);
+	holdTimes.resize(spectrum_frame::BIN_COUNT);
 
 	constexpr float HOLD_TIME_SECONDS = 2.0;
 	this->holdSamples = (size_t)(sampleRate*HOLD_TIME_SECONDS);
-	if (holdSamples < blockSize) holdSamples = blockSize;
 	constexpr float DECAY_TIME = 2.0;
 
 	this->holdDecay = -60*(samplesPerUpdate/(DECAY_TIME*sampleRate));
 
-	fftWindow = LsNumerics::Window::FlatTop<double>(blockSize);
+	binEdges.resize(spectrum_frame::BIN_COUNT + 1);
+	binBands.resize(spectrum_frame::BIN_COUNT);
+	binMinFrequency = binMaxFrequency = 0; // force a layout update.
+	frame.resize(spectrum_frame::FRAME_SIZE);
+	svgPath.reserve(4096);
+	svgHoldPath.reserve(4096);
 }
-void SpectrumAnalyzer::FftWorker::Initialize(double sampleRate, size_t blockSize, float minFrequency,float maxFrequency, float dbLevel)
+void SpectrumAnalyzer::FftWorker::Initialize(double sampleRate, float minFrequency,float maxFrequency, float dbLevel)
 {
-
-	captureBuffer.resize(MAX_BUFFER_SIZE + sampleRate*0.5);
-
 	this->sampleRate = sampleRate;
 	this->minFrequency = minFrequency;
 	this->maxFrequency = maxFrequency;
 	this->dbLevel = dbLevel;
-	size_t t = 1;
-	while (t < blockSize)
-	{
-		t <<= 1;
-	}
-	if (t < 1024) t = 1024;
-	if (t > MAX_BLOCKSIZE) t = MAX_BLOCKSIZE;
-
-	this->blockSize = blockSize;
 
-	this->samplesPerUpdate = (size_t)(sampleRate/FRAMES_PER_SECOND);
+	this->samplesPerUpdate = (size_t)(sampleRate/UPDATES_PER_SECOND);
 	backgroundTask.Initialize(this);
 	Reset();
 }
@@ -381,161 +426,171 @@ void SpectrumAnalyzer::FftWorker::BackgroundTask::CaptureData(FftWorker *fftWork
 	fftWorker->resetHoldValues = false;
 	this->minFrequency = fftWorker->minFrequency;
 	this->maxFrequency = fftWorker->maxFrequency;
-
-	this->capturePosition = fftWorker->captureIndex;
-	this->pCaptureBuffer = &(fftWorker->captureBuffer);
+	this->svgEnabled = fftWorker->svgEnabled;
+	this->frameEnabled = fftWorker->frameEnabled;
 }
 
-void SpectrumAnalyzer::FftWorker::BackgroundTask::CopyFromCaptureBuffer()
+// Welch average of the band's frames since the last update. Low bands don't get a new frame on every update,
+// and keep their previous values until they do.
+void SpectrumAnalyzer::FftWorker::BackgroundTask::CalculateBandSpectrum(Band &band, float dbLevel)
 {
-	size_t captureStart = this->capturePosition;
-	if (capturePosition < blockSize)
+	size_t fftCount = 0;
+	std::fill(band.power.begin(),band.power.end(),0.0);
+	analysisBus->ReadFrames(
+		band.stft,
+		band.nextFrame,
+		[&band, &fftCount](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+		{
+			for (size_t i = 0; i < band.power.size(); ++i)
+			{
+				band.power[i] += std::norm(spectrum[i]);
+			}
+			++fftCount;
+		});
+	if (fftCount == 0)
 	{
-		captureStart = pCaptureBuffer->size()-(blockSize-capturePosition);
-	} else {
-		captureStart = capturePosition - blockSize;
+		return;
 	}
-	size_t captureEnd = captureStart+blockSize;
-
-	if (captureEnd <= pCaptureBuffer->size())
+	double scale = band.norm*band.norm/fftCount;
+	for (size_t i = 0; i < band.fftValues.size(); ++i)
 	{
-		// we can do it in one go.
-		size_t ix = 0;
-		for (size_t i = captureStart; i < captureEnd;++i)
-		{
-			float value = (*pCaptureBuffer)[i];
-			fftResult[ix++] = std::complex<double>(value,0);
-		}
-	} else {
-		// data wraps around. Two segments.
-		captureEnd -= pCaptureBuffer->size();
-
-		size_t ix = 0;
-		for (size_t i = captureStart; i < pCaptureBuffer->size(); ++i)
-		{
-			float value = (*pCaptureBuffer)[i];
-			fftResult[ix++] = std::complex<double>(value,0);
-		}
-		for (size_t i = 0; i < captureEnd;++i)
-		{
-			float value = (*pCaptureBuffer)[i];
-			fftResult[ix++] = std::complex<double>(value,0);
-		}
+		band.fftValues[i] = (float)(10*std::log10(band.power[i]*scale + 1E-30)) + dbLevel;
 	}
 }
-void SpectrumAnalyzer::FftWorker::BackgroundTask::CalculateSvgPaths(size_t blockSize,float minF, float maxF, float dbLevel)
+
+void SpectrumAnalyzer::FftWorker::BackgroundTask::CalculateSpectrum(float minF, float maxF, float dbLevel)
 {
+	using namespace spectrum_frame;
+
 	if (this->resetHoldValues)
 	{
 		this->resetHoldValues = false;
 
-		for (size_t i = 0; i < fftHoldValues.size(); ++i)
+		for (size_t i = 0; i < holdValues.size(); ++i)
 		{
-			fftHoldValues[i] = -200;
+			holdValues[i] = MIN_DB;
 		}
 	}
 
-	// copy fft data out of the capture buffer.
-	CopyFromCaptureBuffer();
-
-
-	fft.Forward(fftResult,fftResult);
-
-
-	for (size_t i = 0; i < fftValues.size(); ++i)
+	UpdateBinLayout();
+	for (Band &band : bands)
 	{
-		fftValues[i] = Af2Db(norm*std::abs(fftResult[i]))+ dbLevel;
+		if (band.active)
+		{
+			CalculateBandSpectrum(band,dbLevel);
+		}
 	}
 
-	for (size_t i = 0; i < fftValues.size(); ++i)
+	frame[MIN_F_INDEX] = binMinFrequency;
+	frame[MAX_F_INDEX] = binMaxFrequency;
+	frame[BIN_COUNT_INDEX] = (float)BIN_COUNT;
+	float *values = &frame[HEADER_SIZE];
+	BinSpectrum(values);
+
+	for (size_t i = 0; i < BIN_COUNT; ++i)
 	{
-		float x = fftHoldValues[i];
-		int64_t t = fftHoldTimes[i];
+		float x = holdValues[i];
+		int64_t t = holdTimes[i];
 		t -= samplesPerUpdate;
 		if (t <= 0)
 		{
 			t = 0;
 			x += this->holdDecay;
-			if (x < -200)
+			if (x < MIN_DB)
 			{
-				x = -200;
+				x = MIN_DB;
 			}
 		} 
-		float result = fftValues[i];
+		float result = values[i];
 		if (result > x)
 		{
 			x = result;
 			t = this->holdSamples;
 		}
-		fftHoldValues[i] = x;
-		fftHoldTimes[i] = t;
+		holdValues[i] = x;
+		holdTimes[i] = t;
 	}
+	std::copy(holdValues.begin(),holdValues.end(),&frame[HEADER_SIZE + BIN_COUNT]);
 
-	this->svgPath = FftToSvg(fftValues);
-	this->svgHoldPath = FftToSvg(fftHoldValues);
+	if (svgEnabled)
+	{
+		this->svgPath = FftToSvg(&frame[HEADER_SIZE]);
+		this->svgHoldPath = FftToSvg(&frame[HEADER_SIZE + BIN_COUNT]);
+	}
 }
-std::string SpectrumAnalyzer::FftWorker::BackgroundTask::FftToSvg(const std::vector<float>& fft)
+
+void SpectrumAnalyzer::FftWorker::BackgroundTask::UpdateBinLayout()
 {
-	int lastX = 0;
-	int lastValue = 1000;
+	if (minFrequency == binMinFrequency && maxFrequency == binMaxFrequency)
+	{
+		return;
+	}
+	binMinFrequency = minFrequency;
+	binMaxFrequency = maxFrequency;
 
-	float logMinF = std::log(minFrequency);
-	float logMaxF = std::log(maxFrequency);
+	double logMinF = std::log(minFrequency);
+	double logMaxF = std::log(maxFrequency);
+	size_t binCount = binEdges.size() - 1;
+	for (size_t i = 0; i < binEdges.size(); ++i)
+	{
+		binEdges[i] = std::exp(logMinF + (logMaxF - logMinF) * i / binCount);
+	}
+	for (Band &band : bands)
+	{
+		band.active = false;
+	}
+	for (size_t bin = 0; bin < binCount; ++bin)
+	{
+		double f = std::sqrt(binEdges[bin]*binEdges[bin+1]);
+		size_t band = BandForFrequency(sampleRate,f,bandCount);
+		binBands[bin] = (uint8_t)band;
+		bands[band].active = true;
+	}
+}
 
-	std::stringstream s;
-	s << std::setprecision(4); 
-	s << "M0,1000";
-	for (size_t i = 1; i < fft.size(); ++i) // "= 1": ignore DC since the window function gives is a DC that fluctuates wildly.
+// Log-frequency bins take the peak of the fft bins they cover in their band's spectrum. Bins too narrow to contain an
+// fft bin are interpolated from their neighbours instead.
+void SpectrumAnalyzer::FftWorker::BackgroundTask::BinSpectrum(float *output)
+{
+	size_t binCount = binEdges.size() - 1;
+	for (size_t bin = 0; bin < binCount; ++bin)
 	{
-		float mag = fft[i];
-		if (mag < -150) mag = -150;
-		float f = i*sampleRate/blockSize;
-		float logF = std::log(f);
-		int x = (logF-logMinF)*SPECTRUM_POINTS/(logMaxF-logMinF);
-		constexpr float MAX_DB = 0;
-		constexpr float MIN_DB = -80;
-		constexpr float MAX_Y = 0;
-		constexpr float MIN_Y = 1000;
-		constexpr float SCALE = (MAX_Y-MIN_Y)/(MAX_DB-MIN_DB);
-
-		float value = (mag-MIN_DB)*SCALE+MIN_Y;
-
-		if (lastX != x)
+		const Band &band = bands[binBands[bin]];
+		const std::vector<float> &fft = band.fftValues;
+		size_t maxIndex = fft.size() - 1;
+		double lowerEdge = binEdges[bin]*band.binsPerHz;
+		double upperEdge = binEdges[bin+1]*band.binsPerHz;
+
+		// ">= 1": ignore DC, which fluctuates wildly.
+		size_t start = std::max((size_t)1, (size_t)std::ceil(lowerEdge));
+		size_t end = std::min(maxIndex + 1, (size_t)std::ceil(upperEdge));
+
+		float value;
+		if (start < end)
 		{
-
-			if (x >= 0)
+			value = fft[start];
+			for (size_t i = start + 1; i < end; ++i)
 			{
-				if (x >= SPECTRUM_POINTS) 
-				{
-					float blend = (SPECTRUM_POINTS-lastX)/(x-lastX);
-					float xN = lastValue*(1-blend)+value*blend;
-					s << " L" << SPECTRUM_POINTS << ',' << (int)std::round(xN);	
-					break;
-				}
-				else if (lastX < 0 && x != 0)
-				{
-					float blend = -lastX/(x-lastX);
-					float x0 = lastValue*(1-blend)+value*blend;
-				
-					s << " L" << 0 << ',' << (int)std::round(x0);	
-					s << " L" << x << ',' << (int)std::round(value);	
-				} else {
-					s << " L" << x << ',' << value;
-				}
-			}
-			lastX = x;
-			lastValue = value;
-		} else {
-			if (x == lastX && value < lastValue) {
-				lastValue = value;
+				value = std::max(value, fft[i]);
 			}
 		}
+		else
+		{
+			double x = std::clamp((lowerEdge + upperEdge) * 0.5, 1.0, (double)maxIndex);
+			size_t i = std::min((size_t)x, maxIndex - 1);
+			double blend = x - i;
+			value = (float)(fft[i] * (1 - blend) + fft[i + 1] * blend);
+		}
+		output[bin] = std::max(value, spectrum_frame::MIN_DB);
 	}
-	s << " L" << lastX << "," << (int)std::round(lastValue);
-	s << " L" << lastX << "," << 1000;
-	s << " L" << 0 << "," << 1000; // close the path.
-		
-	return s.str();
+}
+
+std::string SpectrumAnalyzer::FftWorker::BackgroundTask::FftToSvg(const float *bins)
+{
+	svgWriter.Clear();
+	svgWriter.SetPrecision(4);
+	svgWriter.SpectrumPlot(bins, binEdges.size() - 1);
+	return svgWriter.String();
 }
 
 
@@ -46,7 +46,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Filters/ShelvingLowCutFilter2.h"
 #include "NoiseGate.h"
 #include "GainStage.h"
-#include "LsNumerics/StagedFft.hpp"
+#include "AnalysisBus.hpp"
+#include "SvgPathWriter.hpp"
 
 
 
@@ -67,23 +68,19 @@ namespace toob {
 			MAX_F,
 			LEVEL
 		};
-		static constexpr size_t MAX_BUFFER_SIZE = 16*1024;
-		static constexpr size_t FFT_SIZE = 16*1024;
-
 		RangedInputPort minF = RangedInputPort(10.0f, 400.0f);
 		RangedInputPort maxF = RangedInputPort(1000.0f,22000.0f);
 		RangedInputPort level = RangedInputPort(-30,30);
 
-		bool svgPathReady = false;
+		bool spectrumReady = false;
 		const std::string *pSvgPath = nullptr;
 		const std::string *pSvgHoldPath = nullptr;
+		const std::vector<float> *pSpectrumFrame = nullptr;
 
 
 		class FftWorker: public WorkerAction
 		{
 		private: 
-			static constexpr float FRAMES_PER_SECOND = 15;
-
 			enum class FftState {
 				Idle,
 				Capturing,
@@ -93,19 +90,20 @@ namespace toob {
 			};
 			FftState state = FftState::Idle;
 			bool enabled = false;
+			bool svgEnabled = false;
+			bool frameEnabled = false;
 			double sampleRate;
-			size_t captureIndex = 0;
 			size_t samplesPerUpdate = 0;
 			size_t sampleCount = 0;
 
 			SpectrumAnalyzer*pThis;
-			size_t blockSize;
 			float minFrequency;
 			float maxFrequency;
 			float dbLevel;
 			bool resetHoldValues = true;
 
-			std::vector<float> captureBuffer;
+			// shared with other plugins watching the same signal.
+			AnalysisBus::Subscription::ptr analysisBus;
 
 
 		public:
@@ -114,11 +112,12 @@ namespace toob {
 				pThis(pThis)
 			{
 			}
-			void Initialize(double sampleRate, size_t blockSize, float minFrequency,float maxFrequency,float dbLevel);
+			void Initialize(double sampleRate, float minFrequency,float maxFrequency,float dbLevel);
 			void Reinitialize(float minFrequency, float maxFrequency, float dbLevel);
 			void Reset();
 			void Deactivate();
-			void SetEnabled(bool enabled);
+			// SVG paths and binary frames are each only computed while some client wants them.
+			void SetEnabled(bool svgEnabled, bool frameEnabled);
 			void OnWriteComplete()
 			{
 				this->state = FftState::Idle;
@@ -128,14 +127,7 @@ namespace toob {
 
 			void Capture(size_t nSamples, const float*values)
 			{
-				for (size_t i = 0; i < nSamples; ++i)
-				{
-					captureBuffer[captureIndex++] = values[i];
-					if (captureIndex >= captureBuffer.size())
-					{
-						captureIndex = 0;
-					}
-				}
+				analysisBus->Write(values,nSamples);
 				if (sampleCount < this->samplesPerUpdate)
 				{
 					sampleCount += nSamples;
@@ -150,33 +142,45 @@ namespace toob {
 					}
 				}
 			}
-			size_t GetBlockSize()
-			{
-				return blockSize;
-			}
 		protected:
 			void OnWork() {
-				backgroundTask.CalculateSvgPaths(blockSize,minFrequency,maxFrequency,dbLevel);
+				backgroundTask.CalculateSpectrum(minFrequency,maxFrequency,dbLevel);
 			}
 			void OnResponse()
 			{
-				pThis->OnSvgPathReady(this->backgroundTask.svgPath,this->backgroundTask.svgHoldPath);
+				pThis->OnSpectrumReady(
+					backgroundTask.svgEnabled ? &backgroundTask.svgPath : nullptr,
+					backgroundTask.svgEnabled ? &backgroundTask.svgHoldPath : nullptr,
+					backgroundTask.frameEnabled ? &backgroundTask.frame : nullptr);
 			}
 
 		private:
 			struct BackgroundTask
 			{
 			private:
-				std::vector<float> *pCaptureBuffer;
-				size_t capturePosition;
-				std::vector<float> fftValues;
-				std::vector<float> fftHoldValues;
-				std::vector<int64_t> fftHoldTimes;
-				std::vector<std::complex<double>> fftResult;
+				// One octave of the multi-resolution analysis. See spectrum_bands for the layout.
+				struct Band
+				{
+					size_t stft = 0; // analysis bus id.
+					uint64_t nextFrame = 0;
+					size_t fftSize = 0;
+					double norm = 0;
+
+					bool active = false; // supplies at least one spectrum frame bin.
+					double binsPerHz = 0;
+					std::vector<double> power;
+					std::vector<float> fftValues; // dB.
+				};
+
+				AnalysisBus::Subscription *analysisBus = nullptr;
+
+				std::vector<Band> bands;
+				size_t bandCount = 0;
+
+				std::vector<float> holdValues;
+				std::vector<int64_t> holdTimes;
 				size_t samplesPerUpdate = 0;
 
-				size_t blockSize = 0;
-				double norm =0;
 				double sampleRate = 0;
 				size_t holdSamples = 0;
 				float holdDecay = 0;
@@ -186,19 +190,30 @@ namespace toob {
 				float minFrequency = 0;
 				float maxFrequency = 0;
 
-				LsNumerics::StagedFft fft {4};
-				std::vector<double> fftWindow;
+				// frequency at the lower edge of each spectrum frame bin.
+				std::vector<double> binEdges;
+				// the band that supplies each spectrum frame bin.
+				std::vector<uint8_t> binBands;
+				float binMinFrequency = 0;
+				float binMaxFrequency = 0;
+				SvgPathWriter svgWriter;
 
 			public:
+				bool svgEnabled = false;
+				bool frameEnabled = false;
 				std::string svgPath;
 				std::string svgHoldPath;
+				std::vector<float> frame;
 			public:
 				void Initialize(FftWorker* fftWorker);
 				// convenient way to make sure we don't accidentally share state with audio thread.
 				void CaptureData(FftWorker *fftWorker);
-				void CopyFromCaptureBuffer();
-				void CalculateSvgPaths(size_t blockSize,float minF, float maxF, float dbLevel);
-				std::string FftToSvg(const std::vector<float>& fft);
+				void CalculateSpectrum(float minF, float maxF, float dbLevel);
+			private:
+				void CalculateBandSpectrum(Band &band, float dbLevel);
+				void UpdateBinLayout();
+				void BinSpectrum(float *output);
+				std::string FftToSvg(const float *bins);
 			};
 
 			BackgroundTask backgroundTask;
@@ -211,9 +226,7 @@ namespace toob {
 
 		FftWorker fftWorker;
 
-		static constexpr  size_t MAX_FFT_SIZE = 8192;
-
-		void OnSvgPathReady(const std::string &svgPath, const std::string&svgHoldPath);
+		void OnSpectrumReady(const std::string *svgPath, const std::string *svgHoldPath, const std::vector<float> *frame);
 		void WriteSpectrum();
 
 		double sampleRate;
@@ -249,6 +262,8 @@ namespace toob {
 				units__Frame = plugin->MapURI(LV2_UNITS__frame);
 				patchProperty__spectrumResponse = plugin->MapURI(TOOB_URI  "#spectrumResponse");
 				patchProperty__spectrumEnable = plugin->MapURI(TOOB_URI  "#spectrumEnable");
+				patchProperty__spectrumFrame = plugin->MapURI(TOOB_URI  "#spectrumFrame");
+				patchProperty__spectrumFrameEnable = plugin->MapURI(TOOB_URI  "#spectrumFrameEnable");
 			}
 			LV2_URID patch_accept;
 
@@ -267,6 +282,8 @@ namespace toob {
 			LV2_URID patch__value;
 			LV2_URID patchProperty__spectrumResponse;
 			LV2_URID patchProperty__spectrumEnable;
+			LV2_URID patchProperty__spectrumFrame;
+			LV2_URID patchProperty__spectrumFrameEnable;
 		};
 
 		Urids urids;
@@ -277,8 +294,8 @@ namespace toob {
 		// float peakValueL = 0;
 		// float peakValueR = 0;
 	private:
-		bool enabled = false;
 		int64_t enabledCount = 0;
+		int64_t frameEnabledCount = 0;
 
 
 	protected:
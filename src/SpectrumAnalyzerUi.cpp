@@ -26,6 +26,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <lv2/atom/atom.h>
 #include <lv2/atom/util.h>
 #include "lv2c_ui/Lv2PortViewFactory.hpp"
+#include "SpectrumFrame.hpp"
 
 #ifndef TOOB_URI
 #define TOOB_URI "http://two-play.com/plugins/toob"
@@ -53,7 +54,7 @@ public:
     void MinF(double minF);
     void MaxF(double maxF);
     void Level(double level);
-    void SetResponse(const std::string &svgResponse, const std::string&svgHoldResponse);
+    void SetFrame(const float *frame, size_t size);
 
 protected:
     struct PointF {
@@ -85,7 +86,7 @@ private:
     void PreComputeGridXs();
     void DrawGrid(Lv2cDrawingContext &dc);
     void DrawPlot(Lv2cDrawingContext&dc,PlotValues&values);
-    void ConvertSvg(PlotValues&values, const std::string&svg);
+    void ConvertBins(PlotValues&values, const float *bins, size_t binCount);
     
 
     std::vector<double> majorGridXs, minorGridXs;
@@ -123,10 +124,10 @@ private:
     SpectrumPlotElement::ptr spectrumPlotElement;
 
     struct Urids {
-        LV2_URID patchProperty__spectrumResponse;
-        LV2_URID patchProperty__spectrumEnable;
-        LV2_URID atom__Tuple;
-        LV2_URID atom__String;
+        LV2_URID patchProperty__spectrumFrame;
+        LV2_URID patchProperty__spectrumFrameEnable;
+        LV2_URID atom__Vector;
+        LV2_URID atom__Float;
     };
 
     Urids urids;
@@ -188,10 +189,10 @@ bool PLUGIN_CLASS::instantiate(
         return false;
     }
 
-    urids.patchProperty__spectrumResponse = GetUrid(TOOB_URI  "#spectrumResponse");
-    urids.patchProperty__spectrumEnable = GetUrid(TOOB_URI  "#spectrumEnable");
-    urids.atom__Tuple = GetUrid(LV2_ATOM__Tuple);
-    urids.atom__String = GetUrid(LV2_ATOM__String);
+    urids.patchProperty__spectrumFrame = GetUrid(TOOB_URI  "#spectrumFrame");
+    urids.patchProperty__spectrumFrameEnable = GetUrid(TOOB_URI  "#spectrumFrameEnable");
+    urids.atom__Vector = GetUrid(LV2_ATOM__Vector);
+    urids.atom__Float = GetUrid(LV2_ATOM__Float);
 
     WriteSpectrumEnable(true);
     spectrumPlotElement->Level(GetControlProperty("level").get());
@@ -206,34 +207,26 @@ void PLUGIN_CLASS::ui_delete()
 }
 void PLUGIN_CLASS::WriteSpectrumEnable(bool enable)
 {
-    WritePatchProperty(urids.patchProperty__spectrumEnable,enable);
+    WritePatchProperty(urids.patchProperty__spectrumFrameEnable,enable);
 }
 
-static inline std::string AtomToString(const LV2_Atom*atom)
-{
-    const char*cstr = ((const char*)atom) + sizeof(LV2_Atom);
-    return cstr;
-}
 void PLUGIN_CLASS::OnPatchPropertyReceived(LV2_URID type, const uint8_t*data)
 {
     const LV2_Atom*atom = (const LV2_Atom*)data;
 
-    if (type == urids.patchProperty__spectrumResponse && atom->type == urids.atom__Tuple)
+    if (type == urids.patchProperty__spectrumFrame && atom->type == urids.atom__Vector)
     {
-        const LV2_Atom_Tuple*atomTuple = (const LV2_Atom_Tuple*)atom;
-        LV2_Atom *tuple0 = lv2_atom_tuple_begin(atomTuple);
-        LV2_Atom *tuple1 = lv2_atom_tuple_next(tuple0);
-        if (tuple0->type != urids.atom__String || tuple1->type != urids.atom__String)
+        const LV2_Atom_Vector *vector = (const LV2_Atom_Vector*)atom;
+        if (vector->body.child_type != urids.atom__Float || vector->body.child_size != sizeof(float))
         {
             return;
         }
-        std::string svgResponse = AtomToString(tuple0);
-        std::string svgHoldResponse = AtomToString(tuple1);
+        size_t size = (vector->atom.size - sizeof(LV2_Atom_Vector_Body)) / sizeof(float);
+        const float *frame = (const float*)(&vector->body + 1);
         if (spectrumPlotElement)
         {
-            spectrumPlotElement->SetResponse(svgResponse, svgHoldResponse);
+            spectrumPlotElement->SetFrame(frame, size);
         }
-
     }
 }
 
@@ -252,25 +245,37 @@ Lv2cContainerElement::ptr PLUGIN_CLASS::RenderControls() {
 
 }
 
-void SpectrumPlotElement::ConvertSvg(PlotValues&result, const std::string&svg)
+void SpectrumPlotElement::ConvertBins(PlotValues&result, const float *bins, size_t binCount)
 {
-     std::stringstream s(svg);
+    using namespace spectrum_frame;
+
+    // same outline as the svg paths: down to the baseline at both ends.
     result.resize(0);
-     while (!s.eof())
-     {
-        char cmd, comma;
-        float x,y;
-        s >> cmd;
-        if (!s) break;
-        s >> x >> comma >> y ;
-        result.push_back(PointF{x,y});
-     }
+    double dx = PLOT_WIDTH / binCount;
+    result.push_back(PointF{0, PLOT_HEIGHT});
+    result.push_back(PointF{0, DbToPlotY(bins[0])});
+    for (size_t i = 0; i < binCount; ++i)
+    {
+        result.push_back(PointF{(float)((i + 0.5) * dx), DbToPlotY(bins[i])});
+    }
+    result.push_back(PointF{PLOT_WIDTH, DbToPlotY(bins[binCount - 1])});
+    result.push_back(PointF{PLOT_WIDTH, PLOT_HEIGHT});
 }
 
-void SpectrumPlotElement::SetResponse(const std::string &svgResponse, const std::string&svgHoldResponse)
+void SpectrumPlotElement::SetFrame(const float *frame, size_t size)
 {
-    ConvertSvg(this->values,svgResponse);
-    ConvertSvg(this->holdValues,svgHoldResponse);
+    using namespace spectrum_frame;
+    if (size < HEADER_SIZE)
+    {
+        return;
+    }
+    size_t binCount = (size_t)frame[BIN_COUNT_INDEX];
+    if (binCount == 0 || size < HEADER_SIZE + 2 * binCount)
+    {
+        return;
+    }
+    ConvertBins(this->values, frame + HEADER_SIZE, binCount);
+    ConvertBins(this->holdValues, frame + HEADER_SIZE + binCount, binCount);
     Invalidate();
 }
 
@@ -416,9 +421,9 @@ void SpectrumPlotElement::DrawGrid(Lv2cDrawingContext &dc)
 void SpectrumPlotElement::DrawPlot(Lv2cDrawingContext&dc,PlotValues&values)
 {
     Lv2cSize size = clientSize;
-    // points are in range [0..1000].
-    double scaleX = size.Width()/200;
-    double scaleY = size.Height()*0.001;
+    // points are in plot coordinates (see SpectrumFrame.hpp).
+    double scaleX = size.Width()/spectrum_frame::PLOT_WIDTH;
+    double scaleY = size.Height()/spectrum_frame::PLOT_HEIGHT;
     if (values.size() > 2)
     {
         dc.move_to(scaleX*values[0].x,scaleY*values[0].y);
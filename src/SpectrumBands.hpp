@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2023 Robin E. R. Davies
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "AnalysisBus.hpp"
+
+namespace toob {
+
+    // Octave-band layout of SpectrumAnalyzer's multi-resolution analysis.
+    //
+    // Band n analyzes analysis bus level n (sampleRate/2^n), and supplies spectrum frame bins between
+    // BAND_TOP/2 and BAND_TOP times its sample rate, which keeps them inside the passband of the halfband
+    // decimators that feed it. Band 0 also supplies everything above, and the last band everything below.
+    namespace spectrum_bands {
+        constexpr double BAND_TOP = 0.36;
+
+        constexpr double LOWEST_FREQUENCY = 10; // minimum value of the minF control.
+
+        constexpr double UPDATES_PER_SECOND = 30;
+
+        // A band's fft resolves display bins (spectrum_frame::BIN_COUNT over the default 60Hz-22kHz,
+        // about 23 bins per octave) at the middle of its octave with MAX_FFT_SIZE points. Low bands use
+        // fewer points so that their windows stay no longer than MAX_WINDOW_SECONDS (the window of the
+        // 16K fft at 48kHz that this analysis replaced), but never fewer than MIN_FFT_SIZE, which still
+        // gives about 12 fft bins per octave.
+        constexpr size_t MAX_FFT_SIZE = 128;
+        constexpr size_t MIN_FFT_SIZE = 64;
+        constexpr double MAX_WINDOW_SECONDS = 0.35;
+
+        // Welch averaging: bands that receive more than one fft's worth of samples per update average
+        // up to this many half-overlapped ffts, so that short transients aren't missed between updates.
+        constexpr size_t MAX_AVERAGED_FFTS = 16;
+
+        inline double BandSampleRate(double sampleRate, size_t band)
+        {
+            return sampleRate / (double)(1 << band);
+        }
+
+        // Enough bands to reach LOWEST_FREQUENCY.
+        inline size_t BandCount(double sampleRate)
+        {
+            size_t bandCount = 1;
+            while (bandCount < AnalysisBus::MAX_LEVELS && BAND_TOP * 0.5 * BandSampleRate(sampleRate, bandCount - 1) > LOWEST_FREQUENCY)
+            {
+                ++bandCount;
+            }
+            return bandCount;
+        }
+
+        inline size_t BandFftSize(double sampleRate, size_t band)
+        {
+            double maxSamples = MAX_WINDOW_SECONDS * BandSampleRate(sampleRate, band);
+            size_t fftSize = MAX_FFT_SIZE;
+            while (fftSize > MIN_FFT_SIZE && (double)fftSize > maxSamples)
+            {
+                fftSize /= 2;
+            }
+            return fftSize;
+        }
+
+        inline AnalysisBus::StftConfig BandStftConfig(double sampleRate, size_t band)
+        {
+            AnalysisBus::StftConfig config;
+            config.level = band;
+            config.fftSize = BandFftSize(sampleRate, band);
+            config.hopSize = config.fftSize / 2;
+            config.frameHistory = MAX_AVERAGED_FFTS;
+            return config;
+        }
+
+        // The band that supplies the display bin centered on frequency.
+        inline size_t BandForFrequency(double sampleRate, double frequency, size_t bandCount)
+        {
+            double band = std::floor(std::log2(BAND_TOP * sampleRate / frequency));
+            return (size_t)std::clamp(band, 0.0, (double)(bandCount - 1));
+        }
+    }
+}
@@ -0,0 +1,248 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SpectrumBands.hpp"
+#include "LsNumerics/Window.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace toob;
+using namespace toob::spectrum_bands;
+
+static constexpr size_t BLOCK_SIZE = 64;
+static constexpr double LOW_E = 41.2;
+
+// The single-resolution analysis that the octave bands replaced: a 16K fft at 15 updates per second.
+static constexpr double OLD_FFT_SIZE = 16 * 1024;
+static constexpr double OLD_UPDATES_PER_SECOND = 15;
+
+static double FftCost(double fftSize)
+{
+    return fftSize * std::log2(fftSize);
+}
+
+static double WindowSeconds(double sampleRate, size_t band)
+{
+    return BandFftSize(sampleRate, band) / BandSampleRate(sampleRate, band);
+}
+
+// Low bands trade frequency resolution for time resolution: their windows are no longer than the old 16K
+// window at 48kHz, except where MIN_FFT_SIZE is reached.
+static void TestBandLayout()
+{
+    for (double sampleRate : {44100.0, 48000.0, 96000.0})
+    {
+        size_t bandCount = BandCount(sampleRate);
+        TEST_ASSERT(BAND_TOP * 0.5 * BandSampleRate(sampleRate, bandCount - 1) <= LOWEST_FREQUENCY);
+        for (size_t band = 0; band < bandCount; ++band)
+        {
+            size_t fftSize = BandFftSize(sampleRate, band);
+            TEST_ASSERT(fftSize >= MIN_FFT_SIZE && fftSize <= MAX_FFT_SIZE);
+            TEST_ASSERT(WindowSeconds(sampleRate, band) <= MAX_WINDOW_SECONDS || fftSize == MIN_FFT_SIZE);
+            // fft bins per octave: the display has about 23 bins per octave.
+            double binsPerOctave = BAND_TOP * 0.5 * fftSize;
+            TEST_ASSERT(binsPerOctave >= (fftSize == MAX_FFT_SIZE ? 20 : 10));
+        }
+        size_t lowEBand = BandForFrequency(sampleRate, LOW_E, bandCount);
+        TEST_ASSERT(WindowSeconds(sampleRate, lowEBand) < 0.4);
+        for (double f = LOWEST_FREQUENCY; f <= 20; f += 1)
+        {
+            TEST_ASSERT(WindowSeconds(sampleRate, BandForFrequency(sampleRate, f, bandCount)) < 1.5);
+        }
+    }
+}
+
+struct BandAnalysis
+{
+    size_t band;
+    size_t stft;
+    uint64_t nextFrame = 0;
+    size_t fftSize;
+    double norm;
+};
+
+static BandAnalysis AddBand(AnalysisBus::Subscription &subscription, double sampleRate, size_t band)
+{
+    AnalysisBus::StftConfig config = BandStftConfig(sampleRate, band);
+    BandAnalysis result;
+    result.band = band;
+    result.stft = subscription.AddStft(config);
+    result.fftSize = config.fftSize;
+    std::vector<double> window = LsNumerics::Window::Hann<double>((int)config.fftSize);
+    double windowSum = 0;
+    for (double w : window)
+    {
+        windowSum += w;
+    }
+    result.norm = 2 * std::sqrt((double)config.fftSize) / windowSum;
+    return result;
+}
+
+// Time from the onset of a low E until the display reads it within 3dB, with SpectrumAnalyzer's update schedule.
+static double LowEResponseSeconds(double sampleRate)
+{
+    constexpr double AMPLITUDE = 0.5;
+    auto subscription = AnalysisBus::Subscribe(sampleRate);
+    size_t bandCount = BandCount(sampleRate);
+    BandAnalysis analysis = AddBand(*subscription, sampleRate, BandForFrequency(sampleRate, LOW_E, bandCount));
+
+    double binsPerHz = analysis.fftSize / BandSampleRate(sampleRate, analysis.band);
+    size_t toneBin = (size_t)std::round(LOW_E * binsPerHz);
+    double targetDb = 20 * std::log10(AMPLITUDE) - 3;
+
+    size_t samplesPerUpdate = (size_t)(sampleRate / UPDATES_PER_SECOND);
+    size_t onset = (size_t)sampleRate; // a second of silence first.
+    size_t sinceUpdate = 0;
+    float block[BLOCK_SIZE];
+    for (size_t t = 0; t < onset + 5 * (size_t)sampleRate; t += BLOCK_SIZE)
+    {
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            size_t n = t + i;
+            block[i] = n < onset ? 0.0f : (float)(AMPLITUDE * std::sin(2 * M_PI * LOW_E * (n - onset) / sampleRate));
+        }
+        subscription->Write(block, BLOCK_SIZE);
+        sinceUpdate += BLOCK_SIZE;
+        if (sinceUpdate >= samplesPerUpdate)
+        {
+            sinceUpdate = 0;
+            double power = 0;
+            size_t frames = 0;
+            subscription->ReadFrames(
+                analysis.stft, analysis.nextFrame,
+                [&](uint64_t, const AnalysisBus::spectrum_t &spectrum)
+                {
+                    double peak = 0;
+                    for (size_t i = toneBin - 1; i <= toneBin + 1; ++i)
+                    {
+                        peak = std::max(peak, std::norm(spectrum[i]));
+                    }
+                    power += peak;
+                    ++frames;
+                });
+            if (frames != 0 && t >= onset)
+            {
+                double db = 10 * std::log10(power * analysis.norm * analysis.norm / frames + 1E-30);
+                if (db >= targetDb)
+                {
+                    return (t + BLOCK_SIZE - onset) / sampleRate;
+                }
+            }
+        }
+    }
+    throw std::logic_error("Low E never reached full level.");
+}
+
+static void TestLowBandLatency()
+{
+    for (double sampleRate : {44100.0, 48000.0, 96000.0})
+    {
+        double seconds = LowEResponseSeconds(sampleRate);
+        std::cout << "    " << sampleRate << "Hz: low E response " << seconds << "s" << std::endl;
+        // About 0.6 of the band's window, plus decimator delay and update interval. (256-point bands took 1.1-1.2s.)
+        TEST_ASSERT(seconds < 0.55);
+    }
+}
+
+// FFT work per update, for the bands that the default 60Hz-22kHz display reads, once the Welch averages are full.
+static void TestUpdateCost()
+{
+    constexpr double SAMPLE_RATE = 48000;
+    constexpr double MIN_F = 60;
+    constexpr double MAX_F = 22000;
+
+    auto subscription = AnalysisBus::Subscribe(SAMPLE_RATE);
+    size_t bandCount = BandCount(SAMPLE_RATE);
+    std::vector<BandAnalysis> bands;
+    for (size_t band = BandForFrequency(SAMPLE_RATE, MAX_F, bandCount); band <= BandForFrequency(SAMPLE_RATE, MIN_F, bandCount); ++band)
+    {
+        bands.push_back(AddBand(*subscription, SAMPLE_RATE, band));
+    }
+
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    float block[BLOCK_SIZE];
+    size_t samplesPerUpdate = (size_t)(SAMPLE_RATE / UPDATES_PER_SECOND);
+    constexpr size_t WARMUP_UPDATES = 60;
+    constexpr size_t MEASURED_UPDATES = 60;
+    double cost = 0;
+    uint64_t fftCount = 0;
+    uint64_t framesRead = 0;
+    for (size_t update = 0; update < WARMUP_UPDATES + MEASURED_UPDATES; ++update)
+    {
+        for (size_t t = 0; t < samplesPerUpdate; t += BLOCK_SIZE)
+        {
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                block[i] = noise(random);
+            }
+            subscription->Write(block, BLOCK_SIZE);
+        }
+        uint64_t previousFftCount = subscription->GetFftCount();
+        double updateCost = 0;
+        size_t updateFrames = 0;
+        for (BandAnalysis &band : bands)
+        {
+            subscription->ReadFrames(band.stft, band.nextFrame, [&](uint64_t, const AnalysisBus::spectrum_t &)
+                                     { updateCost += FftCost((double)band.fftSize); ++updateFrames; });
+        }
+        if (update >= WARMUP_UPDATES)
+        {
+            cost += updateCost;
+            framesRead += updateFrames;
+            fftCount += subscription->GetFftCount() - previousFftCount;
+        }
+    }
+    double costPerUpdate = cost / MEASURED_UPDATES;
+    double oldCostPerUpdate = FftCost(OLD_FFT_SIZE);
+    std::cout << "    " << (double)fftCount / MEASURED_UPDATES << " ffts per update, cost "
+              << costPerUpdate / oldCostPerUpdate << " of a 16K fft; "
+              << (costPerUpdate * UPDATES_PER_SECOND) / (oldCostPerUpdate * OLD_UPDATES_PER_SECOND)
+              << " of the old analysis per second." << std::endl;
+
+    TEST_ASSERT(costPerUpdate < oldCostPerUpdate * 0.25);
+    TEST_ASSERT(costPerUpdate * UPDATES_PER_SECOND < oldCostPerUpdate * OLD_UPDATES_PER_SECOND * 0.5);
+    // frames are computed on demand: every fft computed is one that the analyzer reads.
+    TEST_ASSERT(fftCount == framesRead);
+}
+
+int main(void)
+{
+    try
+    {
+        std::cout << "SpectrumBandsTest" << std::endl;
+        TestBandLayout();
+        TestLowBandLatency();
+        TestUpdateCost();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2023 Robin E. R. Davies
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace toob {
+
+    // Binary spectrum frames, sent by SpectrumAnalyzer as the toob#spectrumFrame patch property
+    // (an atom:Vector of atom:Float) to clients that set toob#spectrumFrameEnable.
+    //
+    // A frame is a header (minF, maxF, binCount), followed by binCount live values and then
+    // binCount peak-hold values, in dB. Bins are evenly spaced in log frequency:
+    // bin i covers minF*(maxF/minF)^(i/binCount) to minF*(maxF/minF)^((i+1)/binCount).
+    namespace spectrum_frame {
+        constexpr size_t MIN_F_INDEX = 0;
+        constexpr size_t MAX_F_INDEX = 1;
+        constexpr size_t BIN_COUNT_INDEX = 2;
+        constexpr size_t HEADER_SIZE = 3;
+
+        constexpr size_t BIN_COUNT = 200;
+        constexpr size_t FRAME_SIZE = HEADER_SIZE + 2 * BIN_COUNT;
+
+        constexpr float MIN_DB = -200;
+
+        // Plot coordinates used by the SVG spectrumResponse paths:
+        // x runs from 0 to PLOT_WIDTH; y runs from 0 (0 dB) to PLOT_HEIGHT (PLOT_MIN_DB).
+        constexpr float PLOT_WIDTH = 200;
+        constexpr float PLOT_HEIGHT = 1000;
+        constexpr float PLOT_MIN_DB = -80;
+
+        inline float DbToPlotY(float db)
+        {
+            if (db < -150)
+                db = -150;
+            return db * (PLOT_HEIGHT / PLOT_MIN_DB);
+        }
+    }
+}
@@ -20,6 +20,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "SvgPathWriter.hpp"
+#include "SpectrumFrame.hpp"
 
 
 using namespace toob;
@@ -28,6 +29,7 @@ using namespace toob;
 
 
 void SvgPathWriter::SetPrecision(int digits) { ss.precision(digits); }
+void SvgPathWriter::Clear() { ss.str(std::string()); }
 void SvgPathWriter::MoveTo(double x, double y) {
     ss << "M" <<x << ',' << y;
     lastX = x; lastY = y;
@@ -50,6 +52,23 @@ void SvgPathWriter::Close() {
     ss << "Z";
 }
 
+void SvgPathWriter::SpectrumPlot(const float *dbValues, size_t binCount)
+{
+    using namespace spectrum_frame;
+    if (binCount == 0) return;
+
+    double dx = PLOT_WIDTH / binCount;
+    MoveTo(0, PLOT_HEIGHT);
+    LineTo(0, DbToPlotY(dbValues[0]));
+    for (size_t i = 0; i < binCount; ++i)
+    {
+        LineTo((i + 0.5) * dx, DbToPlotY(dbValues[i]));
+    }
+    LineTo(PLOT_WIDTH, DbToPlotY(dbValues[binCount - 1]));
+    LineTo(PLOT_WIDTH, PLOT_HEIGHT);
+    Close();
+}
+
 
 std::string SvgPathWriter::String()
 {
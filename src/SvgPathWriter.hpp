@@ -32,10 +32,13 @@ namespace toob {
         SvgPathWriter() { }
 
         void SetPrecision(int digits);
+        void Clear();
 
         void MoveTo(double x, double y);
         void LineTo(double x, double y);
         void Close();
+        // Filled plot of one set of values from a binary spectrum frame (see SpectrumFrame.hpp).
+        void SpectrumPlot(const float *dbValues, size_t binCount);
         std::string String();
    private:
         double lastX, lastY;
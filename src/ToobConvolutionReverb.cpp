@@ -33,6 +33,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <deque>
 #include "ss.hpp"
 
 #define TOOB_CONVOLUTION_REVERB_URI "http://two-play.com/plugins/toob-convolution-reverb"
@@ -716,40 +717,24 @@ void ToobConvolutionReverbBase::LoadWorker::Request()
     WorkerAction::Request();
 }
 
-static void NormalizeConvolution(AudioData &data)
+// Per-channel gains that normalize the worst-case convolution output, and then apply level.
+static ChannelMatrix NormalizeConvolution(const std::vector<ChannelStatistics> &statistics, float level)
 {
-    size_t size = data.getSize();
-
-    for (size_t c = 0; c < data.getChannelCount(); ++c)
+    std::vector<float> gains(statistics.size());
+    for (size_t c = 0; c < statistics.size(); ++c)
     {
-        auto &channel = data.getChannel(c);
-        double maxValue = 0;
-        // find the worst-case convolution output.
-        double sum = 0;
-        for (size_t i = 0; i < size; ++i)
-        {
-            sum += channel[i];
-            if (std::abs(sum) > maxValue)
-            {
-                maxValue = std::abs(sum);
-            }
-        }
-        // std::cout << "MaxValue: " << maxValue << std::endl;
-
-        float scale = (float)(1 / maxValue);
-
-        for (size_t i = 0; i < size; ++i)
-        {
-            channel[i] *= scale;
-        }
+        double maxValue = statistics[c].convolutionPeak;
+        gains[c] = maxValue == 0 ? 0.0f : (float)(level / maxValue);
     }
+    return ChannelMatrix::Gain(gains);
 }
 
-static void RemovePredelay(AudioData &audioData)
+// fullScale: the level that thresholds are relative to.
+static void RemovePredelay(AudioData &audioData, float fullScale)
 {
     std::vector<float> &channel = audioData.getChannel(0);
-    float db60 = LsNumerics::Db2Af(-60);
-    float db40 = LsNumerics::Db2Af(-40);
+    float db60 = LsNumerics::Db2Af(-60) * fullScale;
+    float db40 = LsNumerics::Db2Af(-40) * fullScale;
 
     size_t db60Index = 0;
     size_t db30Index = 0;
@@ -808,65 +793,244 @@ static float GetTailScale(const std::vector<float> &data, size_t tailPosition)
     return (float)max;
 }
 
-AudioData ToobConvolutionReverbBase::LoadWorker::LoadFile(const std::filesystem::path &fileName, float level)
+ChannelMatrix ToobConvolutionReverbBase::LoadWorker::GetDownmix(size_t channelCount, ChannelMask channelMask)
 {
-    if (fileName.string().length() == 0)
-    {
-        return AudioData(pReverb->getSampleRate(), 1, 0);
-    }
-    AudioData data;
-    if (fileName.extension() == ".flac")
-    {
-        data = FlacReader::Load(fileName);
-    }
-    else
-    {
-        data = WavReader::Load(fileName);
-    }
-
     // Assume files with 4 channels are in Ambisonic b-Format.
     if (pThis->isStereo)
     {
-        switch (data.getChannelCount())
+        switch (channelCount)
         {
         case 1:
-            data.MonoToStereo();
-            break;
+            return ChannelMatrix::MonoToStereo();
         case 2:
         default:
-            data.SetStereoWidth(this->requestWidth);
-            break;
+            return ChannelMatrix::StereoWidth(channelCount, this->requestWidth);
         case 4:
         {
             float angle = 90 * (this->requestWidth);
-            data.AmbisonicDownmix({AmbisonicMicrophone(-angle + 90 * requestPan, 0), AmbisonicMicrophone(angle + 90 * requestPan, 0)});
+            return ChannelMatrix::AmbisonicDownmix({AmbisonicMicrophone(-angle + 90 * requestPan, 0), AmbisonicMicrophone(angle + 90 * requestPan, 0)});
         }
-        break;
         }
     }
     else
     {
-        if (data.getChannelCount() == 4)
+        if (channelCount == 4)
         {
-            data.AmbisonicDownmix({AmbisonicMicrophone(0, 0)});
+            return ChannelMatrix::AmbisonicDownmix({AmbisonicMicrophone(0, 0)});
         }
         else
         {
-            data.ConvertToMono();
+            return ChannelMatrix::Mono(channelCount, channelMask);
         }
     }
+}
+
+namespace
+{
+    // Decodes a FLAC impulse file a chunk at a time, as the convolution sections that need the samples are built.
+    // The convolution owns the source, and decodes the tail on its section builder thread after the head has
+    // gone live.
+    class FlacImpulseSource : public LsNumerics::ImpulseSource
+    {
+    public:
+        FlacImpulseSource(std::unique_ptr<FlacReader> &&reader, const ChannelMatrix &downmix, size_t size, float level)
+            : reader(std::move(reader)),
+              downmix(downmix),
+              size(size),
+              level(level),
+              statistics(downmix.getOutputChannelCount()),
+              channelPointers(this->reader->Channels())
+        {
+        }
+
+        virtual size_t Read(float *left, float *right, size_t frames) override
+        {
+            size_t read = 0;
+            while (read < frames)
+            {
+                if (chunks.empty() || chunkIndex == chunks.front().getSize())
+                {
+                    if (!chunks.empty())
+                    {
+                        chunks.pop_front();
+                        chunkIndex = 0;
+                    }
+                    if (chunks.empty() && !NextChunk())
+                    {
+                        break;
+                    }
+                }
+                const AudioData &chunk = chunks.front();
+                size_t thisTime = std::min(frames - read, chunk.getSize() - chunkIndex);
+                const float *input = chunk.getChannel(0).data() + chunkIndex;
+                std::copy(input, input + thisTime, left + read);
+                if (right)
+                {
+                    input = chunk.getChannel(1).data() + chunkIndex;
+                    std::copy(input, input + thisTime, right + read);
+                }
+                chunkIndex += thisTime;
+                read += thisTime;
+            }
+            return read;
+        }
+
+        // Normalized from the head of the file, which has to be live before the tail is decoded. The peak of a
+        // reverb impulse's running sum comes early, so this is the same gain that the whole file would give, in
+        // practice. Decodes ahead past leading silence.
+        virtual float GetGain(size_t channel) override
+        {
+            while (statistics[channel].convolutionPeak == 0 && NextChunk())
+            {
+            }
+            double maxValue = statistics[channel].convolutionPeak;
+            float gain = maxValue == 0 ? 0.0f : (float)(level / maxValue);
+            if (channel == 0)
+            {
+                this->gain = gain;
+            }
+            return gain;
+        }
+
+        // Peak of the normalized first channel, beyond size.
+        virtual float GetFeedback() override
+        {
+            chunks.clear();
+            while (NextChunk())
+            {
+                chunks.clear();
+            }
+            float max = tailPeak * gain;
+            if (max < 1E-7)
+            {
+                max = 0;
+            }
+            return max;
+        }
+
+    private:
+        static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+        // Decode the next chunk onto the end of chunks.
+        bool NextChunk()
+        {
+            AudioData &chunk = chunks.emplace_back();
+            chunk.setChannelCount(reader->Channels());
+            chunk.setSize(CHUNK_SIZE);
+            for (size_t c = 0; c < channelPointers.size(); ++c)
+            {
+                channelPointers[c] = chunk.getChannel(c).data();
+            }
+            size_t read = reader->ReadData(channelPointers.data(), 0, CHUNK_SIZE);
+            if (read == 0)
+            {
+                chunks.pop_back();
+                return false;
+            }
+            chunk.setSize(read);
+            chunk.Remix(downmix);
+            for (size_t c = 0; c < statistics.size(); ++c)
+            {
+                statistics[c].Add(chunk.getChannel(c).data(), read);
+            }
+            if (position + read > size)
+            {
+                size_t start = position > size ? 0 : size - position;
+                const auto &channel = chunk.getChannel(0);
+                for (size_t i = start; i < read; ++i)
+                {
+                    tailPeak = std::max(tailPeak, std::abs(channel[i]));
+                }
+            }
+            position += read;
+            return true;
+        }
+
+        std::unique_ptr<FlacReader> reader;
+        ChannelMatrix downmix;
+        size_t size;
+        float level;
+        float gain = 1;
+        std::vector<ChannelStatistics> statistics;
+        std::vector<float *> channelPointers;
+        // decoded, but not yet read.
+        std::deque<AudioData> chunks;
+        size_t chunkIndex = 0;
+        size_t position = 0;
+        float tailPeak = 0;
+    };
+}
+
+// Build the convolution while the file is still being decoded. Only possible for a single FLAC file
+// that needs no resampling or predelay removal; returns false otherwise.
+bool ToobConvolutionReverbBase::LoadWorker::StreamFile(const std::filesystem::path &fileName, float level)
+{
+    if (fileName.extension() != ".flac" || !predelay)
+    {
+        return false;
+    }
+    auto reader = std::make_unique<FlacReader>();
+    reader->Open(fileName);
+    size_t fileSize = reader->NumberOfFrames();
+    uint32_t channels = reader->Channels();
+    if (reader->SampleRate() != (size_t)pReverb->getSampleRate() || fileSize == 0)
+    {
+        return false;
+    }
+    size_t maxSize = (size_t)std::ceil(workingTimeInSeconds * pReverb->getSampleRate());
+    size_t size = std::min(fileSize, maxSize);
+    if (size == 0)
+    {
+        return false;
+    }
+    pThis->LogTrace("%s\n", SS("Streaming file. Sample rate: " << reader->SampleRate() << std::setprecision(3) << " Length: " << (fileSize * 1.0f / reader->SampleRate()) << "s.").c_str());
+    if (size < fileSize)
+    {
+        pThis->LogTrace("%s\n", SS("Max T: " << std::setprecision(3) << workingTimeInSeconds << "s").c_str());
+    }
+
+    // the last sample is recirculated. Head sections are built as their samples are decoded, and go live
+    // when the constructor returns; the tail sections are built in the background as the rest of the file
+    // is decoded, and the tail starts recirculating once the end of the file has been read.
+    auto source = std::make_shared<FlacImpulseSource>(std::move(reader), GetDownmix(channels, ChannelMask::ZERO), size, level);
+    this->convolutionReverbResult = std::make_shared<ConvolutionReverb>(
+        SchedulerPolicy::Realtime,
+        size - 1, std::move(source), pThis->isStereo,
+        sampleRate,
+        audioBufferSize,
+        SectionActivation::Progressive);
+    this->tailScale = 0;
+    return true;
+}
+
+AudioData ToobConvolutionReverbBase::LoadWorker::LoadFile(const std::filesystem::path &fileName, float level)
+{
+    if (fileName.string().length() == 0)
+    {
+        return AudioData(pReverb->getSampleRate(), 1, 0);
+    }
+    AudioData data;
+    if (fileName.extension() == ".flac")
+    {
+        data = FlacReader::Load(fileName);
+    }
+    else
+    {
+        data = WavReader::Load(fileName);
+    }
+
+    std::vector<ChannelStatistics> statistics;
+    data.Remix(GetDownmix(data.getChannelCount(), data.getChannelMask()), &statistics);
     pThis->LogTrace("%s\n", SS("File loaded. Sample rate: " << data.getSampleRate() << std::setprecision(3) << " Length: " << (data.getSize() * 1.0f / data.getSampleRate()) << "s.").c_str());
 
-    NormalizeConvolution(data);
     if (!predelay) // bbetter to do it on the pristine un-filtered data.
     {
-        RemovePredelay(data);
+        // relative to the level the data would have if normalized.
+        RemovePredelay(data, (float)statistics[0].convolutionPeak);
     }
     data.Resample((size_t)pReverb->getSampleRate());
 
-    NormalizeConvolution(data);
-
-    data.Scale(level);
+    data.Remix(NormalizeConvolution(data.GetStatistics(), level));
 
     return data;
 }
@@ -881,6 +1045,11 @@ void ToobConvolutionReverbBase::LoadWorker::OnWork()
     workError = "";
     try
     {
+        if (!requestFileName2[0] && !requestFileName3[0] && requestFileName[0] && StreamFile(requestFileName, requestMix))
+        {
+            pThis->LogTrace("Load complete.\n");
+            return;
+        }
         AudioData data = LoadFile(requestFileName, requestMix);
         if (requestFileName2[0])
         {
@@ -911,14 +1080,16 @@ void ToobConvolutionReverbBase::LoadWorker::OnWork()
                 SchedulerPolicy::Realtime,
                 data.getSize(), data.getChannel(0), data.getChannel(1),
                 sampleRate,
-                audioBufferSize);
+                audioBufferSize,
+                SectionActivation::Progressive);
         }
         else
         {
             this->convolutionReverbResult = std::make_shared<ConvolutionReverb>(SchedulerPolicy::Realtime,
                                                                                 data.getSize(), data.getChannel(0),
                                                                                 sampleRate,
-                                                                                audioBufferSize);
+                                                                                audioBufferSize,
+                                                                                SectionActivation::Progressive);
         }
         this->convolutionReverbResult->SetFeedback(tailScale, data.getSize() - 1);
         pThis->LogTrace("Load complete.\n");
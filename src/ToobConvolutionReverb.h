@@ -232,6 +232,8 @@ namespace toob
 
 		private:
 			AudioData LoadFile(const std::filesystem::path &fileName, float level);
+			bool StreamFile(const std::filesystem::path &fileName, float level);
+			ChannelMatrix GetDownmix(size_t channelCount, ChannelMask channelMask);
 
 			double getRate() { return rate; }
 			bool predelay = true;
@@ -70,11 +70,9 @@ const char* ToobML::URI= TOOB_ML_URI;
 
 #include <limits>
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpedantic"
-#pragma GCC diagnostic ignored "-Wstrict-aliasing"
-#include "RTNeural/RTNeural.h"
-#pragma GCC diagnostic pop
+#include "LsNumerics/BlockLstm.hpp"
+#include "LsNumerics/BlockGru.hpp"
+#include "LsNumerics/BlockRnnModel.hpp"
 
 #define TOOB_ML_PATCH_VERSION 1
 namespace toob {
@@ -92,93 +90,112 @@ public:
 	}
 };
 
-static std::vector<std::vector<float> > Transpose(const std::vector<std::vector<float> > &value)
-{
-	size_t r = value.size();
-	size_t c = value[0].size();
-
-	std::vector<std::vector<float> > result;
-	result.resize(c);
-	for (size_t i = 0; i < c; ++i)
-	{
-		result[i].resize(r);
-	}
-	for (size_t ir = 0; ir < r; ++ir)
-	{
-		for (size_t ic = 0; ic < c; ++ic)
-		{
-			result[ic][ir] = value[ir][ic];
-		}
-	}
-
-	return result;
-}
-template <int N_INPUTS, int HIDDEN_SIZE = 20>
+template <template <int, int, int> class LAYER, int N_INPUTS, int HIDDEN_SIZE>
 class MlModelInstance: public ToobMlModel
 {
 private:
-    RTNeural::ModelT<float, N_INPUTS, 1,
-        RTNeural::LSTMLayerT<float, N_INPUTS, HIDDEN_SIZE>,
-        RTNeural::DenseT<float, HIDDEN_SIZE, 1>> model;
+	using Model = LsNumerics::BlockRnnModel<LAYER, N_INPUTS, HIDDEN_SIZE>;
+	static constexpr int MAX_BLOCK = Model::MAX_BLOCK;
+
+	Model model;
+	typename Model::InputBlock inputBlock;
 
-	using FloatMatrix = std::vector<std::vector<float> >;
-	float inData[3];
 public:
 
 	MlModelInstance(const NeuralModel &jsonModel)
+	: model(jsonModel.model_data().num_layers())
 	{
 		const auto& data = jsonModel.state_dict();
-    	auto& lstm = (model).template get<0>();
-    	auto& dense = (model).template get<1>();
 
-		const FloatMatrix& lstm_weights_ih = data.rec__weight_ih_l0();
-		lstm.setWVals(Transpose(lstm_weights_ih));
-
-		const FloatMatrix& lstm_weights_hh = data.rec__weight_hh_l0(); 
-		lstm.setUVals(Transpose(lstm_weights_hh));
-
-		const std::vector<float>& lstm_bias_ih = data.rec__bias_ih_l0();
-		std::vector<float> lstm_bias_hh = data.rec__bias_hh_l0();
-		if (lstm_bias_ih.size() != lstm_bias_hh.size())
+		try {
+			for (size_t layer = 0; layer < model.NumLayers(); ++layer)
+			{
+				model.SetLayerWeights(
+					layer,
+					data.rec__weight_ih(layer),
+					data.rec__weight_hh(layer),
+					data.rec__bias_ih(layer),
+					data.rec__bias_hh(layer));
+			}
+			model.SetDenseWeights(data.lin__weight(),data.lin__bias());
+		} catch (const std::exception &)
 		{
 			throw MLException("Invalid model.");
 		}
-		for (size_t i = 0; i < lstm_bias_ih.size(); ++i) 
-			lstm_bias_hh[i] += lstm_bias_ih[i];
-		lstm.setBVals(lstm_bias_hh);
-
-		const FloatMatrix& dense_weights = data.lin__weight();
-		dense.setWeights(dense_weights);
-
-		std::vector<float> dense_bias = data.lin__bias();
-		dense.setBias(dense_bias.data());
+		inputBlock.setZero();
 	}
 	virtual void Reset() {
-		model.reset();	
+		model.Reset();
 	}
 
 	virtual  bool IsGainEnabled() const { return N_INPUTS > 1; }
-	virtual float Process(float input, float param, float param2) 
-	{
-		inData[0] = input;
-		inData[1] = param;
-		inData[2] = param2;
-		return model.forward(inData);
-	}
 
-	virtual void Process(int numSamples,const float*input, float*output,float param, float param2) {
-		inData[1] = param;
-		inData[2] = param;
-    	for (int i = 0; i < numSamples; ++i)
+	virtual void Process(int numSamples,const float*input, float*output,const float* param, float param2) {
+		while (numSamples > 0)
 		{
-			inData[0] = inData[i];
-        	output[i] = model.forward(inData);
-		}
+			int n = std::min(numSamples,MAX_BLOCK);
+			for (int i = 0; i < n; ++i)
+			{
+				inputBlock(0,i) = input[i];
+			}
+			if constexpr (N_INPUTS > 1)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					inputBlock(1,i) = param[i];
+				}
+			}
+			if constexpr (N_INPUTS > 2)
+			{
+				inputBlock.row(2).leftCols(n).setConstant(param2);
+			}
+			model.Process(n,inputBlock,output);
 
+			input += n; output += n; param += n;
+			numSamples -= n;
+		}
 	}
 
 };
 
+template <template <int, int, int> class LAYER, int HIDDEN_SIZE>
+static ToobMlModel* CreateModel(const NeuralModel &jsonModel)
+{
+	switch (jsonModel.model_data().input_size())
+	{
+	case 1:
+		return new MlModelInstance<LAYER,1,HIDDEN_SIZE>(jsonModel);
+	case 2:
+		return new MlModelInstance<LAYER,2,HIDDEN_SIZE>(jsonModel);
+	case 3:
+		return new MlModelInstance<LAYER,3,HIDDEN_SIZE>(jsonModel);
+	default:
+		throw MLException(SS("Unsupported model. input_size=" << jsonModel.model_data().input_size()));
+	}
+}
+
+template <template <int, int, int> class LAYER>
+static ToobMlModel* CreateModel(const NeuralModel &jsonModel)
+{
+	switch (jsonModel.model_data().hidden_size())
+	{
+	case 8:
+		return CreateModel<LAYER,8>(jsonModel);
+	case 12:
+		return CreateModel<LAYER,12>(jsonModel);
+	case 16:
+		return CreateModel<LAYER,16>(jsonModel);
+	case 20:
+		return CreateModel<LAYER,20>(jsonModel);
+	case 32:
+		return CreateModel<LAYER,32>(jsonModel);
+	case 40:
+		return CreateModel<LAYER,40>(jsonModel);
+	default:
+		throw MLException(SS("Unsupported model. hidden_size=" << jsonModel.model_data().hidden_size()));
+	}
+}
+
 
 ToobMlModel* ToobMlModel::Load(const std::string&fileName)
 {
@@ -190,51 +207,18 @@ ToobMlModel* ToobMlModel::Load(const std::string&fileName)
 	{
 		throw MLException(SS("Unsupported model. model=" <<modelData.model()));
 	}
-	if (modelData.unit_type() !="LSTM")
-	{
-		throw MLException(SS("Unsupported model. unit_type=" <<modelData.unit_type()));
-	}
-	if (modelData.num_layers() != 1)
+	if (modelData.num_layers() < 1 || modelData.num_layers() > StateDict::MAX_LAYERS)
 	{
 		throw MLException(SS("Unsupported model. num_layers=" <<modelData.num_layers()));
 	}
-	if (modelData.unit_type() !="LSTM")
+	if (modelData.unit_type() == "LSTM")
 	{
-		throw MLException(SS("Unsupported model. unit_type=" <<modelData.unit_type()));
-	}
-	if (jsonModel.model_data().hidden_size() == 20)
-	{
-		switch (jsonModel.model_data().input_size())
-		{
-		case 1:
-			return new MlModelInstance<1,20>(jsonModel);
-		case 2:
-			return new MlModelInstance<2,20>(jsonModel);
-		case 3:
-			return new MlModelInstance<3,20>(jsonModel);
-
-		default:
-			throw MLException("Invalid model");
-			break;
-		}
- 	} else if (jsonModel.model_data().hidden_size() == 40)
+		return CreateModel<LsNumerics::BlockLstmLayer>(jsonModel);
+	} else if (modelData.unit_type() == "GRU")
 	{
-		switch (jsonModel.model_data().input_size())
-		{
-		case 1:
-			return new MlModelInstance<1,40>(jsonModel);
-		case 2:
-			return new MlModelInstance<2,40>(jsonModel);
-		case 3:
-			return new MlModelInstance<3,40>(jsonModel);
-
-		default:
-			throw MLException("Invalid model");
-			break;
-		}
+		return CreateModel<LsNumerics::BlockGruLayer>(jsonModel);
 	} else {
-		throw MLException(SS("Unsupported model. hidden_size=" << jsonModel.model_data().hidden_size()));
-			
+		throw MLException(SS("Unsupported model. unit_type=" <<modelData.unit_type()));
 	}
 }
 
@@ -710,27 +694,44 @@ void ToobML::Run(uint32_t n_samples)
 		modelChanged = false;
 		loadWorker.StartRequest();
 	}
-	for (uint32_t i = 0; i < n_samples; ++i)
+	// Process in sub-blocks so that the model can evaluate a block of samples at a time.
+	// The sag input scale is updated once per sub-block.
+	constexpr uint32_t SUB_BLOCK_SIZE = 64;
+	float modelBuffer[SUB_BLOCK_SIZE];
+	float gainBuffer[SUB_BLOCK_SIZE];
+
+	for (uint32_t blockStart = 0; blockStart < n_samples; blockStart += SUB_BLOCK_SIZE)
 	{
-		float val = trimDezipper.Tick()*input[i];
+		uint32_t n = std::min(SUB_BLOCK_SIZE,n_samples-blockStart);
+		const float *blockInput = input + blockStart;
+		float *blockOutput = output + blockStart;
 
-		float absVal = std::abs(val);
-		if (absVal > trimOutValue)
+		float sagInputScale = sagProcessor.GetInputScale();
+		for (uint32_t i = 0; i < n; ++i)
 		{
-			trimOutValue = absVal;
+			float val = trimDezipper.Tick()*blockInput[i];
+
+			float absVal = std::abs(val);
+			if (absVal > trimOutValue)
+			{
+				trimOutValue = absVal;
+			}
+			if (!bypassToneFilter)
+			{
+				val = baxandallToneStack.Tick(val);
+			}
+			modelBuffer[i] = val*sagInputScale;
+			gainBuffer[i] = gainDezipper.Tick();
 		}
-		if (!bypassToneFilter)
+		if (this->pCurrentModel != nullptr)
 		{
-			val = baxandallToneStack.Tick(val);
+			this->pCurrentModel->Process((int)n,modelBuffer,modelBuffer,gainBuffer,0);
 		}
-
-		val = val*sagProcessor.GetInputScale();
-		if (this->pCurrentModel != nullptr)
+		for (uint32_t i = 0; i < n; ++i)
 		{
-			val = this->pCurrentModel->Process(val,gainDezipper.Tick(),0);
+			float val = dcBlocker.filter(sagProcessor.TickOutput(modelBuffer[i]));
+			blockOutput[i] = val*masterDezipper.Tick();
 		}
-		val = dcBlocker.filter(sagProcessor.TickOutput(val));
-		output[i] = val*masterDezipper.Tick();
 	}
 	frameTime += n_samples;
 
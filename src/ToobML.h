@@ -65,8 +65,8 @@ namespace toob
 		virtual ~ToobMlModel() {}
 		static ToobMlModel *Load(const std::string &fileName);
 		virtual void Reset() = 0;
-		virtual void Process(int numSamples, const float *input, float *output, float param, float param2) = 0;
-		virtual float Process(float input, float param, float param2) = 0;
+		// Process a block of samples. param supplies a per-sample gain value; param2 is held constant for the block.
+		virtual void Process(int numSamples, const float *input, float *output, const float *param, float param2) = 0;
 		virtual bool IsGainEnabled() const = 0;
 	};
 
@@ -53,15 +53,15 @@ using namespace LsNumerics;
 
 using namespace toob;
 
-static const int MAX_UPDATES_PER_SECOND = 15;
+static const int MAX_UPDATES_PER_SECOND = 250; // 4ms hops.
 
 const char *ToobTuner::URI = TOOB_TUNER_URI;
 
-const double ToobTuner::TunerWorker::PitchFilter::MIN_RATIO = // pitch ratio for current-node - 500 cents.
-	std::pow(2, -0.5 / 12);
+const double ToobTuner::TunerWorker::PitchFilter::MIN_RATIO = // pitch ratio for current-note - 10 cents.
+	std::pow(2, -0.1 / 12);
 
-const double ToobTuner::TunerWorker::PitchFilter::MAX_RATIO = // pitch ratio for current-node + 500 cents.
-	std::pow(2, 0.5 / 12);
+const double ToobTuner::TunerWorker::PitchFilter::MAX_RATIO = // pitch ratio for current-note + 10 cents.
+	std::pow(2, 0.1 / 12);
 
 uint64_t timeMs();
 
@@ -77,13 +77,14 @@ ToobTuner::ToobTuner(double _rate,
 	uris.Map(this);
 	lv2_atom_forge_init(&forge, map);
 
+	// 11025 or 12000 Hz for common rates, which is plenty for the fundamentals of guitar notes.
 	subsampleRate = _rate;
-	while (subsampleRate > 48000/2)
+	while (subsampleRate > 48000/4)
 		subsampleRate /= 2;
 
-	this->tunerWorker.Initialize(getRate(), subsampleRate);
-	this->fftSize = this->tunerWorker.pitchDetector.getFftSize();
-	circularBuffer.SetSize(fftSize * 8);
+	this->analysisBus = AnalysisBus::Subscribe(_rate);
+	this->tunerWorker.Initialize(subsampleRate, MAX_UPDATES_PER_SECOND, this->analysisBus.get());
+	circularBuffer.SetSize(this->tunerWorker.GetHistorySize());
 
 	this->lowpassFilter.Design(_rate, 0.1, 1200, -60, subsampleRate / 2);
 
@@ -124,6 +125,17 @@ void ToobTuner::ConnectPort(uint32_t port, void *data)
 	case PortId::NOTIFY_OUT:
 		this->notifyOut = (LV2_Atom_Sequence *)data;
 		break;
+	case PortId::STRUM:
+		Strum.SetData(data);
+		break;
+	case PortId::STRING_1:
+	case PortId::STRING_2:
+	case PortId::STRING_3:
+	case PortId::STRING_4:
+	case PortId::STRING_5:
+	case PortId::STRING_6:
+		this->StringFreq[port - (uint32_t)PortId::STRING_1].SetData(data);
+		break;
 	}
 }
 
@@ -133,6 +145,8 @@ void ToobTuner::Activate()
 	frameTime = 0;
 	this->lowpassFilter.Reset();
 	this->circularBuffer.Reset();
+	this->analysisBus->Reset();
+	this->samplesSinceRequest = 0;
 
 	this->updateFrameIndex = 0;
 
@@ -141,6 +155,11 @@ void ToobTuner::Activate()
 
 	this->muted = Mute.GetValue() != 0;
 	muteDezipper.To(this->muted ? 0 : 1, 0);
+
+	for (auto &stringFreq : StringFreq)
+	{
+		stringFreq.SetValue(-1);
+	}
 }
 void ToobTuner::Deactivate()
 {
@@ -166,7 +185,8 @@ void ToobTuner::Run(uint32_t n_samples)
 	if (updateFrameIndex <= 0 && requestState == RequestState::Idle )
 	{
 		requestState = RequestState::Requested;
-		this->tunerWorker.Request(circularBuffer,this->frameTime);
+		this->tunerWorker.Request(circularBuffer,this->samplesSinceRequest,Strum.GetValue() != 0,RefFrequency.GetValue());
+		this->samplesSinceRequest = 0;
 
 		// set time (in samples) to next request.
 		this->updateFrameIndex = this->updateFrameCount;
@@ -179,6 +199,8 @@ void ToobTuner::Run(uint32_t n_samples)
 			updateFrameIndex = 0;
 		}
 	}
+	analysisBus->Write(input, n_samples);
+
 	int subsampleCount = this->subsampleCount;
 	int subsampleIndex = this->subsampleIndex;
 	;
@@ -191,6 +213,7 @@ void ToobTuner::Run(uint32_t n_samples)
 		{
 			subsampleIndex = 0;
 			circularBuffer.Add((float)subV);
+			++samplesSinceRequest;
 		}
 		output[i] = (float)(v * muteDezipper.Tick());
 	}
@@ -203,10 +226,6 @@ void ToobTuner::Run(uint32_t n_samples)
 
 void ToobTuner::UpdateControls()
 {
-	if (this->RefFrequency.HasChanged())
-	{
-		this->tunerWorker.pitchDetector.setReferencePitch(this->RefFrequency.GetValue());
-	}
 	if (this->Threshold.HasChanged())
 	{
 		this->tunerWorker.thresholdValue = Db2Af(this->Threshold.GetValue());
@@ -222,16 +241,27 @@ void ToobTuner::UpdateControls()
 	}
 }
 
-void ToobTuner::OnPitchReceived(float valueHz)
+float ToobTuner::HzToMidiNote(float valueHz)
 {
-
-	// convert to Midi Note.
 	float midiNote = -1;
 	if (valueHz != 0)
 	{
 		midiNote = std::log2(valueHz / RefFrequency.GetValue()) * 12 + 69;
 	}
-	this->Freq.SetValue(midiNote);
+	return midiNote;
+}
+
+void ToobTuner::OnStringPitchesReceived(const float *valuesHz)
+{
+	for (size_t i = 0; i < STRING_COUNT; ++i)
+	{
+		this->StringFreq[i].SetValue(HzToMidiNote(valuesHz[i]));
+	}
+}
+
+void ToobTuner::OnPitchReceived(float valueHz)
+{
+	this->Freq.SetValue(HzToMidiNote(valueHz));
 	this->requestState = RequestState::Idle;
 	if (this->updateFrameIndex <= 0)
 	{
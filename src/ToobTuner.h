@@ -36,7 +36,9 @@
 #include "lv2/parameters/parameters.h"
 #include "lv2/units/units.h"
 #include "FilterResponse.h"
-#include "LsNumerics/PitchDetector.hpp"
+#include "LsNumerics/YinPitchTracker.hpp"
+#include "LsNumerics/StrumPitchDetector.hpp"
+#include "AnalysisBus.hpp"
 #include "LsNumerics/LsMath.hpp"
 #include <string>
 #include "Filters/ChebyshevDownsamplingFilter.h"
@@ -72,8 +74,17 @@ namespace toob
 			AUDIO_OUT,
 			CONTROL_IN,
 			NOTIFY_OUT,
+			STRUM,
+			STRING_1,
+			STRING_2,
+			STRING_3,
+			STRING_4,
+			STRING_5,
+			STRING_6,
 		};
 
+		static constexpr size_t STRING_COUNT = 6;
+
 		double rate;
 		std::string bundle_path;
 
@@ -86,7 +97,7 @@ namespace toob
 
 		ChebyshevDownsamplingFilter lowpassFilter;
 		double subsampleRate;
-		size_t fftSize;
+		size_t samplesSinceRequest = 0;
 		int subsampleCount;
 		int subsampleIndex;
 		int updateFrameCount;
@@ -102,6 +113,9 @@ namespace toob
 
 		CircularBuffer<float> circularBuffer;
 
+		// strum-mode spectra, shared with other plugins watching the same signal.
+		AnalysisBus::Subscription::ptr analysisBus;
+
 		LV2_Atom_Forge forge; ///< Forge for writing atoms in run thread
 
 		struct Uris
@@ -160,78 +174,63 @@ namespace toob
 		private:
 			ToobTuner *pThis;
 			float pitchResult;
-			uint64_t currentSampleFrame = 0;
+			float stringResults[STRING_COUNT];
 
+			// Smooths needle jitter while the pitch is steady; follows larger changes immediately.
 			class PitchFilter
 			{
 			public:
-				void Initialize(double sampleRate)
-				{
-					this->filterWindowLengthSamples = (uint64_t)(0.2 /*seconds*/*sampleRate);
-				}
-
-				static const double MIN_RATIO; // pitch ratio for current-node - 500 cents.
-				static const double  MAX_RATIO; // pitch ratio for current-node + 500 cents.
-
-
-				bool PitchMatches(float currentValue, float historicalValue) 
+				void Initialize(double updatesPerSecond)
 				{
-					if (historicalValue == 0 || currentValue == 0) return false;
-
-					double midi0 = std::fmod(LsNumerics::FrequencyToMidiNote(currentValue,440), 12.0);
-					double midi1 = std::fmod(LsNumerics::FrequencyToMidiNote(currentValue,440) ,12.0);
-
-					return std::abs(midi0-midi1) < 0.5;
-
-
+					constexpr double SMOOTHING_TIME_SECONDS = 0.01;
+					this->smoothing = 1 - std::exp(-1 / (SMOOTHING_TIME_SECONDS * updatesPerSecond));
+					this->filteredValue = 0;
 				}
 
-				float Filter(uint64_t currentSampleFrame, float value) {
+				static const double MIN_RATIO; // pitch ratio for current-note - 10 cents.
+				static const double  MAX_RATIO; // pitch ratio for current-note + 10 cents.
 
-					// remove stale entries.
-					while (pitchHistory.size() > 5)
+				float Filter(float value) {
+					if (value == 0)
 					{
-						pitchHistory.erase(pitchHistory.begin());
+						filteredValue = 0;
+						return 0;
 					}
-					pitchHistory.push_back({currentSampleFrame, value});
-
-
-					if (value != 0) {
-						size_t matchingSamples = 0;
-						for (size_t i = 0; i < pitchHistory.size(); ++i)
-						{
-							if (PitchMatches(value,pitchHistory[i].value))
-							{
-								++matchingSamples;
-							}
-						}
-						// N% of samples over the last 0.1 seconds must be within 500 cents.
-						if (matchingSamples < pitchHistory.size()) //yyx disabled.
-						{
-							value = 0;
-						}
-
+					double ratio = filteredValue == 0 ? 0 : value / filteredValue;
+					if (ratio < MIN_RATIO || ratio > MAX_RATIO)
+					{
+						filteredValue = value;
+					} else {
+						filteredValue *= std::pow(ratio, smoothing);
 					}
-
-					return value;
+					return (float)filteredValue;
 				}
 
 			private:
-				uint64_t currentSampleFrame = 0;
-				uint64_t filterWindowLengthSamples = 0;
-				struct PitchHistoryEntry
-				{
-					uint64_t sampleFrame;
-					float value;
-				};
-				std::vector<PitchHistoryEntry> pitchHistory;
+				double smoothing = 1;
+				double filteredValue = 0;
 			};
 
 			PitchFilter pitchFilter;
+			PitchFilter stringFilters[STRING_COUNT];
 			std::vector<float> capturedData;
+			size_t capturedCount = 0;
+
+			// Set by Request().
+			bool strumMode = false;
+			float referenceFrequency = 440;
+
+			bool activeStrumMode = false;
+			float stringReferenceFrequency = 0;
+
+			AnalysisBus::Subscription *analysisBus = nullptr;
+			size_t strumStft = 0;
+			uint64_t nextStrumFrame = 0;
+			uint64_t expectedStrumFrame = 0;
 
 		public:
-			PitchDetector pitchDetector;
+			YinPitchTracker pitchTracker;
+			StrumPitchDetector strumDetector;
 			float thresholdValue = 0;
 
 			TunerWorker(ToobTuner *pThis)
@@ -240,48 +239,131 @@ namespace toob
 			{
 			}
 
-			void Initialize(double sampleRate, double subSampleRate)
+			void Initialize(double subSampleRate, double updatesPerSecond, AnalysisBus::Subscription *analysisBus)
 			{
-				pitchFilter.Initialize(sampleRate);
-				constexpr size_t FFT_SIZE = 4096;
-				pitchDetector.Initialize((int)subSampleRate,FFT_SIZE);
-				capturedData.resize(pitchDetector.getFftSize());
+				// an octave below low E, up to the cutoff of the anti-aliasing filter.
+				constexpr double MIN_FREQUENCY = 40;
+				constexpr double MAX_FREQUENCY = 1200;
+				// shorter windows respond faster; lags longer than the window are compared over more than a period.
+				constexpr double WINDOW_SECONDS = 0.012;
+				// ~2.7Hz bins at 11025/12000Hz, to resolve partials of neighbouring strings. Strums sustain, so the
+				// longer window costs less than it would for single notes.
+				constexpr size_t STRUM_FFT_SIZE = 4096;
+				constexpr size_t STRUM_HOP_SIZE = STRUM_FFT_SIZE / 4;
+
+				pitchFilter.Initialize(updatesPerSecond);
+				pitchTracker.Initialize(subSampleRate, MIN_FREQUENCY, MAX_FREQUENCY, WINDOW_SECONDS);
+				strumDetector.Initialize(subSampleRate, STRUM_FFT_SIZE, STRUM_HOP_SIZE, MAX_FREQUENCY);
+
+				// the analysis bus level that runs at subSampleRate.
+				this->analysisBus = analysisBus;
+				AnalysisBus::StftConfig strumConfig;
+				while (analysisBus->GetSampleRate(strumConfig.level) > subSampleRate)
+				{
+					++strumConfig.level;
+				}
+				strumConfig.fftSize = STRUM_FFT_SIZE;
+				strumConfig.hopSize = STRUM_HOP_SIZE;
+				strumConfig.frameHistory = 4;
+				strumStft = analysisBus->AddStft(strumConfig);
+				for (auto &stringFilter : stringFilters)
+				{
+					stringFilter.Initialize(subSampleRate / STRUM_HOP_SIZE);
+				}
+				for (auto &stringResult : stringResults)
+				{
+					stringResult = 0;
+				}
+				capturedData.resize(pitchTracker.GetHistorySize());
 			}
+			size_t GetHistorySize() const { return capturedData.size(); }
 
-			void Request(const CircularBuffer<float>&circularBuffer, uint64_t currentFrame)
+			// Only the samples that arrived since the last request are copied; the detectors keep their own history.
+			void Request(const CircularBuffer<float>&circularBuffer, size_t newSamples, bool strumMode, float referenceFrequency)
 			{
-				circularBuffer.CopyTo(capturedData);
-				this->currentSampleFrame = currentFrame;
+				capturedCount = std::min(newSamples, capturedData.size());
+				circularBuffer.CopyTo(capturedData, capturedCount);
+				this->strumMode = strumMode;
+				this->referenceFrequency = referenceFrequency;
 				this->WorkerAction::Request();
 			}
 
 		protected:
 			void OnWork()
 			{
-				bool aboveThreshold = false;
-				for (auto i = this->capturedData.begin() ; i != capturedData.end(); ++i)
+				if (strumMode != activeStrumMode)
 				{
-					if (std::abs(*i) > this->thresholdValue)
+					activeStrumMode = strumMode;
+					pitchTracker.Reset();
+					strumDetector.Reset();
+					pitchFilter.Filter(0);
+					for (size_t i = 0; i < STRING_COUNT; ++i)
 					{
-						aboveThreshold = true;
-						break;
+						stringResults[i] = stringFilters[i].Filter(0);
 					}
 				}
-				if (aboveThreshold)
+				if (strumMode)
+				{
+					OnStrumWork();
+					return;
+				}
+				pitchTracker.AddSamples(capturedData.data(), capturedCount);
+				if (pitchTracker.GetPeakLevel() > this->thresholdValue)
 				{
-					pitchResult = pitchDetector.detectPitch(this->capturedData.data());
-					// std::cout << "pitch: " << pitchResult << " " << FrequencyToNoteName(pitchResult) << std::endl;
+					pitchResult = (float)pitchTracker.DetectPitch();
 				}
 				else
 				{
 					pitchResult = 0;
 				}
 
-				pitchResult = pitchFilter.Filter(currentSampleFrame, pitchResult);
+				pitchResult = pitchFilter.Filter(pitchResult);
+			}
+			void OnStrumWork()
+			{
+				// standard tuning: E2 A2 D3 G3 B3 E4.
+				static constexpr int STRING_MIDI_NOTES[STRING_COUNT] = {40, 45, 50, 55, 59, 64};
+
+				if (referenceFrequency != stringReferenceFrequency)
+				{
+					stringReferenceFrequency = referenceFrequency;
+					std::vector<double> frequencies;
+					for (int midiNote : STRING_MIDI_NOTES)
+					{
+						frequencies.push_back(referenceFrequency * std::pow(2.0, (midiNote - 69) / 12.0));
+					}
+					strumDetector.SetStringFrequencies(frequencies);
+				}
+				strumDetector.SetThreshold(thresholdValue);
+				pitchResult = 0;
+				// one frame every STRUM_HOP_SIZE samples; requests in between usually have none.
+				bool analyzed = false;
+				analysisBus->ReadFrames(
+					strumStft,
+					nextStrumFrame,
+					[this, &analyzed](uint64_t frameIndex, const AnalysisBus::spectrum_t &spectrum)
+					{
+						if (frameIndex != expectedStrumFrame)
+						{
+							// no phase differences across a gap.
+							strumDetector.Reset();
+						}
+						expectedStrumFrame = frameIndex + 1;
+						strumDetector.AddSpectrum(spectrum);
+						analyzed = true;
+					});
+				if (analyzed)
+				{
+					for (size_t i = 0; i < STRING_COUNT; ++i)
+					{
+						stringResults[i] = stringFilters[i].Filter((float)strumDetector.GetStringPitch(i));
+					}
+				}
 			}
 			void OnResponse()
 			{
 				pThis->OnPitchReceived(this->pitchResult);
+				pThis->OnStringPitchesReceived(this->stringResults);
 			}
 		};
 
@@ -294,9 +376,13 @@ namespace toob
 		RangedInputPort RefFrequency = RangedInputPort(425, 455);
 		RangedInputPort Threshold = RangedInputPort(-60, 0);
 		RangedInputPort Mute = RangedInputPort(0, 1);
+		RangedInputPort Strum = RangedInputPort(0, 1);
 		OutputPort Freq{0};
+		OutputPort StringFreq[STRING_COUNT];
 
 		void OnPitchReceived(float value);
+		void OnStringPitchesReceived(const float *values);
+		float HzToMidiNote(float valueHz);
 
 		bool muted = false;
 		ControlDezipper muteDezipper{0};
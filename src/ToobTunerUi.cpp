@@ -60,8 +60,8 @@ PLUGIN_CLASS::PLUGIN_CLASS()
 
 Lv2cElement::ptr PLUGIN_CLASS::RenderControl(Lv2cBindingProperty<double> &value, const Lv2PortInfo &portInfo) 
 {
-    // Interecept the tuner control so that we bind the reference frequency.
-    if (portInfo.symbol() == "FREQ")
+    // Interecept the tuner controls (and the strum-mode string tuners) so that we bind the reference frequency.
+    if (portInfo.symbol() == "FREQ" || portInfo.symbol().starts_with("STRING"))
     {
         auto tunerControl = Lv2TunerElement::Create();
         value.Bind(tunerControl->ValueProperty);
@@ -34,9 +34,12 @@ namespace toob
         enum class ChunkIds
         {
             Riff = 0x46464952,
+            Rf64 = 0x34364652,
             WaveRiff = 0x45564157,
             Format = 0x020746d66,
             Data = 0x61746164,
+            Junk = 0x4B4E554A,
+            Ds64 = 0x34367364,
 
         };
 
@@ -65,6 +68,9 @@ namespace toob
             uint32_t dwChannelMask = 0;
             WavGuid SubFormat;
         };
+        // Size of the ds64 chunk body (riff size, data size, sample count, table length) in an RF64 file.
+        static constexpr size_t DS64_CHUNK_SIZE = 28;
+
         struct WaveFormat
         {
             uint16_t wFormatTag;
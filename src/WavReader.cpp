@@ -19,12 +19,27 @@
  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+// 64-bit file offsets for mmap()/pread() on 32-bit hosts.
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "WavReader.hpp"
 #include <stdexcept>
 #include "ss.hpp"
 #include "WavGuid.hpp"
 #include <limits>
-#include "ss.hpp"
+#include <algorithm>
+#include <cstring>
+#include "restrict.hpp"
+
+#ifndef _MSC_VER
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace toob;
@@ -35,60 +50,156 @@ using namespace toob::private_use;
 
 int32_t WavReader::ReadInt32()
 {
-    uint8_t bytes[4];
-    f.read((char *)bytes, 4);
-    if (!f)
-    {
-        throw length_error("Unexpected end of file.");
-    }
+    const uint8_t *bytes = Consume(4);
     return int32_t(
-        bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[0] << 24));
+        bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
 }
 uint32_t WavReader::ReadUint32()
 {
-    uint8_t bytes[4];
-    f.read((char *)bytes, 4);
-    if (!f)
-    {
-        throw length_error("Unexpected end of file.");
-    }
+    const uint8_t *bytes = Consume(4);
     return uint32_t(
         bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
 }
 int16_t WavReader::ReadInt16()
 {
-    uint8_t bytes[2];
-    f.read((char *)bytes, 2);
-    if (!f)
-    {
-        throw length_error("Unexpected end of file.");
-    }
+    const uint8_t *bytes = Consume(2);
     return int16_t(
         bytes[0] | (bytes[1] << 8));
 }
 uint16_t WavReader::ReadUint16()
 {
-    uint8_t bytes[2];
-    f.read((char *)bytes, 2);
-    if (!f)
-    {
-        throw length_error("Unexpected end of file.");
-    }
+    const uint8_t *bytes = Consume(2);
     return uint16_t(
         bytes[0] | (bytes[1] << 8));
 }
 
-void WavReader::Open(const std::filesystem::path &filename)
+WavReader::~WavReader()
+{
+    Close();
+}
+
+void WavReader::TestWindowing(size_t windowSize, bool usePread)
+{
+    this->windowLimit = windowSize;
+    this->usePread = usePread;
+}
+
+void WavReader::OpenFile(const std::filesystem::path &filename)
 {
-    f.open(filename, ios::binary | ios::in);
-    if (!f.is_open())
+#ifdef _MSC_VER
+    file.open(filename, ios::binary | ios::in);
+    if (!file.is_open())
+    {
+        throw WavReaderException(SS("Can't open file. (" << filename));
+    }
+    fileSize = (uint64_t)std::filesystem::file_size(filename);
+#else
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
     {
         throw WavReaderException(SS("Can't open file. (" << filename));
     }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        throw WavReaderException(SS("Can't open file. (" << filename));
+    }
+    fileSize = (uint64_t)st.st_size;
+#endif
+    position = 0;
+}
+
+void WavReader::UnmapWindow()
+{
+#ifndef _MSC_VER
+    if (mapping)
+    {
+        munmap(mapping, windowSize);
+        mapping = nullptr;
+    }
+#endif
+    window = nullptr;
+    windowStart = 0;
+    windowSize = 0;
+}
+
+// Move the window so that it holds the size bytes at position. Windows start on a page boundary
+// (mmap requires it) and run windowLimit bytes past the position, so sequential reads remap once
+// per window.
+void WavReader::MapWindow(size_t size)
+{
+    UnmapWindow();
+
+#ifdef _MSC_VER
+    constexpr uint64_t pageSize = 4096;
+#else
+    const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+    uint64_t start = position - position % pageSize;
+    uint64_t end = std::min(fileSize, position + std::max((uint64_t)size, (uint64_t)windowLimit));
+    size_t length = (size_t)(end - start);
+    if (length != end - start)
+    {
+        throw WavReaderException("File is too large.");
+    }
+
+#ifndef _MSC_VER
+    if (!usePread)
+    {
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, (off_t)start);
+        if (p != MAP_FAILED)
+        {
+            // samples are mostly read front to back.
+            madvise(p, length, MADV_SEQUENTIAL);
+            mapping = p;
+            window = (const uint8_t *)p;
+            windowStart = start;
+            windowSize = length;
+            return;
+        }
+        // e.g. a filesystem that doesn't support mmap. Read the rest of the file instead.
+        usePread = true;
+    }
+#endif
+
+    windowBuffer.resize(length);
+#ifdef _MSC_VER
+    file.clear();
+    file.seekg((std::streamoff)start);
+    file.read((char *)windowBuffer.data(), (std::streamsize)length);
+    if ((size_t)file.gcount() != length)
+    {
+        throw WavReaderException("Can't read file.");
+    }
+#else
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t nRead = pread(fd, windowBuffer.data() + done, length - done, (off_t)(start + done));
+        if (nRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (nRead <= 0)
+        {
+            throw WavReaderException("Can't read file.");
+        }
+        done += (size_t)nRead;
+    }
+#endif
+    window = windowBuffer.data();
+    windowStart = start;
+    windowSize = length;
+}
+
+void WavReader::Open(const std::filesystem::path &filename)
+{
+    Close();
+    OpenFile(filename);
     EnterRiff();
     ReadChunks();
 
-    f.seekg(this->dataStart);
+    position = this->dataStart;
 }
 
 static void ThrowFileFormatException()
@@ -98,7 +209,7 @@ static void ThrowFileFormatException()
 void WavReader::EnterRiff()
 {
     uint32_t chunkid = ReadUint32();
-    if (chunkid != (uint32_t)ChunkIds::Riff)
+    if (chunkid != (uint32_t)ChunkIds::Riff && chunkid != (uint32_t)ChunkIds::Rf64)
     {
         ThrowFileFormatException();
     }
@@ -109,7 +220,7 @@ void WavReader::EnterRiff()
     {
         ThrowFileFormatException();
     }
-    this->riffStart = f.tellg();
+    this->riffStart = position;
     this->riffEnd = this->riffStart + chunkSize;
 }
 
@@ -155,6 +266,7 @@ void WavReader::ReadFormat()
                 break;
             case 64:
                 this->audioFormat = AudioFormat::Float64;
+                break;
             default:
                 throw WavReaderException("Unsupported sample format.");
             }
@@ -223,44 +335,79 @@ void WavReader::ReadFormat()
     this->m_frameSize = wf.nBlockAlign;
     this->m_channelMask = (ChannelMask)wf.dwChannelMask;
 }
+static size_t BytesPerSample(WavReader::AudioFormat audioFormat)
+{
+    switch (audioFormat)
+    {
+    case WavReader::AudioFormat::Uint8:
+        return 1;
+    case WavReader::AudioFormat::Int16:
+        return 2;
+    case WavReader::AudioFormat::Int24:
+        return 3;
+    case WavReader::AudioFormat::Int32:
+    case WavReader::AudioFormat::Float32:
+        return 4;
+    case WavReader::AudioFormat::Float64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
 void WavReader::ReadChunks()
 {
 
     uint32_t chunkid = 0;
     uint32_t chunkSize = 0;
-    streampos chunkStart;
+    uint64_t chunkStart;
+    uint64_t ds64DataSize = 0;
 
     bool datachunk = false;
-    while (!datachunk && f.tellg() < (ptrdiff_t)riffEnd)
+    while (!datachunk && position < riffEnd)
     {
         chunkid = ReadUint32();
         chunkSize = ReadUint32();
-        chunkStart = f.tellg();
+        chunkStart = position;
 
         switch ((ChunkIds)chunkid)
         {
         case ChunkIds::Format:
             ReadFormat();
             break;
+        case ChunkIds::Ds64:
+        {
+            // RF64: 64-bit sizes replace the 32-bit RIFF and data chunk sizes.
+            uint64_t riffSize = ReadUint32();
+            riffSize |= ((uint64_t)ReadUint32()) << 32;
+            ds64DataSize = ReadUint32();
+            ds64DataSize |= ((uint64_t)ReadUint32()) << 32;
+            this->riffEnd = this->riffStart + riffSize - sizeof(uint32_t);
+            break;
+        }
         case ChunkIds::Data:
             datachunk = true;
-            dataStart = f.tellg();
-            dataEnd = dataStart + chunkSize;
+            dataStart = position;
+            dataEnd = dataStart + (chunkSize == 0xFFFFFFFF ? ds64DataSize : chunkSize);
             break;
         default:
             break;
         }
-        streampos chunkEnd = chunkStart + (std::streampos)chunkSize;
+        uint64_t chunkEnd = chunkStart + chunkSize;
         if (chunkSize & 1)
         {
-            chunkEnd = chunkEnd + (streampos)1;
+            chunkEnd = chunkEnd + 1;
         }
-        f.seekg(chunkEnd);
+        position = std::min(chunkEnd, fileSize);
+    }
+    if (!datachunk || m_channels == 0 || m_frameSize < m_channels * BytesPerSample(audioFormat))
+    {
+        ThrowFileFormatException();
     }
-    f.seekg(dataStart);
+    position = dataStart;
 }
 
-size_t WavReader::NumberOfFrames() const {
+uint64_t WavReader::NumberOfFrames() const {
     return (this->dataEnd-this->dataStart)/this->m_frameSize;
 }
 
@@ -281,86 +428,64 @@ static inline float AudioInputConvert(int16_t value) {
     return CVT16*value; 
 }
 
-//constexpr float CVT8 = 1.0f/(256.0);
+constexpr float CVT8 = 1.0f/128.0f;
 
-// static inline float AudioInputConvert(uint8_t value) { 
-//     return CVT8*value-0.5; 
-// }
+static inline float AudioInputConvert(uint8_t value) { 
+    return CVT8*((int32_t)value-128); 
+}
 
-template<typename T>
-void WavReader::ReadTypedData(float**channels,size_t offset,size_t length)
-{
-    size_t frameSize = this->Channels()*sizeof(T);
-    size_t maxLength = 64*1024/frameSize;
-    size_t bufferSize = maxLength*frameSize;
+// Frames are converted in blocks, one channel at a time, so that the inner loops are simple enough to vectorize,
+// and the block's input stays in cache for the other channels.
+static constexpr size_t CONVERSION_BLOCK_FRAMES = 1024;
 
-    if (this->readBuffer.size() < bufferSize) 
+template <typename T>
+static void ConvertChannel(const uint8_t *restrict input, size_t frameSize, float *restrict output, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
     {
-        this->readBuffer.resize(bufferSize);
+        T value;
+        std::memcpy(&value, input + i * frameSize, sizeof(T)); // may not be aligned.
+        output[i] = AudioInputConvert(value);
     }
-    T*buffer = (T*)(void*)(&this->readBuffer[0]);
-    while (length != 0)
+}
+
+static void ConvertInt24Channel(const uint8_t *restrict input, size_t frameSize, float *restrict output, size_t length)
+{
+    constexpr float scale = 1.0f/((int64_t)(std::numeric_limits<int32_t>::max())+(int64_t)1);
+    for (size_t i = 0; i < length; ++i)
     {
-        size_t thisTime = std::min(maxLength,length);
-        f.read((char*)(void*)buffer,thisTime*this->m_frameSize);
-        if (!f)
-        {
-            ThrowFileFormatException();
-        }
-        T*p = buffer;
+        const uint8_t *p = input + i * frameSize;
+        int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+        output[i] = v * scale;
+    }
+}
 
-        for (size_t i = 0; i < thisTime; ++i)
+template<typename T>
+void WavReader::ReadTypedData(float**channels,size_t offset,size_t length)
+{
+    // Consumed a block at a time, so that the window never has to hold more than one block.
+    for (size_t block = 0; block < length; block += CONVERSION_BLOCK_FRAMES)
+    {
+        size_t thisTime = std::min(CONVERSION_BLOCK_FRAMES, length - block);
+        const uint8_t *input = Consume(thisTime*this->m_frameSize);
+        for (size_t chan = 0; chan < this->Channels(); ++chan)
         {
-            size_t ix = offset+i;
-            for (size_t chan = 0; chan < this->Channels(); ++chan)
-            {
-                channels[chan][ix] = AudioInputConvert(*p++);
-            }
+            ConvertChannel<T>(input + chan*sizeof(T), this->m_frameSize, channels[chan] + offset + block, thisTime);
         }
-
-        length -= thisTime;
-        offset += thisTime;
     }
 }
 
 
 void WavReader::ReadInt24Data(float**channels,size_t offset,size_t length)
 {
-    size_t frameSize = this->Channels()*3;
-    size_t maxLength = 64*1024/frameSize;
-    size_t bufferSize = maxLength*frameSize;
-
-    if (this->readBuffer.size() < bufferSize) 
-    {
-        this->readBuffer.resize(bufferSize);
-    }
-    uint8_t*buffer = (uint8_t*)(void*)(&this->readBuffer[0]);
-    while (length != 0)
+    for (size_t block = 0; block < length; block += CONVERSION_BLOCK_FRAMES)
     {
-        size_t thisTime = std::min(maxLength,length);
-        f.read((char*)(void*)buffer,thisTime*this->m_frameSize);
-        if (!f)
-        {
-            ThrowFileFormatException();
-        }
-        uint8_t*p = buffer;
-
-        constexpr float scale = 1.0f/((int64_t)(std::numeric_limits<int32_t>::max())+(int64_t)1);
-
-        for (size_t i = 0; i < thisTime; ++i)
+        size_t thisTime = std::min(CONVERSION_BLOCK_FRAMES, length - block);
+        const uint8_t *input = Consume(thisTime*this->m_frameSize);
+        for (size_t chan = 0; chan < this->Channels(); ++chan)
         {
-            size_t ix = offset+i;
-            for (size_t chan = 0; chan < this->Channels(); ++chan)
-            {
-                int32_t v = (p[0] << 8)| (p[1] << 16) | (p[2] << 24);
-                p += 3;
-
-                channels[chan][ix] = (float)(v*scale);
-            }
+            ConvertInt24Channel(input + chan*3, this->m_frameSize, channels[chan] + offset + block, thisTime);
         }
-
-        length -= thisTime;
-        offset += thisTime;
     }
 }
 
@@ -368,6 +493,11 @@ void WavReader::ReadInt24Data(float**channels,size_t offset,size_t length)
 
 void WavReader::ReadData(float**channels,size_t offset, size_t length)
 {
+    if (length > (std::max(this->position, std::min(this->dataEnd, this->fileSize)) - this->position)/this->m_frameSize)
+    {
+        // the data chunk is shorter than the header claims.
+        ThrowFileFormatException();
+    }
     switch (this->audioFormat)
     {
         case AudioFormat::Float32:
@@ -385,36 +515,69 @@ void WavReader::ReadData(float**channels,size_t offset, size_t length)
         case AudioFormat::Int32:
             ReadTypedData<int32_t>(channels,offset,length);
             break;
+        case AudioFormat::Uint8:
+            ReadTypedData<uint8_t>(channels,offset,length);
+            break;
         default:
             throw WavReaderException("Unsupported format.");
     }
 }
 
+void WavReader::Seek(uint64_t frame)
+{
+    this->position = this->dataStart + std::min(frame, NumberOfFrames()) * this->m_frameSize;
+}
+
+void WavReader::Close()
+{
+    UnmapWindow();
+    windowBuffer = std::vector<uint8_t>();
+#ifdef _MSC_VER
+    file.close();
+#else
+    if (fd != -1)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    fileSize = 0;
+    position = 0;
+}
+
 std::vector<std::vector<float>> WavReader::ReadData()
 {
     std::vector<std::vector<float>> result;
     result.resize(this->m_channels);
-    size_t numberOfFrames = NumberOfFrames();
+    size_t numberOfFrames = (size_t)NumberOfFrames();
 
-    float **tResult = new float*[Channels()];
+    std::vector<float*> tResult(Channels());
 
     for (size_t i = 0; i < result.size(); ++i)
     {
         result[i].resize(numberOfFrames);
-        tResult[i] = &result[i][0];
+        tResult[i] = result[i].data();
     }
-    ReadData(tResult,0,numberOfFrames);
+    ReadData(tResult.data(),0,numberOfFrames);
 
     return result;
 }
 
+// Converts straight into audioData's buffers.
 void WavReader::Read(AudioData&audioData)
 {
     audioData.setSampleRate(this->SampleRate());
-
-    std::vector<std::vector<float>> data = ReadData();
-    audioData.setData(std::move(data));
+    audioData.setChannelCount(this->Channels());
+    audioData.setSize((size_t)NumberOfFrames());
     audioData.setChannelMask(m_channelMask);
+
+    std::vector<float*> channels(Channels());
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        channels[i] = audioData.getChannel(i).data();
+    }
+    Seek(0);
+    ReadData(channels.data(),0,(size_t)NumberOfFrames());
 }
 
 
@@ -21,7 +21,6 @@
 
 #pragma once
 #include <string>
-#include <fstream>
 #include <cstdint>
 #include <stdexcept>
 #include <vector>
@@ -29,6 +28,9 @@
 #include "AudioData.hpp"
 #include "WavConstants.hpp"
 #include <filesystem>
+#ifdef _MSC_VER
+#include <fstream>
+#endif
 
 namespace toob
 {
@@ -41,6 +43,12 @@ namespace toob
         {
         }
     };
+
+    // Reads .wav files in place, through a sliding memory-mapped window on the file. Samples are
+    // converted straight from the mapping into the caller's buffers, so a file can be streamed
+    // (Seek/ReadData) without reading the parts that aren't used, and files larger than the address
+    // space (RF64 on 32-bit hosts) can be read. If the file can't be mapped, the window is filled
+    // with pread() instead.
     class WavReader
     {
     public:
@@ -55,35 +63,52 @@ namespace toob
             Float64,
         };
 
+        WavReader() = default;
+        WavReader(const WavReader &) = delete;
+        WavReader &operator=(const WavReader &) = delete;
+        ~WavReader();
+
         static AudioData Load(const std::filesystem::path &path);
 
         void Open(const std::filesystem::path &path);
 
         uint32_t Channels() const { return m_channels; }
         uint32_t SampleRate() const { return m_sampleRate; }
-        size_t NumberOfFrames() const;
+        uint64_t NumberOfFrames() const;
 
         void Read(AudioData &audioData);
 
         std::vector<std::vector<float>> ReadData();
 
+        // Convert the next length frames into channels[c][offset...offset+length).
         void ReadData(float **channels, size_t offset, size_t length);
+        // Position the reader so that the next ReadData starts at frame.
+        void Seek(uint64_t frame);
+        void Close();
         ChannelMask GetChannelMask() const { return m_channelMask; }
 
-    private:
-        void ReadInt24Data(float **channels, size_t offset, size_t length);
+        // Bytes of the file that are mapped at once.
+        static constexpr size_t WINDOW_SIZE = 16 * 1024 * 1024;
+
+        // Testing only: use a smaller window (rounded up to whole pages), and optionally read with
+        // pread() instead of mmap(). Call before Open().
+        void TestWindowing(size_t windowSize, bool usePread);
 
+    private:
         template <typename T>
         void ReadTypedData(float **channels, size_t offset, size_t length);
+        void ReadInt24Data(float **channels, size_t offset, size_t length);
 
-        std::vector<uint8_t> readBuffer;
-        std::ifstream f;
         AudioFormat audioFormat = AudioFormat::Invalid;
 
+        void OpenFile(const std::filesystem::path &path);
+        void MapWindow(size_t size);
+        void UnmapWindow();
         void EnterRiff();
         void ReadChunks();
         void ReadFormat();
 
+        const uint8_t *Consume(size_t size);
         uint8_t ReadUint8();
         int32_t ReadInt32();
         int16_t ReadInt16();
@@ -96,22 +121,50 @@ namespace toob
         size_t m_frameSize = 0;
         ChannelMask m_channelMask = ChannelMask::ZERO;
 
-        size_t riffStart = 0;
-        size_t riffEnd = 0;
-
-        size_t dataStart = 0;
-        size_t dataEnd = 0;
+#ifdef _MSC_VER
+        std::ifstream file;
+#else
+        int fd = -1;
+        void *mapping = nullptr;
+#endif
+        bool usePread = false;
+        size_t windowLimit = WINDOW_SIZE;
+        std::vector<uint8_t> windowBuffer;
+
+        // bytes [windowStart, windowStart+windowSize) of the file are at window.
+        const uint8_t *window = nullptr;
+        uint64_t windowStart = 0;
+        size_t windowSize = 0;
+
+        // file offsets.
+        uint64_t fileSize = 0;
+        uint64_t position = 0;
+
+        uint64_t riffStart = 0;
+        uint64_t riffEnd = 0;
+
+        uint64_t dataStart = 0;
+        uint64_t dataEnd = 0;
     };
 
-    inline uint8_t WavReader::ReadUint8()
+    inline const uint8_t *WavReader::Consume(size_t size)
     {
-        char b;
-        f.read(&b, 1);
-        if (!f)
+        if (size > fileSize - position)
+        {
+            throw std::length_error("Unexpected end of file.");
+        }
+        if (position < windowStart || position + size > windowStart + windowSize)
         {
-            throw std::domain_error("End of file.");
+            MapWindow(size);
         }
-        return (uint8_t)b;
+        const uint8_t *result = window + (position - windowStart);
+        position += size;
+        return result;
+    }
+
+    inline uint8_t WavReader::ReadUint8()
+    {
+        return *Consume(1);
     }
 
 }
@@ -0,0 +1,614 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "WavReader.hpp"
+#include "TestAssert.hpp"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+using namespace toob;
+namespace fs = std::filesystem;
+
+using AudioFormat = WavReader::AudioFormat;
+
+// Not a multiple of WavReader's conversion block size.
+static constexpr size_t FRAMES = 3001;
+static constexpr uint32_t SAMPLE_RATE = 44100;
+
+static fs::path TestDirectory()
+{
+    fs::path path = fs::temp_directory_path() / ("WavReaderTest-" + std::to_string(getpid()));
+    fs::remove_all(path);
+    fs::create_directories(path);
+    return path;
+}
+
+static size_t BytesPerSample(AudioFormat format)
+{
+    switch (format)
+    {
+    case AudioFormat::Uint8:
+        return 1;
+    case AudioFormat::Int16:
+        return 2;
+    case AudioFormat::Int24:
+        return 3;
+    case AudioFormat::Int32:
+    case AudioFormat::Float32:
+        return 4;
+    case AudioFormat::Float64:
+        return 8;
+    default:
+        throw std::logic_error("Invalid format.");
+    }
+}
+
+static bool IsFloat(AudioFormat format)
+{
+    return format == AudioFormat::Float32 || format == AudioFormat::Float64;
+}
+
+static const char *FormatName(AudioFormat format)
+{
+    switch (format)
+    {
+    case AudioFormat::Uint8:
+        return "Uint8";
+    case AudioFormat::Int16:
+        return "Int16";
+    case AudioFormat::Int24:
+        return "Int24";
+    case AudioFormat::Int32:
+        return "Int32";
+    case AudioFormat::Float32:
+        return "Float32";
+    case AudioFormat::Float64:
+        return "Float64";
+    default:
+        return "Invalid";
+    }
+}
+
+// Integer sample codes that exercise the sign bit and the full range of each format.
+static int64_t SampleCode(AudioFormat format, size_t channel, size_t frame)
+{
+    uint64_t hash = (frame + 1) * 2654435761u + channel * 40503u;
+    switch (format)
+    {
+    case AudioFormat::Uint8:
+        return (int64_t)(hash % 256);
+    case AudioFormat::Int16:
+        return (int64_t)(int16_t)(uint16_t)hash;
+    case AudioFormat::Int24:
+        return (int64_t)((int32_t)((uint32_t)hash << 8) >> 8);
+    case AudioFormat::Int32:
+        return (int64_t)(int32_t)(uint32_t)hash;
+    default:
+        throw std::logic_error("Invalid format.");
+    }
+}
+
+static double FloatSample(size_t channel, size_t frame)
+{
+    return 0.9 * std::sin(0.013 * (double)frame + (double)channel) + 1E-9 * (double)frame;
+}
+
+static float ExpectedSample(AudioFormat format, size_t channel, size_t frame)
+{
+    switch (format)
+    {
+    case AudioFormat::Uint8:
+        return (float)(SampleCode(format, channel, frame) - 128) / 128.0f;
+    case AudioFormat::Int16:
+        return (float)SampleCode(format, channel, frame) / 32768.0f;
+    case AudioFormat::Int24:
+        return (float)SampleCode(format, channel, frame) / 8388608.0f;
+    case AudioFormat::Int32:
+        return (float)((double)SampleCode(format, channel, frame) / 2147483648.0);
+    case AudioFormat::Float32:
+    case AudioFormat::Float64:
+        return (float)FloatSample(channel, frame);
+    default:
+        throw std::logic_error("Invalid format.");
+    }
+}
+
+class ByteWriter
+{
+public:
+    void Uint8(uint8_t value) { bytes.push_back(value); }
+    void Uint16(uint16_t value)
+    {
+        Uint8((uint8_t)value);
+        Uint8((uint8_t)(value >> 8));
+    }
+    void Uint32(uint32_t value)
+    {
+        Uint16((uint16_t)value);
+        Uint16((uint16_t)(value >> 16));
+    }
+    void Uint64(uint64_t value)
+    {
+        Uint32((uint32_t)value);
+        Uint32((uint32_t)(value >> 32));
+    }
+    void Id(const char *id)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            Uint8((uint8_t)id[i]);
+        }
+    }
+    void Float32(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Uint32(bits);
+    }
+    void Float64(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Uint64(bits);
+    }
+    void Sample(AudioFormat format, size_t channel, size_t frame)
+    {
+        switch (format)
+        {
+        case AudioFormat::Float32:
+            Float32((float)FloatSample(channel, frame));
+            break;
+        case AudioFormat::Float64:
+            Float64(FloatSample(channel, frame));
+            break;
+        default:
+        {
+            uint64_t code = (uint64_t)SampleCode(format, channel, frame);
+            for (size_t i = 0; i < BytesPerSample(format); ++i)
+            {
+                Uint8((uint8_t)(code >> (8 * i)));
+            }
+            break;
+        }
+        }
+    }
+    void Patch32(size_t offset, uint32_t value)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            bytes[offset + i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+    size_t Size() const { return bytes.size(); }
+
+    std::vector<uint8_t> bytes;
+};
+
+struct WavOptions
+{
+    AudioFormat format = AudioFormat::Int16;
+    size_t channels = 2;
+    bool extensible = false;
+    uint32_t channelMask = 0;
+    bool rf64 = false;
+    // Bytes of sample data dropped from the end of the file, with the headers left unchanged.
+    size_t truncatedBytes = 0;
+};
+
+static void WriteWav(const fs::path &path, const WavOptions &options)
+{
+    size_t frameSize = options.channels * BytesPerSample(options.format);
+    uint64_t dataSize = (uint64_t)frameSize * FRAMES;
+
+    ByteWriter writer;
+    writer.Id(options.rf64 ? "RF64" : "RIFF");
+    size_t riffSizeOffset = writer.Size();
+    writer.Uint32(0xFFFFFFFF);
+    writer.Id("WAVE");
+
+    size_t ds64SizesOffset = 0;
+    if (options.rf64)
+    {
+        writer.Id("ds64");
+        writer.Uint32(28);
+        ds64SizesOffset = writer.Size();
+        writer.Uint64(0); // riff size
+        writer.Uint64(dataSize);
+        writer.Uint64(FRAMES); // sample count
+        writer.Uint32(0);      // table length
+    }
+
+    writer.Id("fmt ");
+    writer.Uint32(options.extensible ? 40 : 16);
+    uint16_t formatTag = options.extensible ? 0xFFFE : (IsFloat(options.format) ? 3 : 1);
+    writer.Uint16(formatTag);
+    writer.Uint16((uint16_t)options.channels);
+    writer.Uint32(SAMPLE_RATE);
+    writer.Uint32((uint32_t)(SAMPLE_RATE * frameSize));
+    writer.Uint16((uint16_t)frameSize);
+    writer.Uint16((uint16_t)(8 * BytesPerSample(options.format)));
+    if (options.extensible)
+    {
+        writer.Uint16(22);
+        writer.Uint16((uint16_t)(8 * BytesPerSample(options.format)));
+        writer.Uint32(options.channelMask);
+        // KSDATAFORMAT_SUBTYPE_PCM or _IEEE_FLOAT; data3 is stored big-endian.
+        writer.Uint32(IsFloat(options.format) ? 3 : 1);
+        writer.Uint16(0x0000);
+        writer.Uint16(0x0010);
+        for (uint8_t b : {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71})
+        {
+            writer.Uint8(b);
+        }
+    }
+
+    // An odd-sized chunk that the reader has to skip, along with its pad byte.
+    writer.Id("LIST");
+    writer.Uint32(5);
+    writer.Id("INFO");
+    writer.Uint8(0);
+    writer.Uint8(0);
+
+    writer.Id("data");
+    writer.Uint32(options.rf64 ? 0xFFFFFFFF : (uint32_t)dataSize);
+    for (size_t frame = 0; frame < FRAMES; ++frame)
+    {
+        for (size_t channel = 0; channel < options.channels; ++channel)
+        {
+            writer.Sample(options.format, channel, frame);
+        }
+    }
+    if (options.rf64)
+    {
+        uint64_t riffSize = writer.Size() - 8;
+        for (size_t i = 0; i < 2; ++i)
+        {
+            writer.Patch32(ds64SizesOffset + 4 * i, (uint32_t)(riffSize >> (32 * i)));
+        }
+    }
+    else
+    {
+        writer.Patch32(riffSizeOffset, (uint32_t)(writer.Size() - 8));
+    }
+    writer.bytes.resize(writer.Size() - options.truncatedBytes);
+
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write((const char *)writer.bytes.data(), (std::streamsize)writer.Size());
+    TEST_ASSERT(f.good());
+}
+
+static void CheckSamples(AudioFormat format, const std::vector<float> &samples, size_t channel, size_t firstFrame)
+{
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        float expected = ExpectedSample(format, channel, firstFrame + i);
+        TEST_ASSERT(std::abs(samples[i] - expected) <= 1E-7f);
+    }
+}
+
+static void TestFormats(const fs::path &directory)
+{
+    for (AudioFormat format : {AudioFormat::Uint8, AudioFormat::Int16, AudioFormat::Int24, AudioFormat::Int32,
+                               AudioFormat::Float32, AudioFormat::Float64})
+    {
+        for (bool extensible : {false, true})
+        {
+            std::cout << "    " << FormatName(format) << (extensible ? " (extensible)" : "") << std::endl;
+            WavOptions options;
+            options.format = format;
+            options.channels = 3;
+            options.extensible = extensible;
+            options.channelMask = 0x7;
+            fs::path path = directory / "format.wav";
+            WriteWav(path, options);
+
+            WavReader reader;
+            reader.Open(path);
+            TEST_ASSERT(reader.Channels() == options.channels);
+            TEST_ASSERT(reader.SampleRate() == SAMPLE_RATE);
+            TEST_ASSERT(reader.NumberOfFrames() == FRAMES);
+            if (extensible)
+            {
+                TEST_ASSERT(reader.GetChannelMask() == (ChannelMask)options.channelMask);
+            }
+            std::vector<std::vector<float>> data = reader.ReadData();
+            TEST_ASSERT(data.size() == options.channels);
+            for (size_t channel = 0; channel < data.size(); ++channel)
+            {
+                TEST_ASSERT(data[channel].size() == FRAMES);
+                CheckSamples(format, data[channel], channel, 0);
+            }
+        }
+    }
+}
+
+static void TestLoad(const fs::path &directory)
+{
+    WavOptions options;
+    options.format = AudioFormat::Int24;
+    fs::path path = directory / "load.wav";
+    WriteWav(path, options);
+
+    AudioData audioData = WavReader::Load(path);
+    TEST_ASSERT(audioData.getSampleRate() == SAMPLE_RATE);
+    TEST_ASSERT(audioData.getChannelCount() == options.channels);
+    TEST_ASSERT(audioData.getSize() == FRAMES);
+    for (size_t channel = 0; channel < options.channels; ++channel)
+    {
+        CheckSamples(options.format, audioData.getChannel(channel), channel, 0);
+    }
+}
+
+static void TestRf64(const fs::path &directory)
+{
+    for (AudioFormat format : {AudioFormat::Int16, AudioFormat::Float32})
+    {
+        WavOptions options;
+        options.format = format;
+        options.rf64 = true;
+        fs::path path = directory / "rf64.wav";
+        WriteWav(path, options);
+
+        WavReader reader;
+        reader.Open(path);
+        TEST_ASSERT(reader.Channels() == options.channels);
+        TEST_ASSERT(reader.NumberOfFrames() == FRAMES);
+        std::vector<std::vector<float>> data = reader.ReadData();
+        for (size_t channel = 0; channel < data.size(); ++channel)
+        {
+            CheckSamples(format, data[channel], channel, 0);
+        }
+    }
+}
+
+static void TestSeek(const fs::path &directory)
+{
+    WavOptions options;
+    options.format = AudioFormat::Int24;
+    fs::path path = directory / "seek.wav";
+    WriteWav(path, options);
+
+    WavReader reader;
+    reader.Open(path);
+
+    // Read into the middle of the caller's buffers.
+    constexpr size_t SEEK_FRAME = 1234;
+    constexpr size_t LENGTH = 700;
+    constexpr size_t OFFSET = 10;
+    std::vector<std::vector<float>> buffers(options.channels, std::vector<float>(OFFSET + LENGTH, 99.0f));
+    std::vector<float *> channels;
+    for (auto &buffer : buffers)
+    {
+        channels.push_back(buffer.data());
+    }
+    reader.Seek(SEEK_FRAME);
+    reader.ReadData(channels.data(), OFFSET, LENGTH);
+    for (size_t channel = 0; channel < options.channels; ++channel)
+    {
+        for (size_t i = 0; i < OFFSET; ++i)
+        {
+            TEST_ASSERT(buffers[channel][i] == 99.0f);
+        }
+        CheckSamples(options.format, std::vector<float>(buffers[channel].begin() + OFFSET, buffers[channel].end()), channel, SEEK_FRAME);
+    }
+
+    // Reads continue from where the last one stopped.
+    reader.ReadData(channels.data(), 0, 1);
+    for (size_t channel = 0; channel < options.channels; ++channel)
+    {
+        TEST_ASSERT(buffers[channel][0] == ExpectedSample(options.format, channel, SEEK_FRAME + LENGTH));
+    }
+
+    // Seeking backwards.
+    reader.Seek(0);
+    reader.ReadData(channels.data(), 0, 1);
+    for (size_t channel = 0; channel < options.channels; ++channel)
+    {
+        TEST_ASSERT(buffers[channel][0] == ExpectedSample(options.format, channel, 0));
+    }
+
+    // Seeks past the end are clamped, and there's nothing left to read.
+    reader.Seek(FRAMES + 100);
+    reader.ReadData(channels.data(), 0, 0);
+    bool threw = false;
+    try
+    {
+        reader.ReadData(channels.data(), 0, 1);
+    }
+    catch (const WavReaderException &)
+    {
+        threw = true;
+    }
+    TEST_ASSERT(threw);
+
+    reader.Seek(FRAMES - 1);
+    reader.ReadData(channels.data(), 0, 1);
+    for (size_t channel = 0; channel < options.channels; ++channel)
+    {
+        TEST_ASSERT(buffers[channel][0] == ExpectedSample(options.format, channel, FRAMES - 1));
+    }
+}
+
+// A window much smaller than the file, so that frames straddle window boundaries, through both
+// mmap() and the pread() fallback.
+static void TestWindows(const fs::path &directory)
+{
+    WavOptions options;
+    options.format = AudioFormat::Int24;
+    options.channels = 3;
+    fs::path path = directory / "window.wav";
+    WriteWav(path, options);
+
+    for (bool usePread : {false, true})
+    {
+        WavReader reader;
+        reader.TestWindowing(1, usePread);
+        reader.Open(path);
+        TEST_ASSERT(reader.NumberOfFrames() == FRAMES);
+        std::vector<std::vector<float>> data = reader.ReadData();
+        for (size_t channel = 0; channel < data.size(); ++channel)
+        {
+            CheckSamples(options.format, data[channel], channel, 0);
+        }
+
+        std::vector<std::vector<float>> buffers(options.channels, std::vector<float>(FRAMES));
+        std::vector<float *> channels;
+        for (auto &buffer : buffers)
+        {
+            channels.push_back(buffer.data());
+        }
+        for (size_t frame : {(size_t)2000, (size_t)17, FRAMES - 1})
+        {
+            reader.Seek(frame);
+            reader.ReadData(channels.data(), 0, FRAMES - frame);
+            for (size_t channel = 0; channel < options.channels; ++channel)
+            {
+                CheckSamples(options.format, std::vector<float>(buffers[channel].begin(), buffers[channel].begin() + (FRAMES - frame)), channel, frame);
+            }
+        }
+    }
+}
+
+static void TestTruncatedData(const fs::path &directory)
+{
+    for (bool rf64 : {false, true})
+    {
+        WavOptions options;
+        options.format = AudioFormat::Int16;
+        options.rf64 = rf64;
+        options.truncatedBytes = 1000; // 250 frames, leaving a partial frame at the end.
+        fs::path path = directory / "truncated.wav";
+        WriteWav(path, options);
+
+        WavReader reader;
+        reader.Open(path);
+        TEST_ASSERT(reader.NumberOfFrames() == FRAMES);
+
+        // The part of the data chunk that is there can be read.
+        size_t available = FRAMES - 250;
+        std::vector<std::vector<float>> buffers(options.channels, std::vector<float>(FRAMES));
+        std::vector<float *> channels;
+        for (auto &buffer : buffers)
+        {
+            channels.push_back(buffer.data());
+        }
+        reader.ReadData(channels.data(), 0, available);
+        CheckSamples(options.format, std::vector<float>(buffers[0].begin(), buffers[0].begin() + available), 0, 0);
+
+        // ... but not past the end of the file.
+        bool threw = false;
+        try
+        {
+            reader.ReadData(channels.data(), available, 1);
+        }
+        catch (const WavReaderException &)
+        {
+            threw = true;
+        }
+        TEST_ASSERT(threw);
+
+        threw = false;
+        reader.Seek(0);
+        try
+        {
+            reader.ReadData();
+        }
+        catch (const WavReaderException &)
+        {
+            threw = true;
+        }
+        TEST_ASSERT(threw);
+
+        threw = false;
+        try
+        {
+            WavReader::Load(path);
+        }
+        catch (const std::logic_error &)
+        {
+            threw = true;
+        }
+        TEST_ASSERT(threw);
+    }
+}
+
+static void TestInvalidFiles(const fs::path &directory)
+{
+    fs::path path = directory / "invalid.wav";
+    {
+        // No fmt or data chunk.
+        static const char header[] = {'R', 'I', 'F', 'F', 4, 0, 0, 0, 'W', 'A', 'V', 'E'};
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f.write(header, sizeof(header));
+    }
+    WavReader reader;
+    bool threw = false;
+    try
+    {
+        reader.Open(path);
+    }
+    catch (const std::exception &)
+    {
+        threw = true;
+    }
+    TEST_ASSERT(threw);
+
+    threw = false;
+    try
+    {
+        reader.Open(directory / "missing.wav");
+    }
+    catch (const std::exception &)
+    {
+        threw = true;
+    }
+    TEST_ASSERT(threw);
+}
+
+int main(void)
+{
+    try
+    {
+        std::cout << "WavReaderTest" << std::endl;
+        fs::path directory = TestDirectory();
+        TestFormats(directory);
+        TestLoad(directory);
+        TestRf64(directory);
+        TestSeek(directory);
+        TestWindows(directory);
+        TestTruncatedData(directory);
+        TestInvalidFiles(directory);
+        fs::remove_all(directory);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
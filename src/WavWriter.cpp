@@ -22,6 +22,8 @@
 #include "WavWriter.hpp"
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 #include "AudioData.hpp"
 
 using namespace std;
@@ -43,11 +45,21 @@ inline void WavWriter::seek(size_t pos)
 
 void WavWriter::Open(const std::string &fileName)
 {
-    this->f.open(fileName, ios::binary | ios::out);
-    if (!f)
+    this->fileStream.open(fileName, ios::binary | ios::out);
+    if (!fileStream)
     {
         throw invalid_argument("Can't open file " + fileName);
     }
+    f.rdbuf(fileStream.rdbuf());
+    WriteHeader();
+    this->isOpen = true;
+}
+
+void WavWriter::Open(std::streambuf *streamBuffer)
+{
+    f.rdbuf(streamBuffer);
+    // let errors from the stream buffer propagate.
+    f.exceptions(ios::badbit);
     WriteHeader();
     this->isOpen = true;
 }
@@ -57,14 +69,74 @@ void WavWriter::Close()
     if (this->isOpen)
     {
         this->isOpen = false;
-        ExitChunk();
-        ExitRiff();
-        f.seekp(this->waveFormatStart);
-        WriteWavFormat(this->channels);
-        f.close();        
+        uint64_t dataSize = tell() - dataOffset;
+        if (dataSize & 1)
+        {
+            Write((uint8_t)0);
+        }
+        WriteSizes(dataSize);
+        f.flush();
+        f.exceptions(ios::goodbit);
+        f.rdbuf(nullptr);
+        if (fileStream.is_open())
+        {
+            fileStream.close();
+        }
     }
 }
 
+void WavWriter::UpdateHeader()
+{
+    if (this->isOpen)
+    {
+        WriteSizes(tell() - dataOffset);
+        f.flush();
+        if (!f)
+        {
+            throw std::runtime_error("Failed to write to WAV file.");
+        }
+    }
+}
+
+void WavWriter::WriteSizes(uint64_t dataSize)
+{
+    auto currentPosition = f.tellp();
+    uint64_t riffSize = (uint64_t)currentPosition - 2 * sizeof(uint32_t);
+
+    if (riffSize > std::numeric_limits<uint32_t>::max())
+    {
+        isRf64 = true;
+    }
+    if (isRf64)
+    {
+        // replace the JUNK chunk reserved in the header with a ds64 chunk.
+        f.seekp(0);
+        Write((uint32_t)ChunkIds::Rf64);
+        Write((uint32_t)0xFFFFFFFF);
+        f.seekp(junkOffset - (std::streamoff)(2 * sizeof(uint32_t)));
+        Write((uint32_t)ChunkIds::Ds64);
+        Write((uint32_t)DS64_CHUNK_SIZE);
+        uint64_t frameSize = channels * (sampleFormat == SampleFormat::Int16 ? sizeof(int16_t) : sizeof(float));
+        uint64_t frames = frameSize == 0 ? 0 : dataSize / frameSize;
+        f.write((const char *)&riffSize, sizeof(riffSize));
+        f.write((const char *)&dataSize, sizeof(dataSize));
+        f.write((const char *)&frames, sizeof(frames));
+        Write((uint32_t)0);
+        f.seekp(dataOffset - (std::streamoff)sizeof(uint32_t));
+        Write((uint32_t)0xFFFFFFFF);
+    }
+    else
+    {
+        f.seekp(sizeof(uint32_t));
+        Write((uint32_t)riffSize);
+        f.seekp(dataOffset - (std::streamoff)sizeof(uint32_t));
+        Write((uint32_t)dataSize);
+    }
+    f.seekp(this->waveFormatStart);
+    WriteWavFormat(this->channels);
+    f.seekp(currentPosition);
+}
+
 static float MaxValue(const std::vector<float> &data)
 {
     float max = std::numeric_limits<float>::min();
@@ -161,12 +233,47 @@ void WavWriter::Write(size_t count, size_t channels,const float **channelData, f
             throw  invalid_argument("Number of channels changed.");
         }
     }
-    for (size_t i = 0; i < count; ++i)
+    // interleave into a staging buffer so that the stream sees a few large writes instead of one per sample.
+    constexpr size_t BLOCK_FRAMES = 1024;
+
+    size_t offset = 0;
+    while (offset < count)
     {
-        for (size_t c = 0; c < channels; ++c)
+        size_t thisTime = std::min(count - offset, BLOCK_FRAMES);
+        if (sampleFormat == SampleFormat::Int16)
+        {
+            int16Buffer.resize(thisTime * channels);
+            int16_t *p = int16Buffer.data();
+            for (size_t i = offset; i < offset + thisTime; ++i)
+            {
+                for (size_t c = 0; c < channels; ++c)
+                {
+                    float v = channelData[c][i] * scale * 32768.0f;
+                    if (v > 32767.0f) v = 32767.0f;
+                    if (v < -32768.0f) v = -32768.0f;
+                    *p++ = (int16_t)std::lrint(v);
+                }
+            }
+            f.write((const char *)int16Buffer.data(), thisTime * channels * sizeof(int16_t));
+        }
+        else
         {
-            WriteSample(channelData[c][i]*scale);
+            floatBuffer.resize(thisTime * channels);
+            float *p = floatBuffer.data();
+            for (size_t i = offset; i < offset + thisTime; ++i)
+            {
+                for (size_t c = 0; c < channels; ++c)
+                {
+                    *p++ = channelData[c][i] * scale;
+                }
+            }
+            f.write((const char *)floatBuffer.data(), thisTime * channels * sizeof(float));
+        }
+        if (!f)
+        {
+            throw std::runtime_error("Failed to write to WAV file.");
         }
+        offset += thisTime;
     }
 }
 
@@ -176,26 +283,30 @@ void WavWriter::EnterRiff(private_use::ChunkIds chunkId)
     Write((uint32_t)ChunkIds::Riff);
     Write((uint32_t)(0));
     Write((uint32_t)chunkId);
-    this->riffOffset = f.tellp();
-}
-void WavWriter::ExitRiff()
-{
-    uint32_t riffSize = f.tellp()-this->riffOffset;
-    f.seekp(riffOffset-2*sizeof(uint32_t));
-    Write(riffSize);
 }
 
 
 void WavWriter::WriteHeader()
 {
+    this->isRf64 = false;
     EnterRiff(ChunkIds::WaveRiff);
 
+    // space for a ds64 chunk, in case the file has to be promoted to RF64.
+    EnterChunk(ChunkIds::Junk);
+    this->junkOffset = this->f.tellp();
+    for (size_t i = 0; i < DS64_CHUNK_SIZE; ++i)
+    {
+        Write((uint8_t)0);
+    }
+    ExitChunk();
+
     EnterChunk(ChunkIds::Format);
     this->waveFormatStart = this->f.tellp();
 
-    WriteWavFormat(0);
+    WriteWavFormat(this->channels);
     ExitChunk();
     EnterChunk(ChunkIds::Data);
+    this->dataOffset = this->f.tellp();
 }
 
 void WavWriter::WriteWavFormat(size_t channels)
@@ -205,12 +316,13 @@ void WavWriter::WriteWavFormat(size_t channels)
     wf.wFormatTag = (uint16_t)WavFormat::Extensible;
     wf.nSamplesPerSec = sampleRate;
     wf.nChannels = channels;
-    wf.wBitsPerSample = sizeof(float)*8;
-    wf.nBlockAlign = sizeof(float)*channels;
+    size_t sampleSize = sampleFormat == SampleFormat::Int16 ? sizeof(int16_t) : sizeof(float);
+    wf.wBitsPerSample = sampleSize*8;
+    wf.nBlockAlign = sampleSize*channels;
     wf.nAvgBytesPerSec = wf.nBlockAlign*sampleRate;
-    wf.wReserved = 0;
+    wf.wValidBitsPerSample = wf.wBitsPerSample;
     wf.dwChannelMask = 0;
-    wf.SubFormat = WAVE_FORMAT_IEEE_FLOAT;
+    wf.SubFormat = sampleFormat == SampleFormat::Int16 ? WAVE_FORMAT_PCM: WAVE_FORMAT_IEEE_FLOAT;
 
     // have to write field-by-field becase Windows version densely packed (DWORD dwChannelMask is not 8-bit-aligned)
     Write(wf.wFormatTag);
@@ -220,7 +332,7 @@ void WavWriter::WriteWavFormat(size_t channels)
     Write(wf.nBlockAlign);
     Write(wf.wBitsPerSample);
     Write(wf.cbSize);
-    Write(wf.wReserved);
+    Write(wf.wValidBitsPerSample);
     Write(wf.dwChannelMask);
 
     Write(wf.SubFormat.data0);
@@ -34,10 +34,17 @@ namespace toob {
 
     class WavWriter {
     public:
+        enum class SampleFormat {
+            Float32,
+            Int16
+        };
+
         WavWriter() {}
         WavWriter(const std::string &fileName) { Open(fileName);}
         ~WavWriter() { Close(); }
         void Open(const std::string & fileName);
+        // Write to a caller-supplied stream buffer, which must support output seeks. Not owned.
+        void Open(std::streambuf *streamBuffer);
         void Close();
 
         void Write(uint32_t sampleRate, const std::vector<float> &data, bool normalize = false);
@@ -45,10 +52,20 @@ namespace toob {
 
         void Write(size_t count,size_t channels, const float**data, float scale=1.0);
 
-    private:
+        // Streaming use: set format properties before writing. The format chunk is
+        // rewritten when the file is closed.
         void SetSampleRate(uint32_t sampleRate) {
             this->sampleRate = sampleRate;
         }
+        void SetChannelCount(size_t channels) { this->channels = channels; }
+        void SetSampleFormat(SampleFormat sampleFormat) { this->sampleFormat = sampleFormat; }
+        SampleFormat GetSampleFormat() const { return sampleFormat; }
+
+        // Write the current RIFF and data sizes, and flush, so that the file is valid if
+        // writing stops unexpectedly. Files that grow past 4GB are promoted to RF64.
+        void UpdateHeader();
+
+    private:
 
         void Write(uint8_t v);
         void Write(int32_t v);
@@ -66,15 +83,21 @@ namespace toob {
         void EnterRiff(private_use::ChunkIds chunkId);
         void EnterChunk(private_use::ChunkIds chunkId);
         void ExitChunk();
-        void ExitRiff();
+        void WriteSizes(uint64_t dataSize);
 
     private:
         uint32_t sampleRate = 44100;
+        SampleFormat sampleFormat = SampleFormat::Float32;
         bool isOpen = false;
         size_t channels = 0;
+        bool isRf64 = false;
         std::streamoff waveFormatStart;
-        std::streamoff riffOffset;
+        std::streamoff junkOffset;
         std::streamoff chunkOffset;
-        std::ofstream f;
+        std::streamoff dataOffset;
+        std::ofstream fileStream;
+        std::ostream f { nullptr };
+        std::vector<float> floatBuffer;
+        std::vector<int16_t> int16Buffer;
     };
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "AsyncFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace toob;
+
+static_assert(AsyncFile::BLOCK_SIZE % AsyncFile::ALIGNMENT == 0);
+static_assert(AsyncFile::HEADER_SIZE % AsyncFile::ALIGNMENT == 0);
+static_assert(AsyncFile::HEADER_SIZE <= AsyncFile::BLOCK_SIZE);
+
+static uint8_t *AllocateAligned(size_t size)
+{
+    void *result = std::aligned_alloc(AsyncFile::ALIGNMENT, size);
+    if (!result)
+    {
+        throw std::bad_alloc();
+    }
+    memset(result, 0, size);
+    return (uint8_t *)result;
+}
+
+static size_t AlignUp(size_t value)
+{
+    return (value + AsyncFile::ALIGNMENT - 1) & ~(AsyncFile::ALIGNMENT - 1);
+}
+
+AsyncFile::AsyncFile(const std::filesystem::path &path, size_t maxQueueDepth)
+    : maxQueueDepth(std::max(maxQueueDepth, (size_t)2))
+{
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0664);
+    isDirect = fd != -1;
+    if (fd == -1 && errno == EINVAL)
+    {
+        // filesystem doesn't support O_DIRECT (e.g. tmpfs).
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0664);
+    }
+    if (fd == -1)
+    {
+        throw std::runtime_error("Can't open " + path.string() + ". (" + strerror(errno) + ")");
+    }
+
+    // one block for the producer, one for a Flush() copy, and the queue.
+    blocks.resize(this->maxQueueDepth + 2);
+    for (auto &block : blocks)
+    {
+        block.data = AllocateAligned(BLOCK_SIZE);
+        freeBlocks.push_back(&block);
+    }
+    headerCopy = AllocateAligned(HEADER_SIZE);
+
+    currentBlock = freeBlocks.back();
+    freeBlocks.pop_back();
+    currentBlock->position = 0;
+    currentFill = 0;
+
+    writerThread = std::thread([this]() { WriterThread(); });
+}
+
+AsyncFile::~AsyncFile()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::exception &)
+    {
+    }
+    for (auto &block : blocks)
+    {
+        free(block.data);
+    }
+    free(headerCopy);
+}
+
+void AsyncFile::Write(uint64_t position, const void *data_, size_t length)
+{
+    const uint8_t *data = (const uint8_t *)data_;
+    if (fd == -1)
+    {
+        throw std::logic_error("AsyncFile is closed.");
+    }
+    if (position != size)
+    {
+        if (position + length > std::min(size, (uint64_t)HEADER_SIZE))
+        {
+            throw std::logic_error("AsyncFile: only the header can be rewritten.");
+        }
+        memcpy(headerCopy + position, data, length);
+        if (currentBlock->position == 0)
+        {
+            memcpy(currentBlock->data + position, data, length);
+        }
+        else
+        {
+            headerDirty = true;
+        }
+        return;
+    }
+    while (length != 0)
+    {
+        size_t thisTime = std::min(length, BLOCK_SIZE - currentFill);
+        memcpy(currentBlock->data + currentFill, data, thisTime);
+        if (size < HEADER_SIZE)
+        {
+            size_t headerBytes = std::min(thisTime, (size_t)(HEADER_SIZE - size));
+            memcpy(headerCopy + size, data, headerBytes);
+        }
+        currentFill += thisTime;
+        size += thisTime;
+        data += thisTime;
+        length -= thisTime;
+
+        if (currentFill == BLOCK_SIZE)
+        {
+            uint64_t nextPosition = currentBlock->position + BLOCK_SIZE;
+            currentBlock->length = BLOCK_SIZE;
+            Submit(currentBlock);
+            currentBlock = TakeFreeBlock();
+            currentBlock->position = nextPosition;
+            currentFill = 0;
+        }
+    }
+}
+
+void AsyncFile::ReadHeader(uint64_t position, void *data, size_t length) const
+{
+    if (position + length > std::min(size, (uint64_t)HEADER_SIZE))
+    {
+        throw std::logic_error("AsyncFile: read past the end of the header.");
+    }
+    memcpy(data, headerCopy + position, length);
+}
+
+// Queue the rewritten header, and a copy of the partially-filled current block.
+void AsyncFile::SubmitTail()
+{
+    if (headerDirty)
+    {
+        headerDirty = false;
+        Block *block = TakeFreeBlock();
+        memcpy(block->data, headerCopy, HEADER_SIZE);
+        block->position = 0;
+        block->length = HEADER_SIZE;
+        Submit(block);
+    }
+    if (currentFill != 0)
+    {
+        // write a copy, padded to the alignment; the rest of the block is still being filled.
+        Block *block = TakeFreeBlock();
+        size_t length = AlignUp(currentFill);
+        memcpy(block->data, currentBlock->data, currentFill);
+        memset(block->data + currentFill, 0, length - currentFill);
+        block->position = currentBlock->position;
+        block->length = length;
+        Submit(block);
+    }
+}
+
+void AsyncFile::Flush()
+{
+    if (fd == -1)
+    {
+        return;
+    }
+    SubmitTail();
+    WaitForIdle();
+    // remove padding.
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        throw std::runtime_error(std::string("Failed to write file. (") + strerror(errno) + ")");
+    }
+}
+
+void AsyncFile::Checkpoint()
+{
+    if (fd == -1)
+    {
+        return;
+    }
+    SubmitTail();
+    // the writer thread removes the padding, and syncs.
+    Job job;
+    job.syncSize = size;
+    Submit(job);
+}
+
+void AsyncFile::Close()
+{
+    if (fd == -1)
+    {
+        return;
+    }
+    try
+    {
+        Flush();
+    }
+    catch (const std::exception &)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        writerCv.notify_all();
+        writerThread.join();
+        ::close(fd);
+        fd = -1;
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    writerCv.notify_all();
+    writerThread.join();
+    ::close(fd);
+    fd = -1;
+}
+
+AsyncFile::Block *AsyncFile::TakeFreeBlock()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    producerCv.wait(lock, [this]() { return !freeBlocks.empty() || !error.empty(); });
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+    Block *result = freeBlocks.back();
+    freeBlocks.pop_back();
+    return result;
+}
+
+void AsyncFile::Submit(Block *block)
+{
+    Job job;
+    job.block = block;
+    Submit(job);
+}
+
+void AsyncFile::Submit(const Job &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error.empty())
+        {
+            if (job.block)
+            {
+                freeBlocks.push_back(job.block);
+            }
+            throw std::runtime_error(error);
+        }
+        writeQueue.push_back(job);
+        ++pendingJobs;
+        if (job.block)
+        {
+            ++queueDepth;
+        }
+    }
+    writerCv.notify_one();
+}
+
+void AsyncFile::WaitForIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    producerCv.wait(lock, [this]() { return pendingJobs == 0 || !error.empty(); });
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+void AsyncFile::WriterThread()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            writerCv.wait(lock, [this]() { return stopping || !writeQueue.empty(); });
+            if (writeQueue.empty())
+            {
+                return;
+            }
+            job = writeQueue.front();
+            writeQueue.pop_front();
+        }
+
+        std::string writeError;
+        Block *block = job.block;
+        if (!block)
+        {
+            // remove padding written by SubmitTail(), then make it all durable.
+            if (ftruncate(fd, (off_t)job.syncSize) != 0 || fdatasync(fd) != 0)
+            {
+                writeError = std::string("Failed to write file. (") + strerror(errno) + ")";
+            }
+        }
+        size_t written = 0;
+        while (block && written < block->length)
+        {
+            ssize_t n = pwrite(fd, block->data + written, block->length - written, (off_t)(block->position + written));
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                writeError = std::string("Failed to write file. (") + strerror(errno) + ")";
+                break;
+            }
+            written += (size_t)n;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!writeError.empty() && error.empty())
+            {
+                error = writeError;
+            }
+            if (block)
+            {
+                freeBlocks.push_back(block);
+                --queueDepth;
+            }
+            --pendingJobs;
+        }
+        producerCv.notify_all();
+    }
+}
+
+////////////////////////////////////////////////////////
+
+AsyncFileStreamBuffer::int_type AsyncFileStreamBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+    char_type ch = traits_type::to_char_type(c);
+    xsputn(&ch, 1);
+    return c;
+}
+
+std::streamsize AsyncFileStreamBuffer::xsputn(const char_type *s, std::streamsize n)
+{
+    file.Write(position, s, (size_t)n);
+    position += n;
+    return n;
+}
+
+AsyncFileStreamBuffer::pos_type AsyncFileStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    int64_t base = 0;
+    switch (dir)
+    {
+    case std::ios_base::beg:
+        base = 0;
+        break;
+    case std::ios_base::cur:
+        base = (int64_t)position;
+        break;
+    case std::ios_base::end:
+        base = (int64_t)file.Size();
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+    return seekpos(pos_type(base + off), which);
+}
+
+AsyncFileStreamBuffer::pos_type AsyncFileStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::out) || (off_type)pos < 0 || (uint64_t)(off_type)pos > file.Size())
+    {
+        return pos_type(off_type(-1));
+    }
+    position = (uint64_t)(off_type)pos;
+    return pos;
+}
+
+int AsyncFileStreamBuffer::sync()
+{
+    // don't wait for the writer thread; ostream::flush() happens on every header update.
+    file.Checkpoint();
+    return 0;
+}
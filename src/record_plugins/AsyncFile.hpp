@@ -0,0 +1,141 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace toob
+{
+    // Sequential file output for recordings, written by a dedicated writer thread.
+    //
+    // Data is collected into large aligned blocks which are queued to the writer thread,
+    // so that writeback stalls on slow media block the writer thread rather than the caller.
+    // The file is opened with O_DIRECT where the filesystem supports it, which keeps
+    // long recordings out of the page cache.
+    //
+    // Writes go at the end of the file, except that the first HEADER_SIZE bytes may be
+    // rewritten at any time (for header updates). Flush() writes everything so far,
+    // including a partial last block, and waits for completion. Checkpoint() queues the
+    // same writes followed by an fdatasync(), without waiting for any of them.
+    class AsyncFile
+    {
+    public:
+        static constexpr size_t ALIGNMENT = 4096;
+        static constexpr size_t BLOCK_SIZE = 256 * 1024;
+        static constexpr size_t HEADER_SIZE = 64 * 1024;
+        static constexpr size_t DEFAULT_QUEUE_DEPTH = 8;
+
+        AsyncFile(const std::filesystem::path &path, size_t maxQueueDepth = DEFAULT_QUEUE_DEPTH);
+        ~AsyncFile();
+
+        AsyncFile(const AsyncFile &) = delete;
+        AsyncFile &operator=(const AsyncFile &) = delete;
+
+        uint64_t Size() const { return size; }
+        void Write(uint64_t position, const void *data, size_t length);
+        void ReadHeader(uint64_t position, void *data, size_t length) const;
+        void Flush();
+        void Checkpoint();
+        void Close();
+
+        // Number of blocks queued or being written.
+        size_t QueueDepth() const { return queueDepth.load(std::memory_order_relaxed); }
+        size_t MaxQueueDepth() const { return maxQueueDepth; }
+        bool IsDirect() const { return isDirect; }
+
+    private:
+        struct Block
+        {
+            uint8_t *data = nullptr;
+            uint64_t position = 0;
+            size_t length = 0;
+        };
+        // A block to write, or (if block is null) a sync of the first syncSize bytes of the file.
+        struct Job
+        {
+            Block *block = nullptr;
+            uint64_t syncSize = 0;
+        };
+
+        Block *TakeFreeBlock();
+        void SubmitTail();
+        void Submit(Block *block);
+        void Submit(const Job &job);
+        void WaitForIdle();
+        void ThrowIfError();
+        void WriterThread();
+
+        int fd = -1;
+        bool isDirect = false;
+        size_t maxQueueDepth;
+        uint64_t size = 0;
+
+        Block *currentBlock = nullptr;
+        size_t currentFill = 0;
+        uint8_t *headerCopy = nullptr;
+        bool headerDirty = false;
+
+        std::vector<Block> blocks;
+        std::mutex mutex;
+        std::condition_variable writerCv;
+        std::condition_variable producerCv;
+        std::deque<Job> writeQueue;
+        std::vector<Block *> freeBlocks;
+        std::atomic<size_t> queueDepth{0};
+        size_t pendingJobs = 0;
+        bool stopping = false;
+        std::string error;
+        std::thread writerThread;
+    };
+
+    // Unbuffered std::streambuf over an AsyncFile, so that stream-based writers can write to it.
+    class AsyncFileStreamBuffer : public std::streambuf
+    {
+    public:
+        AsyncFileStreamBuffer(AsyncFile &file) : file(file) {}
+
+    protected:
+        virtual int_type overflow(int_type c) override;
+        virtual std::streamsize xsputn(const char_type *s, std::streamsize n) override;
+        virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+        virtual int sync() override;
+
+    private:
+        AsyncFile &file;
+        uint64_t position = 0;
+    };
+}
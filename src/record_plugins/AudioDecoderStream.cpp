@@ -0,0 +1,648 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "AudioDecoderStream.hpp"
+#include "FfmpegDecoderStream.hpp"
+#include "../WavReader.hpp"
+#include <FLAC++/decoder.h>
+#include <mpg123.h>
+#include <opusfile.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace toob;
+using namespace toob::private_use;
+
+void toob::private_use::ConvertChannels(
+    float *const *input, size_t inputChannels,
+    float **output, size_t outputChannels,
+    size_t offset, size_t frames)
+{
+    if (inputChannels == 1)
+    {
+        for (size_t c = 0; c < outputChannels; ++c)
+        {
+            std::copy(input[0], input[0] + frames, output[c] + offset);
+        }
+    }
+    else if (outputChannels == 1)
+    {
+        float scale = 1.0f / inputChannels;
+        float *out = output[0] + offset;
+        for (size_t i = 0; i < frames; ++i)
+        {
+            float sum = 0;
+            for (size_t c = 0; c < inputChannels; ++c)
+            {
+                sum += input[c][i];
+            }
+            out[i] = sum * scale;
+        }
+    }
+    else
+    {
+        for (size_t c = 0; c < outputChannels; ++c)
+        {
+            if (c < inputChannels)
+            {
+                std::copy(input[c], input[c] + frames, output[c] + offset);
+            }
+            else
+            {
+                std::fill(output[c] + offset, output[c] + offset + frames, 0.0f);
+            }
+        }
+    }
+}
+
+// Interleaved to planar, converted to the output channel count.
+static void ConvertInterleaved(
+    const float *input, size_t inputChannels,
+    std::vector<std::vector<float>> &scratch, std::vector<float *> &scratchPointers,
+    float **output, size_t outputChannels,
+    size_t offset, size_t frames)
+{
+    if (scratch.size() < inputChannels)
+    {
+        scratch.resize(inputChannels);
+        scratchPointers.resize(inputChannels);
+    }
+    for (size_t c = 0; c < inputChannels; ++c)
+    {
+        if (scratch[c].size() < frames)
+        {
+            scratch[c].resize(frames);
+        }
+        scratchPointers[c] = scratch[c].data();
+        float *planar = scratch[c].data();
+        for (size_t i = 0; i < frames; ++i)
+        {
+            planar[i] = input[i * inputChannels + c];
+        }
+    }
+    ConvertChannels(
+        scratchPointers.data(), inputChannels,
+        output, outputChannels,
+        offset, frames);
+}
+
+namespace toob
+{
+    class WavDecoderStream : public AudioDecoderStream
+    {
+    public:
+        // Returns false if the file would have to be resampled.
+        bool open(const std::filesystem::path &file, int channels, uint32_t sampleRate)
+        {
+            reader.Open(file);
+            if (reader.SampleRate() != sampleRate || reader.Channels() == 0)
+            {
+                return false;
+            }
+            this->channels = (size_t)channels;
+            this->length = reader.NumberOfFrames();
+            this->position = 0;
+            if (reader.Channels() != this->channels)
+            {
+                scratch.resize(reader.Channels());
+                scratchPointers.resize(reader.Channels());
+                for (size_t c = 0; c < scratch.size(); ++c)
+                {
+                    scratch[c].resize(SCRATCH_FRAMES);
+                    scratchPointers[c] = scratch[c].data();
+                }
+            }
+            isOpen = true;
+            return true;
+        }
+
+        virtual size_t read(float **buffers, size_t frames) override
+        {
+            if (!isOpen)
+            {
+                return 0;
+            }
+            frames = (size_t)std::min((uint64_t)frames, length - position);
+            try
+            {
+                if (scratch.empty())
+                {
+                    reader.ReadData(buffers, 0, frames);
+                }
+                else
+                {
+                    size_t offset = 0;
+                    while (offset < frames)
+                    {
+                        size_t thisTime = std::min(SCRATCH_FRAMES, frames - offset);
+                        reader.ReadData(scratchPointers.data(), 0, thisTime);
+                        ConvertChannels(
+                            scratchPointers.data(), scratchPointers.size(),
+                            buffers, channels,
+                            offset, thisTime);
+                        offset += thisTime;
+                    }
+                }
+            }
+            catch (const std::exception &)
+            {
+                // the data chunk is shorter than the header claims (e.g. an interrupted recording).
+                close();
+                return 0;
+            }
+            position += frames;
+            return frames;
+        }
+
+        virtual void seek(uint64_t frame) override
+        {
+            if (!isOpen)
+            {
+                return;
+            }
+            position = std::min(frame, length);
+            reader.Seek(position);
+        }
+
+        virtual void close() override
+        {
+            if (isOpen)
+            {
+                isOpen = false;
+                reader.Close();
+            }
+        }
+
+        virtual bool eof() const override
+        {
+            return !isOpen || position >= length;
+        }
+
+    private:
+        static constexpr size_t SCRATCH_FRAMES = 4096;
+
+        WavReader reader;
+        bool isOpen = false;
+        size_t channels = 0;
+        uint64_t length = 0;
+        uint64_t position = 0;
+        std::vector<std::vector<float>> scratch;
+        std::vector<float *> scratchPointers;
+    };
+
+    class FlacDecoderStream : public AudioDecoderStream, private FLAC::Decoder::File
+    {
+    public:
+        ~FlacDecoderStream()
+        {
+            close();
+        }
+
+        // Returns false if the file would have to be resampled.
+        bool open(const std::filesystem::path &file, int channels, uint32_t sampleRate)
+        {
+            this->channels = (size_t)channels;
+            ::FLAC__StreamDecoderInitStatus rc = init(file.string());
+            if (rc != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+            {
+                throw std::runtime_error("Can't open file " + file.string());
+            }
+            isOpen = true;
+            if (!process_until_end_of_metadata() || fileChannels == 0)
+            {
+                throw std::runtime_error("Invalid file format: " + file.string());
+            }
+            if (fileSampleRate != sampleRate)
+            {
+                return false;
+            }
+            return true;
+        }
+
+        virtual size_t read(float **buffers, size_t frames) override
+        {
+            size_t offset = 0;
+            while (offset < frames)
+            {
+                if (blockIndex == blockLength && !NextBlock())
+                {
+                    break;
+                }
+                size_t thisTime = std::min(frames - offset, blockLength - blockIndex);
+                for (size_t c = 0; c < fileChannels; ++c)
+                {
+                    blockPointers[c] = block[c].data() + blockIndex;
+                }
+                ConvertChannels(
+                    blockPointers.data(), fileChannels,
+                    buffers, channels,
+                    offset, thisTime);
+                blockIndex += thisTime;
+                offset += thisTime;
+            }
+            return offset;
+        }
+
+        virtual void seek(uint64_t frame) override
+        {
+            if (!isOpen)
+            {
+                return;
+            }
+            blockIndex = blockLength = 0;
+            atEnd = false;
+            if (totalSamples != 0 && frame >= totalSamples)
+            {
+                atEnd = true;
+                return;
+            }
+            // libFLAC delivers the frame that contains the target with the
+            // samples before the target trimmed off, so the seek is exact.
+            if (!seek_absolute(frame))
+            {
+                flush();
+                atEnd = true;
+            }
+        }
+
+        virtual void close() override
+        {
+            if (isOpen)
+            {
+                isOpen = false;
+                finish();
+            }
+            atEnd = true;
+        }
+
+        virtual bool eof() const override
+        {
+            return atEnd || !isOpen;
+        }
+
+    protected:
+        virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 *const buffer[]) override
+        {
+            size_t frames = frame->header.blocksize;
+            size_t frameChannels = std::min((size_t)frame->header.channels, fileChannels);
+            float scale = std::ldexp(1.0f, 1 - (int)frame->header.bits_per_sample);
+            for (size_t c = 0; c < fileChannels; ++c)
+            {
+                if (block[c].size() < frames)
+                {
+                    block[c].resize(frames);
+                }
+                float *output = block[c].data();
+                if (c < frameChannels)
+                {
+                    const FLAC__int32 *input = buffer[c];
+                    for (size_t i = 0; i < frames; ++i)
+                    {
+                        output[i] = scale * input[i];
+                    }
+                }
+                else
+                {
+                    std::fill(output, output + frames, 0.0f);
+                }
+            }
+            blockIndex = 0;
+            blockLength = frames;
+            return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+        }
+
+        virtual void metadata_callback(const ::FLAC__StreamMetadata *metadata) override
+        {
+            if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO)
+            {
+                const FLAC__StreamMetadata_StreamInfo &streamInfo = metadata->data.stream_info;
+                fileSampleRate = streamInfo.sample_rate;
+                fileChannels = streamInfo.channels;
+                totalSamples = streamInfo.total_samples;
+
+                block.resize(fileChannels);
+                blockPointers.resize(fileChannels);
+                for (auto &channel : block)
+                {
+                    channel.resize(streamInfo.max_blocksize);
+                }
+            }
+        }
+
+        virtual void error_callback(::FLAC__StreamDecoderErrorStatus status) override
+        {
+            // libFLAC resynchronizes on the next frame by itself; the damaged frame is dropped.
+        }
+
+    private:
+        bool NextBlock()
+        {
+            blockIndex = blockLength = 0;
+            while (!atEnd && blockLength == 0)
+            {
+                if (get_state() == FLAC__STREAM_DECODER_END_OF_STREAM || !process_single())
+                {
+                    atEnd = true;
+                }
+            }
+            return blockLength != 0;
+        }
+
+        bool isOpen = false;
+        bool atEnd = false;
+        size_t channels = 0;
+        size_t fileChannels = 0;
+        uint32_t fileSampleRate = 0;
+        uint64_t totalSamples = 0;
+
+        std::vector<std::vector<float>> block;
+        std::vector<float *> blockPointers;
+        size_t blockIndex = 0;
+        size_t blockLength = 0;
+    };
+
+    class Mp3DecoderStream : public AudioDecoderStream
+    {
+    public:
+        ~Mp3DecoderStream()
+        {
+            close();
+        }
+
+        // Returns false if the file would have to be resampled.
+        bool open(const std::filesystem::path &file, int channels, uint32_t sampleRate)
+        {
+            static std::once_flag initFlag;
+            std::call_once(initFlag, []()
+                           { mpg123_init(); });
+
+            this->channels = (size_t)channels;
+            int error = MPG123_OK;
+            handle = mpg123_new(nullptr, &error);
+            if (!handle)
+            {
+                throw std::runtime_error(mpg123_plain_strerror(error));
+            }
+            // GAPLESS trims the encoder delay and padding (from the LAME header), so that frame
+            // positions match the original audio.
+            mpg123_param(handle, MPG123_ADD_FLAGS, MPG123_FORCE_FLOAT | MPG123_GAPLESS | MPG123_QUIET, 0.0);
+            if (mpg123_open(handle, file.string().c_str()) != MPG123_OK)
+            {
+                throw std::runtime_error("Can't open file " + file.string());
+            }
+            long fileSampleRate = 0;
+            int encoding = 0;
+            if (mpg123_getformat(handle, &fileSampleRate, &fileChannels, &encoding) != MPG123_OK ||
+                encoding != MPG123_ENC_FLOAT_32 || fileChannels <= 0)
+            {
+                throw std::runtime_error("Invalid file format: " + file.string());
+            }
+            if (fileSampleRate != (long)sampleRate)
+            {
+                return false;
+            }
+            atEnd = false;
+            return true;
+        }
+
+        virtual size_t read(float **buffers, size_t frames) override
+        {
+            size_t offset = 0;
+            while (offset < frames && !atEnd)
+            {
+                size_t thisTime = std::min(frames - offset, BLOCK_FRAMES);
+                interleaved.resize(thisTime * fileChannels);
+                size_t bytesRead = 0;
+                int rc = mpg123_read(handle, (unsigned char *)interleaved.data(), interleaved.size() * sizeof(float), &bytesRead);
+                size_t framesRead = bytesRead / (sizeof(float) * fileChannels);
+                ConvertInterleaved(
+                    interleaved.data(), (size_t)fileChannels,
+                    scratch, scratchPointers,
+                    buffers, channels,
+                    offset, framesRead);
+                offset += framesRead;
+                if (rc == MPG123_NEW_FORMAT)
+                {
+                    // (the channel count can change between frames.)
+                    long rate = 0;
+                    int encoding = 0;
+                    mpg123_getformat(handle, &rate, &fileChannels, &encoding);
+                }
+                else if (rc != MPG123_OK)
+                {
+                    // MPG123_DONE, or a read error.
+                    atEnd = true;
+                }
+            }
+            return offset;
+        }
+
+        virtual void seek(uint64_t frame) override
+        {
+            if (!handle)
+            {
+                return;
+            }
+            // sample-accurate: mpg123 decodes from a few frames back, and discards the samples before the target.
+            atEnd = mpg123_seek(handle, (off_t)frame, SEEK_SET) < 0;
+        }
+
+        virtual void close() override
+        {
+            if (handle)
+            {
+                mpg123_close(handle);
+                mpg123_delete(handle);
+                handle = nullptr;
+            }
+            atEnd = true;
+        }
+
+        virtual bool eof() const override
+        {
+            return atEnd;
+        }
+
+    private:
+        static constexpr size_t BLOCK_FRAMES = 4096;
+
+        mpg123_handle *handle = nullptr;
+        bool atEnd = true;
+        size_t channels = 0;
+        int fileChannels = 0;
+        std::vector<float> interleaved;
+        std::vector<std::vector<float>> scratch;
+        std::vector<float *> scratchPointers;
+    };
+
+    class OpusDecoderStream : public AudioDecoderStream
+    {
+    public:
+        ~OpusDecoderStream()
+        {
+            close();
+        }
+
+        // Returns false if the file would have to be resampled. Opus always decodes at 48kHz.
+        // Throws if the file isn't Ogg Opus (Ogg Vorbis, for example).
+        bool open(const std::filesystem::path &file, int channels, uint32_t sampleRate)
+        {
+            this->channels = (size_t)channels;
+            int error = 0;
+            opusFile = op_open_file(file.string().c_str(), &error);
+            if (!opusFile)
+            {
+                throw std::runtime_error("Can't open file " + file.string());
+            }
+            if (sampleRate != OPUS_SAMPLE_RATE)
+            {
+                return false;
+            }
+            atEnd = false;
+            return true;
+        }
+
+        virtual size_t read(float **buffers, size_t frames) override
+        {
+            size_t offset = 0;
+            while (offset < frames && !atEnd)
+            {
+                // each link of a chained file can have a different channel count.
+                size_t fileChannels = (size_t)op_channel_count(opusFile, -1);
+                size_t thisTime = std::min(frames - offset, BLOCK_FRAMES);
+                interleaved.resize(thisTime * fileChannels);
+                int link = -1;
+                int framesRead = op_read_float(opusFile, interleaved.data(), (int)interleaved.size(), &link);
+                if (framesRead == OP_HOLE)
+                {
+                    // a damaged page. Decoding continues with the next one.
+                    continue;
+                }
+                if (framesRead <= 0)
+                {
+                    atEnd = true;
+                    break;
+                }
+                ConvertInterleaved(
+                    interleaved.data(), (size_t)op_channel_count(opusFile, link),
+                    scratch, scratchPointers,
+                    buffers, channels,
+                    offset, (size_t)framesRead);
+                offset += (size_t)framesRead;
+            }
+            return offset;
+        }
+
+        virtual void seek(uint64_t frame) override
+        {
+            if (!opusFile)
+            {
+                return;
+            }
+            // sample-accurate, with pre-roll handled by opusfile.
+            atEnd = op_pcm_seek(opusFile, (ogg_int64_t)frame) != 0;
+        }
+
+        virtual void close() override
+        {
+            if (opusFile)
+            {
+                op_free(opusFile);
+                opusFile = nullptr;
+            }
+            atEnd = true;
+        }
+
+        virtual bool eof() const override
+        {
+            return atEnd;
+        }
+
+    private:
+        static constexpr uint32_t OPUS_SAMPLE_RATE = 48000;
+        static constexpr size_t BLOCK_FRAMES = 4096;
+
+        OggOpusFile *opusFile = nullptr;
+        bool atEnd = true;
+        size_t channels = 0;
+        std::vector<float> interleaved;
+        std::vector<std::vector<float>> scratch;
+        std::vector<float *> scratchPointers;
+    };
+}
+
+AudioDecoderStream::ptr AudioDecoderStream::Create(const std::filesystem::path &file, int channels, uint32_t sampleRate)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                   { return (char)std::tolower(c); });
+    try
+    {
+        if (extension == ".wav")
+        {
+            auto stream = std::make_unique<WavDecoderStream>();
+            if (stream->open(file, channels, sampleRate))
+            {
+                return stream;
+            }
+        }
+        else if (extension == ".flac")
+        {
+            auto stream = std::make_unique<FlacDecoderStream>();
+            if (stream->open(file, channels, sampleRate))
+            {
+                return stream;
+            }
+        }
+        else if (extension == ".mp3")
+        {
+            auto stream = std::make_unique<Mp3DecoderStream>();
+            if (stream->open(file, channels, sampleRate))
+            {
+                return stream;
+            }
+        }
+        else if (extension == ".opus" || extension == ".ogg")
+        {
+            auto stream = std::make_unique<OpusDecoderStream>();
+            if (stream->open(file, channels, sampleRate))
+            {
+                return stream;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        // fall back to ffmpeg, which copes with some files the native decoders don't (compressed WAV formats, or Ogg Vorbis, for example).
+    }
+    auto stream = std::make_unique<FfmpegDecoderStream>();
+    stream->open(file, channels, sampleRate);
+    return stream;
+}
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Robin E. R. Davies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+namespace toob
+{
+    // Streams decoded audio from a file, converted to a fixed channel count and sample rate.
+    // Intended for use on a background thread.
+    //
+    // WAV, FLAC, MP3 and Ogg Opus files whose sample rate matches the requested rate are decoded
+    // in-process, and seek to the exact frame. Everything else (Ogg Vorbis, M4A, resampled files) is
+    // decoded by an ffmpeg child process; seeking restarts the child at the requested time.
+    class AudioDecoderStream
+    {
+    public:
+        using ptr = std::unique_ptr<AudioDecoderStream>;
+
+        AudioDecoderStream() {}
+        AudioDecoderStream(const AudioDecoderStream &) = delete;
+        AudioDecoderStream &operator=(const AudioDecoderStream &) = delete;
+        virtual ~AudioDecoderStream() {}
+
+        static ptr Create(const std::filesystem::path &file, int channels, uint32_t sampleRate);
+
+        // Returns the number of frames read, which is less than frames only at the end of the file.
+        virtual size_t read(float **buffers, size_t frames) = 0;
+        // Position the stream so that the next read starts at frame (at the requested sample rate).
+        virtual void seek(uint64_t frame) = 0;
+        virtual void close() = 0;
+        virtual bool eof() const = 0;
+    };
+
+    namespace private_use
+    {
+        // Convert planar audio from one channel count to another, the way ffmpeg's -ac does for
+        // the common cases: mono is copied to every output, mixes to mono are averaged, and
+        // otherwise extra channels are dropped or silent.
+        void ConvertChannels(
+            float *const *input, size_t inputChannels,
+            float **output, size_t outputChannels,
+            size_t offset, size_t frames);
+    }
+}
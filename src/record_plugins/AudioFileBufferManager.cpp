@@ -25,32 +25,80 @@
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
 
 using namespace toob;
 
-AudioFileBuffer::AudioFileBuffer(size_t channels, size_t bufferSize)
-    : bufferSize_(bufferSize)
+namespace
 {
-    data_.resize(channels);
-    for (size_t i = 0; i < channels; ++i)
+    constexpr size_t SLAB_ALIGNMENT = 4096;
+    constexpr size_t CHANNEL_ALIGNMENT = 64 / sizeof(float); // keep every channel on its own cache line.
+
+    size_t RoundUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t MakeHead(uint64_t previousHead, uint32_t index)
     {
-        data_[i].resize(bufferSize);
+        uint64_t tag = (previousHead >> 32) + 1;
+        return (tag << 32) | index;
     }
-    refCount = 1;
+}
+
+AudioFileBuffer::AudioFileBuffer(size_t channels, size_t bufferSize)
+    : channels_(channels), bufferSize_(bufferSize), channelStride_(RoundUp(bufferSize, CHANNEL_ALIGNMENT))
+{
+    ownedData = std::make_unique<float[]>(channels * channelStride_);
+    data_ = ownedData.get();
+}
+
+AudioFileBuffer::AudioFileBuffer(AudioFileBufferPool *pool, uint32_t poolIndex, size_t channels, size_t bufferSize, size_t channelStride, float *data)
+    : pool(pool), poolIndex(poolIndex), channels_(channels), bufferSize_(bufferSize), channelStride_(channelStride), data_(data)
+{
 }
 
 AudioFileBuffer::~AudioFileBuffer()
 {
 }
 
+void AudioFileBuffer::OnFinalRelease()
+{
+    if (pool)
+    {
+        refCount = 1;
+        pool->PutBuffer(this);
+    }
+    else
+    {
+        delete this;
+    }
+}
+
 AudioFileBuffer::ptr AudioFileBuffer::Create(size_t channels, size_t bufferSize)
 {
     return AudioFileBuffer::ptr(new AudioFileBuffer(channels, bufferSize));
 }
 
 AudioFileBufferPool::AudioFileBufferPool(size_t channels, size_t bufferSize, size_t reserve)
-    : channels(channels), bufferSize(bufferSize)
+    : channels(channels), bufferSize(bufferSize), channelStride(RoundUp(bufferSize, CHANNEL_ALIGNMENT)),
+      freeHead(EMPTY),
+      freeLinks(new std::atomic<uint32_t>[MAX_BUFFERS]),
+      bufferTable(new std::atomic<AudioFileBuffer *>[MAX_BUFFERS])
 {
+    for (size_t i = 0; i < MAX_BUFFERS; ++i)
+    {
+        freeLinks[i].store(EMPTY, std::memory_order_relaxed);
+        bufferTable[i].store(nullptr, std::memory_order_relaxed);
+    }
+    freeIndices.reserve(MAX_BUFFERS);
+    for (size_t i = MAX_BUFFERS; i != 0; --i)
+    {
+        freeIndices.push_back((uint32_t)(i - 1));
+    }
     Reserve(reserve);
 }
 
@@ -69,7 +117,7 @@ AudioFileBufferPool::~AudioFileBufferPool()
     {
         Trim(0);
         TestPoolCount(0);
-        if (this->freeList != nullptr)
+        if ((uint32_t)this->freeHead.load() != EMPTY)
         {
             DBG_ASSERT("AudioFileBufferPool::~AudioFileBufferPool: freeList not empty");
         }
@@ -85,62 +133,200 @@ AudioFileBufferPool::~AudioFileBufferPool()
 // do what we can to report an error since we can't throw.
         std::cout << "Warning: " << e.what() << std::endl;
     }
+    // Slabs that are still in use after Trim(0) hold leaked buffers, and are deliberately not freed.
+}
+
+AudioFileBufferPool::Slab *AudioFileBufferPool::AllocateSlab(size_t count)
+{
+    std::lock_guard lock{slabMutex};
+
+    if (freeIndices.size() < count)
+    {
+        throw std::runtime_error("AudioFileBufferPool: too many buffers.");
+    }
+    size_t headerBytes = RoundUp(count * sizeof(AudioFileBuffer), SLAB_ALIGNMENT);
+    size_t dataBytes = RoundUp(count * channels * channelStride * sizeof(float), SLAB_ALIGNMENT);
+
+    auto slab = std::make_unique<Slab>();
+    slab->bytes = headerBytes + dataBytes;
+    slab->memory = std::aligned_alloc(SLAB_ALIGNMENT, slab->bytes);
+    if (!slab->memory)
+    {
+        throw std::bad_alloc();
+    }
+    // Best effort. Most systems allow only a small amount of locked memory per process.
+    slab->locked = mlock(slab->memory, slab->bytes) == 0;
+    // Fresh buffers start out silent. This also touches every page here, rather than on the realtime thread.
+    std::memset((char *)slab->memory + headerBytes, 0, dataBytes);
+
+    slab->bufferCount = count;
+    slab->buffers = (AudioFileBuffer *)slab->memory;
+    float *data = (float *)((char *)slab->memory + headerBytes);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = freeIndices.back();
+        freeIndices.pop_back();
+        AudioFileBuffer *buffer = new (slab->buffers + i) AudioFileBuffer(
+            this, index, channels, bufferSize, channelStride, data + i * channels * channelStride);
+        bufferTable[index].store(buffer, std::memory_order_release);
+    }
+    allocatedCount += count;
+    slabs.push_back(std::move(slab));
+    return slabs.back().get();
+}
+
+void AudioFileBufferPool::FreeSlab(Slab *slab)
+{
+    for (size_t i = 0; i < slab->bufferCount; ++i)
+    {
+        AudioFileBuffer *buffer = slab->buffers + i;
+        bufferTable[buffer->poolIndex].store(nullptr, std::memory_order_relaxed);
+        freeIndices.push_back(buffer->poolIndex);
+        buffer->~AudioFileBuffer();
+    }
+    if (slab->locked)
+    {
+        munlock(slab->memory, slab->bytes);
+    }
+    std::free(slab->memory);
+    slab->memory = nullptr;
+}
+
+AudioFileBufferPool::Slab *AudioFileBufferPool::FindSlab(AudioFileBuffer *buffer)
+{
+    for (auto &slab : slabs)
+    {
+        if (buffer >= slab->buffers && buffer < slab->buffers + slab->bufferCount)
+        {
+            return slab.get();
+        }
+    }
+    throw std::runtime_error("AudioFileBufferPool: buffer does not belong to this pool.");
 }
 
 void AudioFileBufferPool::Reserve(size_t count)
 {
-    while (pooledCount < count)
+    size_t pooled = pooledCount;
+    if (pooled < count)
     {
-        AudioFileBuffer *buffer = new AudioFileBuffer(channels, bufferSize);
-        ++allocatedCount;
-        PutBuffer(buffer);
+        Slab *slab = AllocateSlab(count - pooled);
+        for (size_t i = 0; i < slab->bufferCount; ++i)
+        {
+            Push(slab->buffers + i);
+        }
+    }
+    if (pooledCount >= lowWatermark)
+    {
+        lowWatermarkSignalled.store(false, std::memory_order_relaxed);
     }
 }
+
 void AudioFileBufferPool::Trim(size_t count)
 {
     while (pooledCount > count)
     {
-        auto buffer = TakeBuffer();
-        size_t count = buffer->Release();
-        if (count != 0)
+        AudioFileBuffer *buffer = Pop();
+        if (!buffer)
+        {
+            break;
+        }
+        if (buffer->refCount.load() != 1)
         {
             throw std::runtime_error("AudioFileBufferPool::Trim: buffer has non-zero ref count");
         }
         --allocatedCount;
+
+        std::lock_guard lock{slabMutex};
+        Slab *slab = FindSlab(buffer);
+        if (++slab->retiredCount == slab->bufferCount)
+        {
+            FreeSlab(slab);
+            for (auto i = slabs.begin(); i != slabs.end(); ++i)
+            {
+                if (i->get() == slab)
+                {
+                    slabs.erase(i);
+                    break;
+                }
+            }
+        }
     }
 }
 
-void AudioFileBufferPool::PutBuffer(AudioFileBuffer *buffer)
+void AudioFileBufferPool::SetLowWatermark(size_t count, LowWatermarkCallback &&callback)
 {
-    if (buffer->refCount.load() != 1)
+    this->lowWatermark = count;
+    this->lowWatermarkCallback = std::move(callback);
+    this->lowWatermarkSignalled = false;
+}
+
+void AudioFileBufferPool::Push(AudioFileBuffer *buffer)
+{
+    uint32_t index = buffer->poolIndex;
+    uint64_t head = freeHead.load(std::memory_order_relaxed);
+    while (true)
     {
-        throw std::runtime_error("AudioFileBufferPool::Trim: buffer has invalid ref count");
+        freeLinks[index].store((uint32_t)head, std::memory_order_relaxed);
+        if (freeHead.compare_exchange_weak(head, MakeHead(head, index), std::memory_order_release, std::memory_order_relaxed))
+        {
+            break;
+        }
     }
+    ++pooledCount;
+}
 
-    AudioFileBuffer *current = freeList.load(std::memory_order_relaxed);
-    buffer->next = current;
-    while (!freeList.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+AudioFileBuffer *AudioFileBufferPool::Pop()
+{
+    uint64_t head = freeHead.load(std::memory_order_acquire);
+    while (true)
     {
-        /**/;
+        uint32_t index = (uint32_t)head;
+        if (index == EMPTY)
+        {
+            return nullptr;
+        }
+        // If another thread takes this buffer first, the tag in freeHead changes and the exchange
+        // fails, so a stale link is never installed.
+        uint32_t next = freeLinks[index].load(std::memory_order_relaxed);
+        if (freeHead.compare_exchange_weak(head, MakeHead(head, next), std::memory_order_acquire, std::memory_order_acquire))
+        {
+            --pooledCount;
+            return bufferTable[index].load(std::memory_order_relaxed);
+        }
     }
-    ++pooledCount;
 }
 
-AudioFileBuffer *AudioFileBufferPool::TakeBuffer()
+void AudioFileBufferPool::CheckLowWatermark()
 {
-    AudioFileBuffer *current = freeList.load(std::memory_order_relaxed);
-    while (current)
+    if (pooledCount < lowWatermark && lowWatermarkCallback)
     {
-        AudioFileBuffer *next = current->next;
-        if (freeList.compare_exchange_weak(current, next, std::memory_order_acquire, std::memory_order_relaxed))
+        if (!lowWatermarkSignalled.load(std::memory_order_relaxed) && !lowWatermarkSignalled.exchange(true))
         {
-            pooledCount--;
-            return current;
+            lowWatermarkCallback();
         }
     }
-    // No pooled buffers. create a new one.
-    ++allocatedCount;
-    return new AudioFileBuffer(channels, bufferSize);
+}
+
+void AudioFileBufferPool::PutBuffer(AudioFileBuffer *buffer)
+{
+    if (buffer->refCount.load() != 1)
+    {
+        throw std::runtime_error("AudioFileBufferPool::PutBuffer: buffer has invalid ref count");
+    }
+    if (buffer->pool != this)
+    {
+        throw std::runtime_error("AudioFileBufferPool::PutBuffer: buffer does not belong to this pool.");
+    }
+    Push(buffer);
+}
+
+AudioFileBuffer *AudioFileBufferPool::TakeBuffer()
+{
+    // Never allocates. An empty pool is an overrun that the caller reports; the low watermark
+    // callback has still been given a chance to ask for a refill.
+    AudioFileBuffer *buffer = Pop();
+    CheckLowWatermark();
+    return buffer;
 }
 
 void AudioFileBufferPool::TestPoolCount(size_t expected)
@@ -150,12 +336,12 @@ void AudioFileBufferPool::TestPoolCount(size_t expected)
         throw std::runtime_error("AudioFileBufferPool::TestPoolCount: pool count mismatch");
     }
 
-    auto t = this->freeList.load();
+    uint32_t index = (uint32_t)this->freeHead.load();
     size_t n = 0;
 
-    while (t)
+    while (index != EMPTY)
     {
-        t = t->next;
+        index = freeLinks[index].load();
         ++n;
     }
     if (n != expected)
@@ -26,6 +26,10 @@
 #include <atomic>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 namespace toob
 {
@@ -38,12 +42,14 @@ namespace toob
         ToobObject() {}
         virtual ~ToobObject() {}
 
+        // Called when the last reference is released.
+        virtual void OnFinalRelease() { delete this; }
+
+        std::atomic<uint64_t> refCount = 1;
+
     public:
         size_t AddRef();
         size_t Release();
-
-    private:
-        std::atomic<uint64_t> refCount = 1;
     };
 
     template <typename T>
@@ -102,31 +108,60 @@ namespace toob
         T *ptr;
     };
 
+    class AudioFileBufferPool;
+
+    // Channel data is stored planar, in memory that belongs to the buffer's pool (or to the
+    // buffer itself, for buffers made with Create()). New buffers are zero-filled, but buffers are
+    // not cleared when they are recycled; callers that need silence must write it.
     class AudioFileBuffer : public ToobObject
     {
     private:
         AudioFileBuffer(size_t channels, size_t bufferSize);
+        AudioFileBuffer(AudioFileBufferPool *pool, uint32_t poolIndex, size_t channels, size_t bufferSize, size_t channelStride, float *data);
         ~AudioFileBuffer();
 
     public:
         using ptr = ToobPtr<AudioFileBuffer>;
         static ptr Create(size_t channels, size_t bufferSize);
 
-        size_t GetChannelCount() const { return data_.size(); }
+        size_t GetChannelCount() const { return channels_; }
         size_t GetBufferSize() const { return bufferSize_; }
-        float *GetChannel(size_t channel) { return data_[channel].data(); }
-        const float *GetChannel(size_t channel) const { return data_[channel].data(); }
+        float *GetChannel(size_t channel) { return data_ + channel * channelStride_; }
+        const float *GetChannel(size_t channel) const { return data_ + channel * channelStride_; }
+
+    protected:
+        // Pooled buffers go back to their pool instead of being deleted.
+        virtual void OnFinalRelease() override;
 
     private:
         friend class AudioFileBufferPool;
-        AudioFileBuffer* next = nullptr;
-        std::atomic<uint64_t> refCount;
+        AudioFileBufferPool *pool = nullptr;
+        uint32_t poolIndex = 0;
+        size_t channels_;
         size_t bufferSize_;
-        std::vector<std::vector<float>> data_;
+        size_t channelStride_;
+        float *data_;
+        std::unique_ptr<float[]> ownedData;
     };
 
+    // Lock-free pool of AudioFileBuffers.
+    //
+    // Buffers are allocated in slabs: one contiguous, page-aligned block of sample data for
+    // every Reserve() call, which is mlocked if the process is allowed to. The free list is a
+    // stack of buffer indices whose head carries a 32-bit tag that changes on every push and pop,
+    // so a stale head can never be swapped back in (the ABA problem). Links live in an array
+    // owned by the pool, so a thread that loses a race never touches buffer memory.
+    //
+    // TakeBuffer() and PutBuffer() are lock-free and may be called from any thread. Reserve() and
+    // Trim() allocate and free memory, and must not be called on the realtime thread. TakeBuffer()
+    // never allocates: it returns nullptr when the pool is empty.
     class AudioFileBufferPool {
     public:
+        using LowWatermarkCallback = std::function<void()>;
+
+        // Upper limit on the number of buffers a pool can hold at once.
+        static constexpr size_t MAX_BUFFERS = 8192;
+
         AudioFileBufferPool(size_t channels, size_t bufferSize, size_t reserve = 6);
         virtual ~AudioFileBufferPool();
 
@@ -137,19 +172,57 @@ namespace toob
         AudioFileBuffer* TakeBuffer();
         void PutBuffer(AudioFileBuffer *buffer);
 
+        // Call callback (on the thread that took the buffer, so it must be realtime-safe) when
+        // TakeBuffer() leaves fewer than count buffers in the pool, so that another thread can
+        // Reserve() more before the pool runs dry. Called once per crossing; the watermark re-arms
+        // when the pool is refilled.
+        void SetLowWatermark(size_t count, LowWatermarkCallback &&callback);
+
         void TestPoolCount(size_t expected);
         size_t AllocationCount() const { return allocatedCount; }
+        size_t PooledCount() const { return pooledCount; }
 
         size_t GetBufferSize() { return bufferSize; }
         size_t GetChannels() { return channels; }
 
     private:
+        struct Slab
+        {
+            void *memory = nullptr;
+            size_t bytes = 0;
+            bool locked = false;
+            size_t bufferCount = 0;
+            size_t retiredCount = 0;
+            AudioFileBuffer *buffers = nullptr;
+        };
+        static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+
+        Slab *AllocateSlab(size_t count);
+        void FreeSlab(Slab *slab);
+        Slab *FindSlab(AudioFileBuffer *buffer);
+
+        AudioFileBuffer *Pop();
+        void Push(AudioFileBuffer *buffer);
+        void CheckLowWatermark();
+
         size_t channels;
         size_t bufferSize;
+        size_t channelStride;
+
+        std::atomic<uint64_t> freeHead; // tag << 32 | index (EMPTY if the list is empty).
+        std::unique_ptr<std::atomic<uint32_t>[]> freeLinks;
+        std::unique_ptr<std::atomic<AudioFileBuffer *>[]> bufferTable;
+
         std::atomic<size_t> pooledCount { 0};
         std::atomic<size_t> allocatedCount {0};
-        std::atomic<AudioFileBuffer*> freeList;
-    
+
+        std::mutex slabMutex;
+        std::vector<std::unique_ptr<Slab>> slabs;
+        std::vector<uint32_t> freeIndices;
+
+        size_t lowWatermark = 0;
+        LowWatermarkCallback lowWatermarkCallback;
+        std::atomic<bool> lowWatermarkSignalled { false};
     };
 
     /////////////////////////////////
@@ -162,7 +235,7 @@ namespace toob
         size_t result = --refCount;
         if (result == 0)
         {
-            delete this;
+            OnFinalRelease();
         }
         return result;
     }
@@ -0,0 +1,809 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "AudioFileWriter.hpp"
+#include "AsyncFile.hpp"
+#include "../WavWriter.hpp"
+#include "../WavConstants.hpp"
+#include <FLAC++/encoder.h>
+#include <FLAC++/metadata.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace toob;
+using namespace toob::private_use;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr const char *IN_PROGRESS_EXTENSION = ".$$$";
+
+    std::runtime_error ErrnoException(const std::string &message)
+    {
+        return std::runtime_error(message + " (" + strerror(errno) + ")");
+    }
+
+    // Pick a name for a file that was not completed normally. The extension is
+    // adjusted to match the contents, and existing files are not overwritten.
+    fs::path CompletedPath(const fs::path &outputPath, const char *extension)
+    {
+        fs::path result = outputPath;
+        if (result.extension() != extension)
+        {
+            result.replace_extension(extension);
+        }
+        fs::path stem = result;
+        stem.replace_extension();
+        for (int i = 1; fs::exists(result); ++i)
+        {
+            result = stem.string() + "-" + std::to_string(i) + extension;
+        }
+        return result;
+    }
+
+    // The in-progress file for a recording. An exclusive flock is held while it is
+    // being written, so that RecoverIncompleteFiles() in another instance leaves it alone.
+    class InProgressFile
+    {
+    public:
+        InProgressFile(const fs::path &outputPath)
+            : outputPath(outputPath),
+              path(outputPath.string() + IN_PROGRESS_EXTENSION)
+        {
+            fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0664);
+            if (fd < 0)
+            {
+                throw ErrnoException("Can't create recording file " + path.string() + ".");
+            }
+            if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+            {
+                ::close(fd);
+                fd = -1;
+                throw std::runtime_error("Recording file is in use. " + path.string());
+            }
+            if (ftruncate(fd, 0) != 0)
+            {
+                ::close(fd);
+                fd = -1;
+                throw ErrnoException("Can't create recording file " + path.string() + ".");
+            }
+        }
+        ~InProgressFile()
+        {
+            if (fd != -1)
+            {
+                ::close(fd);
+            }
+        }
+        const fs::path &Path() const { return path; }
+        const fs::path &OutputPath() const { return outputPath; }
+        int Fd() const { return fd; }
+
+        void Sync()
+        {
+            if (fdatasync(fd) != 0)
+            {
+                throw ErrnoException("Failed to write recording file.");
+            }
+        }
+        void Complete(const fs::path &completedPath)
+        {
+            fs::rename(path, completedPath);
+            ::close(fd);
+            fd = -1;
+        }
+
+    private:
+        fs::path outputPath;
+        fs::path path;
+        int fd = -1;
+    };
+
+    class WavFileWriter : public AudioFileWriter
+    {
+    public:
+        WavFileWriter(const fs::path &path, WavWriter::SampleFormat sampleFormat, int channels, uint32_t sampleRate)
+            : AudioFileWriter(sampleRate),
+              file(path),
+              asyncFile(file.Path()),
+              streamBuffer(asyncFile),
+              channels(channels)
+        {
+            writer.SetSampleFormat(sampleFormat);
+            writer.SetSampleRate(sampleRate);
+            writer.SetChannelCount(channels);
+            writer.Open(&streamBuffer);
+            isOpen = true;
+            // make the (empty) file recoverable from the start.
+            updateHeader();
+        }
+        virtual ~WavFileWriter()
+        {
+            if (isOpen)
+            {
+                try
+                {
+                    finishWav();
+                    file.Complete(CompletedPath(file.OutputPath(), ".wav"));
+                }
+                catch (const std::exception &)
+                {
+                    // left as an in-progress file for RecoverIncompleteFiles.
+                }
+            }
+        }
+
+        virtual void close() override
+        {
+            if (isOpen)
+            {
+                finishWav();
+                file.Complete(file.OutputPath());
+            }
+        }
+        virtual size_t writeQueueDepth() const override { return asyncFile.QueueDepth(); }
+        virtual size_t maxWriteQueueDepth() const override { return asyncFile.MaxQueueDepth(); }
+
+    protected:
+        virtual void writeFrames(const float *const *data, size_t frames) override
+        {
+            writer.Write(frames, channels, const_cast<const float **>(data));
+        }
+        virtual void updateHeader() override
+        {
+            // the stream flush queues a checkpoint (write and sync) on the writer thread.
+            writer.UpdateHeader();
+        }
+
+        void finishWav()
+        {
+            isOpen = false;
+            writer.Close();
+            asyncFile.Close();
+            file.Sync();
+        }
+
+        InProgressFile file;
+        AsyncFile asyncFile;
+        AsyncFileStreamBuffer streamBuffer;
+        bool isOpen = false;
+
+    private:
+        size_t channels;
+        WavWriter writer;
+    };
+
+    class FlacFileWriter : public AudioFileWriter
+    {
+    public:
+        FlacFileWriter(const fs::path &path, int channels, uint32_t sampleRate)
+            : AudioFileWriter(sampleRate),
+              file(path),
+              asyncFile(file.Path()),
+              channels(channels),
+              encoder(this)
+        {
+            // 24-bit samples. Compression level 5 (libFLAC's default) keeps up comfortably
+            // with realtime on a Pi 4; higher levels buy very little extra compression.
+            encoder.set_channels(channels);
+            encoder.set_bits_per_sample(24);
+            encoder.set_sample_rate(sampleRate);
+            encoder.set_compression_level(5);
+            encoder.set_verify(false);
+
+            // Space for a seek table, which is filled in as the file is written.
+            seekTableSpace.set_length(MAX_SEEK_POINTS * SEEK_POINT_SIZE);
+            FLAC::Metadata::Prototype *metadata[] = {&seekTableSpace};
+            encoder.set_metadata(metadata, 1);
+            seekInterval = (uint64_t)sampleRate * 10;
+            nextSeekSample = 0;
+
+            FLAC__StreamEncoderInitStatus rc = encoder.init();
+            if (rc != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+            {
+                throw std::runtime_error(
+                    std::string("Can't create FLAC file. (") + FLAC__StreamEncoderInitStatusString[rc] + ")");
+            }
+            isOpen = true;
+            seekTableOffset = FindPaddingBlock();
+
+            buffers.resize(channels);
+            bufferPointers.resize(channels);
+            for (int c = 0; c < channels; ++c)
+            {
+                buffers[c].resize(BLOCK_FRAMES);
+                bufferPointers[c] = buffers[c].data();
+            }
+            seekPoints.reserve(MAX_SEEK_POINTS);
+        }
+        virtual ~FlacFileWriter()
+        {
+            if (isOpen)
+            {
+                try
+                {
+                    finishFlac();
+                    file.Complete(CompletedPath(file.OutputPath(), ".flac"));
+                }
+                catch (const std::exception &)
+                {
+                }
+            }
+        }
+
+        virtual void close() override
+        {
+            if (isOpen)
+            {
+                finishFlac();
+                file.Complete(file.OutputPath());
+            }
+        }
+        virtual size_t writeQueueDepth() const override { return asyncFile.QueueDepth(); }
+        virtual size_t maxWriteQueueDepth() const override { return asyncFile.MaxQueueDepth(); }
+
+    protected:
+        virtual void writeFrames(const float *const *data, size_t frames) override
+        {
+            if (!isOpen)
+            {
+                throw std::logic_error("FLAC file is not open.");
+            }
+            constexpr float SCALE = 8388608.0f; // 2^23
+            size_t offset = 0;
+            while (offset < frames)
+            {
+                size_t thisTime = std::min(frames - offset, BLOCK_FRAMES);
+                for (int c = 0; c < channels; ++c)
+                {
+                    const float *input = data[c] + offset;
+                    FLAC__int32 *output = buffers[c].data();
+                    for (size_t i = 0; i < thisTime; ++i)
+                    {
+                        float v = input[i] * SCALE;
+                        if (v > 8388607.0f) v = 8388607.0f;
+                        if (v < -8388608.0f) v = -8388608.0f;
+                        output[i] = (FLAC__int32)std::lrint(v);
+                    }
+                }
+                if (!encoder.process(bufferPointers.data(), (uint32_t)thisTime))
+                {
+                    ThrowEncoderError("Failed to write FLAC file.");
+                }
+                offset += thisTime;
+            }
+        }
+        virtual void updateHeader() override
+        {
+            if (isOpen)
+            {
+                WriteSeekTable();
+                asyncFile.Checkpoint();
+            }
+        }
+
+    private:
+        // Output goes through the callbacks to the AsyncFile.
+        class Encoder : public FLAC::Encoder::Stream
+        {
+        public:
+            Encoder(FlacFileWriter *owner) : owner(owner) {}
+
+        protected:
+            virtual ::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame) override
+            {
+                try
+                {
+                    if (samples != 0)
+                    {
+                        owner->OnFrame(position, samples);
+                    }
+                    owner->asyncFile.Write(position, buffer, bytes);
+                    position += bytes;
+                    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+                }
+                catch (const std::exception &e)
+                {
+                    owner->writeError = e.what();
+                    return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+                }
+            }
+            virtual ::FLAC__StreamEncoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset) override
+            {
+                if (absolute_byte_offset > owner->asyncFile.Size())
+                {
+                    return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+                }
+                position = absolute_byte_offset;
+                return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+            }
+            virtual ::FLAC__StreamEncoderTellStatus tell_callback(FLAC__uint64 *absolute_byte_offset) override
+            {
+                *absolute_byte_offset = position;
+                return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+            }
+
+        private:
+            FlacFileWriter *owner;
+            uint64_t position = 0;
+        };
+
+        struct SeekPoint
+        {
+            uint64_t sampleNumber;
+            uint64_t offset;
+            uint16_t frameSamples;
+        };
+
+        [[noreturn]] void ThrowEncoderError(const char *message)
+        {
+            std::string detail = writeError.empty() ? std::string(encoder.get_state().as_cstring()) : writeError;
+            throw std::runtime_error(std::string(message) + " (" + detail + ")");
+        }
+
+        void OnFrame(uint64_t frameStart, uint32_t frameSamples)
+        {
+            if (samplesWritten == 0)
+            {
+                firstFrameOffset = frameStart;
+            }
+            if (samplesWritten >= nextSeekSample)
+            {
+                if (seekPoints.size() == MAX_SEEK_POINTS)
+                {
+                    // out of space: keep every second point, and double the interval.
+                    size_t n = 0;
+                    for (size_t i = 0; i < seekPoints.size(); i += 2)
+                    {
+                        seekPoints[n++] = seekPoints[i];
+                    }
+                    seekPoints.resize(n);
+                    seekInterval *= 2;
+                }
+                if (seekPoints.empty() || samplesWritten >= seekPoints.back().sampleNumber + seekInterval)
+                {
+                    seekPoints.push_back(SeekPoint{
+                        samplesWritten,
+                        frameStart - firstFrameOffset,
+                        (uint16_t)frameSamples});
+                }
+                nextSeekSample = seekPoints.back().sampleNumber + seekInterval;
+            }
+            samplesWritten += frameSamples;
+        }
+
+        uint64_t FindPaddingBlock()
+        {
+            uint64_t offset = 4; // "fLaC"
+            while (true)
+            {
+                uint8_t header[4];
+                asyncFile.ReadHeader(offset, header, sizeof(header));
+                uint32_t length = (((uint32_t)header[1]) << 16) | (((uint32_t)header[2]) << 8) | header[3];
+                if ((header[0] & 0x7F) == FLAC__METADATA_TYPE_PADDING && length == MAX_SEEK_POINTS * SEEK_POINT_SIZE)
+                {
+                    return offset;
+                }
+                if (header[0] & 0x80)
+                {
+                    throw std::runtime_error("Can't find FLAC seek table.");
+                }
+                offset += sizeof(header) + length;
+            }
+        }
+
+        static void WriteBigEndian(uint8_t *p, uint64_t value, size_t bytes)
+        {
+            for (size_t i = 0; i < bytes; ++i)
+            {
+                p[i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+            }
+        }
+
+        // Convert the reserved PADDING block to a SEEKTABLE block holding the seek points
+        // recorded so far. Unused points are placeholders.
+        void WriteSeekTable()
+        {
+            uint8_t blockType;
+            asyncFile.ReadHeader(seekTableOffset, &blockType, 1);
+
+            seekTableData.resize(4 + MAX_SEEK_POINTS * SEEK_POINT_SIZE);
+            uint8_t *p = seekTableData.data();
+            p[0] = (uint8_t)((blockType & 0x80) | FLAC__METADATA_TYPE_SEEKTABLE);
+            WriteBigEndian(p + 1, MAX_SEEK_POINTS * SEEK_POINT_SIZE, 3);
+            p += 4;
+            for (size_t i = 0; i < MAX_SEEK_POINTS; ++i)
+            {
+                if (i < seekPoints.size())
+                {
+                    WriteBigEndian(p, seekPoints[i].sampleNumber, 8);
+                    WriteBigEndian(p + 8, seekPoints[i].offset, 8);
+                    WriteBigEndian(p + 16, seekPoints[i].frameSamples, 2);
+                }
+                else
+                {
+                    WriteBigEndian(p, FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER, 8);
+                    WriteBigEndian(p + 8, 0, 8);
+                    WriteBigEndian(p + 16, 0, 2);
+                }
+                p += SEEK_POINT_SIZE;
+            }
+            asyncFile.Write(seekTableOffset, seekTableData.data(), seekTableData.size());
+        }
+
+        void finishFlac()
+        {
+            isOpen = false;
+            // finish() rewrites STREAMINFO, but leaves the seek table (still PADDING as far
+            // as libFLAC is concerned) alone.
+            if (!encoder.finish())
+            {
+                ThrowEncoderError("Failed to complete FLAC file.");
+            }
+            WriteSeekTable();
+            asyncFile.Close();
+            file.Sync();
+        }
+
+        static constexpr size_t BLOCK_FRAMES = 4096;
+        static constexpr size_t MAX_SEEK_POINTS = 1024;
+        static constexpr size_t SEEK_POINT_SIZE = 18;
+
+        InProgressFile file;
+        AsyncFile asyncFile;
+        int channels;
+        bool isOpen = false;
+        std::string writeError;
+        Encoder encoder;
+        FLAC::Metadata::Padding seekTableSpace;
+        uint64_t seekTableOffset = 0;
+        uint64_t firstFrameOffset = 0;
+        uint64_t samplesWritten = 0;
+        uint64_t seekInterval = 0;
+        uint64_t nextSeekSample = 0;
+        std::vector<SeekPoint> seekPoints;
+        std::vector<uint8_t> seekTableData;
+        std::vector<std::vector<FLAC__int32>> buffers;
+        std::vector<const FLAC__int32 *> bufferPointers;
+    };
+
+    std::string execForOutput(const char *cmd)
+    {
+        std::array<char, 128> buffer;
+        std::string result;
+
+        FILE *pipe = popen(cmd, "r");
+
+        if (!pipe)
+        {
+            throw std::runtime_error("popen() failed!");
+        }
+
+        while (fgets(buffer.data(), buffer.size(), pipe) != nullptr)
+        {
+            result += buffer.data();
+        }
+        int rc = pclose(pipe);
+
+        bool success = WIFEXITED(rc) && WEXITSTATUS(rc) == EXIT_SUCCESS;
+
+        if (!success)
+        {
+            throw std::runtime_error("Command to execute ffmpeg conversion. " + std::string(cmd) + " " + result);
+        }
+
+        return result;
+    }
+
+    std::string fileToCmdline(const fs::path &path)
+    {
+        std::string t = path.string();
+
+        std::stringstream ss;
+        ss << '\'';
+        for (char c : t)
+        {
+            if (c == '\'')
+            {
+                ss << "'\\''";
+            }
+            else
+            {
+                ss << c;
+            }
+        }
+        ss << '\'';
+        return ss.str();
+    }
+
+    // No in-process MP3 encoder is available, so MP3 takes are recorded as float WAV files,
+    // and transcoded with ffmpeg when the file is closed. An MP3 take that is not closed
+    // normally is kept as a .wav file.
+    class Mp3FileWriter : public WavFileWriter
+    {
+    public:
+        Mp3FileWriter(const fs::path &path, int channels, uint32_t sampleRate)
+            : WavFileWriter(path, WavWriter::SampleFormat::Float32, channels, sampleRate)
+        {
+        }
+
+        virtual void close() override
+        {
+            if (!isOpen)
+            {
+                return;
+            }
+            finishWav();
+
+            std::stringstream s;
+            s << "/usr/bin/ffmpeg -y"
+              << " -i " << fileToCmdline(file.Path())
+              << " -codec:a libmp3lame -qscale:a 0"
+              << " " << fileToCmdline(file.OutputPath()) << " 2>&1";
+            try
+            {
+                execForOutput(s.str().c_str());
+            }
+            catch (const std::exception &)
+            {
+                file.Complete(CompletedPath(file.OutputPath(), ".wav"));
+                throw;
+            }
+            fs::remove(file.Path());
+        }
+    };
+
+    bool PRead(int fd, void *data, size_t size, uint64_t offset)
+    {
+        return pread(fd, data, size, (off_t)offset) == (ssize_t)size;
+    }
+    void PWrite(int fd, const void *data, size_t size, uint64_t offset)
+    {
+        if (pwrite(fd, data, size, (off_t)offset) != (ssize_t)size)
+        {
+            throw ErrnoException("Failed to write file.");
+        }
+    }
+
+    // Set the RIFF and data chunk sizes of a WAV file from the length of the file.
+    // Returns false if the file isn't a WAV file.
+    bool RepairWavFile(int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return false;
+        }
+        uint64_t fileSize = st.st_size;
+
+        uint32_t header[3];
+        if (!PRead(fd, header, sizeof(header), 0))
+        {
+            return false;
+        }
+        if ((header[0] != (uint32_t)ChunkIds::Riff && header[0] != (uint32_t)ChunkIds::Rf64) || header[2] != (uint32_t)ChunkIds::WaveRiff)
+        {
+            return false;
+        }
+        // the data chunk follows a handful of small header chunks.
+        constexpr uint64_t MAX_HEADER_SIZE = 64 * 1024;
+        uint64_t position = sizeof(header);
+        uint64_t ds64Offset = 0;
+        uint64_t dataOffset = 0;
+        uint16_t blockAlign = 0;
+        while (position + 8 <= fileSize && position < MAX_HEADER_SIZE)
+        {
+            uint32_t chunkHeader[2];
+            if (!PRead(fd, chunkHeader, sizeof(chunkHeader), position))
+            {
+                return false;
+            }
+            uint64_t body = position + sizeof(chunkHeader);
+            uint32_t chunkSize = chunkHeader[1];
+            switch ((ChunkIds)chunkHeader[0])
+            {
+            case ChunkIds::Junk:
+            case ChunkIds::Ds64:
+                if (position == sizeof(header) && chunkSize >= DS64_CHUNK_SIZE)
+                {
+                    ds64Offset = body;
+                }
+                break;
+            case ChunkIds::Format:
+                if (!PRead(fd, &blockAlign, sizeof(blockAlign), body + 12))
+                {
+                    return false;
+                }
+                break;
+            case ChunkIds::Data:
+                dataOffset = body;
+                break;
+            default:
+                break;
+            }
+            if (dataOffset != 0)
+            {
+                break;
+            }
+            position = body + chunkSize + (chunkSize & 1);
+        }
+        if (dataOffset == 0 || blockAlign == 0)
+        {
+            return false;
+        }
+        // drop any partially-written frame.
+        uint64_t dataSize = fileSize - dataOffset;
+        dataSize -= dataSize % blockAlign;
+        uint64_t fileEnd = dataOffset + dataSize + (dataSize & 1);
+        if (ftruncate(fd, (off_t)fileEnd) != 0)
+        {
+            throw ErrnoException("Failed to write file.");
+        }
+        uint64_t riffSize = fileEnd - 8;
+        if (riffSize > std::numeric_limits<uint32_t>::max())
+        {
+            if (ds64Offset == 0)
+            {
+                return false;
+            }
+            uint32_t rf64Header[2] = {(uint32_t)ChunkIds::Rf64, 0xFFFFFFFF};
+            PWrite(fd, rf64Header, sizeof(rf64Header), 0);
+            uint32_t ds64Header[2] = {(uint32_t)ChunkIds::Ds64, (uint32_t)DS64_CHUNK_SIZE};
+            PWrite(fd, ds64Header, sizeof(ds64Header), ds64Offset - sizeof(ds64Header));
+            uint64_t sizes[3] = {riffSize, dataSize, dataSize / blockAlign};
+            PWrite(fd, sizes, sizeof(sizes), ds64Offset);
+            uint32_t tableLength = 0;
+            PWrite(fd, &tableLength, sizeof(tableLength), ds64Offset + sizeof(sizes));
+            uint32_t dataChunkSize = 0xFFFFFFFF;
+            PWrite(fd, &dataChunkSize, sizeof(dataChunkSize), dataOffset - sizeof(uint32_t));
+        }
+        else
+        {
+            uint32_t riffSize32 = (uint32_t)riffSize;
+            PWrite(fd, &riffSize32, sizeof(riffSize32), sizeof(uint32_t));
+            uint32_t dataSize32 = (uint32_t)dataSize;
+            PWrite(fd, &dataSize32, sizeof(dataSize32), dataOffset - sizeof(uint32_t));
+        }
+        if (fdatasync(fd) != 0)
+        {
+            throw ErrnoException("Failed to write file.");
+        }
+        return true;
+    }
+
+    bool IsFlacFile(int fd)
+    {
+        char magic[4];
+        return PRead(fd, magic, sizeof(magic), 0) && memcmp(magic, "fLaC", 4) == 0;
+    }
+}
+
+AudioFileWriter::AudioFileWriter(uint32_t sampleRate)
+    : framesPerHeaderUpdate((size_t)(sampleRate * HEADER_UPDATE_INTERVAL_SECONDS))
+{
+}
+
+void AudioFileWriter::write(const float *const *channels, size_t frames)
+{
+    writeFrames(channels, frames);
+    framesSinceHeaderUpdate += frames;
+    if (framesSinceHeaderUpdate >= framesPerHeaderUpdate)
+    {
+        framesSinceHeaderUpdate = 0;
+        updateHeader();
+    }
+}
+
+AudioFileWriter::ptr AudioFileWriter::Create(
+    const fs::path &path,
+    AudioFileFormat format,
+    int channels,
+    uint32_t sampleRate)
+{
+    if (channels < 1 || channels > MAX_CHANNELS || (format == AudioFileFormat::Mp3 && channels > 2))
+    {
+        throw std::invalid_argument("Unsupported number of channels.");
+    }
+    switch (format)
+    {
+    case AudioFileFormat::WavInt16:
+        return std::make_unique<WavFileWriter>(path, WavWriter::SampleFormat::Int16, channels, sampleRate);
+    case AudioFileFormat::WavFloat:
+        return std::make_unique<WavFileWriter>(path, WavWriter::SampleFormat::Float32, channels, sampleRate);
+    case AudioFileFormat::Flac:
+        return std::make_unique<FlacFileWriter>(path, channels, sampleRate);
+    case AudioFileFormat::Mp3:
+        return std::make_unique<Mp3FileWriter>(path, channels, sampleRate);
+    default:
+        throw std::invalid_argument("Unsupported audio file format.");
+    }
+}
+
+std::vector<fs::path> AudioFileWriter::RecoverIncompleteFiles(const fs::path &directory)
+{
+    std::vector<fs::path> result;
+    std::error_code ec;
+    if (!fs::is_directory(directory, ec))
+    {
+        return result;
+    }
+    for (const auto &entry : fs::directory_iterator(directory, ec))
+    {
+        const fs::path &path = entry.path();
+        if (!entry.is_regular_file(ec) || path.extension() != IN_PROGRESS_EXTENSION)
+        {
+            continue;
+        }
+        int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        try
+        {
+            // a lock that can't be taken means the file is still being recorded.
+            if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+            {
+                fs::path outputPath = path;
+                outputPath.replace_extension();
+                fs::path completedPath;
+                if (RepairWavFile(fd))
+                {
+                    completedPath = CompletedPath(outputPath, ".wav");
+                }
+                else if (IsFlacFile(fd))
+                {
+                    // FLAC frames are self-describing, and the header is already valid (with an unknown
+                    // length); the seek table is as of the last header update.
+                    completedPath = CompletedPath(outputPath, ".flac");
+                }
+                if (!completedPath.empty())
+                {
+                    fs::rename(path, completedPath);
+                    result.push_back(completedPath);
+                }
+            }
+        }
+        catch (const std::exception &)
+        {
+            // leave it for next time.
+        }
+        ::close(fd);
+    }
+    return result;
+}
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 Robin E. R. Davies
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace toob
+{
+    enum class AudioFileFormat
+    {
+        WavInt16,
+        WavFloat,
+        Flac,
+        Mp3
+    };
+
+    // Encodes audio to a file as it is written. Intended for use on a background thread.
+    //
+    // While recording, data goes to an in-progress file (the output path with a ".$$$" suffix),
+    // which is locked, and whose header is updated and flushed to disk every
+    // HEADER_UPDATE_INTERVAL_SECONDS so that a take survives a power failure. The flush is queued
+    // to the file's writer thread, so write() doesn't wait for the disk. close() finalizes
+    // the file and renames it to the output path; it throws if the file could not be completed.
+    // Destroying a writer without calling close() keeps what was recorded, with an extension
+    // that matches its contents.
+    class AudioFileWriter
+    {
+    protected:
+        AudioFileWriter(uint32_t sampleRate);
+
+    public:
+        using ptr = std::unique_ptr<AudioFileWriter>;
+
+        static constexpr double HEADER_UPDATE_INTERVAL_SECONDS = 5.0;
+        // WAV and FLAC files hold up to MAX_CHANNELS interleaved channels; MP3 files hold one or two.
+        static constexpr int MAX_CHANNELS = 8;
+
+        AudioFileWriter(const AudioFileWriter &) = delete;
+        AudioFileWriter &operator=(const AudioFileWriter &) = delete;
+        virtual ~AudioFileWriter() {}
+
+        static ptr Create(
+            const std::filesystem::path &path,
+            AudioFileFormat format,
+            int channels,
+            uint32_t sampleRate);
+
+        // Close out in-progress files left in a directory by a crash or power failure.
+        // Files that are still being written by another instance are skipped.
+        // Returns the paths of the recovered files.
+        static std::vector<std::filesystem::path> RecoverIncompleteFiles(const std::filesystem::path &directory);
+
+        void write(const float *const *channels, size_t frames);
+        virtual void close() = 0;
+
+        // Blocks waiting to be written to disk. A growing queue means the disk is falling behind.
+        virtual size_t writeQueueDepth() const = 0;
+        virtual size_t maxWriteQueueDepth() const = 0;
+
+    protected:
+        virtual void writeFrames(const float *const *channels, size_t frames) = 0;
+        // Make the file on disk valid up to the current position, and flush it.
+        virtual void updateHeader() = 0;
+
+    private:
+        size_t framesPerHeaderUpdate;
+        size_t framesSinceHeaderUpdate = 0;
+    };
+}
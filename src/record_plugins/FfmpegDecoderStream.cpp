@@ -36,13 +36,16 @@
  #include <vector>
  #include <string>
  #include <string.h>
+ #include <cstdio>
 
  using namespace toob;
 
  #pragma GCC diagnostic ignored "-Wunused-result" // GCC 12 bug.
 
- void FfmpegDecoderStream::open(const std::filesystem::path &filePath, int channels, uint32_t sampleRate)
+ void FfmpegDecoderStream::open(const std::filesystem::path &filePath, int channels, uint32_t sampleRate, uint64_t startFrame)
  {
+    this->file = filePath;
+    this->sampleRate = sampleRate;
     this->channels = channels;
     // Requirements: fork the ffmpeg process, making sure that NO file handles (especially socket handlers) 
     // are passed to the child process. The one socket handle that is passed in is the return pipe handle. 
@@ -66,6 +69,14 @@
 
     std::vector<std::string> args;
     args.push_back("/usr/bin/ffmpeg");
+    if (startFrame != 0)
+    {
+        // input seeking: ffmpeg decodes from the preceding seek point and discards up to the requested time.
+        char startTime[64];
+        snprintf(startTime, sizeof(startTime), "%.6f", (double)startFrame / sampleRate);
+        args.push_back("-ss");
+        args.push_back(startTime);
+    }
     args.push_back("-i");
     args.push_back(filePath.string());    
     args.push_back("-f");
@@ -192,8 +203,9 @@
     } else  {
         size_t offset = 0;
         float buffer[1024];
+        size_t frameBytes = sizeof(float)*this->channels;
         while (offset < count) {
-            size_t bytesThisTime = std::min((count - offset)*sizeof(float)*2, sizeof(buffer));
+            size_t bytesThisTime = std::min((count - offset), sizeof(buffer)/frameBytes)*frameBytes;
 
             size_t nRead = ::read(this->pipefd, buffer,bytesThisTime);
 
@@ -204,7 +216,7 @@
                 return offset;
             }
             size_t ix = 0;
-            size_t framesThisTime = nRead/(sizeof(float)*2);
+            size_t framesThisTime = nRead/frameBytes;
             for (size_t i = 0; i < framesThisTime; ++i)
             {
                 size_t outIx = i + offset;
@@ -214,7 +226,7 @@
                 }
             }
 
-            offset += nRead / (sizeof(float)*2);
+            offset += framesThisTime;
         }
         return count;
     }
@@ -222,6 +234,16 @@
 }
 
 
+void FfmpegDecoderStream::seek(uint64_t frame)
+{
+    if (file.empty())
+    {
+        return;
+    }
+    close();
+    open(file, channels, sampleRate, frame);
+}
+
 FfmpegDecoderStream::~FfmpegDecoderStream()
 {
     close();
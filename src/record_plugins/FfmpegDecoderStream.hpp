@@ -25,20 +25,26 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <string>
+#include "AudioDecoderStream.hpp"
 
 namespace toob
 {
 
    // Exec FfMpegExec in order to receive streamed decoded audio.
-   class FfmpegDecoderStream
+   class FfmpegDecoderStream : public AudioDecoderStream
    {
    public:
       ~FfmpegDecoderStream();
-      void open(const std::filesystem::path &file, int channels, uint32_t sampleRate);
-      size_t read(float**buffers, size_t frames);
-      void close();
-      bool eof() const { return pipefd == -1; }
+      void open(const std::filesystem::path &file, int channels, uint32_t sampleRate, uint64_t startFrame = 0);
+      virtual size_t read(float**buffers, size_t frames) override;
+      // Restarts ffmpeg at the requested time.
+      virtual void seek(uint64_t frame) override;
+      virtual void close() override;
+      virtual bool eof() const override { return pipefd == -1; }
    private:
+      std::filesystem::path file;
+      uint32_t sampleRate = 0;
       int channels = 0;
       int pipefd = -1;
       int pidChild = -1;
@@ -25,9 +25,12 @@
 #include <string>
 #include <cstring>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 #include <thread>
+#include <utility>
 #include <iostream>
-#include "FfmpegDecoderStream.hpp"
+#include "AudioDecoderStream.hpp"
 
 // using namespace lv2c::lv2_plugin;
 
@@ -49,6 +52,16 @@ namespace toob_looper_commands
         RefreshPool,
         BackgroundError,
         FreeBuffer,
+        PageOut,
+        PageIn,
+        PageInComplete,
+        SaveSession,
+        SaveSessionChunk,
+        SaveSessionEnd,
+        LoadSession,
+        DeleteSessionFile,
+        SessionChunkLoaded,
+        SessionLoaded,
         Quit,
         Finished
     };
@@ -78,15 +91,146 @@ namespace toob_looper_commands
         char message[1024];
     };
 
+    // Freeing a long loop releases hundreds of buffers at once, so they are batched.
     struct FreeBufferCommand : public BufferCommand
     {
+        static constexpr size_t MAX_BUFFERS = 32;
+
+        FreeBufferCommand()
+            : BufferCommand(MessageType::FreeBuffer, sizeof(FreeBufferCommand))
+        {
+        }
         FreeBufferCommand(toob::AudioFileBuffer *buffer)
-            : BufferCommand(MessageType::FreeBuffer, sizeof(FreeBufferCommand)), buffer(buffer)
+            : FreeBufferCommand()
+        {
+            Add(buffer);
+        }
+        void Add(toob::AudioFileBuffer *buffer) { buffers[count++] = buffer; }
+        bool Full() const { return count == MAX_BUFFERS; }
+
+        size_t count = 0;
+        toob::AudioFileBuffer *buffers[MAX_BUFFERS];
+    };
+
+    struct PageOutCommand : public BufferCommand
+    {
+        PageOutCommand(size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer)
+            : BufferCommand(MessageType::PageOut, sizeof(PageOutCommand)), loopId(loopId), chunk(chunk), buffer(buffer)
+        {
+        }
+        size_t loopId;
+        size_t chunk;
+        toob::AudioFileBuffer *buffer;
+    };
+
+    struct PageInCommand : public BufferCommand
+    {
+        PageInCommand(size_t loopId, uint64_t generation, size_t chunk)
+            : BufferCommand(MessageType::PageIn, sizeof(PageInCommand)), loopId(loopId), generation(generation), chunk(chunk)
         {
         }
+        size_t loopId;
+        uint64_t generation;
+        size_t chunk;
+    };
+
+    struct PageInCompleteCommand : public BufferCommand
+    {
+        PageInCompleteCommand(size_t loopId, uint64_t generation, size_t chunk, toob::AudioFileBuffer *buffer)
+            : BufferCommand(MessageType::PageInComplete, sizeof(PageInCompleteCommand)), loopId(loopId), generation(generation), chunk(chunk), buffer(buffer)
+        {
+        }
+        size_t loopId;
+        uint64_t generation;
+        size_t chunk;
         toob::AudioFileBuffer *buffer;
     };
 
+    struct SaveSessionCommand : public BufferCommand
+    {
+        SaveSessionCommand(const char *path, size_t loopCount, size_t length)
+            : BufferCommand(MessageType::SaveSession, sizeof(SaveSessionCommand)), loopCount(loopCount), length(length)
+        {
+            std::strncpy(this->path, path, sizeof(this->path) - 1);
+            this->path[sizeof(this->path) - 1] = '\0';
+        }
+        size_t loopCount;
+        size_t length;
+        char path[1024];
+    };
+
+    // One chunk of one loop. Chunks arrive in order, all loops for a chunk before the next chunk.
+    struct SaveSessionChunkCommand : public BufferCommand
+    {
+        SaveSessionChunkCommand(size_t loopIndex, size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer, bool paged)
+            : BufferCommand(MessageType::SaveSessionChunk, sizeof(SaveSessionChunkCommand)),
+              loopIndex(loopIndex), loopId(loopId), chunk(chunk), buffer(buffer), paged(paged)
+        {
+        }
+        size_t loopIndex;
+        size_t loopId;
+        size_t chunk;
+        toob::AudioFileBuffer *buffer; // null if the chunk is empty or paged out.
+        bool paged;
+    };
+
+    struct SaveSessionEndCommand : public BufferCommand
+    {
+        SaveSessionEndCommand() : BufferCommand(MessageType::SaveSessionEnd, sizeof(SaveSessionEndCommand))
+        {
+        }
+    };
+
+    struct LoadSessionCommand : public BufferCommand
+    {
+        LoadSessionCommand(const char *path, size_t loopCount, uint64_t generation)
+            : BufferCommand(MessageType::LoadSession, sizeof(LoadSessionCommand)), loopCount(loopCount), generation(generation)
+        {
+            std::strncpy(this->path, path, sizeof(this->path) - 1);
+            this->path[sizeof(this->path) - 1] = '\0';
+        }
+        size_t loopCount;
+        uint64_t generation;
+        size_t loopIds[ToobLooperEngine::MAX_SESSION_LOOPS];
+        char path[1024];
+    };
+
+    struct DeleteSessionFileCommand : public BufferCommand
+    {
+        DeleteSessionFileCommand(const char *path)
+            : BufferCommand(MessageType::DeleteSessionFile, sizeof(DeleteSessionFileCommand))
+        {
+            std::strncpy(this->path, path, sizeof(this->path) - 1);
+            this->path[sizeof(this->path) - 1] = '\0';
+        }
+        char path[1024];
+    };
+
+    struct SessionChunkLoadedCommand : public BufferCommand
+    {
+        SessionChunkLoadedCommand(uint64_t generation, size_t loopIndex, size_t chunk, toob::AudioFileBuffer *buffer)
+            : BufferCommand(MessageType::SessionChunkLoaded, sizeof(SessionChunkLoadedCommand)),
+              generation(generation), loopIndex(loopIndex), chunk(chunk), buffer(buffer)
+        {
+        }
+        uint64_t generation;
+        size_t loopIndex;
+        size_t chunk;
+        toob::AudioFileBuffer *buffer; // null if the chunk went straight to the page file.
+    };
+
+    struct SessionLoadedCommand : public BufferCommand
+    {
+        SessionLoadedCommand(uint64_t generation, size_t length, uint32_t loopMask)
+            : BufferCommand(MessageType::SessionLoaded, sizeof(SessionLoadedCommand)),
+              generation(generation), length(length), loopMask(loopMask)
+        {
+        }
+        uint64_t generation;
+        size_t length;
+        uint32_t loopMask; // loops with content.
+    };
+
     struct QuitCommand : public BufferCommand
     {
         QuitCommand() : BufferCommand(MessageType::Quit, sizeof(QuitCommand))
@@ -115,16 +259,32 @@ ToobLooperEngine::ToobLooperEngine(int channels, double rate)
 {
     this->sampleRate = rate;
     this->bufferPool = std::make_unique<toob::AudioFileBufferPool>(channels, (size_t)rate / 10);
-    bufferPool->Reserve(20);
+    bufferPool->Reserve(POOL_RESERVE);
+    // Page-ins take buffers on the background thread too, so the callback can't post to the
+    // (single-writer) background queue directly. fgHandleMessages() posts the request instead.
+    bufferPool->SetLowWatermark(
+        POOL_LOW_WATERMARK,
+        [this]()
+        {
+            this->refillRequested.store(true, std::memory_order_relaxed);
+        });
+    // /tmp is frequently a tmpfs, which would defeat the purpose of paging loops out of RAM.
+    const char *tmpDir = getenv("TMPDIR");
+    this->pageDirectory = tmpDir && *tmpDir ? tmpDir : "/var/tmp";
     inputTrigger.Init(rate);
     this->trigger_lead_samples = (size_t)(rate * TRIGGER_LEAD_TIME);
     leftInputDelay.SetMaxDelay(trigger_lead_samples+2048);
     rightInputDelay.SetMaxDelay(trigger_lead_samples+2048);
+    // assigned on the realtime thread.
+    fgPendingLoadPath.reserve(1024);
+    fgSavePath.reserve(1024);
+    unreferencedSessionPath.reserve(1024);
 }
 
 
 ToobLooperEngine::~ToobLooperEngine()
 {
+    WaitForSessionSave();
     for (auto &loop : loops)
     {
         loop.Reset();
@@ -158,6 +318,28 @@ ToobLooperFour::ToobLooperFour(
         loops[i].plugin = this;
         loops[i].sampleRate = rate;
     }
+
+    urids.atom__Path = MapURI(LV2_ATOM__Path);
+    urids.atom__String = MapURI(LV2_ATOM__String);
+    sessionFile.reserve(1024);
+
+    const LV2_FileBrowser_Files *fileBrowserFiles = this->GetFeature<LV2_FileBrowser_Files>(features, LV2_FILEBROWSER__files);
+    if (fileBrowserFiles)
+    {
+        // Sessions go into the well-known directory for audio file recordings in PiPedal.
+        char *cRecordingDirectory = fileBrowserFiles->get_upload_path(fileBrowserFiles->handle, "audiorecording");
+        if (cRecordingDirectory)
+        {
+            this->sessionDirectory = cRecordingDirectory;
+            fileBrowserFiles->free_path(fileBrowserFiles->handle, cRecordingDirectory);
+        }
+    }
+    if (sessionDirectory.empty())
+    {
+        const char *home = getenv("HOME");
+        this->sessionDirectory = std::filesystem::path(home ? home : "/var/tmp") / "Music/TooB Recordings";
+    }
+    this->sessionDirectory /= "Looper Sessions";
 }
 ToobLooperOne::ToobLooperOne(
     double rate,
@@ -209,83 +391,907 @@ void ToobLooperFour::Activate()
     super::Activate();
 
     this->activated = true;
+    StartBackgroundThread();
+    if (!sessionFile.empty())
+    {
+        // loaded in the background once Run() picks up the request.
+        RequestLoadSession(sessionFile);
+    }
+}
+
+void ToobLooperOne::Activate()
+{
+    super::Activate();
+
+    this->activated = true;
+    StartBackgroundThread();
+}
+
+void ToobLooperEngine::StartBackgroundThread()
+{
     this->finished = false;
 
-    this->bufferPool->Reserve(10);
+    this->bufferPool->Reserve(POOL_RESERVE);
+    this->bufferOverrun = false;
+    this->bufferOverrunReported = false;
 
     this->backgroundThread = std::make_unique<std::jthread>(
         [this]()
         {
-        try {
+            bgRun();
+        });
+}
+
+void ToobLooperEngine::StopBackgroundThread()
+{
+    // discard the rest of a session load that is in progress.
+    ++sessionGeneration;
+    sessionLoading = false;
+
+    QuitCommand cmd;
+    while (!this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5)); // queue full.
+    }
+
+    while (true)
+    {
+        fgHandleMessages();
+        if (this->finished)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    this->backgroundThread->join();
+    this->backgroundThread.reset();
+
+    // A save that the thread didn't finish is written by the detached save, if there is one.
+    bgSessionWriter = nullptr;
+    bgSessionData.clear();
+    fgSaving = false;
+    if (detachedSave)
+    {
+        detachedSave->pageFile = std::exchange(pageFile, -1);
+        StartSessionSaveThread(std::move(detachedSave));
+    }
+    if (pageFile != -1)
+    {
+        close(pageFile);
+        pageFile = -1;
+    }
+
+    // Stale page-ins and session chunks that arrived after the Quit command are freed here.
+    uint8_t buffer[2048];
+    while (this->toBackgroundQueue.peekSize() != 0)
+    {
+        if (!this->toBackgroundQueue.read_packet(sizeof(buffer), buffer))
+        {
+            break;
+        }
+        BufferCommand *cmd = (BufferCommand *)buffer;
+        if (cmd->command == MessageType::FreeBuffer)
+        {
+            FreeBufferCommand *freeBuffer = (FreeBufferCommand *)cmd;
+            for (size_t i = 0; i < freeBuffer->count; ++i)
+            {
+                bgFreeBuffer(freeBuffer->buffers[i]);
+            }
+        }
+    }
+}
+
+void ToobLooperEngine::bgRun()
+{
+    try {
         bool quit = false;
 
-        std::vector<uint8_t> buffer (2048);
-        BufferCommand*cmd = (BufferCommand*)buffer.data();
-        while (!quit)
+        std::vector<uint8_t> buffer (2048);
+        BufferCommand*cmd = (BufferCommand*)buffer.data();
+        while (!quit)
+        {
+            this->toBackgroundQueue.readWait();
+            size_t size = this->toBackgroundQueue.peekSize();
+            if (size == 0) continue;
+
+            if (size > buffer.size()) {
+                buffer.resize(size);
+                cmd = (BufferCommand*)buffer.data();
+            }
+            if (!this->toBackgroundQueue.read_packet(buffer.size()  ,(uint8_t*)cmd))
+            {
+                break;
+            }
+
+            try {
+                switch (cmd->command) {
+                case MessageType::RefreshPool:
+                {
+                    bufferPool->Reserve(POOL_RESERVE);
+                    break;
+                }
+                case MessageType::FreeBuffer:
+                {
+                    FreeBufferCommand *freeBuffer = (FreeBufferCommand*)cmd;
+                    for (size_t i = 0; i < freeBuffer->count; ++i)
+                    {
+                        bgFreeBuffer(freeBuffer->buffers[i]);
+                    }
+                }
+                break;
+                case MessageType::PageOut:
+                {
+                    PageOutCommand *pageOut = (PageOutCommand*)cmd;
+                    bgPageOut(pageOut->loopId, pageOut->chunk, pageOut->buffer);
+                }
+                break;
+                case MessageType::SaveSession:
+                {
+                    SaveSessionCommand *save = (SaveSessionCommand*)cmd;
+                    bgBeginSaveSession(save->path, save->loopCount, save->length);
+                }
+                break;
+                case MessageType::SaveSessionChunk:
+                {
+                    SaveSessionChunkCommand *chunk = (SaveSessionChunkCommand*)cmd;
+                    bgSaveSessionChunk(chunk->loopIndex, chunk->loopId, chunk->chunk, chunk->buffer, chunk->paged);
+                }
+                break;
+                case MessageType::SaveSessionEnd:
+                {
+                    bgEndSaveSession();
+                }
+                break;
+                case MessageType::LoadSession:
+                {
+                    LoadSessionCommand *load = (LoadSessionCommand*)cmd;
+                    bgLoadSession(load->path, load->loopCount, load->loopIds, load->generation);
+                }
+                break;
+                case MessageType::DeleteSessionFile:
+                {
+                    DeleteSessionFileCommand *deleteFile = (DeleteSessionFileCommand*)cmd;
+                    bgDeleteSessionFile(deleteFile->path);
+                }
+                break;
+                case MessageType::PageIn:
+                {
+                    PageInCommand *pageIn = (PageInCommand*)cmd;
+                    toob::AudioFileBuffer *buffer = bgPageIn(pageIn->loopId, pageIn->chunk);
+                    PageInCompleteCommand reply(pageIn->loopId, pageIn->generation, pageIn->chunk, buffer);
+                    this->fromBackgroundQueue.write_packet(sizeof(reply), (uint8_t*)&reply);
+                }
+                break;
+
+                case MessageType::Quit:
+                {
+                    quit = true;
+                    break;
+                }   
+                default:
+                    throw std::runtime_error("Unknown Background command.");
+            }
+        } catch (const std::exception&e)
+        {
+            std::stringstream ss;
+            ss << "Background thread error: " << e.what();
+            bgError(ss.str());
+    
+        }
+    }
+    } catch (std::exception &e) {
+        std::stringstream ss;
+        ss << "Background thread error: " << e.what();
+        bgError(ss.str());
+    }
+
+    // The page file stays open; StopBackgroundThread() either hands it to a detached session save
+    // or closes it.
+    FinishedCommand finishedCommand;
+    this->fromBackgroundQueue.write_packet(sizeof(FinishedCommand), (uint8_t*)&finishedCommand);
+}
+
+// Reported (and logged) by fgError() on the realtime thread.
+void ToobLooperEngine::bgError(const std::string &message)
+{
+    BackgroundErrorCommmand errorCmd(message);
+    this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t*)&errorCmd);
+}
+
+void ToobLooperEngine::bgFreeBuffer(toob::AudioFileBuffer *buffer)
+{
+    // must zero the buffer before returning it.
+    for (size_t c = 0; c < buffer->GetChannelCount(); ++c) {
+        float *p = buffer->GetChannel(c);
+        for (size_t i = 0; i < buffer->GetBufferSize(); ++i) {
+            p[i] = 0.0f;
+        }
+    }
+    bufferPool->PutBuffer(buffer);
+}
+
+int ToobLooperEngine::bgGetPageFile()
+{
+    if (pageFile == -1)
+    {
+        // Unlinked immediately, so the file disappears with the process, however it exits. Regions
+        // that are never written stay sparse.
+        std::string path = (pageDirectory / "toob-looper-XXXXXX").string();
+        pageFile = mkstemp(path.data());
+        if (pageFile == -1)
+        {
+            std::stringstream ss;
+            ss << "Can't create looper page file in " << pageDirectory << ". " << strerror(errno);
+            throw std::runtime_error(ss.str());
+        }
+        unlink(path.c_str());
+    }
+    return pageFile;
+}
+
+off_t ToobLooperEngine::PageFileOffset(size_t loopId, size_t chunk)
+{
+    size_t chunkBytes = bufferPool->GetChannels() * bufferPool->GetBufferSize() * sizeof(float);
+    return (off_t)((loopId * Loop::MAX_LOOP_CHUNKS + chunk) * chunkBytes);
+}
+
+static std::vector<float *> ChannelPointers(toob::AudioFileBuffer *buffer)
+{
+    std::vector<float *> result(buffer->GetChannelCount());
+    for (size_t c = 0; c < result.size(); ++c)
+    {
+        result[c] = buffer->GetChannel(c);
+    }
+    return result;
+}
+
+// Channels are stored planar, so a chunk is read or written with one vectored call.
+std::vector<iovec> ToobLooperEngine::ChunkIoVectors(float *const *channels, size_t *bytes)
+{
+    std::vector<iovec> iov(bufferPool->GetChannels());
+    *bytes = 0;
+    for (size_t c = 0; c < iov.size(); ++c)
+    {
+        iov[c].iov_base = channels[c];
+        iov[c].iov_len = bufferPool->GetBufferSize() * sizeof(float);
+        *bytes += iov[c].iov_len;
+    }
+    return iov;
+}
+
+void ToobLooperEngine::bgWriteChunk(size_t loopId, size_t chunk, float *const *channels)
+{
+    size_t bytes;
+    std::vector<iovec> iov = ChunkIoVectors(channels, &bytes);
+    ssize_t written = pwritev(bgGetPageFile(), iov.data(), (int)iov.size(), PageFileOffset(loopId, chunk));
+    if (written != (ssize_t)bytes)
+    {
+        std::stringstream ss;
+        ss << "Can't write looper page file. " << (written < 0 ? strerror(errno) : "Disk full.");
+        throw std::runtime_error(ss.str());
+    }
+}
+
+// Returns false, with errno set (0 if the page was never written), if the chunk can't be read. The
+// chunk then reads as silence, rather than leaving the loop waiting for it forever.
+bool ToobLooperEngine::ReadPageFileChunk(int file, size_t loopId, size_t chunk, float *const *channels)
+{
+    size_t bytes;
+    std::vector<iovec> iov = ChunkIoVectors(channels, &bytes);
+    ssize_t nRead = -1;
+    int error = 0;
+    if (file != -1)
+    {
+        nRead = preadv(file, iov.data(), (int)iov.size(), PageFileOffset(loopId, chunk));
+        error = nRead < 0 ? errno : 0;
+    }
+    if (nRead != (ssize_t)bytes)
+    {
+        for (size_t c = 0; c < iov.size(); ++c)
+        {
+            std::fill(channels[c], channels[c] + bufferPool->GetBufferSize(), 0.0f);
+        }
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void ToobLooperEngine::bgReadChunk(size_t loopId, size_t chunk, float *const *channels)
+{
+    if (!ReadPageFileChunk(pageFile, loopId, chunk, channels))
+    {
+        std::stringstream ss;
+        ss << "Can't read looper page file. " << (errno != 0 ? strerror(errno) : "Page not found.");
+        bgError(ss.str());
+    }
+}
+
+void ToobLooperEngine::bgPageOut(size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer)
+{
+    try {
+        bgWriteChunk(loopId, chunk, ChannelPointers(buffer).data());
+    } catch (const std::exception &)
+    {
+        bgFreeBuffer(buffer);
+        throw;
+    }
+    bgFreeBuffer(buffer);
+    // Return the memory of paged-out chunks to the system, rather than holding it in the pool.
+    if (bufferPool->PooledCount() > 4 * Loop::PAGE_AHEAD_CHUNKS)
+    {
+        bufferPool->Trim(2 * Loop::PAGE_AHEAD_CHUNKS);
+    }
+}
+
+toob::AudioFileBuffer *ToobLooperEngine::bgTakeBuffer()
+{
+    // The realtime thread may empty the pool between Reserve() and TakeBuffer(), so retry once.
+    for (int retry = 0; retry < 2; ++retry)
+    {
+        if (bufferPool->PooledCount() < POOL_LOW_WATERMARK)
+        {
+            bufferPool->Reserve(POOL_RESERVE);
+        }
+        toob::AudioFileBuffer *buffer = bufferPool->TakeBuffer();
+        if (buffer)
+        {
+            return buffer;
+        }
+    }
+    throw std::runtime_error("Looper buffer pool is empty.");
+}
+
+toob::AudioFileBuffer *ToobLooperEngine::bgPageIn(size_t loopId, size_t chunk)
+{
+    toob::AudioFileBuffer *buffer = bgTakeBuffer();
+    bgReadChunk(loopId, chunk, ChannelPointers(buffer).data());
+    return buffer;
+}
+
+void ToobLooperEngine::RequestSaveSession(const std::string &path)
+{
+    std::lock_guard lock{sessionMutex};
+    pendingSavePath = path;
+    // cleared now rather than when the save starts, so that a second request for the same
+    // contents doesn't name a new file.
+    sessionDirty.store(false, std::memory_order_relaxed);
+    sessionRequestPending.store(true, std::memory_order_release);
+}
+
+void ToobLooperEngine::RequestLoadSession(const std::string &path)
+{
+    std::lock_guard lock{sessionMutex};
+    pendingLoadPath = path;
+    pendingSavePath.clear();
+    sessionRequestPending.store(true, std::memory_order_release);
+}
+
+void ToobLooperEngine::fgRequestLoadSession(const char *path)
+{
+    fgPendingLoadPath = path;
+    sessionRequestPending.store(true, std::memory_order_release);
+}
+
+std::string ToobLooperEngine::TakeUnfinishedSave()
+{
+    if (fgSaving)
+    {
+        fgSaving = false;
+        return fgSavePath;
+    }
+    std::lock_guard lock{sessionMutex};
+    return std::exchange(pendingSavePath, std::string());
+}
+
+void ToobLooperEngine::DetachSessionSave(const std::string &path, bool referenced)
+{
+    auto job = std::make_unique<SessionSaveJob>();
+    job->path = path;
+    {
+        std::lock_guard lock{sessionMutex};
+        if (unreferencedSessionPath != path)
+        {
+            job->deletePath = unreferencedSessionPath;
+        }
+        unreferencedSessionPath = referenced ? std::string() : path;
+    }
+    if (!path.empty())
+    {
+        // Resident chunks move to the job, so that Loop::Reset() doesn't free them. Paged chunks
+        // are read from the page file, which the job takes over when the background thread stops.
+        job->length = loops.size() != 0 ? loops[0].length : 0;
+        job->loops.resize(SessionLoopCount());
+        for (size_t i = 0; i < job->loops.size(); ++i)
+        {
+            Loop &loop = loops[i];
+            SessionSaveJob::SavedLoop &saved = job->loops[i];
+            saved.loopId = loop.loopId;
+            saved.buffers.resize(loop.chunkStates.size());
+            saved.paged.resize(loop.chunkStates.size());
+            for (size_t chunk = 0; chunk < loop.chunkStates.size(); ++chunk)
+            {
+                switch (loop.chunkStates[chunk])
+                {
+                case Loop::ChunkState::Resident:
+                    saved.buffers[chunk] = loop.buffers[chunk];
+                    loop.buffers[chunk] = nullptr;
+                    loop.chunkStates[chunk] = Loop::ChunkState::Empty;
+                    break;
+                case Loop::ChunkState::Paged:
+                case Loop::ChunkState::PagingIn:
+                    saved.paged[chunk] = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        sessionDirty.store(false, std::memory_order_relaxed);
+    }
+    detachedSave = std::move(job);
+}
+
+void ToobLooperEngine::MarkSessionReferenced(const std::string &path)
+{
+    std::lock_guard lock{sessionMutex};
+    if (unreferencedSessionPath == path)
+    {
+        unreferencedSessionPath.clear();
+    }
+}
+
+void ToobLooperEngine::WaitForSessionSave()
+{
+    if (sessionSaveThread && sessionSaveThread->joinable())
+    {
+        sessionSaveThread->join();
+    }
+}
+
+void ToobLooperEngine::StartSessionSaveThread(std::unique_ptr<SessionSaveJob> job)
+{
+    std::unique_ptr<std::jthread> previous = std::move(sessionSaveThread);
+    sessionSaveThread = std::make_unique<std::jthread>(
+        [this, job = std::move(job), previous = std::move(previous)]()
+        {
+            // in order, so that a superseded file is never deleted before it has been written.
+            if (previous)
+            {
+                previous->join();
+            }
+            RunSessionSaveJob(*job);
+        });
+}
+
+void ToobLooperEngine::RunSessionSaveJob(SessionSaveJob &job)
+{
+    try
+    {
+        if (!job.path.empty() && job.length != 0)
+        {
+            size_t bufferSize = bufferPool->GetBufferSize();
+            size_t loopCount = job.loops.size();
+            std::vector<std::vector<float>> data(loopCount * 2, std::vector<float>(bufferSize));
+            std::vector<float *> channels(data.size());
+            for (size_t c = 0; c < channels.size(); ++c)
+            {
+                channels[c] = data[c].data();
+            }
+            std::filesystem::path sessionPath{job.path};
+            std::filesystem::create_directories(sessionPath.parent_path());
+            toob::AudioFileWriter::ptr writer = toob::AudioFileWriter::Create(
+                sessionPath, toob::AudioFileFormat::Flac, (int)(loopCount * 2), (uint32_t)sampleRate);
+            bool pageFileError = false;
+            for (size_t chunk = 0; chunk * bufferSize < job.length; ++chunk)
+            {
+                for (size_t i = 0; i < loopCount; ++i)
+                {
+                    const SessionSaveJob::SavedLoop &loop = job.loops[i];
+                    float *const *loopChannels = channels.data() + i * 2;
+                    toob::AudioFileBuffer *buffer = chunk < loop.buffers.size() ? loop.buffers[chunk] : nullptr;
+                    if (buffer)
+                    {
+                        std::copy(buffer->GetChannel(0), buffer->GetChannel(0) + bufferSize, loopChannels[0]);
+                        std::copy(buffer->GetChannel(1), buffer->GetChannel(1) + bufferSize, loopChannels[1]);
+                    }
+                    else if (chunk < loop.paged.size() && loop.paged[chunk])
+                    {
+                        pageFileError |= !ReadPageFileChunk(job.pageFile, loop.loopId, chunk, loopChannels);
+                    }
+                    else
+                    {
+                        std::fill(loopChannels[0], loopChannels[0] + bufferSize, 0.0f);
+                        std::fill(loopChannels[1], loopChannels[1] + bufferSize, 0.0f);
+                    }
+                }
+                writer->write(channels.data(), std::min(bufferSize, job.length - chunk * bufferSize));
+            }
+            writer->close();
+            if (pageFileError)
+            {
+                fgError("Can't read looper page file. Parts of the saved session are silent.");
+            }
+        }
+        if (!job.deletePath.empty())
+        {
+            std::error_code ec;
+            std::filesystem::remove(job.deletePath, ec);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::stringstream ss;
+        ss << "Looper session save failed. " << e.what();
+        fgError(ss.str().c_str());
+    }
+    for (auto &loop : job.loops)
+    {
+        for (toob::AudioFileBuffer *buffer : loop.buffers)
+        {
+            if (buffer)
+            {
+                bgFreeBuffer(buffer);
+            }
+        }
+    }
+    if (job.pageFile != -1)
+    {
+        close(job.pageFile);
+    }
+}
+
+// Lock held.
+void ToobLooperEngine::fgSupersedeUnreferencedSession(const std::string &path)
+{
+    if (!unreferencedSessionPath.empty() && unreferencedSessionPath != path)
+    {
+        DeleteSessionFileCommand cmd(unreferencedSessionPath.c_str());
+        this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+        unreferencedSessionPath.clear();
+    }
+}
+
+void ToobLooperEngine::fgPollSessionRequests()
+{
+    // A save finishes before anything else can change the loops that it reads. A load may
+    // supersede one that is in progress; the background thread abandons the stale one.
+    // (Requests that arrive while the background thread is stopping are left for the next Activate().)
+    if (!activated || fgSaving || !sessionRequestPending.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    // Never wait for a non-realtime thread. A request that is being written is picked up next cycle.
+    std::unique_lock lock{sessionMutex, std::try_to_lock};
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+    if (!pendingLoadPath.empty())
+    {
+        fgSupersedeUnreferencedSession(pendingLoadPath);
+        fgBeginLoadSession(pendingLoadPath.c_str());
+        pendingLoadPath.clear();
+    }
+    else if (!pendingSavePath.empty() && !sessionLoading)
+    {
+        // a saved state refers to the file, so it is written before a patch:Set load replaces the loops.
+        fgSupersedeUnreferencedSession(pendingSavePath);
+        fgBeginSaveSession(pendingSavePath.c_str());
+        pendingSavePath.clear();
+    }
+    else if (!fgPendingLoadPath.empty())
+    {
+        fgSupersedeUnreferencedSession(fgPendingLoadPath);
+        fgBeginLoadSession(fgPendingLoadPath.c_str());
+        fgPendingLoadPath.clear();
+    }
+    sessionRequestPending.store(
+        !pendingLoadPath.empty() || !pendingSavePath.empty() || !fgPendingLoadPath.empty(),
+        std::memory_order_relaxed);
+}
+
+void ToobLooperEngine::fgBeginSaveSession(const char *path)
+{
+    size_t length = loops.size() != 0 ? loops[0].length : 0;
+    if (length == 0)
+    {
+        return;
+    }
+    SaveSessionCommand cmd(path, SessionLoopCount(), length);
+    if (!this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+    {
+        fgError("Looper session save failed. Background queue full.");
+        return;
+    }
+    fgSaving = true;
+    fgSavePath = path;
+    fgSaveChunk = 0;
+    fgSaveChunks = (length + bufferPool->GetBufferSize() - 1) / bufferPool->GetBufferSize();
+}
+
+void ToobLooperEngine::fgContinueSaveSession()
+{
+    // A few chunks per cycle, leaving room in the queue for paging traffic. Buffers referenced by
+    // the commands stay valid until the background thread has copied them, because any command
+    // that frees or pages them out is queued behind.
+    constexpr size_t CHUNKS_PER_CYCLE = 4;
+    constexpr size_t QUEUE_RESERVE = 16384;
+    size_t loopCount = SessionLoopCount();
+    for (size_t n = 0; n < CHUNKS_PER_CYCLE; ++n)
+    {
+        if (fgSaveChunk == fgSaveChunks)
+        {
+            SaveSessionEndCommand cmd;
+            if (this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+            {
+                fgSaving = false;
+            }
+            return;
+        }
+        if (this->toBackgroundQueue.writeSpace() < QUEUE_RESERVE + loopCount * (sizeof(SaveSessionChunkCommand) + sizeof(size_t)))
+        {
+            return;
+        }
+        for (size_t i = 0; i < loopCount; ++i)
+        {
+            Loop &loop = loops[i];
+            toob::AudioFileBuffer *buffer = nullptr;
+            bool paged = false;
+            if (fgSaveChunk < loop.chunkStates.size())
+            {
+                switch (loop.chunkStates[fgSaveChunk])
+                {
+                case Loop::ChunkState::Resident:
+                    buffer = loop.buffers[fgSaveChunk];
+                    break;
+                case Loop::ChunkState::Paged:
+                case Loop::ChunkState::PagingIn:
+                    paged = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+            SaveSessionChunkCommand cmd(i, loop.loopId, fgSaveChunk, buffer, paged);
+            this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+        }
+        ++fgSaveChunk;
+    }
+}
+
+void ToobLooperEngine::fgBeginLoadSession(const char *path)
+{
+    for (auto &loop : loops)
+    {
+        loop.Reset();
+    }
+    sessionDirty.store(false, std::memory_order_relaxed);
+    LoadSessionCommand cmd(path, SessionLoopCount(), ++sessionGeneration);
+    for (size_t i = 0; i < cmd.loopCount; ++i)
+    {
+        cmd.loopIds[i] = loops[i].loopId;
+    }
+    if (!this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+    {
+        fgError("Looper session load failed. Background queue full.");
+        return;
+    }
+    sessionLoading = true;
+}
+
+void ToobLooperEngine::fgOnSessionLoaded(uint64_t generation, size_t length, uint32_t loopMask)
+{
+    if (generation != sessionGeneration)
+    {
+        return;
+    }
+    sessionLoading = false;
+    if (length == 0 || loopMask == 0)
+    {
+        return;
+    }
+    // Restored loops start muted, with the main loop running; Play unmutes them.
+    loopMask |= 1;
+    for (size_t i = 0; i < SessionLoopCount(); ++i)
+    {
+        if (loopMask & (1u << i))
+        {
+            Loop &loop = loops[i];
+            loop.length = length;
+            loop.play_cursor = 0;
+            loop.recordLevel.To(0.0f, 0.0);
+            loop.playbackLevel.To(0.0f, 0.0);
+            loop.state = LoopState::Silent;
+        }
+    }
+    SetMasterLoopLength(length);
+    this->time_zero = this->current_plugin_sample;
+    this->has_time_zero = true;
+    sessionDirty.store(false, std::memory_order_relaxed);
+    OnSessionLoaded();
+}
+
+bool ToobLooperEngine::Loop::InstallChunk(size_t chunk, toob::AudioFileBuffer *buffer)
+{
+    if (state != LoopState::Idle || chunk >= MAX_LOOP_CHUNKS)
+    {
+        return false; // the user started recording while the session was loading.
+    }
+    if (chunk >= buffers.size())
+    {
+        buffers.resize(chunk + 1);
+        chunkStates.resize(chunk + 1);
+    }
+    buffers[chunk] = buffer;
+    chunkStates[chunk] = buffer ? ChunkState::Resident : ChunkState::Paged;
+    return true;
+}
+
+// Blocks until the realtime thread has made room; it drains the queue every cycle.
+void ToobLooperEngine::bgSend(size_t size, void *packet)
+{
+    while (!this->fromBackgroundQueue.write_packet(size, (uint8_t *)packet))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+void ToobLooperEngine::bgBeginSaveSession(const char *path, size_t loopCount, size_t length)
+{
+    bgSessionWriter = nullptr;
+    bgSessionLoopCount = loopCount;
+    bgSessionLength = length;
+    bgSessionData.resize(loopCount * 2);
+    for (auto &channel : bgSessionData)
+    {
+        channel.resize(bufferPool->GetBufferSize());
+    }
+    std::filesystem::path sessionPath{path};
+    std::filesystem::create_directories(sessionPath.parent_path());
+    bgSessionWriter = toob::AudioFileWriter::Create(sessionPath, toob::AudioFileFormat::Flac, (int)(loopCount * 2), (uint32_t)sampleRate);
+}
+
+void ToobLooperEngine::bgSaveSessionChunk(size_t loopIndex, size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer, bool paged)
+{
+    if (!bgSessionWriter || loopIndex >= bgSessionLoopCount)
+    {
+        return; // the save failed to start.
+    }
+    size_t bufferSize = bufferPool->GetBufferSize();
+    float *channels[2] = {bgSessionData[loopIndex * 2].data(), bgSessionData[loopIndex * 2 + 1].data()};
+    if (buffer)
+    {
+        std::copy(buffer->GetChannel(0), buffer->GetChannel(0) + bufferSize, channels[0]);
+        std::copy(buffer->GetChannel(1), buffer->GetChannel(1) + bufferSize, channels[1]);
+    }
+    else if (paged)
+    {
+        bgReadChunk(loopId, chunk, channels);
+    }
+    else
+    {
+        std::fill(channels[0], channels[0] + bufferSize, 0.0f);
+        std::fill(channels[1], channels[1] + bufferSize, 0.0f);
+    }
+    if (loopIndex == bgSessionLoopCount - 1)
+    {
+        size_t frames = std::min(bufferSize, bgSessionLength - chunk * bufferSize);
+        std::vector<float *> data(bgSessionData.size());
+        for (size_t c = 0; c < data.size(); ++c)
+        {
+            data[c] = bgSessionData[c].data();
+        }
+        try {
+            bgSessionWriter->write(data.data(), frames);
+        } catch (const std::exception &)
+        {
+            bgSessionWriter = nullptr;
+            throw;
+        }
+    }
+}
+
+void ToobLooperEngine::bgEndSaveSession()
+{
+    if (bgSessionWriter)
+    {
+        auto writer = std::move(bgSessionWriter);
+        writer->close();
+    }
+    bgSessionData.clear();
+}
+
+void ToobLooperEngine::bgLoadSession(const char *path, size_t loopCount, const size_t *loopIds, uint64_t generation)
+{
+    size_t length = 0;
+    uint32_t loopMask = 0;
+    try
+    {
+        // the file may be one that a detached save is still writing.
+        WaitForSessionSave();
+        // sessions are FLAC at the engine's sample rate, so this is an in-process decode.
+        toob::AudioDecoderStream::ptr decoder = toob::AudioDecoderStream::Create(path, (int)(loopCount * 2), (uint32_t)sampleRate);
+
+        size_t bufferSize = bufferPool->GetBufferSize();
+        std::vector<toob::AudioFileBuffer *> row(loopCount);
+        std::vector<float *> channels(loopCount * 2);
+        for (size_t chunk = 0; chunk < Loop::MAX_LOOP_CHUNKS; ++chunk)
         {
-            this->toBackgroundQueue.readWait();
-            size_t size = this->toBackgroundQueue.peekSize();
-            if (size == 0) continue;
-
-            if (size > buffer.size()) {
-                buffer.resize(size);
-                cmd = (BufferCommand*)buffer.data();
+            if (generation != sessionGeneration.load(std::memory_order_relaxed))
+            {
+                // superseded by another load, or the plugin is being deactivated. Chunks that were
+                // already sent are freed by the realtime thread.
+                return;
             }
-            if (!this->toBackgroundQueue.read_packet(buffer.size()  ,(uint8_t*)cmd))
+            for (size_t i = 0; i < loopCount; ++i)
             {
-                break;
+                row[i] = bgTakeBuffer();
+                channels[i * 2] = row[i]->GetChannel(0);
+                channels[i * 2 + 1] = row[i]->GetChannel(1);
             }
-
-            try {
-                switch (cmd->command) {
-                case MessageType::RefreshPool:
+            size_t frames = decoder->read(channels.data(), bufferSize);
+            for (size_t i = 0; i < loopCount; ++i)
+            {
+                toob::AudioFileBuffer *buffer = row[i];
+                bool silent = true;
+                for (size_t c = 0; c < 2 && silent; ++c)
                 {
-                    bufferPool->Reserve(10);
-                    break;
+                    const float *p = buffer->GetChannel(c);
+                    silent = std::all_of(p, p + frames, [](float v)
+                                         { return v == 0.0f; });
                 }
-                case MessageType::FreeBuffer:
+                if (silent)
                 {
-                    FreeBufferCommand *freeBuffer = (FreeBufferCommand*)cmd;
-                    auto buffer = freeBuffer->buffer;
-                    // must zero the buffer before returning it.
-                    for (size_t c = 0; c < buffer->GetChannelCount(); ++c) {
-                        float *p = buffer->GetChannel(c);
-                        for (size_t i = 0; i < buffer->GetBufferSize(); ++i) {
-                            p[i] = 0.0f;
-                        }
+                    // silent chunks stay empty, and take no memory.
+                    bufferPool->PutBuffer(buffer);
+                    continue;
+                }
+                loopMask |= 1u << i;
+                if (chunk < Loop::MAX_RESIDENT_CHUNKS)
+                {
+                    SessionChunkLoadedCommand loaded(generation, i, chunk, buffer);
+                    bgSend(sizeof(loaded), &loaded);
+                }
+                else
+                {
+                    // Long loops are decoded straight into the page file, and paged in ahead of
+                    // the play cursor like any other long loop.
+                    try {
+                        bgWriteChunk(loopIds[i], chunk, channels.data() + i * 2);
+                    } catch (const std::exception &)
+                    {
+                        bgFreeBuffer(buffer);
+                        throw;
                     }
-                    bufferPool->PutBuffer(freeBuffer->buffer);
+                    bgFreeBuffer(buffer);
+                    SessionChunkLoadedCommand loaded(generation, i, chunk, nullptr);
+                    bgSend(sizeof(loaded), &loaded);
                 }
+            }
+            length += frames;
+            if (frames < bufferSize)
+            {
                 break;
-
-                case MessageType::Quit:
-                {
-                    quit = true;
-                    break;
-                }   
-                default:
-                    throw std::runtime_error("Unknown Background command.");
             }
-        } catch (const std::exception&e)
-        {
-            std::stringstream ss;
-            ss << "Background thread error: " << e.what();
-            LogError(ss.str());
-            BackgroundErrorCommmand errorCmd(ss.str());
-            this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t*)&errorCmd);
-    
         }
     }
-    } catch (std::exception &e) {
-        std::stringstream ss;
-        ss << "Background thread error: " << e.what();
-        LogError(ss.str());
-        BackgroundErrorCommmand errorCmd(ss.str());
-        this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t*)&errorCmd);
+    catch (const std::exception &)
+    {
+        SessionLoadedCommand failed(generation, 0, 0);
+        bgSend(sizeof(failed), &failed);
+        throw;
     }
+    SessionLoadedCommand loaded(generation, length, loopMask);
+    bgSend(sizeof(loaded), &loaded);
+}
 
-    FinishedCommand finishedCommand;
-    this->fromBackgroundQueue.write_packet(sizeof(FinishedCommand), (uint8_t*)&finishedCommand); });
+void ToobLooperEngine::bgDeleteSessionFile(const char *path)
+{
+    // the file may be one that a detached save is still writing.
+    WaitForSessionSave();
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
 }
 
 namespace
@@ -647,6 +1653,10 @@ void ToobLooperFour::UpdateOutputControls(size_t samplesInFrame)
 
 void ToobLooperFour::HandleTriggers()
 {
+    if (sessionLoading)
+    {
+        return; // the loops are being filled from a session file.
+    }
     try
     {
 
@@ -814,44 +1824,94 @@ void ToobLooperFour::Deactivate()
 {
     this->activated = false;
 
+    // Keep the loops through a preset change. A save that a saved state refers to, and that
+    // hasn't been written yet, is completed with the loops as they are now.
+    std::string savePath = TakeUnfinishedSave();
+    bool referenced = !savePath.empty();
+    if (!referenced && SessionHasContent() && SessionDirty())
+    {
+        savePath = NewSessionPath();
+    }
+    if (!savePath.empty())
+    {
+        DetachSessionSave(savePath, referenced);
+        sessionFile = savePath;
+    }
+    else if (!SessionHasContent() && SessionDirty())
+    {
+        sessionFile.clear(); // the loops were erased.
+        DetachSessionSave(std::string(), false);
+    }
+
     for (size_t i = 0; i < N_LOOPS; ++i)
     {
         loops[i].Reset();
     }
-    QuitCommand cmd;
-    this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+    StopBackgroundThread();
 
-    while (true)
+    super::Deactivate();
+}
+
+void ToobLooperOne::Deactivate()
+{
+    this->activated = false;
+
+    for (auto &loop : loops)
     {
-        fgHandleMessages();
-        if (this->finished)
-        {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        loop.Reset();
     }
-    this->backgroundThread->join();
-    this->backgroundThread.reset();
+    StopBackgroundThread();
 
     super::Deactivate();
 }
 
 void ToobLooperEngine::fgHandleMessages()
 {
-    size_t size = this->fromBackgroundQueue.peekSize();
-    if (size == 0)
+    if (refillRequested.load(std::memory_order_relaxed))
     {
-        return;
+        refillRequested.store(false, std::memory_order_relaxed);
+        ToobRefreshPoolCmmand cmd;
+        this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
     }
-    char buffer[2048];
-    if (size > sizeof(buffer))
+    if (bufferOverrun)
     {
-        fgError("Foreground buffer overflow");
-        return;
+        bufferOverrun = false;
+        if (!bufferOverrunReported)
+        {
+            bufferOverrunReported = true;
+            fgError("Looper buffer overrun. Audio was dropped.");
+        }
+    }
+    else if (bufferOverrunReported && bufferPool->PooledCount() >= POOL_LOW_WATERMARK)
+    {
+        bufferOverrunReported = false;
+    }
+    sessionHasContent.store(loops.size() != 0 && loops[0].length != 0, std::memory_order_relaxed);
+    fgPollSessionRequests();
+    if (fgSaving)
+    {
+        fgContinueSaveSession();
     }
-    size_t packetSize = fromBackgroundQueue.read_packet(sizeof(buffer), buffer);
-    if (packetSize != 0)
+
+    // Page-ins arrive in bursts when a loop starts playing from a paged-out position.
+    while (true)
     {
+        size_t size = this->fromBackgroundQueue.peekSize();
+        if (size == 0)
+        {
+            return;
+        }
+        char buffer[2048];
+        if (size > sizeof(buffer))
+        {
+            fgError("Foreground buffer overflow");
+            return;
+        }
+        size_t packetSize = fromBackgroundQueue.read_packet(sizeof(buffer), buffer);
+        if (packetSize == 0)
+        {
+            return;
+        }
         BufferCommand *cmd = (BufferCommand *)buffer;
         switch (cmd->command)
         {
@@ -861,6 +1921,46 @@ void ToobLooperEngine::fgHandleMessages()
             fgError(errorCmd->message);
             break;
         }
+        case MessageType::PageInComplete:
+        {
+            PageInCompleteCommand *complete = (PageInCompleteCommand *)cmd;
+            bool installed = false;
+            for (auto &loop : loops)
+            {
+                if (loop.loopId == complete->loopId)
+                {
+                    installed = loop.OnPageInComplete(complete->generation, complete->chunk, complete->buffer);
+                    break;
+                }
+            }
+            if (!installed)
+            {
+                FreeBufferCommand freeCmd(complete->buffer);
+                this->toBackgroundQueue.write_packet(sizeof(freeCmd), (uint8_t *)&freeCmd);
+            }
+            break;
+        }
+        case MessageType::SessionChunkLoaded:
+        {
+            SessionChunkLoadedCommand *loaded = (SessionChunkLoadedCommand *)cmd;
+            bool installed = false;
+            if (loaded->generation == sessionGeneration && loaded->loopIndex < loops.size())
+            {
+                installed = loops[loaded->loopIndex].InstallChunk(loaded->chunk, loaded->buffer);
+            }
+            if (!installed && loaded->buffer)
+            {
+                FreeBufferCommand freeCmd(loaded->buffer);
+                this->toBackgroundQueue.write_packet(sizeof(freeCmd), (uint8_t *)&freeCmd);
+            }
+            break;
+        }
+        case MessageType::SessionLoaded:
+        {
+            SessionLoadedCommand *loaded = (SessionLoadedCommand *)cmd;
+            fgOnSessionLoaded(loaded->generation, loaded->length, loaded->loopMask);
+            break;
+        }
         case MessageType::Finished:
         {
             this->finished = true;
@@ -882,9 +1982,153 @@ void ToobLooperFour::fgError(const char *message)
     LogError("%s", message);
 }
 
-ToobLooperFour::~ToobLooperFour()
+void ToobLooperFour::OnSessionLoaded()
+{
+    this->PutPatchPropertyPath(0, this->loopSession_urid, this->sessionFile.c_str());
+}
+
+bool ToobLooperFour::OnPatchPathSet(LV2_URID propertyUrid, const char *value)
+{
+    if (propertyUrid == this->loopSession_urid)
+    {
+        this->sessionFile = value;
+        if (activated && *value != 0)
+        {
+            // queued, so that it can't interrupt a save in progress.
+            fgRequestLoadSession(value);
+        }
+        return true;
+    }
+    return false;
+}
+
+const char *ToobLooperFour::OnGetPatchPropertyValue(LV2_URID propertyUrid)
+{
+    if (propertyUrid == this->loopSession_urid)
+    {
+        return this->sessionFile.c_str();
+    }
+    return nullptr;
+}
+
+std::string ToobLooperFour::NewSessionPath()
+{
+    char name[64];
+    time_t now = time(nullptr);
+    struct tm localTime;
+    localtime_r(&now, &localTime);
+    strftime(name, sizeof(name), "looper-%Y-%m-%d-%H%M%S", &localTime);
+
+    // Saves are written asynchronously, so the previous one may not exist on disk yet.
+    std::filesystem::path path = sessionDirectory / (std::string(name) + ".flac");
+    for (int i = 2; std::filesystem::exists(path) || path.string() == sessionFile; ++i)
+    {
+        path = sessionDirectory / (std::string(name) + "-" + std::to_string(i) + ".flac");
+    }
+    return path.string();
+}
+
+LV2_State_Status
+ToobLooperFour::OnRestoreLv2State(
+    LV2_State_Retrieve_Function retrieve,
+    LV2_State_Handle handle,
+    uint32_t flags,
+    const LV2_Feature *const *features)
+{
+    size_t size;
+    uint32_t type;
+    uint32_t valueFlags;
+    const void *data = (*retrieve)(handle, this->loopSession_urid, &size, &type, &valueFlags);
+    if (data)
+    {
+        if (type != this->urids.atom__Path && type != this->urids.atom__String)
+        {
+            return LV2_State_Status::LV2_STATE_ERR_BAD_TYPE;
+        }
+        this->sessionFile = MapFilename(features, (const char *)data);
+        if (activated && !sessionFile.empty())
+        {
+            RequestLoadSession(sessionFile);
+        }
+    }
+    return LV2_State_Status::LV2_STATE_SUCCESS;
+}
+
+LV2_State_Status
+ToobLooperFour::OnSaveLv2State(
+    LV2_State_Store_Function store,
+    LV2_State_Handle handle,
+    uint32_t flags,
+    const LV2_Feature *const *features)
+{
+    if (!SessionHasContent())
+    {
+        return LV2_State_Status::LV2_STATE_SUCCESS; // not-set => "". Avoids assuming that hosts can handle a "" path.
+    }
+    if (SessionDirty() || sessionFile.empty())
+    {
+        // Encoded on the background thread; the state only needs the name.
+        std::string path = NewSessionPath();
+        RequestSaveSession(path);
+        sessionFile = path;
+    }
+    else
+    {
+        MarkSessionReferenced(sessionFile);
+    }
+    std::string abstractPath = UnmapFilename(features, sessionFile);
+    store(handle, loopSession_urid, abstractPath.c_str(), abstractPath.length() + 1, urids.atom__Path, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+    return LV2_State_Status::LV2_STATE_SUCCESS;
+}
+
+std::string ToobLooperFour::UnmapFilename(const LV2_Feature *const *features, const std::string &fileName)
 {
+    const LV2_State_Map_Path *mapPath = GetFeature<LV2_State_Map_Path>(features, LV2_STATE__mapPath);
+    const LV2_State_Free_Path *freePath = GetFeature<LV2_State_Free_Path>(features, LV2_STATE__freePath);
 
+    if (mapPath == nullptr)
+    {
+        return fileName;
+    }
+    char *result = mapPath->abstract_path(mapPath->handle, fileName.c_str());
+    std::string t = result;
+    if (freePath)
+    {
+        freePath->free_path(freePath->handle, result);
+    }
+    else
+    {
+        free(result);
+    }
+    return t;
+}
+
+std::string ToobLooperFour::MapFilename(const LV2_Feature *const *features, const std::string &fileName)
+{
+    const LV2_State_Map_Path *mapPath = GetFeature<LV2_State_Map_Path>(features, LV2_STATE__mapPath);
+    const LV2_State_Free_Path *freePath = GetFeature<LV2_State_Free_Path>(features, LV2_STATE__freePath);
+
+    if (mapPath == nullptr || fileName.empty())
+    {
+        return fileName;
+    }
+    char *result = mapPath->absolute_path(mapPath->handle, fileName.c_str());
+    std::string t = result;
+    if (freePath)
+    {
+        freePath->free_path(freePath->handle, result);
+    }
+    else
+    {
+        free(result);
+    }
+    return t;
+}
+
+ToobLooperFour::~ToobLooperFour()
+{
+    // the save thread reports errors through fgError().
+    WaitForSessionSave();
 }
 
 // static size_t CalculateLoopLength(double sampleRate,size_t length, size_t master_loop_length)
@@ -926,6 +2170,10 @@ void ToobLooperEngine::Loop::Init(ToobLooperEngine *plugin)
     this->pre_trigger_blend_samples = (size_t)(plugin->sampleRate * TRIGGER_FADE_IN_TIME);
     this->bufferSize = plugin->bufferPool->GetBufferSize();
     this->plugin = plugin;
+    this->loopId = plugin->nextLoopId++;
+    // reserved up front, so that a growing loop never allocates on the realtime thread.
+    this->buffers.reserve(MAX_LOOP_CHUNKS);
+    this->chunkStates.reserve(MAX_LOOP_CHUNKS);
     this->recordLevel.SetSampleRate(plugin->sampleRate);
     this->playbackLevel.SetSampleRate(plugin->sampleRate);
     this->recordLevel.To(0.0f, 0.0);
@@ -1175,16 +2423,34 @@ void ToobLooperEngine::Loop::Stop(ToobLooperEngine *plugin, size_t loopOffset)
 
 void ToobLooperEngine::Loop::Reset()
 {
+    if (length != 0)
+    {
+        plugin->sessionDirty.store(true, std::memory_order_relaxed);
+    }
+    FreeBufferCommand cmd;
     for (size_t i = 0; i < buffers.size(); ++i)
     {
-        if (buffers[i] != nullptr)
+        if (chunkStates[i] == ChunkState::Resident)
         {
-            FreeBufferCommand cmd(buffers[i]);
-            buffers[i] = nullptr;
-            plugin->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+            cmd.Add(buffers[i]);
+            if (cmd.Full())
+            {
+                plugin->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+                cmd.count = 0;
+            }
         }
+        buffers[i] = nullptr;
     }
+    if (cmd.count != 0)
+    {
+        plugin->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+    }
+    // Paged-out chunks are simply abandoned; their page file region is overwritten when the loop
+    // is next paged out.
     buffers.clear();
+    chunkStates.clear();
+    ++generation;
+    pagedCursorChunk = (size_t)-1;
     recordLevel.To(0, 0);
     playbackLevel.To(0, 0);
     play_cursor = 0;
@@ -1220,6 +2486,10 @@ void ToobLooperEngine::Loop::process(
     ToobLooperEngine *plugin,
     const float *__restrict inL, const float *__restrict inR, float *__restrict outL, float *__restrict outR, size_t n_samples)
 {
+    if (state == LoopState::Recording || state == LoopState::Overdubbing)
+    {
+        plugin->sessionDirty.store(true, std::memory_order_relaxed);
+    }
     size_t index = 0;
     while (index < n_samples)
     {
@@ -1232,14 +2502,24 @@ void ToobLooperEngine::Loop::process(
         {
             while (index < n_samples)
             {
-                float &vLeft = atL(play_cursor);
-                float &vRight = atR(play_cursor);
-                float left = inL[index];
-                float right = inR[index];
-                vLeft = left;
-                vRight = right;
-                ++play_cursor;
-                index++;
+                size_t n = n_samples - index;
+                if (play_cursor < length)
+                {
+                    n = std::min(n, length - play_cursor);
+                }
+                Span run = this->span(play_cursor, n);
+                n = run.count;
+                if (run.left)
+                {
+                    std::copy(inL + index, inL + index + n, run.left);
+                    std::copy(inR + index, inR + index + n, run.right);
+                }
+                else
+                {
+                    recordError.SetError(); // past MAX_LOOP_SECONDS.
+                }
+                play_cursor += n;
+                index += n;
 
                 if (play_cursor == length)
                 {
@@ -1287,19 +2567,51 @@ void ToobLooperEngine::Loop::process(
         {
             while (index < n_samples)
             {
-                float recordLevel = this->recordLevel.Tick();
-                float playLevel = this->playbackLevel.Tick();
-                float &vLeft = atL(play_cursor);
-                float &vRight = atR(play_cursor);
-                outL[index] += playLevel * vLeft;
-                outR[index] += playLevel * vRight;
-                float left = inL[index];
-                float right = inL[index];
-                vLeft += recordLevel * left;
-                vRight += recordLevel * right;
-
-                play_cursor++;
-                index++;
+                if (this->length == 0)
+                {
+                    index = n_samples;
+                    break;
+                }
+                if (play_cursor >= this->length)
+                {
+                    play_cursor = 0;
+                }
+                // the longest run over which storage is contiguous and both levels are linear.
+                size_t n = std::min(n_samples - index, this->length - play_cursor);
+                Span run = this->span(play_cursor, n);
+                n = std::min({run.count, this->recordLevel.LinearRun(), this->playbackLevel.LinearRun()});
+
+                float recordLevel, dRecordLevel;
+                float playLevel, dPlayLevel;
+                this->recordLevel.TickBlock(n, recordLevel, dRecordLevel);
+                this->playbackLevel.TickBlock(n, playLevel, dPlayLevel);
+
+                if (run.left)
+                {
+                    float *__restrict loopL = run.left;
+                    float *__restrict loopR = run.right;
+                    const float *__restrict srcL = inL + index;
+                    const float *__restrict srcR = inR + index;
+                    float *__restrict dstL = outL + index;
+                    float *__restrict dstR = outR + index;
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        float play = playLevel + dPlayLevel * i;
+                        float record = recordLevel + dRecordLevel * i;
+                        dstL[i] += play * loopL[i];
+                        dstR[i] += play * loopR[i];
+                        loopL[i] += record * srcL[i];
+                        loopR[i] += record * srcR[i];
+                    }
+                }
+                else
+                {
+                    // The page-in didn't arrive in time. Play silence, and drop the overdub.
+                    playError.SetError();
+                }
+
+                play_cursor += n;
+                index += n;
                 if (play_cursor >= this->length)
                 {
                     play_cursor = 0;
@@ -1397,6 +2709,82 @@ void ToobLooperEngine::Loop::process(
             throw std::runtime_error("Unknown loop state.");
         }
     }
+    if (state != LoopState::Idle)
+    {
+        UpdatePaging();
+    }
+}
+
+void ToobLooperEngine::Loop::UpdatePaging()
+{
+    size_t cursorChunk = play_cursor / bufferSize;
+    if (cursorChunk == pagedCursorChunk)
+    {
+        return;
+    }
+    pagedCursorChunk = cursorChunk;
+    // If the background queue is full, nothing changes, and the next call tries again.
+    bool queueFull = false;
+
+    // while the length of a loop is still open, chunks only exist behind the cursor.
+    size_t nChunks = length != 0 ? (length + bufferSize - 1) / bufferSize : buffers.size();
+    if (nChunks <= MAX_RESIDENT_CHUNKS)
+    {
+        return;
+    }
+    if (length != 0 || cursorChunk >= PAGE_BEHIND_CHUNKS)
+    {
+        size_t behind = (cursorChunk + nChunks - PAGE_BEHIND_CHUNKS) % nChunks;
+        if (behind >= PINNED_CHUNKS && behind < chunkStates.size() && chunkStates[behind] == ChunkState::Resident)
+        {
+            PageOutCommand cmd(loopId, behind, buffers[behind]);
+            if (plugin->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+            {
+                buffers[behind] = nullptr;
+                chunkStates[behind] = ChunkState::Paged;
+            }
+            else
+            {
+                queueFull = true;
+            }
+        }
+    }
+    // The whole window is checked, since the cursor can jump (e.g. when a loop is restarted).
+    for (size_t i = 0; i <= PAGE_AHEAD_CHUNKS; ++i)
+    {
+        size_t ahead = cursorChunk + i;
+        if (ahead >= nChunks)
+        {
+            if (length == 0)
+                break;
+            ahead -= nChunks;
+        }
+        if (ahead < chunkStates.size() && chunkStates[ahead] == ChunkState::Paged)
+        {
+            PageInCommand cmd(loopId, generation, ahead);
+            if (!plugin->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd))
+            {
+                queueFull = true;
+                break;
+            }
+            chunkStates[ahead] = ChunkState::PagingIn;
+        }
+    }
+    if (queueFull)
+    {
+        pagedCursorChunk = (size_t)-1;
+    }
+}
+
+bool ToobLooperEngine::Loop::OnPageInComplete(uint64_t generation, size_t chunk, toob::AudioFileBuffer *buffer)
+{
+    if (generation != this->generation || chunk >= chunkStates.size() || chunkStates[chunk] != ChunkState::PagingIn)
+    {
+        return false;
+    }
+    buffers[chunk] = buffer;
+    chunkStates[chunk] = ChunkState::Resident;
+    return true;
 }
 
 void ToobLooperEngine::Loop::fadeHead()
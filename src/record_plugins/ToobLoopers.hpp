@@ -21,13 +21,19 @@
 
 #define DEFINE_LV2_PLUGIN_BASE
 
+#include <atomic>
 #include <chrono>
 #include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <vector>
+#include <algorithm>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include "lv2ext/pipedal.lv2/ext/fileBrowser.h"
 #include "AudioFileBufferManager.hpp"
+#include "AudioFileWriter.hpp"
 #include <thread>
 #include "../TemporaryFile.hpp"
 #include <queue>
@@ -50,7 +56,7 @@ using namespace record_plugin;
 namespace toob
 {
 	class AudioFileBufferPool;
-	class FfmpegDecoderStream;
+	class AudioDecoderStream;
 };
 
 enum class OutputFormat
@@ -92,6 +98,36 @@ protected:
 	ToobLooperEngine(int channels, double sampleRate);
 	~ToobLooperEngine();
 
+	// Loop length is bounded by the size of the chunk table that is reserved for each loop.
+	static constexpr size_t MAX_LOOP_SECONDS = 30 * 60;
+
+public:
+	// A session file holds the contents of the first MAX_SESSION_LOOPS loops, as FLAC, two
+	// channels per loop. All loops share the length of the main loop.
+	static constexpr size_t MAX_SESSION_LOOPS = toob::AudioFileWriter::MAX_CHANNELS / 2;
+
+	// Session requests may be made from any thread. They are picked up by the realtime thread on
+	// its next cycle, and carried out on the background thread.
+	void RequestSaveSession(const std::string &path);
+	void RequestLoadSession(const std::string &path);
+	// The path of a save that was requested or started, but that won't be written before the
+	// background thread stops ("" if none). Realtime thread stopped (i.e. from Deactivate()).
+	std::string TakeUnfinishedSave();
+	// Save the session from Deactivate(), before the loops are reset. The loops' buffers and the
+	// page file are handed to a thread of their own, which writes the file once the background
+	// thread has stopped, so that Deactivate() doesn't wait for the encode. An empty path saves
+	// nothing. Unless referenced (a saved state refers to the path), the file is deleted again when
+	// a later save or load supersedes it.
+	void DetachSessionSave(const std::string &path, bool referenced);
+	// A saved state refers to the path, so it is no longer deleted when superseded.
+	void MarkSessionReferenced(const std::string &path);
+	void WaitForSessionSave();
+	// True if the loops have changed since the session was last saved or loaded.
+	bool SessionDirty() const { return sessionDirty.load(std::memory_order_relaxed); }
+	bool SessionHasContent() const { return sessionHasContent.load(std::memory_order_relaxed); }
+
+protected:
+
 
 	void SetSlowBlinkLed(RateLimitedOutputPort &bar_led);
 
@@ -125,64 +161,104 @@ protected:
 	class Loop 
 	{
 	public:
+		// Loops are stored in chunks of one pool buffer (0.1 seconds) each.
+		static constexpr size_t CHUNKS_PER_SECOND = 10;
+		static constexpr size_t MAX_LOOP_CHUNKS = MAX_LOOP_SECONDS * CHUNKS_PER_SECOND;
+		// Loops longer than this are paged to disk, keeping only a window around the play cursor
+		// resident.
+		static constexpr size_t MAX_RESIDENT_CHUNKS = 60 * CHUNKS_PER_SECOND;
+		static constexpr size_t PAGE_AHEAD_CHUNKS = 2 * CHUNKS_PER_SECOND;
+		static constexpr size_t PAGE_BEHIND_CHUNKS = 1 * CHUNKS_PER_SECOND;
+		// The head of the loop stays resident so that the wrap at the end of a loop that is still
+		// being recorded never has to wait for a page-in.
+		static constexpr size_t PINNED_CHUNKS = PAGE_AHEAD_CHUNKS;
+
+		enum class ChunkState : uint8_t
+		{
+			Empty,	  // never written; reads as silence.
+			Resident, // held in buffers[].
+			PagingIn, // on disk, with a page-in outstanding.
+			Paged,	  // on disk only.
+		};
+
 		void Init(ToobLooperEngine *plugin);
 
 		void fadeHead();
 		void fadeTail();
 
-		float getL(size_t index)
+		// A contiguous run of loop storage: both channels, from a given loop position up to the end of
+		// the buffer that holds it.
+		struct Span
 		{
-			size_t bufferNumber = index / bufferSize;
-			if (bufferNumber >= buffers.size())
-				return 0.0f;
-			auto buffer = buffers[bufferNumber];
-			if (buffer == 0)
-				return 0.0f;
-			size_t bufferIndex = index % bufferSize;
-			return buffer->GetChannel(0)[bufferIndex];
-		}
-		float getR(size_t index)
+			float *left;
+			float *right;
+			size_t count;
+		};
+
+		// Storage for up to count samples starting at index (fewer, if the run crosses a buffer
+		// boundary). Buffers are taken from the pool as they are first touched, and are zero-filled.
+		// left and right are null if the chunk is paged out, past MAX_LOOP_CHUNKS, or the pool has
+		// run dry (an overrun, reported by fgHandleMessages()).
+		Span span(size_t index, size_t count)
 		{
 			size_t bufferNumber = index / bufferSize;
+			size_t offset = index - bufferNumber * bufferSize;
+			count = std::min(count, bufferSize - offset);
+			if (bufferNumber >= MAX_LOOP_CHUNKS)
+			{
+				return Span{nullptr, nullptr, count};
+			}
 			if (bufferNumber >= buffers.size())
-				return 0.0f;
+			{
+				// within the capacity reserved by Init(), so no allocation.
+				buffers.resize(bufferNumber + 1);
+				chunkStates.resize(bufferNumber + 1);
+			}
+			switch (chunkStates[bufferNumber])
+			{
+			case ChunkState::Empty:
+				buffers[bufferNumber] = plugin->bufferPool->TakeBuffer();
+				if (!buffers[bufferNumber])
+				{
+					plugin->bufferOverrun = true;
+					return Span{nullptr, nullptr, count};
+				}
+				chunkStates[bufferNumber] = ChunkState::Resident;
+				break;
+			case ChunkState::Resident:
+				break;
+			default:
+				return Span{nullptr, nullptr, count};
+			}
 			auto buffer = buffers[bufferNumber];
-			if (buffer == 0)
-				return 0.0f;
-			size_t bufferIndex = index % bufferSize;
-			return buffer->GetChannel(1)[bufferIndex];
+			return Span{
+				buffer->GetChannel(0) + offset,
+				buffer->GetChannel(1) + offset,
+				count};
 		}
 
 		float &atL(size_t index)
 		{
-			size_t bufferNumber = index / bufferSize;
-			if (bufferNumber >= buffers.size())
-				buffers.resize(bufferNumber + 1);
-			auto buffer = buffers[bufferNumber];
-			if (buffer == 0)
-			{
-				buffer = plugin->bufferPool->TakeBuffer();
-				buffers[bufferNumber] = buffer;
-			}
-			size_t bufferIndex = index % bufferSize;
-			return buffer->GetChannel(0)[bufferIndex];
+			float *p = span(index, 1).left;
+			return p ? *p : discard;
 		}
 
 		float &atR(size_t index)
 		{
-			size_t bufferNumber = index / bufferSize;
-			if (bufferNumber >= buffers.size())
-				buffers.resize(bufferNumber + 1);
-			auto buffer = buffers[bufferNumber];
-			if (buffer == 0)
-			{
-				buffer = plugin->bufferPool->TakeBuffer();
-				buffers[bufferNumber] = buffer;
-			}
-			size_t bufferIndex = index % bufferSize;
-			return buffer->GetChannel(1)[bufferIndex];
+			float *p = span(index, 1).right;
+			return p ? *p : discard;
 		}
 
+		// Write back chunks that have fallen behind the play cursor, and request page-ins for
+		// chunks ahead of it.
+		void UpdatePaging();
+		// A page-in requested by UpdatePaging() has completed. Returns false if the buffer is no
+		// longer wanted.
+		bool OnPageInComplete(uint64_t generation, size_t chunk, toob::AudioFileBuffer *buffer);
+		// Install a chunk decoded from a session file; a null buffer means it was written to the
+		// page file. Returns false if the buffer is no longer wanted.
+		bool InstallChunk(size_t chunk, toob::AudioFileBuffer *buffer);
+
 		size_t declickSamples = 0;
 
 		ToobLooperEngine *plugin = nullptr;
@@ -191,8 +267,12 @@ protected:
 		size_t bufferSize = 0;
 		bool isMasterLoop = false;
 
-		const size_t BUFFER_RESERVE = 60 * 10; // 60 seconds / 0.1second/buffer.
-		std::vector<toob::AudioFileBuffer *> buffers{BUFFER_RESERVE};
+		size_t loopId = 0;		 // identifies the loop's region of the page file.
+		uint64_t generation = 0; // incremented by Reset(), to discard stale page-ins.
+		std::vector<toob::AudioFileBuffer *> buffers;
+		std::vector<ChunkState> chunkStates;
+		size_t pagedCursorChunk = (size_t)-1;
+		float discard = 0;
 		size_t length = 0;
 		size_t master_loop_length = 0;
 
@@ -264,6 +344,7 @@ protected:
 	virtual bool GetRecordToOverdubOption() = 0;
 
 	virtual void OnLoopEnd(Loop &loop) { }
+	virtual void OnSessionLoaded() { }
 
 	void UpdateLoopPosition(Loop &loop, RateLimitedOutputPort &position, size_t n_frames);
 	void UpdateLoopLeds(Loop &loop, RateLimitedOutputPort &record_led, RateLimitedOutputPort &play_led);
@@ -311,9 +392,99 @@ protected:
 	toob::ToobRingBuffer<false, false> fromBackgroundQueue;
 
 	std::unique_ptr<std::jthread> backgroundThread;
-
+	std::atomic<bool> refillRequested{false};
+
+	// The realtime thread never allocates buffers. A recording loop takes CHUNKS_PER_SECOND buffers a
+	// second, so the watermark leaves the background thread two seconds to refill the pool.
+	static constexpr size_t POOL_LOW_WATERMARK = 2 * Loop::CHUNKS_PER_SECOND;
+	static constexpr size_t POOL_RESERVE = 2 * POOL_LOW_WATERMARK;
+	// Set on the realtime thread when the pool runs dry. Reported once per overrun.
+	bool bufferOverrun = false;
+	bool bufferOverrunReported = false;
+
+	size_t SessionLoopCount() const { return std::min(loops.size(), MAX_SESSION_LOOPS); }
+	void fgPollSessionRequests();
+	void fgBeginSaveSession(const char *path);
+	void fgContinueSaveSession();
+	void fgBeginLoadSession(const char *path);
+	void fgOnSessionLoaded(uint64_t generation, size_t length, uint32_t loopMask);
+
+	std::mutex sessionMutex;
+	std::string pendingSavePath;
+	std::string pendingLoadPath;
+	// A session file written by DetachSessionSave() that no saved state refers to.
+	std::string unreferencedSessionPath;
+	std::atomic<bool> sessionRequestPending{false};
+	std::atomic<bool> sessionDirty{false};
+	std::atomic<bool> sessionHasContent{false};
+
+	// Loads requested by the realtime thread itself (patch:Set), which can't wait for sessionMutex.
+	void fgRequestLoadSession(const char *path);
+	void fgSupersedeUnreferencedSession(const std::string &path);
+	std::string fgPendingLoadPath;
+
+	bool fgSaving = false;
+	std::string fgSavePath;
+	size_t fgSaveChunk = 0;
+	size_t fgSaveChunks = 0;
+	bool sessionLoading = false;
+	// Read by the background thread, so that it can abandon a load that has been superseded.
+	std::atomic<uint64_t> sessionGeneration{0};
+
+	void StartBackgroundThread();
+	void StopBackgroundThread();
 	void fgHandleMessages();
 
+	size_t nextLoopId = 0;
+
+	// Background thread only.
+	int pageFile = -1;
+	std::filesystem::path pageDirectory;
+	void bgRun();
+	void bgError(const std::string &message);
+	void bgFreeBuffer(toob::AudioFileBuffer *buffer);
+	void bgPageOut(size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer);
+	toob::AudioFileBuffer *bgPageIn(size_t loopId, size_t chunk);
+	toob::AudioFileBuffer *bgTakeBuffer();
+	void bgWriteChunk(size_t loopId, size_t chunk, float *const *channels);
+	void bgReadChunk(size_t loopId, size_t chunk, float *const *channels);
+	int bgGetPageFile();
+	off_t PageFileOffset(size_t loopId, size_t chunk);
+	std::vector<iovec> ChunkIoVectors(float *const *channels, size_t *bytes);
+
+	void bgSend(size_t size, void *packet);
+	void bgBeginSaveSession(const char *path, size_t loopCount, size_t length);
+	void bgSaveSessionChunk(size_t loopIndex, size_t loopId, size_t chunk, toob::AudioFileBuffer *buffer, bool paged);
+	void bgEndSaveSession();
+	void bgLoadSession(const char *path, size_t loopCount, const size_t *loopIds, uint64_t generation);
+	void bgDeleteSessionFile(const char *path);
+	bool ReadPageFileChunk(int file, size_t loopId, size_t chunk, float *const *channels);
+
+	toob::AudioFileWriter::ptr bgSessionWriter;
+	std::vector<std::vector<float>> bgSessionData;
+	size_t bgSessionLoopCount = 0;
+	size_t bgSessionLength = 0;
+
+	struct SessionSaveJob
+	{
+		struct SavedLoop
+		{
+			size_t loopId = 0;
+			std::vector<toob::AudioFileBuffer *> buffers; // resident chunks; owned by the job.
+			std::vector<bool> paged;
+		};
+		std::string path; // "" if there is nothing to save.
+		std::string deletePath;
+		size_t length = 0;
+		std::vector<SavedLoop> loops;
+		int pageFile = -1;
+	};
+	void StartSessionSaveThread(std::unique_ptr<SessionSaveJob> job);
+	void RunSessionSaveJob(SessionSaveJob &job);
+	// Taken by DetachSessionSave(), and started by StopBackgroundThread().
+	std::unique_ptr<SessionSaveJob> detachedSave;
+	// Each save thread waits for the one before it, so waiting for the last waits for all of them.
+	std::unique_ptr<std::jthread> sessionSaveThread;
 
 };
 
@@ -346,6 +517,8 @@ protected:
 	void UndoLoop();
 
 	virtual void Run(uint32_t n_samples) override;
+	virtual void Activate() override;
+	virtual void Deactivate() override;
 	void HandleTriggers();
 	void UpdateOutputControls(uint64_t sampleInFrame);
 
@@ -421,8 +594,25 @@ public:
 
 	virtual void HandleTriggers();
 
+	virtual bool OnPatchPathSet(LV2_URID propertyUrid, const char *value) override;
+	virtual const char *OnGetPatchPropertyValue(LV2_URID propertyUrid) override;
+
+	LV2_State_Status
+	OnRestoreLv2State(
+		LV2_State_Retrieve_Function retrieve,
+		LV2_State_Handle handle,
+		uint32_t flags,
+		const LV2_Feature *const *features);
+
+	LV2_State_Status
+	OnSaveLv2State(
+		LV2_State_Store_Function store,
+		LV2_State_Handle handle,
+		uint32_t flags,
+		const LV2_Feature *const *features);
 
 	virtual void fgError(const char *message) override;
+	virtual void OnSessionLoaded() override;
 
 	virtual float getTempo() override { 
 		return this->tempo.GetValue();
@@ -443,4 +633,18 @@ public:
 
 	void UpdateOutputControls(uint64_t sampleInFrame);
 
+private:
+	struct Urids
+	{
+		uint32_t atom__Path;
+		uint32_t atom__String;
+	};
+	Urids urids;
+
+	std::string NewSessionPath();
+	std::string UnmapFilename(const LV2_Feature *const *features, const std::string &fileName);
+	std::string MapFilename(const LV2_Feature *const *features, const std::string &fileName);
+
+	std::filesystem::path sessionDirectory;
+	std::string sessionFile;
 };
@@ -19,6 +19,7 @@
 
 #include "ToobRecordMono.hpp"
 #include <stdexcept>
+#include <algorithm>
 #include <numbers>
 #include <cmath>
 #include <ctime>
@@ -27,6 +28,7 @@
 #include <unistd.h>
 #include <thread>
 #include <iostream>
+#include "AudioDecoderStream.hpp"
 #include "FfmpegDecoderStream.hpp"
 
 // using namespace lv2c::lv2_plugin;
@@ -122,10 +124,11 @@ namespace
 
     struct ToobStartRecordingCommand : public BufferCommand
     {
-        ToobStartRecordingCommand(const std::string &fileName, OutputFormat outputFormat)
+        ToobStartRecordingCommand(const std::string &fileName, OutputFormat outputFormat, size_t channels)
             : BufferCommand(MessageType::StartRecording,
                             sizeof(ToobStartRecordingCommand)),
-              outputFormat(outputFormat)
+              outputFormat(outputFormat),
+              channels(channels)
         {
             if (fileName.length() > 1023)
             {
@@ -137,6 +140,7 @@ namespace
         }
 
         OutputFormat outputFormat;
+        size_t channels;
         char filename[1024];
     };
 
@@ -145,9 +149,10 @@ namespace
 
     struct ToobCuePlaybackCommand : public BufferCommand
     {
-        ToobCuePlaybackCommand(const std::string &fileName)
+        ToobCuePlaybackCommand(const std::string &fileName, size_t channels)
             : BufferCommand(MessageType::CuePlayback,
-                            sizeof(ToobCuePlaybackCommand))
+                            sizeof(ToobCuePlaybackCommand)),
+              channels(channels)
         {
             if (fileName.length() > 1023)
             {
@@ -158,6 +163,7 @@ namespace
             this->size = (size + 3) & (~3);
         }
 
+        size_t channels;
         char filename[1024];
     };
 
@@ -221,10 +227,18 @@ ToobRecordMono::ToobRecordMono(
     recordingFilePath.reserve(1024);
     recordingDirectory.reserve(1024);
 
-    this->isStereo = channels > 1;
+    this->channelCount = (size_t)channels;
 
     this->recordingDirectory = "/tmp";
     this->bufferPool = std::make_unique<toob::AudioFileBufferPool>(channels, (size_t)rate / 10);
+    // The background thread tops up the pool the next time it wakes up.
+    this->bufferPool->SetLowWatermark(
+        LOW_BUFFER_WATERMARK,
+        [this]()
+        {
+            this->refillRequested.store(true, std::memory_order_relaxed);
+        });
+    this->bufferPool->Reserve(BUFFER_RESERVE);
 
     this->fileBrowserFilesFeature = this->GetFeature<LV2_FileBrowser_Files>(features, LV2_FILEBROWSER__files);
 
@@ -318,6 +332,15 @@ void ToobRecordMono::Activate()
     this->backgroundThread = std::make_unique<std::jthread>(
         [this]()
         {
+        try {
+            // close out takes left behind by a crash or power failure.
+            for (const auto &recoveredFile : toob::AudioFileWriter::RecoverIncompleteFiles(this->recordingDirectory))
+            {
+                LogWarning("Recovered incomplete recording %s\n", recoveredFile.c_str());
+            }
+        } catch (const std::exception &e) {
+            LogError("Recording recovery failed. %s\n", e.what());
+        }
         try {
         bool quit = false;
 
@@ -343,7 +366,7 @@ void ToobRecordMono::Activate()
                 case MessageType::StartRecording:
                 {
                     ToobStartRecordingCommand* startCmd = (ToobStartRecordingCommand*)cmd;
-                    bgStartRecording(startCmd->filename, GetOutputFormat());
+                    bgStartRecording(startCmd->filename, startCmd->outputFormat, startCmd->channels);
                     break;
                 }
                 case MessageType::RecordBuffer:
@@ -366,7 +389,7 @@ void ToobRecordMono::Activate()
                 case MessageType::CuePlayback:
                 {
                     ToobCuePlaybackCommand* cueCmd = (ToobCuePlaybackCommand*)cmd;
-                    bgCuePlayback(cueCmd->filename);
+                    bgCuePlayback(cueCmd->filename, cueCmd->channels);
                     break;
                 }
                 case MessageType::RequestNextPlayBuffer:
@@ -398,6 +421,10 @@ void ToobRecordMono::Activate()
             this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t*)&errorCmd);
     
         }
+        if (this->refillRequested.exchange(false, std::memory_order_relaxed))
+        {
+            bufferPool->Reserve(BUFFER_RESERVE);
+        }
     }
     } catch (std::exception &e) {
         std::stringstream ss;
@@ -407,7 +434,7 @@ void ToobRecordMono::Activate()
         this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t*)&errorCmd);
     }
     bgStopPlaying();
-    bgCloseTempFile();
+    bgAbandonRecording();
 
     FinishedCommand finishedCommand;
     this->fromBackgroundQueue.write_packet(sizeof(FinishedCommand), (uint8_t*)&finishedCommand); });
@@ -444,6 +471,13 @@ void ToobRecordMono::UpdateOutputControls(size_t samplesInFrame)
 
 void ToobRecordMono::StartRecording()
 {
+    this->realtimeBuffer.Attach(this->bufferPool->TakeBuffer());
+    this->realtimeWriteIndex = 0;
+    if (this->realtimeBuffer.Get() == nullptr)
+    {
+        LogError("Can't start recording. Buffer overrun.\n");
+        return;
+    }
 
     this->state = PluginState::Recording;
     ResetPlayTime();
@@ -453,16 +487,13 @@ void ToobRecordMono::StartRecording()
 
     MakeNewRecordingFilename();
 
-    this->realtimeBuffer.Attach(this->bufferPool->TakeBuffer());
-    this->realtimeWriteIndex = 0;
-
-    ToobStartRecordingCommand cmd{this->recordingFilePath, GetOutputFormat()};
+    ToobStartRecordingCommand cmd{this->recordingFilePath, GetOutputFormat(), GetRecordingChannelCount()};
     this->toBackgroundQueue.write_packet(cmd.size, (uint8_t *)&cmd);
 }
 
 void ToobRecordMono::SendBufferToBackground()
 {
-    if (this->state == PluginState::Recording)
+    if (this->state == PluginState::Recording && this->realtimeBuffer.Get() != nullptr)
     {
         auto buffer = this->realtimeBuffer.Detach();
 
@@ -471,6 +502,22 @@ void ToobRecordMono::SendBufferToBackground()
     }
 }
 
+// Replace the buffer that was just sent to the background thread. If the pool has run dry, stop the
+// take (keeping what has been recorded so far) rather than allocate on the realtime thread.
+bool ToobRecordMono::TakeRecordingBuffer()
+{
+    this->realtimeBuffer.Attach(this->bufferPool->TakeBuffer());
+    this->realtimeWriteIndex = 0;
+    if (this->realtimeBuffer.Get() == nullptr)
+    {
+        StopRecording();
+        UpdateOutputControls(0);
+        LogError("Recording stopped. Buffer overrun.\n");
+        return false;
+    }
+    return true;
+}
+
 void ToobRecordMono::StopRecording()
 {
 
@@ -592,10 +639,11 @@ void ToobRecordMono::Mix(uint32_t n_samples)
             {
                 SendBufferToBackground();
 
-
-                this->realtimeBuffer.Attach(this->bufferPool->TakeBuffer());
+                if (!TakeRecordingBuffer())
+                {
+                    break;
+                }
                 buffer = this->realtimeBuffer->GetChannel(0);
-                this->realtimeWriteIndex = 0;
             }
         }
     }
@@ -671,11 +719,12 @@ void ToobRecordStereo::Mix(uint32_t n_samples)
             {
                 SendBufferToBackground();
 
-
-                this->realtimeBuffer.Attach(this->bufferPool->TakeBuffer());
+                if (!TakeRecordingBuffer())
+                {
+                    break;
+                }
                 bufferL = this->realtimeBuffer->GetChannel(0);
-                bufferR = this->realtimeBuffer->GetChannel(0);
-                this->realtimeWriteIndex = 0;
+                bufferR = this->realtimeBuffer->GetChannel(1);
             }
         }
     }
@@ -719,6 +768,150 @@ void ToobRecordStereo::Mix(uint32_t n_samples)
     }
 }
 
+ToobRecordMultitrack::ToobRecordMultitrack(
+    double rate,
+    const char *bundle_path,
+    const LV2_Feature *const *features)
+    : super(rate, bundle_path, features, (int)MAX_TRACKS)
+{
+    for (size_t i = 0; i < MAX_TRACKS; ++i)
+    {
+        inputs[i] = nullptr;
+        outputs[i] = nullptr;
+    }
+}
+
+void ToobRecordMultitrack::ConnectPort(uint32_t port, void *data)
+{
+    if (port == (uint32_t)PortId::TRACKS)
+    {
+        this->tracks = (const float *)data;
+    }
+    else if (port >= (uint32_t)PortId::IN_3 && port < (uint32_t)PortId::OUT_3)
+    {
+        inputs[port - (uint32_t)PortId::IN_3 + 2] = (const float *)data;
+    }
+    else if (port >= (uint32_t)PortId::OUT_3 && port < (uint32_t)PortId::END)
+    {
+        outputs[port - (uint32_t)PortId::OUT_3 + 2] = (float *)data;
+    }
+    else
+    {
+        super::ConnectPort(port, data);
+    }
+}
+
+size_t ToobRecordMultitrack::GetRecordingChannelCount()
+{
+    if (!tracks)
+    {
+        return MAX_TRACKS;
+    }
+    int value = (int)(*tracks);
+    return (size_t)std::clamp(value, 1, (int)MAX_TRACKS);
+}
+
+void ToobRecordMultitrack::Mix(uint32_t n_samples)
+{
+    inputs[0] = in.Get();
+    inputs[1] = inR.Get();
+    outputs[0] = out.Get();
+    outputs[1] = outR.Get();
+
+    auto level = this->level.GetAf();
+
+    // All tracks go into the same buffer, so every track in the file starts on the same frame.
+    // Buffers always carry MAX_TRACKS channels; the background thread writes as many of them
+    // as the file has tracks.
+    if (this->state == PluginState::Recording)
+    {
+        this->playPosition += n_samples;
+
+        uint32_t i = 0;
+        while (i < n_samples)
+        {
+            size_t thisTime = std::min(
+                (size_t)(n_samples - i),
+                this->realtimeBuffer->GetBufferSize() - this->realtimeWriteIndex);
+            for (size_t c = 0; c < MAX_TRACKS; ++c)
+            {
+                const float *src = inputs[c] + i;
+                float *buffer = this->realtimeBuffer->GetChannel(c) + this->realtimeWriteIndex;
+                for (size_t j = 0; j < thisTime; ++j)
+                {
+                    buffer[j] = src[j] * level;
+                }
+            }
+            i += thisTime;
+            this->realtimeWriteIndex += thisTime;
+            if (this->realtimeWriteIndex >= this->realtimeBuffer->GetBufferSize())
+            {
+                SendBufferToBackground();
+
+                if (!TakeRecordingBuffer())
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Hosts may connect any output to the same buffer as any input, so read every input before
+    // writing any output.
+    for (uint32_t i = 0; i < n_samples; ++i)
+    {
+        float values[MAX_TRACKS];
+        float peak = 0;
+        for (size_t c = 0; c < MAX_TRACKS; ++c)
+        {
+            values[c] = inputs[c][i];
+            peak = std::max(peak, std::abs(values[c]));
+        }
+        for (size_t c = 0; c < MAX_TRACKS; ++c)
+        {
+            outputs[c][i] = values[c];
+        }
+        this->level_vu.AddValue(peak * level);
+    }
+
+    if (this->state == PluginState::Playing)
+    {
+        if (!this->fgPlaybackQueue.empty())
+        {
+            this->playPosition += n_samples;
+
+            auto buffer = this->fgPlaybackQueue.front();
+
+            for (uint32_t i = 0; i < n_samples; ++i)
+            {
+                for (size_t c = 0; c < MAX_TRACKS; ++c)
+                {
+                    outputs[c][i] = c < fgPlaybackChannels ? buffer->GetChannel(c)[this->fgPlaybackIndex] : 0;
+                }
+                this->fgPlaybackIndex++;
+
+                if (fgPlaybackIndex == buffer->GetBufferSize())
+                {
+                    fgPlaybackIndex = 0;
+                    fgPlaybackQueue.pop_front();
+                    bufferPool->PutBuffer(buffer);
+                    if (fgPlaybackQueue.empty())
+                    {
+                        this->state = PluginState::Idle;
+                        CuePlayback();
+
+                        break;
+                    }
+                    buffer = fgPlaybackQueue.front();
+
+                    ToobNextPlayBufferCommand cmd;
+                    this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
+                }
+            }
+        }
+    }
+}
+
 void ToobRecordMono::Deactivate()
 {
     QuitCommand cmd;
@@ -736,8 +929,8 @@ void ToobRecordMono::Deactivate()
     this->backgroundThread->join();
     this->backgroundThread.reset();
 
-    bgCloseTempFile();
-    bgStopPlaying();
+    bgAbandonRecording();
+    bgClosePlayback();
 
     while (!fgPlaybackQueue.empty()) {
         bufferPool->PutBuffer(fgPlaybackQueue.pop_front());
@@ -814,184 +1007,85 @@ void ToobRecordMono::CuePlayback(const char *filename)
         SetFilePath(filename);
 
         this->state = PluginState::CuePlaying;
+        this->fgPlaybackChannels = GetRecordingChannelCount();
 
-        ToobCuePlaybackCommand cmd{filename};
+        ToobCuePlaybackCommand cmd{filename, fgPlaybackChannels};
         this->toBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
     }
 }
 
-void ToobRecordMono::bgCloseTempFile()
+void ToobRecordMono::bgAbandonRecording()
 {
-    if (bgFile)
-    {
-        fclose(bgFile);
-        bgFile = nullptr;
-    }
-    if (bgTemporaryFile)
+    // the writer's destructor finalizes what has been recorded so far where the format allows it.
+    bgWriter.reset();
+}
+
+static toob::AudioFileFormat ToAudioFileFormat(OutputFormat outputFormat)
+{
+    switch (outputFormat)
     {
-        bgTemporaryFile.reset();
+    case OutputFormat::Wav:
+        return toob::AudioFileFormat::WavInt16;
+    case OutputFormat::WavFloat:
+        return toob::AudioFileFormat::WavFloat;
+    case OutputFormat::Flac:
+        return toob::AudioFileFormat::Flac;
+    case OutputFormat::Mp3:
+        return toob::AudioFileFormat::Mp3;
+    default:
+        throw std::runtime_error("Invalid output format.");
     }
 }
 
-void ToobRecordMono::bgStartRecording(const char *filename, OutputFormat outputFormat)
+void ToobRecordMono::bgStartRecording(const char *filename, OutputFormat outputFormat, size_t channels)
 {
     bgStopPlaying();
-    bgCloseTempFile();
+    bgAbandonRecording();
     
-    bufferPool->Reserve(10); // nominally up to ~1 second of buffering (with 0.5s pre-roll)
+    bufferPool->Reserve(BUFFER_RESERVE); // nominally up to ~1 second of buffering (with 0.5s pre-roll)
     this->bgRecordingFilePath = filename;
-    this->bgOutputFormat = outputFormat;
+    this->bgRecordingChannels = std::min(channels, bufferPool->GetChannels());
 
-    bgTemporaryFile = std::make_unique<pipedal::TemporaryFile>(bgRecordingFilePath.parent_path(), ".$$$");
-    FILE *file = fopen(bgTemporaryFile->Path().c_str(), "wb");
-    if (!file)
-    {
-        throw std::runtime_error("Failed to open temporary file for recording.");
-    }
-    this->bgFile = file;
+    bgWriter = toob::AudioFileWriter::Create(
+        bgRecordingFilePath,
+        ToAudioFileFormat(outputFormat),
+        (int)bgRecordingChannels,
+        (uint32_t)getRate());
 }
 void ToobRecordMono::bgWriteBuffer(toob::AudioFileBuffer *buffer, size_t count)
 {
 
-    if (!bgFile)
+    if (!bgWriter)
     {
         return;
     }
-    size_t channels = buffer->GetChannelCount();
-    if (channels == 1)
+    const float *channels[toob::AudioFileWriter::MAX_CHANNELS];
+    for (size_t c = 0; c < bgRecordingChannels; ++c)
     {
-        float *data = buffer->GetChannel(0);
-        fwrite(data, sizeof(float), count, bgFile);
+        channels[c] = buffer->GetChannel(c);
     }
-    else if (channels == 2)
+    try {
+        bgWriter->write(channels, count);
+    } catch (const std::exception &)
     {
-        float rawBuffer[1024];
-
-        size_t offset = 0;
-
-        while (count != 0)
-        {
-            size_t thisTime = std::min(count, (size_t)(1024 / 2));
-            float *data0 = buffer->GetChannel(0) + offset;
-            float *data1 = buffer->GetChannel(1) + offset;
-            size_t ix = 0;
-            for (size_t i = 0; i < thisTime; i++)
-            {
-                rawBuffer[ix++] = data0[i];
-                rawBuffer[ix++] = data1[i];
-            }
-            size_t written = fwrite(rawBuffer, sizeof(float), thisTime * 2, bgFile);
-            if (written != thisTime * 2)
-            {
-                std::stringstream ss;
-                ss << "Failed to write to temporary file. " << strerror(errno);
-                bgCloseTempFile();
-                throw std::runtime_error(ss.str());
-            }
-            count -= thisTime;
-            offset += thisTime;
-        }
+        bgAbandonRecording();
+        throw;
     }
-}
-
-static std::string execForOutput(const char *cmd)
-{
-    std::array<char, 128> buffer;
-    std::string result;
-
-    FILE *pipe = popen(cmd, "r");
-
-    if (!pipe)
+    // If the disk is falling behind, grow the buffer pool now, so that the realtime thread
+    // doesn't run out of buffers if writes stall completely.
+    if (bgWriter->writeQueueDepth() * 2 >= bgWriter->maxWriteQueueDepth())
     {
-        throw std::runtime_error("popen() failed!");
+        bufferPool->Reserve(STALLED_WRITE_BUFFER_RESERVE);
     }
-
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr)
-    {
-        result += buffer.data();
-    }
-    int rc = pclose(pipe);
-
-    bool success = WIFEXITED(rc) && WEXITSTATUS(rc) == EXIT_SUCCESS;
-
-    if (!success)
-    {
-        throw std::runtime_error("Command to execute ffmpeg conversion. " + std::string(cmd) + " " + result);
-    }
-
-    return result;
-}
-
-static std::string fileToCmdline(const std::filesystem::path &path)
-{
-    std::string t = path.string();
-
-    std::stringstream ss;
-    ss << '\'';
-    for (char c : t)
-    {
-        if (c == '\'')
-        {
-            ss << "'\\''";
-        }
-        else
-        {
-            ss << c;
-        }
-    }
-    ss << '\'';
-    return ss.str();
 }
 
 void ToobRecordMono::bgStopRecording()
 {
-    if (bgFile)
+    if (bgWriter)
     {
-        fclose(bgFile);
-        bgFile = nullptr;
-
-        std::stringstream s;
-        // ffmpeg -f f32le -ar 48000 -ac 2 -i rawfile.raw -c:a flac -compression_level 12 output.flac
-
-        std::string encodingArgs;
-        std::string extension;
-    switch (bgOutputFormat)
-        {
-        case OutputFormat::Wav:
-        {
-            // encodingArgs = "-acodec pcm_f32le";
-            encodingArgs = "-acodec pcm_s16le";
-            extension = ".wav";
-            break;
-        }
-        case OutputFormat::WavFloat:
-        {
-            encodingArgs = "-acodec pcm_f32le";
-            extension = ".wav";
-            break;
-        }
-        case OutputFormat::Flac:
-        {
-            encodingArgs = "-c:a flac  -sample_fmt s32 -compression_level 12";
-            extension = ".flac";
-            break;
-        }
-        case OutputFormat::Mp3:
-        {
-            encodingArgs = "-codec:a libmp3lame -qscale:a 0";
-            extension = ".mp3";
-            break;
-        }
-        }
-
-        s << "/usr/bin/ffmpeg -y -f f32le -ar " << ((size_t)getRate()) << " -ac " << (isStereo ? 2 : 1)
-          << " -i " << fileToCmdline(bgTemporaryFile->Path())
-          << " " << encodingArgs
-          << " " << fileToCmdline(bgRecordingFilePath) << " 2>&1";
-
-        execForOutput(s.str().c_str());
+        auto writer = std::move(bgWriter);
+        writer->close();
     }
-    bgCloseTempFile();
 
     RecordingStoppedCommand cmd(this->bgRecordingFilePath.c_str());
     this->fromBackgroundQueue.write_packet(sizeof(cmd), (uint8_t *)&cmd);
@@ -1002,6 +1096,11 @@ OutputFormat ToobRecordMono::GetOutputFormat()
     return (OutputFormat)fformat.GetValue();
 }
 
+size_t ToobRecordMono::GetRecordingChannelCount()
+{
+    return channelCount;
+}
+
 std::string ToobRecordMono::RecordingFileExtension()
 {
     switch (GetOutputFormat())
@@ -1120,66 +1219,70 @@ void ToobRecordMono::fgError(const char *message)
 
 AudioFileBuffer *ToobRecordMono::bgReadDecoderBuffer()
 {
-    if (!this->decoderStream)
+    if (!this->decoderStream || bgPlaybackEof)
     {
         return nullptr;
     }
     AudioFileBuffer *buffer = bufferPool->TakeBuffer();
-    size_t channels = buffer->GetChannelCount();
-    size_t count = buffer->GetBufferSize();
-
-    if (channels == 1)
+    if (!buffer)
     {
-        float *data = buffer->GetChannel(0);
-        float *buffers[1] = {data};
-        //
-        auto nRead = this->decoderStream->read(buffers, count);
-        if (nRead != count)
+        // the playback queue has drained the pool. Not the realtime thread, so it's safe to grow it.
+        bufferPool->Reserve(BUFFER_RESERVE);
+        buffer = bufferPool->TakeBuffer();
+        if (!buffer)
         {
-            for (size_t i = nRead; i < count; ++i)
-            {
-                data[i] = 0;
-            }
-            decoderStream.reset();
+            throw std::runtime_error("Out of playback buffers.");
         }
-        return buffer;
     }
-    else if (channels == 2)
-    {
-        float *data0 = buffer->GetChannel(0);
-        float *data1 = buffer->GetChannel(1);
+    size_t count = buffer->GetBufferSize();
 
-        float *buffers[2] = {data0, data1};
-        //
-        auto nRead = this->decoderStream->read(buffers, count);
-        if (nRead != count)
+    float *buffers[toob::AudioFileWriter::MAX_CHANNELS];
+    for (size_t c = 0; c < bgPlaybackChannels; ++c)
+    {
+        buffers[c] = buffer->GetChannel(c);
+    }
+    auto nRead = this->decoderStream->read(buffers, count);
+    if (nRead != count)
+    {
+        for (size_t c = 0; c < bgPlaybackChannels; ++c)
         {
             for (size_t i = nRead; i < count; ++i)
             {
-                data0[i] = 0;
-                data1[i] = 0;
+                buffers[c][i] = 0;
             }
-            decoderStream.reset();
         }
-        return buffer;
-    }
-    else
-    {
-        throw std::runtime_error("Unsupported number of channels.");
+        bgPlaybackEof = true;
     }
+    return buffer;
 }
 
-void ToobRecordMono::bgCuePlayback(const char *filename)
+void ToobRecordMono::bgCuePlayback(const char *filename, size_t channels)
 {
 
     try
     {
-        this->decoderStream = std::make_unique<FfmpegDecoderStream>();
-        decoderStream->open(filename, isStereo ? 2 : 1, (uint32_t)getRate());
+        channels = std::min(channels, bufferPool->GetChannels());
+
+        std::error_code ec;
+        auto fileTime = std::filesystem::last_write_time(filename, ec);
+
+        if (this->decoderStream && channels == bgPlaybackChannels && bgPlaybackFile == filename && fileTime == bgPlaybackFileTime)
+        {
+            decoderStream->seek(0);
+        }
+        else
+        {
+            bgClosePlayback();
+            this->bgPlaybackChannels = channels;
+            this->decoderStream = AudioDecoderStream::Create(filename, (int)bgPlaybackChannels, (uint32_t)getRate());
+            this->bgPlaybackFile = filename;
+            this->bgPlaybackFileTime = fileTime;
+        }
+        bgPlaybackEof = false;
     }
     catch (const std::exception &e)
     {
-        this->decoderStream.reset();
+        bgClosePlayback();
         BackgroundErrorCommmand errorCmd(e.what());
         this->fromBackgroundQueue.write_packet(sizeof(errorCmd), (uint8_t *)&errorCmd);
         return;
@@ -1196,8 +1299,22 @@ void ToobRecordMono::bgCuePlayback(const char *filename)
 }
 
 void ToobRecordMono::bgStopPlaying()
+{
+    if (dynamic_cast<FfmpegDecoderStream *>(this->decoderStream.get()))
+    {
+        // don't leave an ffmpeg process running; it would be restarted to seek anyway.
+        bgClosePlayback();
+        return;
+    }
+    // in-process streams stay open; the next cue of the same file seeks back to the start.
+    this->bgPlaybackEof = true;
+}
+
+void ToobRecordMono::bgClosePlayback()
 {
     this->decoderStream.reset();
+    this->bgPlaybackFile.clear();
+    this->bgPlaybackEof = true;
 }
 
 void ToobRecordMono::fgResetPlaybackQueue()
@@ -1215,8 +1332,6 @@ ToobRecordStereo::ToobRecordStereo(
     const LV2_Feature *const *features)
     : super(rate, bundle_path, features,2)
 {
-    this->isStereo = true;
-
 }
 
 ToobRecordMono::~ToobRecordMono() {
@@ -1349,3 +1464,4 @@ void ToobRecordMono::RequestLoad(const char *filename)
 
 REGISTRATION_DECLARATION PluginRegistration<ToobRecordMono> toobMonoregistration(ToobRecordMono::URI);
 REGISTRATION_DECLARATION PluginRegistration<ToobRecordStereo> toobStereoRegistration(ToobRecordStereo::URI);
+REGISTRATION_DECLARATION PluginRegistration<ToobRecordMultitrack> toobMultitrackRegistration(ToobRecordMultitrack::URI);
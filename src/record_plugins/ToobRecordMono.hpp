@@ -21,6 +21,7 @@
 
 #define DEFINE_LV2_PLUGIN_BASE
 
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <memory>
@@ -28,8 +29,8 @@
 #include "ToobRecordMonoInfo.hpp"
 #include "ToobRecordStereoInfo.hpp"
 #include "AudioFileBufferManager.hpp"
+#include "AudioFileWriter.hpp"
 #include <thread>
-#include "../TemporaryFile.hpp"
 #include <queue>
 #include "../Fifo.hpp"
 
@@ -42,7 +43,7 @@ using namespace record_plugin;
 namespace toob
 {
 	class AudioFileBufferPool;
-	class FfmpegDecoderStream;
+	class AudioDecoderStream;
 };
 
 enum class OutputFormat
@@ -116,8 +117,10 @@ protected:
 
 protected:
 	virtual OutputFormat GetOutputFormat();
+	// Number of channels in new recordings (and in playback of recorded files).
+	virtual size_t GetRecordingChannelCount();
 
-	bool isStereo = false;
+	size_t channelCount = 1;
 
 	bool loadRequested = false;
 
@@ -126,6 +129,7 @@ protected:
 	bool finished = false;
 	std::string RecordingFileExtension();
 	void SendBufferToBackground();
+	bool TakeRecordingBuffer();
 
 	void MakeNewRecordingFilename();
 	void StopRecording();
@@ -166,29 +170,40 @@ protected:
 	std::unique_ptr<std::jthread> backgroundThread;
 
 	std::filesystem::path bgRecordingFilePath;
-	std::unique_ptr<pipedal::TemporaryFile> bgTemporaryFile;
-	FILE *bgFile = nullptr;
-	OutputFormat bgOutputFormat;
+	toob::AudioFileWriter::ptr bgWriter;
+	size_t bgRecordingChannels = 0;
+	static constexpr size_t BUFFER_RESERVE = 20;				   // 2 seconds.
+	// The realtime thread never allocates buffers, so this leaves the background thread a second to refill the pool.
+	static constexpr size_t LOW_BUFFER_WATERMARK = 10;
+	static constexpr size_t STALLED_WRITE_BUFFER_RESERVE = 50; // 5 seconds.
+	std::atomic<bool> refillRequested{false};
 
 	void fgHandleMessages();
 	void fgError(const char *message);
 
-	void bgCloseTempFile();
-	void bgStartRecording(const char *filename, OutputFormat outputFormat);
+	void bgAbandonRecording();
+	void bgStartRecording(const char *filename, OutputFormat outputFormat, size_t channels);
 	void bgWriteBuffer(toob::AudioFileBuffer *buffer, size_t count);
 	void bgStopRecording();
 
 	void bgStopPlaying();
+	void bgClosePlayback();
 
-	std::unique_ptr<toob::FfmpegDecoderStream> decoderStream;
+	// Kept open between cues, so that replaying the same file is a seek rather than a re-open.
+	std::unique_ptr<toob::AudioDecoderStream> decoderStream;
+	std::string bgPlaybackFile;
+	std::filesystem::file_time_type bgPlaybackFileTime;
+	bool bgPlaybackEof = true;
+	size_t bgPlaybackChannels = 0;
 
 	toob::AudioFileBuffer *bgReadDecoderBuffer();
 
 	void fgResetPlaybackQueue();
 
-	void bgCuePlayback(const char *filename);
+	void bgCuePlayback(const char *filename, size_t channels);
 
 	size_t fgPlaybackIndex;
+	size_t fgPlaybackChannels = 1;
 	toob::Fifo<toob::AudioFileBuffer *, 16> fgPlaybackQueue;
 };
 
@@ -214,3 +229,46 @@ public:
 protected:
 	virtual void Mix(uint32_t n_samples) override;
 };
+
+// Records up to MAX_TRACKS inputs, sample-aligned, to a single interleaved WAV or FLAC file.
+// Tracks 1 and 2 use the stereo plugin's in/out and inR/outR ports; the remaining ports follow
+// the stereo plugin's ports.
+class ToobRecordMultitrack : public ToobRecordMono
+{
+public:
+	using super = ToobRecordMono;
+
+	static Lv2Plugin *Create(double rate,
+							 const char *bundle_path,
+							 const LV2_Feature *const *features)
+	{
+		return new ToobRecordMultitrack(rate, bundle_path, features);
+	}
+
+	ToobRecordMultitrack(double rate,
+						 const char *bundle_path,
+						 const LV2_Feature *const *features);
+
+	virtual ~ToobRecordMultitrack() {}
+	static constexpr const char *URI = "http://two-play.com/plugins/toob-record-multitrack";
+
+	static constexpr size_t MAX_TRACKS = toob::AudioFileWriter::MAX_CHANNELS;
+
+protected:
+	virtual void ConnectPort(uint32_t port, void *data) override;
+	virtual size_t GetRecordingChannelCount() override;
+	virtual void Mix(uint32_t n_samples) override;
+
+private:
+	enum class PortId
+	{
+		TRACKS = 15,
+		IN_3 = 16,
+		OUT_3 = IN_3 + MAX_TRACKS - 2,
+		END = OUT_3 + MAX_TRACKS - 2
+	};
+
+	const float *tracks = nullptr;
+	const float *inputs[MAX_TRACKS];
+	float *outputs[MAX_TRACKS];
+};
@@ -19,9 +19,17 @@
 
 #pragma once
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <atomic>
+#include <chrono>
 #include <mutex>
-#include <condition_variable>
+#include <stdexcept>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
 
 namespace toob
 {
@@ -32,6 +40,14 @@ namespace toob
         TimedOut,
         Closed
     };
+
+    // Single-reader packet ring buffer.
+    //
+    // Read and write positions are free-running counters, published with release stores and
+    // observed with acquire loads, so neither the writer nor the reader ever takes a lock (unless
+    // MULTI_WRITER is set, in which case writers serialize among themselves). When SEMAPHORE_READER
+    // is set, the reader can sleep on a futex. Writers only make a system call to wake it if
+    // the reader has announced that it is about to sleep.
     template <bool MULTI_WRITER = false, bool SEMAPHORE_READER = false>
     class ToobRingBuffer
     {
@@ -39,13 +55,19 @@ namespace toob
         bool mlocked = false;
         size_t ringBufferSize;
         size_t ringBufferMask;
-        int64_t readPosition = 0;  // volatile = ordering barrier wrt writePosition
-        int64_t writePosition = 0; // volatile = ordering barrier wrt/ readPosition
-        std::mutex mutex;
+
+        // Separate cache lines, so the reader and writer don't contend for them.
+        alignas(64) std::atomic<size_t> readPosition{0};
+        alignas(64) std::atomic<size_t> writePosition{0};
+
+        alignas(64) std::atomic<uint32_t> readerEpoch{0}; // futex word; incremented whenever the reader should wake.
+        std::atomic<uint32_t> readerWaiting{0};
+        std::atomic<bool> is_open{true};
+
         std::mutex writeMutex;
 
-        bool is_open = true;
-        std::condition_variable cvRead;
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+                      "futex requires a plain 32-bit atomic.");
 
         size_t nextPowerOfTwo(size_t size)
         {
@@ -76,143 +98,87 @@ namespace toob
 #endif
         }
 
+        // Not thread-safe. Call only while neither the reader nor the writer is active.
         void reset()
         {
-            this->readPosition = 0;
-            this->writePosition = 0;
-            this->is_open = true;
-            cvRead.notify_all();
+            this->readPosition.store(0, std::memory_order_relaxed);
+            this->writePosition.store(0, std::memory_order_relaxed);
+            this->is_open.store(true, std::memory_order_release);
+            wakeReader();
         }
         void close()
         {
             if (SEMAPHORE_READER)
             {
-                this->is_open = false;
-                cvRead.notify_all();
+                this->is_open.store(false, std::memory_order_release);
+                wakeReader();
             }
         }
 
         template <class Rep, class Period>
         RingBufferStatus readWait_for(const std::chrono::duration<Rep, Period> &timeout)
         {
-            while (true)
-            {
-                if (SEMAPHORE_READER)
-                {
-                    std::unique_lock lock(mutex);
-                    if (isReadReady_())
-                    {
-                        return RingBufferStatus::Ready;
-                    }
-                    if (!is_open)
-                        return RingBufferStatus::Closed;
-
-                    auto status = cvRead.wait_for(lock, timeout);
-                    if (status == std::cv_status::timeout)
-                    {
-                        return RingBufferStatus::TimedOut;
-                    }
-                }
-                else
-                {
-                    static_assert("SEMAPHORE_READER is not set to true.");
-                }
-            }
+            return readWait_until((size_t)1, std::chrono::steady_clock::now() + timeout);
         }
 
         template <class Clock, class Duration>
         RingBufferStatus readWait_until(const std::chrono::time_point<Clock, Duration> &time_point)
         {
-            while (true)
-            {
-                if (SEMAPHORE_READER)
-                {
-                    std::unique_lock lock(mutex);
-                    if (isReadReady_())
-                    {
-                        return RingBufferStatus::Ready;
-                    }
-                    if (!is_open)
-                        return RingBufferStatus::Closed;
-
-                    auto status = cvRead.wait_until(lock, time_point);
-                    if (status == std::cv_status::timeout)
-                    {
-                        return RingBufferStatus::TimedOut;
-                    }
-                }
-                else
-                {
-                    static_assert("SEMAPHORE_READER is not set to true.");
-                }
-            }
+            return readWait_until((size_t)1, time_point);
         }
         template <class Clock, class Duration>
         RingBufferStatus readWait_until(size_t size, const std::chrono::time_point<Clock, Duration> &time_point)
         {
+            static_assert(SEMAPHORE_READER, "SEMAPHORE_READER is not set to true.");
             while (true)
             {
-                if (SEMAPHORE_READER)
+                uint32_t epoch = readerEpoch.load(std::memory_order_acquire);
+                if (size <= 1 ? isReadReady_() : readSpace_() >= size)
                 {
-                    std::unique_lock lock(mutex);
-                    size_t available = readSpace_();
-                    if (available >= size)
-                    {
-                        return RingBufferStatus::Ready;
-                    }
-                    if (!is_open)
-                        return RingBufferStatus::Closed;
-
-                    auto status = cvRead.wait_until(lock, time_point);
-                    if (status == std::cv_status::timeout)
-                    {
-                        return RingBufferStatus::TimedOut;
-                    }
+                    return RingBufferStatus::Ready;
+                }
+                if (!is_open.load(std::memory_order_acquire))
+                {
+                    return RingBufferStatus::Closed;
                 }
-                else
+                auto remaining = time_point - Clock::now();
+                if (remaining <= remaining.zero())
                 {
-                    static_assert("SEMAPHORE_READER is not set to true.");
+                    return RingBufferStatus::TimedOut;
                 }
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+                struct timespec ts;
+                ts.tv_sec = (time_t)(ns / 1000000000);
+                ts.tv_nsec = (long)(ns % 1000000000);
+                waitForWriter(epoch, &ts);
             }
         }
 
         bool readWait()
         {
-            if (SEMAPHORE_READER)
+            static_assert(SEMAPHORE_READER, "SEMAPHORE_READER is not set to true.");
+            while (true)
             {
-                while (true)
+                uint32_t epoch = readerEpoch.load(std::memory_order_acquire);
+                if (isReadReady_())
                 {
-                    std::unique_lock lock(mutex);
-                    if (isReadReady_())
-                    {
-                        return true;
-                    }
-
-                    if (!is_open)
-                        return false;
-                    cvRead.wait(lock);
+                    return true;
                 }
-            }
-            else
-            {
-                static_assert("SEMAPHORE_READER is not set to true.");
+                if (!is_open.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+                waitForWriter(epoch, nullptr);
             }
         }
         size_t writeSpace()
         {
-            // at most ringBufferSize-1 in order to
-            // to distinguish the empty buffer from the full buffer.
-            std::unique_lock lock(mutex);
-
-            int64_t size = readPosition - 1 - writePosition;
-            if (size < 0)
-                size += this->ringBufferSize;
-            return (size_t)size;
+            size_t size = writePosition.load(std::memory_order_relaxed) - readPosition.load(std::memory_order_acquire);
+            return ringBufferSize - size;
         }
 
         size_t readSpace()
         {
-            std::unique_lock lock(mutex);
             return readSpace_();
         }
 
@@ -221,61 +187,11 @@ namespace toob
             if (MULTI_WRITER)
             {
                 std::lock_guard writeLock{writeMutex};
-                if (!is_open)
-                {
-                    return false;
-                }
-                if (writeSpace() < bytes + sizeof(bytes))
-                {
-                    return false;
-                }
-                size_t index = this->writePosition;
-                for (size_t i = 0; i < sizeof(bytes); ++i)
-                {
-                    buffer[(index++ & ringBufferMask)] = ((uint8_t *)(&bytes))[i];
-                }
-                for (size_t i = 0; i < bytes; ++i)
-                {
-                    buffer[(index++) & ringBufferMask] = ((uint8_t *)data)[i];
-                }
-                {
-                    std::lock_guard lock(mutex);
-                    this->writePosition = (index)&ringBufferMask;
-                }
-                if (SEMAPHORE_READER)
-                {
-                    cvRead.notify_all();
-                }
-                return true;
+                return write_packet_(bytes, data);
             }
             else
             {
-                if (!is_open)
-                {
-                    return false;
-                }
-                if (writeSpace() < bytes + sizeof(bytes))
-                {
-                    return false;
-                }
-                size_t index = this->writePosition;
-                for (size_t i = 0; i < sizeof(bytes); ++i)
-                {
-                    buffer[(index++ & ringBufferMask)] = ((uint8_t *)(&bytes))[i];
-                }
-                for (size_t i = 0; i < bytes; ++i)
-                {
-                    buffer[(index++) & ringBufferMask] = ((uint8_t *)data)[i];
-                }
-                {
-                    std::lock_guard lock(mutex);
-                    this->writePosition = (index)&ringBufferMask;
-                }
-                if (SEMAPHORE_READER)
-                {
-                    cvRead.notify_all();
-                }
-                return true;
+                return write_packet_(bytes, data);
             }
         }
 
@@ -286,7 +202,7 @@ namespace toob
                 return 0;
             }
 
-            if (!is_open)
+            if (!is_open.load(std::memory_order_acquire))
             {
                 throw std::runtime_error("ToobRingBuffer::read_packet: closed.");
             }
@@ -309,7 +225,7 @@ namespace toob
 
         ~ToobRingBuffer()
         {
-#ifdef USE_MLOCK
+#ifndef NO_MLOCK
             if (this->mlocked)
             {
                 munlock(buffer, ringBufferSize);
@@ -320,62 +236,95 @@ namespace toob
         }
         bool isReadReady()
         {
-            std::lock_guard lock(mutex);
             if (isReadReady_())
                 return true;
-            return !this->is_open;
+            return !this->is_open.load(std::memory_order_acquire);
         }
 
         size_t peekSize()
         {
-            std::lock_guard lock(mutex);
             return peekSize_();
         }
 
     private:
-        bool read_(size_t bytes, uint8_t *data)
+        bool write_packet_(size_t bytes, void *data)
         {
-            if (readSpace() < bytes)
-                throw std::runtime_error("ToobRingBuffer::read: not enough data.");
-            int64_t readPosition = this->readPosition;
-            for (size_t i = 0; i < bytes; ++i)
+            if (!is_open.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            if (writeSpace() < bytes + sizeof(bytes))
             {
-                data[i] = this->buffer[(readPosition + i) & this->ringBufferMask];
+                return false;
             }
+            size_t index = this->writePosition.load(std::memory_order_relaxed);
+            copyIn(index, &bytes, sizeof(bytes));
+            copyIn(index + sizeof(bytes), data, bytes);
+            this->writePosition.store(index + sizeof(bytes) + bytes, std::memory_order_release);
+            if (SEMAPHORE_READER)
             {
-                std::lock_guard lock{mutex};
-                this->readPosition = (readPosition + bytes) & this->ringBufferMask;
+                wakeReader();
             }
             return true;
         }
 
-        bool isReadReady_(size_t size)
+        void copyIn(size_t position, const void *data, size_t bytes)
+        {
+            size_t offset = position & ringBufferMask;
+            size_t firstPart = std::min(bytes, ringBufferSize - offset);
+            std::memcpy(buffer + offset, data, firstPart);
+            std::memcpy(buffer, (const char *)data + firstPart, bytes - firstPart);
+        }
+        void copyOut(size_t position, void *data, size_t bytes)
+        {
+            size_t offset = position & ringBufferMask;
+            size_t firstPart = std::min(bytes, ringBufferSize - offset);
+            std::memcpy(data, buffer + offset, firstPart);
+            std::memcpy((char *)data + firstPart, buffer, bytes - firstPart);
+        }
+
+        void wakeReader()
+        {
+            // The seq_cst increment and load pair with the reader's seq_cst store to readerWaiting
+            // and its re-check of readerEpoch in the kernel, so either the reader sees the new epoch,
+            // or we see that it is waiting.
+            readerEpoch.fetch_add(1, std::memory_order_seq_cst);
+            if (readerWaiting.load(std::memory_order_seq_cst) != 0)
+            {
+                syscall(SYS_futex, (uint32_t *)&readerEpoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+            }
+        }
+        void waitForWriter(uint32_t epoch, const struct timespec *timeout)
+        {
+            readerWaiting.store(1, std::memory_order_seq_cst);
+            // returns immediately if a writer has changed readerEpoch since we sampled it.
+            syscall(SYS_futex, (uint32_t *)&readerEpoch, FUTEX_WAIT_PRIVATE, epoch, timeout, nullptr, 0);
+            readerWaiting.store(0, std::memory_order_relaxed);
+        }
+
+        bool read_(size_t bytes, uint8_t *data)
         {
-            size_t available = readSpace();
-            return available >= size;
+            if (readSpace() < bytes)
+                throw std::runtime_error("ToobRingBuffer::read: not enough data.");
+            size_t readPosition = this->readPosition.load(std::memory_order_relaxed);
+            copyOut(readPosition, data, bytes);
+            this->readPosition.store(readPosition + bytes, std::memory_order_release);
+            return true;
         }
 
         size_t readSpace_()
         {
-            int64_t size = writePosition - readPosition;
-            if (size < 0)
-                size += this->ringBufferSize;
-            return size_t(size);
+            return writePosition.load(std::memory_order_acquire) - readPosition.load(std::memory_order_relaxed);
         }
 
-        uint32_t peekSize_()
+        size_t peekSize_()
         {
             size_t available = readSpace_();
-            if (available < sizeof(uint32_t))
+            if (available < sizeof(size_t))
                 return 0;
-            volatile uint32_t result;
-            uint8_t *p = (uint8_t *)&result;
-            size_t ix = this->readPosition;
-            for (size_t i = 0; i < sizeof(result); ++i)
-            {
-                *p++ = this->buffer[(ix++) & ringBufferMask];
-            }
-            if (available < sizeof(uint32_t) + result)
+            size_t result;
+            copyOut(this->readPosition.load(std::memory_order_relaxed), &result, sizeof(result));
+            if (available < sizeof(size_t) + result)
                 return 0;
             return result;
         }